@@ -38,7 +38,9 @@
 #include <xapian/unicode.h>
 
 #include <algorithm>
+#include <cerrno>
 #include <cstdlib> // For abs().
+#include <fstream>
 #include <memory>
 #include <string>
 #include <vector>
@@ -372,6 +374,39 @@ Database::keep_alive()
     internal->keep_alive();
 }
 
+void
+Database::set_term_stats_cache_size(Xapian::termcount max_entries)
+{
+    internal->set_term_stats_cache_size(max_entries);
+}
+
+void
+Database::set_expansion_cache_size(Xapian::termcount max_terms)
+{
+    internal->set_expansion_cache_size(max_terms);
+}
+
+Xapian::termcount
+Database::warm_term_stats_cache(const string& path) const
+{
+    ifstream in(path.c_str());
+    if (!in)
+	throw InvalidArgumentError("Couldn't open term list file: " + path,
+				   errno);
+    Xapian::termcount count = 0;
+    string term;
+    while (getline(in, term)) {
+	if (term.empty())
+	    continue;
+	// Fetching the statistics is enough to put them in the cache.
+	Xapian::doccount termfreq;
+	internal->get_freqs(term, &termfreq, NULL);
+	(void)internal->get_wdf_upper_bound(term);
+	++count;
+    }
+    return count;
+}
+
 string
 Database::get_description() const
 {
@@ -486,6 +521,12 @@ Database::get_uuid() const
     return internal->get_uuid();
 }
 
+string
+Database::get_server_status() const
+{
+    return internal->get_server_status();
+}
+
 bool
 Database::locked() const
 {
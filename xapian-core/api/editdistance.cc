@@ -232,3 +232,55 @@ EditDistanceCalculator::calc(const unsigned* ptr, int len,
     return seqcmp_editdist<unsigned>(ptr, len, &target[0], target.size(),
 				     array, max_distance);
 }
+
+size_t
+EditDistanceCalculator::hopeless_prefix_len(const string& candidate,
+					    int max_distance) const
+{
+    // We calculate the edit distance matrix a row at a time, where row i
+    // holds the edit distances between the first i characters of candidate
+    // and each prefix of the target.  Every path through the matrix to the
+    // final edit distance for any string starting with the first i characters
+    // of candidate must visit row i or (via a transposition) row i - 1, and
+    // costs never decrease along a path, so once the minimum of both those
+    // rows exceeds max_distance no such string can be close enough.
+    const int m = target.size();
+    const int width = m + 1;
+    rows.resize(width * 3);
+    int* prev2 = &rows[0];
+    int* prev = prev2 + width;
+    int* cur = prev + width;
+    for (int j = 0; j != width; ++j) prev[j] = j;
+    int prev_min = 0;
+    unsigned prev_ch = 0;
+
+    using Xapian::Utf8Iterator;
+    Utf8Iterator it(candidate);
+    for (int i = 1; it != Utf8Iterator(); ++i) {
+	unsigned ch = *it;
+	++it;
+	cur[0] = i;
+	int cur_min = i;
+	for (int j = 1; j != width; ++j) {
+	    int cost = (ch == target[j - 1]) ? 0 : 1;
+	    int d = min(min(prev[j], cur[j - 1]) + 1, prev[j - 1] + cost);
+	    if (i > 1 && j > 1 && ch == target[j - 2] &&
+		prev_ch == target[j - 1]) {
+		d = min(d, prev2[j - 2] + 1);
+	    }
+	    cur[j] = d;
+	    cur_min = min(cur_min, d);
+	}
+	if (cur_min > max_distance && prev_min > max_distance) {
+	    return it.raw() - candidate.data();
+	}
+	prev_min = cur_min;
+	prev_ch = ch;
+	int* tmp = prev2;
+	prev2 = prev;
+	prev = cur;
+	cur = tmp;
+    }
+
+    return 0;
+}
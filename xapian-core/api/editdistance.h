@@ -55,6 +55,9 @@ class EditDistanceCalculator {
 
     mutable int* array = nullptr;
 
+    /// Rows of the dynamic programming matrix for hopeless_prefix_len().
+    mutable std::vector<int> rows;
+
     // We sum the character frequency histogram absolute differences to compute
     // a lower bound on the edit distance.  Rather than counting each Unicode
     // code point uniquely, we use an array with VEC_SIZE elements and tally
@@ -142,6 +145,25 @@ class EditDistanceCalculator {
 	// Actually calculate the edit distance.
 	return calc(&utf32[0], utf32.size(), max_distance);
     }
+
+    /** Find a prefix of a candidate which rules out all strings starting
+     *  with it.
+     *
+     *  This allows a caller iterating a sorted list of candidates (e.g. the
+     *  term list) to skip over all the candidates sharing that prefix.
+     *
+     *  @param candidate	String to check prefixes of.
+     *  @param max_distance	The greatest edit distance that's interesting
+     *				to us.
+     *
+     *  @return The length in bytes of the shortest prefix of @a candidate
+     *		such that every string starting with that prefix has an
+     *		edit distance greater than @a max_distance from the target,
+     *		or 0 if there isn't such a prefix.  The prefix always ends at
+     *		a character boundary.
+     */
+    size_t hopeless_prefix_len(const std::string& candidate,
+			       int max_distance) const;
 };
 
 #endif // XAPIAN_INCLUDED_EDITDISTANCE_H
@@ -39,6 +39,7 @@
 #include "xapian/rset.h"
 #include "xapian/weight.h"
 
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -190,9 +191,24 @@ Enquire::clear_matchspies()
 }
 
 void
-Enquire::set_time_limit(double time_limit)
+Enquire::set_time_limit(double time_limit, bool hard)
 {
     internal->time_limit = time_limit;
+    internal->hard_time_limit = hard;
+}
+
+void
+Enquire::set_pruning_factor(double factor)
+{
+    if (!(factor >= 1.0))
+	throw_invalid_arg("Enquire::set_pruning_factor(): factor must be >= 1");
+    internal->pruning_factor = factor;
+}
+
+void
+Enquire::set_remote_shard_stats(bool shard_stats)
+{
+    internal->remote_shard_stats = shard_stats;
 }
 
 MSet
@@ -205,6 +221,18 @@ Enquire::get_mset(doccount first,
     return internal->get_mset(first, maxitems, checkatleast, rset, mdecider);
 }
 
+vector<MSet>
+Enquire::get_msets(const vector<Query>& queries,
+		   doccount first,
+		   doccount maxitems,
+		   doccount checkatleast,
+		   const RSet* rset,
+		   const MatchDecider* mdecider) const
+{
+    return internal->get_msets(queries, first, maxitems, checkatleast,
+			       rset, mdecider);
+}
+
 TermIterator
 Enquire::get_matching_terms_begin(docid did) const
 {
@@ -258,7 +286,66 @@ Enquire::Internal::get_mset(doccount first,
 			    const RSet* rset,
 			    const MatchDecider* mdecider) const
 {
-    if (query.empty()) {
+    // Lazily initialise query_length if it wasn't explicitly specified.
+    if (query_length == 0) {
+	query_length = query.get_length();
+    }
+
+    return run_query(query, query_length,
+		     first, maxitems, checkatleast, rset, mdecider);
+}
+
+vector<MSet>
+Enquire::Internal::get_msets(const vector<Query>& queries,
+			     doccount first,
+			     doccount maxitems,
+			     doccount checkatleast,
+			     const RSet* rset,
+			     const MatchDecider* mdecider) const
+{
+    vector<MSet> msets;
+    msets.reserve(queries.size());
+
+    // Run each distinct query only once.  We can't do this if there are
+    // matchspies or a match decider, as they may rely on seeing the
+    // documents from every query.
+    bool dedup = matchspies.empty() && !mdecider;
+    map<string, size_t> seen;
+    for (auto&& q : queries) {
+	string key;
+	if (dedup) {
+	    try {
+		key = q.serialise();
+	    } catch (const Xapian::UnimplementedError&) {
+		// A PostingSource subclass which doesn't support
+		// serialisation.
+	    }
+	    if (!key.empty()) {
+		auto i = seen.find(key);
+		if (i != seen.end()) {
+		    msets.push_back(msets[i->second]);
+		    continue;
+		}
+		seen.emplace(std::move(key), msets.size());
+	    }
+	}
+	msets.push_back(run_query(q, q.get_length(),
+				  first, maxitems, checkatleast,
+				  rset, mdecider));
+    }
+    return msets;
+}
+
+MSet
+Enquire::Internal::run_query(const Query& q,
+			     termcount qlen,
+			     doccount first,
+			     doccount maxitems,
+			     doccount checkatleast,
+			     const RSet* rset,
+			     const MatchDecider* mdecider) const
+{
+    if (q.empty()) {
 	MSet mset;
 	mset.internal->set_first(first);
 	return mset;
@@ -274,11 +361,6 @@ Enquire::Internal::get_mset(doccount first,
     if (!weight.get())
 	weight.reset(new BM25Weight);
 
-    // Lazily initialise query_length if it wasn't explicitly specified.
-    if (query_length == 0) {
-	query_length = query.get_length();
-    }
-
     Xapian::doccount first_orig = first;
     {
 	Xapian::doccount docs = db.get_doccount();
@@ -288,25 +370,40 @@ Enquire::Internal::get_mset(doccount first,
 	checkatleast = max(checkatleast, first + maxitems);
     }
 
+    const KeyMaker* sorter = sort_functor.get();
+    valueno sort_slot = sort_key;
+    if (sorter) {
+	valueno materialised_slot = sorter->get_materialised_slot();
+	if (materialised_slot != BAD_VALUENO) {
+	    // The keys were stored in a value slot at index time, so we can
+	    // just read them from there instead of calling the KeyMaker.
+	    sort_slot = materialised_slot;
+	    sorter = NULL;
+	}
+    }
+
     unique_ptr<Xapian::Weight::Internal> stats(new Xapian::Weight::Internal);
     ::Matcher match(db,
-		    query,
-		    query_length,
+		    q,
+		    qlen,
 		    rset,
 		    *stats,
 		    *weight,
-		    (sort_functor.get() != NULL),
+		    (sorter != NULL),
 		    (mdecider != NULL),
 		    collapse_key,
 		    collapse_max,
 		    percent_threshold,
 		    weight_threshold,
 		    order,
-		    sort_key,
+		    sort_slot,
 		    sort_by,
 		    sort_val_reverse,
 		    time_limit,
-		    matchspies);
+		    hard_time_limit,
+		    pruning_factor,
+		    matchspies,
+		    remote_shard_stats);
 
     MSet mset = match.get_mset(first,
 			       maxitems,
@@ -314,16 +411,18 @@ Enquire::Internal::get_mset(doccount first,
 			       *stats,
 			       *weight,
 			       mdecider,
-			       sort_functor.get(),
+			       sorter,
 			       collapse_key,
 			       collapse_max,
 			       percent_threshold,
 			       weight_threshold,
 			       order,
-			       sort_key,
+			       sort_slot,
 			       sort_by,
 			       sort_val_reverse,
 			       time_limit,
+			       hard_time_limit,
+			       pruning_factor,
 			       matchspies);
 
     if (first_orig != first && mset.internal.get()) {
@@ -79,10 +79,25 @@ class Enquire::Internal : public Xapian::Internal::intrusive_base {
 
     double time_limit = 0.0;
 
+    bool hard_time_limit = false;
+
+    double pruning_factor = 1.0;
+
+    bool remote_shard_stats = false;
+
     enum { EXPAND_TRAD, EXPAND_BO1 } eweight = EXPAND_TRAD;
 
     double expand_k = 1.0;
 
+    /// Run @a q, which has length @a qlen, with the current settings.
+    MSet run_query(const Query& q,
+		   termcount qlen,
+		   doccount first,
+		   doccount maxitems,
+		   doccount checkatleast,
+		   const RSet* rset,
+		   const MatchDecider* mdecider) const;
+
   public:
     explicit
     Internal(const Database& db_);
@@ -93,6 +108,13 @@ class Enquire::Internal : public Xapian::Internal::intrusive_base {
 		  const RSet* rset,
 		  const MatchDecider* mdecider) const;
 
+    std::vector<MSet> get_msets(const std::vector<Query>& queries,
+				doccount first,
+				doccount maxitems,
+				doccount checkatleast,
+				const RSet* rset,
+				const MatchDecider* mdecider) const;
+
     TermIterator get_matching_terms_begin(docid did) const;
 
     ESet get_eset(termcount maxitems,
@@ -24,6 +24,7 @@
 #include "xapian/keymaker.h"
 
 #include "xapian/document.h"
+#include "xapian/error.h"
 
 #include <string>
 #include <vector>
@@ -34,6 +35,46 @@ namespace Xapian {
 
 KeyMaker::~KeyMaker() { }
 
+Xapian::valueno
+KeyMaker::get_materialised_slot() const
+{
+    return Xapian::BAD_VALUENO;
+}
+
+MaterialisedKeyMaker::MaterialisedKeyMaker(const KeyMaker* keymaker_,
+					   Xapian::valueno slot_)
+    : keymaker(keymaker_), slot(slot_)
+{
+    if (slot == Xapian::BAD_VALUENO) {
+	throw Xapian::InvalidArgumentError("MaterialisedKeyMaker: slot can't "
+					   "be Xapian::BAD_VALUENO");
+    }
+}
+
+void
+MaterialisedKeyMaker::materialise(Xapian::Document& doc) const
+{
+    if (!keymaker.get()) {
+	throw Xapian::InvalidOperationError("MaterialisedKeyMaker::"
+					    "materialise(): no KeyMaker "
+					    "specified");
+    }
+    // Document::add_value() removes the value if passed an empty string.
+    doc.add_value(slot, (*keymaker)(doc));
+}
+
+string
+MaterialisedKeyMaker::operator()(const Xapian::Document& doc) const
+{
+    return doc.get_value(slot);
+}
+
+Xapian::valueno
+MaterialisedKeyMaker::get_materialised_slot() const
+{
+    return slot;
+}
+
 string
 MultiValueKeyMaker::operator()(const Xapian::Document & doc) const
 {
@@ -58,7 +58,27 @@ LeafPostList::get_weight(Xapian::termcount doclen,
 			 Xapian::termcount unique_terms) const
 {
     if (!weight) return 0;
-    double sumpart = weight->get_sumpart(get_wdf(), doclen, unique_terms);
+    double sumpart;
+    // For built-in schemes, call get_sumpart() directly rather than via the
+    // vtable, which also lets the compiler see which function is called.
+    switch (weight->get_kernel_()) {
+	case Xapian::Weight::KERNEL_BM25: {
+	    auto wt = static_cast<const Xapian::BM25Weight*>(weight);
+	    sumpart = wt->Xapian::BM25Weight::get_sumpart(get_wdf(), doclen,
+							  unique_terms);
+	    break;
+	}
+	case Xapian::Weight::KERNEL_BM25PLUS: {
+	    auto wt = static_cast<const Xapian::BM25PlusWeight*>(weight);
+	    sumpart = wt->Xapian::BM25PlusWeight::get_sumpart(get_wdf(),
+							      doclen,
+							      unique_terms);
+	    break;
+	}
+	default:
+	    sumpart = weight->get_sumpart(get_wdf(), doclen, unique_terms);
+	    break;
+    }
     AssertRel(sumpart, <=, weight->get_maxpart());
     return sumpart;
 }
@@ -21,6 +21,7 @@
 #include <config.h>
 
 #include "msetinternal.h"
+#include "xapian/error.h"
 #include "xapian/mset.h"
 
 #include "net/length.h"
@@ -167,6 +168,12 @@ MSet::get_max_attained() const
     return internal->max_attained;
 }
 
+bool
+MSet::is_partial() const
+{
+    return internal->partial;
+}
+
 double
 MSet::get_max_possible() const
 {
@@ -226,7 +233,7 @@ MSet::Internal::fetch(Xapian::doccount first_, Xapian::doccount last) const
     if (first_ <= last) {
 	Xapian::doccount n = last - first_;
 	for (Xapian::doccount i = 0; i <= n; ++i) {
-	    enquire->request_document(items[i].get_docid());
+	    enquire->request_document(items[first_ + i].get_docid());
 	}
     }
 }
@@ -306,6 +313,7 @@ MSet::Internal::merge_stats(const Internal* o)
     uncollapsed_estimated += o->uncollapsed_estimated;
     uncollapsed_upper_bound += o->uncollapsed_upper_bound;
     max_possible = max(max_possible, o->max_possible);
+    if (o->partial) partial = true;
     if (o->max_attained > max_attained) {
 	max_attained = o->max_attained;
 	percent_scale_factor = o->percent_scale_factor;
@@ -335,6 +343,8 @@ MSet::Internal::serialise() const
 
     result += serialise_double(percent_scale_factor);
 
+    result += char('0' + partial);
+
     result += encode_length(items.size());
     for (auto&& item : items) {
 	result += serialise_double(item.get_weight());
@@ -369,6 +379,10 @@ MSet::Internal::unserialise(const char * p, const char * p_end)
 
     percent_scale_factor = unserialise_double(&p, p_end);
 
+    if (p == p_end || (*p != '0' && *p != '1'))
+	throw Xapian::NetworkError("Bad serialised MSet (partial)");
+    partial = (*p++ == '1');
+
     size_t msize;
     decode_length(&p, p_end, msize);
     while (msize-- > 0) {
@@ -83,6 +83,9 @@ class MSet::Internal : public Xapian::Internal::intrusive_base {
     /// Scale factor to convert weights to percentages.
     double percent_scale_factor = 0;
 
+    /// Did the match stop early because of a time limit?
+    bool partial = false;
+
   public:
     Internal() {}
 
@@ -121,6 +124,8 @@ class MSet::Internal : public Xapian::Internal::intrusive_base {
 
     double get_percent_scale_factor() const { return percent_scale_factor; }
 
+    void set_partial() { partial = true; }
+
     Xapian::Document get_document(Xapian::doccount index) const;
 
     void fetch(Xapian::doccount first, Xapian::doccount last) const;
@@ -39,6 +39,7 @@
 
 #include <cfloat>
 #include <memory>
+#include <typeinfo>
 
 using namespace std;
 
@@ -242,6 +243,8 @@ ValueWeightPostingSource::ValueWeightPostingSource(Xapian::valueno slot_)
 {
 }
 
+ValueWeightPostingSource::~ValueWeightPostingSource() { }
+
 double
 ValueWeightPostingSource::get_weight() const
 {
@@ -287,6 +290,7 @@ void
 ValueWeightPostingSource::init(const Database & db_)
 {
     ValuePostingSource::init(db_);
+    block_maxima = NULL;
 
     string upper_bound;
     try {
@@ -302,7 +306,60 @@ ValueWeightPostingSource::init(const Database & db_)
 	set_maxweight(0.0);
     } else {
 	set_maxweight(sortable_unserialise(upper_bound));
+	// The block maxima are only bounds on the weight if get_weight() is
+	// ours, so don't use them for subclasses (which may also override
+	// next(), etc).
+	if (typeid(*this) == typeid(ValueWeightPostingSource)) {
+	    const Database& database = get_database();
+	    block_maxima = database.internal->get_value_block_maxima(get_slot());
+	}
+    }
+}
+
+void
+ValueWeightPostingSource::skip_low_blocks(double min_wt)
+{
+    if (!block_maxima.get() || at_end()) return;
+
+    Xapian::docid did = get_docid();
+    Xapian::docid new_did = block_maxima->skip_low_blocks(did, min_wt);
+    if (new_did == 0) {
+	done();
+	return;
+    }
+    if (new_did != did) {
+	// There's a value in the block we skip to which is at least min_wt,
+	// so this can't land in another block we'd want to skip.
+	ValuePostingSource::skip_to(new_did, min_wt);
+	if (at_end()) return;
     }
+
+    double max_from_here = block_maxima->get_max_from(get_docid());
+    if (max_from_here < get_maxweight())
+	set_maxweight(max_from_here);
+}
+
+void
+ValueWeightPostingSource::next(double min_wt)
+{
+    ValuePostingSource::next(min_wt);
+    skip_low_blocks(min_wt);
+}
+
+void
+ValueWeightPostingSource::skip_to(Xapian::docid min_docid, double min_wt)
+{
+    ValuePostingSource::skip_to(min_docid, min_wt);
+    skip_low_blocks(min_wt);
+}
+
+bool
+ValueWeightPostingSource::check(Xapian::docid min_docid, double min_wt)
+{
+    if (!ValuePostingSource::check(min_docid, min_wt))
+	return false;
+    skip_low_blocks(min_wt);
+    return true;
 }
 
 string
@@ -37,6 +37,12 @@ PostList::get_termfreq_est_using_stats(const Xapian::Weight::Internal &) const
      "get_termfreq_est_using_stats() not meaningful for this PostingIterator");
 }
 
+double
+PostList::get_iteration_cost_est() const
+{
+    return get_termfreq_est();
+}
+
 Xapian::termcount
 PostList::get_wdf() const
 {
@@ -76,6 +76,18 @@ class PostList {
     virtual TermFreqs get_termfreq_est_using_stats(
 	const Xapian::Weight::Internal & stats) const;
 
+    /** Get an estimate of the cost of iterating this postlist.
+     *
+     *  This is measured in the number of entries which need to be looked at
+     *  to iterate through the postlist with next(), and is used when planning
+     *  which sub-postlist of an AND should be iterated, with the others just
+     *  being checked for each candidate.
+     *
+     *  The default implementation returns get_termfreq_est(), which is
+     *  appropriate for postlists which only visit entries which match.
+     */
+    virtual double get_iteration_cost_est() const;
+
     /// Return the current docid.
     virtual Xapian::docid get_docid() const = 0;
 
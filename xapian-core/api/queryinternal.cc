@@ -228,151 +228,39 @@ class Context {
 	pls.resize(new_size);
     }
 
-    /** Expand a wildcard query.
+    /** Expand a wildcard or edit distance query.
      *
-     *  Used with BoolOrContext and OrContext.
-     */
-    void expand_wildcard(const QueryWildcard* query, double factor);
-
-    /** Expand an edit distance query.
+     *  The terms the query expands to are cached by the shard (if it
+     *  supports caching) so running the same query again doesn't need to
+     *  repeat the expansion.
      *
      *  Used with BoolOrContext and OrContext.
      */
-    void expand_edit_distance(const QueryEditDistance* query, double factor);
+    template<typename Q>
+    void expand(const Q* query, double factor);
 };
 
 template<typename T>
+template<typename Q>
 inline void
-Context<T>::expand_wildcard(const QueryWildcard* query,
-			    double factor)
+Context<T>::expand(const Q* query, double factor)
 {
-    unique_ptr<TermList> t(qopt->db.open_allterms(query->get_fixed_prefix()));
-    bool skip_ucase = query->get_fixed_prefix().empty();
-    auto max_type = query->get_max_type();
-    Xapian::termcount expansions_left = query->get_max_expansion();
-    // If there's no expansion limit, set expansions_left to the maximum
-    // value Xapian::termcount can hold.
-    if (expansions_left == 0)
-	--expansions_left;
-    while (true) {
-	t->next();
-done_skip_to:
-	if (t->at_end())
-	    break;
-
-	const string & term = t->get_termname();
-	if (skip_ucase && term[0] >= 'A') {
-	    // If there's a leading wildcard then skip terms that start
-	    // with A-Z, as we don't want the expansion to include prefixed
-	    // terms.
-	    //
-	    // This assumes things about the structure of terms which the
-	    // Query class otherwise doesn't need to care about, but it
-	    // seems hard to avoid here.
-	    skip_ucase = false;
-	    if (term[0] <= 'Z') {
-		static_assert('Z' + 1 == '[', "'Z' + 1 == '['");
-		t->skip_to("[");
-		goto done_skip_to;
-	    }
-	}
-
-	if (!query->test_prefix_known(term)) continue;
-
-	if (max_type < Xapian::Query::WILDCARD_LIMIT_MOST_FREQUENT) {
-	    if (expansions_left-- == 0) {
-		if (max_type == Xapian::Query::WILDCARD_LIMIT_FIRST)
-		    break;
-		string msg("Wildcard ");
-		msg += query->get_pattern();
-		if (query->get_just_flags() == 0)
-		    msg += '*';
-		msg += " expands to more than ";
-		msg += str(query->get_max_expansion());
-		msg += " terms";
-		throw Xapian::WildcardError(msg);
-	    }
-	}
-
-	add_postlist(qopt->open_lazy_post_list(term, 1, factor));
+    string key;
+    query->serialise(key);
+    vector<string> expansion;
+    const vector<string>* terms = qopt->db.find_cached_expansion(key);
+    if (!terms) {
+	query->expand(qopt->db, expansion);
+	terms = qopt->db.cache_expansion(key, expansion);
+	if (!terms)
+	    terms = &expansion;
     }
 
-    if (max_type == Xapian::Query::WILDCARD_LIMIT_MOST_FREQUENT) {
-	// FIXME: open_lazy_post_list() results in the term getting registered
-	// for stats, so we still incur an avoidable cost from the full
-	// expansion size of the wildcard, which is most likely to be visible
-	// with the remote backend.  Perhaps we should split creating the lazy
-	// postlist from registering the term for stats.
-	auto set_size = query->get_max_expansion();
-	if (size() > set_size) {
-	    init_tf();
-	    auto begin = pls.begin();
-	    nth_element(begin, begin + set_size - 1, pls.end(),
-			ComparePostListTermFreqAscending());
-	    shrink(set_size);
-	}
-    }
-}
-
-template<typename T>
-inline void
-Context<T>::expand_edit_distance(const QueryEditDistance* query,
-				 double factor)
-{
-    string pfx(query->get_pattern(), 0, query->get_fixed_prefix_len());
-    unique_ptr<TermList> t(qopt->db.open_allterms(pfx));
-    bool skip_ucase = pfx.empty();
-    auto max_type = query->get_max_type();
-    Xapian::termcount expansions_left = query->get_max_expansion();
-    // If there's no expansion limit, set expansions_left to the maximum
-    // value Xapian::termcount can hold.
-    if (expansions_left == 0)
-	--expansions_left;
-    while (true) {
-	t->next();
-done_skip_to:
-	if (t->at_end())
-	    break;
-
-	const string& term = t->get_termname();
-	if (!startswith(term, pfx))
-	    break;
-	if (skip_ucase && term[0] >= 'A') {
-	    // Skip terms that start with A-Z, as we don't want the expansion
-	    // to include prefixed terms.
-	    //
-	    // This assumes things about the structure of terms which the
-	    // Query class otherwise doesn't need to care about, but it
-	    // seems hard to avoid here.
-	    skip_ucase = false;
-	    if (term[0] <= 'Z') {
-		static_assert('Z' + 1 == '[', "'Z' + 1 == '['");
-		t->skip_to("[");
-		goto done_skip_to;
-	    }
-	}
-
-	if (!query->test(term)) continue;
-
-	if (max_type < Xapian::Query::WILDCARD_LIMIT_MOST_FREQUENT) {
-	    if (expansions_left-- == 0) {
-		if (max_type == Xapian::Query::WILDCARD_LIMIT_FIRST)
-		    break;
-		string msg("Edit distance ");
-		msg += query->get_pattern();
-		msg += '~';
-		msg += str(query->get_threshold());
-		msg += " expands to more than ";
-		msg += str(query->get_max_expansion());
-		msg += " terms";
-		throw Xapian::WildcardError(msg);
-	    }
-	}
-
+    for (auto&& term : *terms) {
 	add_postlist(qopt->open_lazy_post_list(term, 1, factor));
     }
 
-    if (max_type == Xapian::Query::WILDCARD_LIMIT_MOST_FREQUENT) {
+    if (query->get_max_type() == Xapian::Query::WILDCARD_LIMIT_MOST_FREQUENT) {
 	// FIXME: open_lazy_post_list() results in the term getting registered
 	// for stats, so we still incur an avoidable cost from the full
 	// expansion size of the wildcard, which is most likely to be visible
@@ -553,6 +441,29 @@ class AndContext : public Context<PostList*> {
 	PostList * postlist(PostList* pl,
 			    const vector<PostList*>& pls,
 			    PostListTree* pltree) const;
+
+	/** Estimate the cost of this filter per candidate it removes.
+	 *
+	 *  The cost of checking a candidate is roughly proportional to the
+	 *  number of position lists which need to be read, and we use the
+	 *  same guesses for the proportion of candidates which pass as the
+	 *  postlists' get_termfreq_est() methods do.
+	 */
+	double get_rank() const {
+	    double pass;
+	    if (op_ == Xapian::Query::OP_NEAR) {
+		pass = 1.0 / 2;
+	    } else if (window == end - begin) {
+		pass = 1.0 / 4;
+	    } else {
+		pass = 1.0 / 3;
+	    }
+	    return (end - begin) / (1.0 - pass);
+	}
+
+	bool operator<(const PosFilter& o) const {
+	    return get_rank() < o.get_rank();
+	}
     };
 
     list<PosFilter> pos_filters;
@@ -621,11 +532,10 @@ AndContext::postlist()
     unique_ptr<PostList> pl(new MultiAndPostList(pls.begin(), pls.end(),
 						 qopt->matcher, qopt->db_size));
 
-    // Sort the positional filters to try to apply them in an efficient order.
-    // FIXME: We need to figure out what that is!  Try applying lowest cf/tf
-    // first?
-
-    // Apply any positional filters.
+    // Apply any positional filters.  The first filter applied is checked
+    // first, so sort them to minimise the expected cost of eliminating a
+    // candidate - filters which are cheap to check and reject more go first.
+    pos_filters.sort();
     list<PosFilter>::const_iterator i;
     for (i = pos_filters.begin(); i != pos_filters.end(); ++i) {
 	const PosFilter & filter = *i;
@@ -1277,7 +1187,7 @@ QueryWildcard::QueryWildcard(const std::string &pattern_,
       flags(flags_),
       combiner(combiner_)
 {
-    if ((flags & ~Query::WILDCARD_LIMIT_MASK_) == 0) {
+    if ((flags & Query::WILDCARD_PATTERN_GLOB) == 0) {
 	head = min_len = pattern.size();
 	max_len = numeric_limits<decltype(max_len)>::max();
 	prefix = pattern;
@@ -1361,6 +1271,25 @@ default_case:
 	// and the candidate is min_len bytes long.
 	check_pattern = true;
     }
+
+    if (flags & Query::WILDCARD_NGRAM_INDEX) {
+	// Collect the literal parts of the pattern after the fixed prefix
+	// which are long enough to look up in a TermNgramIndex.
+	string fragment;
+	for (i = head; i <= pattern.size(); ++i) {
+	    if (i != pattern.size()) {
+		char ch = pattern[i];
+		if (!(ch == '*' && (flags & Query::WILDCARD_PATTERN_MULTI)) &&
+		    !(ch == '?' && (flags & Query::WILDCARD_PATTERN_SINGLE))) {
+		    fragment += ch;
+		    continue;
+		}
+	    }
+	    if (TermNgramIndex::usable_fragment(fragment))
+		ngram_fragments.push_back(fragment);
+	    fragment.clear();
+	}
+    }
 }
 
 bool
@@ -1424,6 +1353,73 @@ QueryWildcard::test_prefix_known(const string& candidate) const
 			  head);
 }
 
+void
+QueryWildcard::expand(const Xapian::Database::Internal& db,
+		      vector<string>& terms) const
+{
+    unique_ptr<TermList> t;
+    if (use_ngram_index()) {
+	auto ngram_index = db.get_term_ngram_index();
+	if (ngram_index) {
+	    t.reset(ngram_index->open_candidates(get_fixed_prefix(),
+						 get_ngram_fragments()));
+	}
+    }
+    if (!t)
+	t.reset(db.open_allterms(get_fixed_prefix()));
+    bool skip_ucase = get_fixed_prefix().empty();
+    auto max_type = get_max_type();
+    Xapian::termcount expansions_left = get_max_expansion();
+    // If there's no expansion limit, set expansions_left to the maximum
+    // value Xapian::termcount can hold.
+    if (expansions_left == 0)
+	--expansions_left;
+    while (true) {
+	t->next();
+done_skip_to:
+	if (t->at_end())
+	    break;
+
+	const string & term = t->get_termname();
+	if (skip_ucase && term[0] >= 'A') {
+	    // If there's a leading wildcard then skip terms that start
+	    // with A-Z, as we don't want the expansion to include prefixed
+	    // terms.
+	    //
+	    // This assumes things about the structure of terms which the
+	    // Query class otherwise doesn't need to care about, but it
+	    // seems hard to avoid here.
+	    skip_ucase = false;
+	    if (term[0] <= 'Z') {
+		static_assert('Z' + 1 == '[', "'Z' + 1 == '['");
+		t->skip_to("[");
+		goto done_skip_to;
+	    }
+	}
+
+	db.note_wildcard_term_checked();
+	if (!test_prefix_known(term)) continue;
+
+	if (max_type < Xapian::Query::WILDCARD_LIMIT_MOST_FREQUENT) {
+	    if (expansions_left-- == 0) {
+		if (max_type == Xapian::Query::WILDCARD_LIMIT_FIRST)
+		    break;
+		string msg("Wildcard ");
+		msg += get_pattern();
+		if (!(get_just_flags() &
+		      Xapian::Query::WILDCARD_PATTERN_GLOB))
+		    msg += '*';
+		msg += " expands to more than ";
+		msg += str(get_max_expansion());
+		msg += " terms";
+		throw Xapian::WildcardError(msg);
+	    }
+	}
+
+	terms.push_back(term);
+    }
+}
+
 PostList*
 QueryWildcard::postlist(QueryOptimiser * qopt, double factor) const
 {
@@ -1442,7 +1438,7 @@ QueryWildcard::postlist(QueryOptimiser * qopt, double factor) const
 	}
 
 	BoolOrContext ctx(qopt, 0);
-	ctx.expand_wildcard(this, 0.0);
+	ctx.expand(this, 0.0);
 
 	if (op == Query::OP_SYNONYM) {
 	    qopt->inc_total_subqs();
@@ -1467,7 +1463,7 @@ QueryWildcard::postlist(QueryOptimiser * qopt, double factor) const
     }
 
     OrContext ctx(qopt, 0);
-    ctx.expand_wildcard(this, factor);
+    ctx.expand(this, factor);
 
     qopt->set_total_subqs(qopt->get_total_subqs() + ctx.size());
 
@@ -1537,6 +1533,75 @@ QueryEditDistance::test(const string& candidate) const
     return edist <= threshold ? edist + 1 : 0;
 }
 
+void
+QueryEditDistance::expand(const Xapian::Database::Internal& db,
+			  vector<string>& terms) const
+{
+    string pfx(get_pattern(), 0, get_fixed_prefix_len());
+    unique_ptr<TermList> t(db.open_allterms(pfx));
+    bool skip_ucase = pfx.empty();
+    auto max_type = get_max_type();
+    Xapian::termcount expansions_left = get_max_expansion();
+    // If there's no expansion limit, set expansions_left to the maximum
+    // value Xapian::termcount can hold.
+    if (expansions_left == 0)
+	--expansions_left;
+    while (true) {
+	t->next();
+done_skip_to:
+	if (t->at_end())
+	    break;
+
+	const string& term = t->get_termname();
+	if (!startswith(term, pfx))
+	    break;
+	if (skip_ucase && term[0] >= 'A') {
+	    // Skip terms that start with A-Z, as we don't want the expansion
+	    // to include prefixed terms.
+	    //
+	    // This assumes things about the structure of terms which the
+	    // Query class otherwise doesn't need to care about, but it
+	    // seems hard to avoid here.
+	    skip_ucase = false;
+	    if (term[0] <= 'Z') {
+		static_assert('Z' + 1 == '[', "'Z' + 1 == '['");
+		t->skip_to("[");
+		goto done_skip_to;
+	    }
+	}
+
+	if (!test(term)) {
+	    // If a prefix of term is already too far from the pattern for any
+	    // term starting with it to match, skip over all such terms.
+	    size_t len = hopeless_prefix_len(term);
+	    if (len && static_cast<unsigned char>(term[len - 1]) != 0xff) {
+		string next(term, 0, len);
+		++next.back();
+		t->skip_to(next);
+		goto done_skip_to;
+	    }
+	    continue;
+	}
+
+	if (max_type < Xapian::Query::WILDCARD_LIMIT_MOST_FREQUENT) {
+	    if (expansions_left-- == 0) {
+		if (max_type == Xapian::Query::WILDCARD_LIMIT_FIRST)
+		    break;
+		string msg("Edit distance ");
+		msg += get_pattern();
+		msg += '~';
+		msg += str(get_threshold());
+		msg += " expands to more than ";
+		msg += str(get_max_expansion());
+		msg += " terms";
+		throw Xapian::WildcardError(msg);
+	    }
+	}
+
+	terms.push_back(term);
+    }
+}
+
 PostList*
 QueryEditDistance::postlist(QueryOptimiser * qopt, double factor) const
 {
@@ -1555,7 +1620,7 @@ QueryEditDistance::postlist(QueryOptimiser * qopt, double factor) const
 	}
 
 	BoolOrContext ctx(qopt, 0);
-	ctx.expand_edit_distance(this, 0.0);
+	ctx.expand(this, 0.0);
 
 	if (op == Query::OP_SYNONYM) {
 	    qopt->inc_total_subqs();
@@ -1580,7 +1645,7 @@ QueryEditDistance::postlist(QueryOptimiser * qopt, double factor) const
     }
 
     OrContext ctx(qopt, 0);
-    ctx.expand_edit_distance(this, factor);
+    ctx.expand(this, factor);
 
     qopt->set_total_subqs(qopt->get_total_subqs() + ctx.size());
 
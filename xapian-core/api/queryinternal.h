@@ -22,12 +22,17 @@
 #define XAPIAN_INCLUDED_QUERYINTERNAL_H
 
 #include "api/editdistance.h"
+#include "backends/termngramindex.h"
 #include "postlist.h"
 #include "queryvector.h"
 #include "stringutils.h"
+#include "xapian/database.h"
 #include "xapian/intrusive_ptr.h"
 #include "xapian/query.h"
 
+#include <string>
+#include <vector>
+
 /// Default set_size for OP_ELITE_SET:
 const Xapian::termcount DEFAULT_ELITE_SET_SIZE = 10;
 
@@ -435,6 +440,13 @@ class QueryWildcard : public Query::Internal {
 
     std::string prefix, suffix;
 
+    /** Literal parts of the pattern after the prefix to look up n-grams for.
+     *
+     *  Only set if WILDCARD_NGRAM_INDEX was specified, and only contains
+     *  fragments long enough to contain an n-gram.
+     */
+    std::vector<std::string> ngram_fragments;
+
     bool test_wildcard_(const std::string& candidate, size_t o, size_t p,
 			size_t i) const;
 
@@ -452,6 +464,17 @@ class QueryWildcard : public Query::Internal {
 	return startswith(candidate, prefix) && test_prefix_known(candidate);
     }
 
+    /** Find the terms this wildcard expands to.
+     *
+     *  @param db	The database shard to expand in.
+     *  @param terms	Vector to append the terms to.
+     *
+     *  @exception Xapian::WildcardError is thrown if the expansion limit is
+     *		   exceeded and the limit type is WILDCARD_LIMIT_ERROR.
+     */
+    void expand(const Xapian::Database::Internal& db,
+		std::vector<std::string>& terms) const;
+
     Xapian::Query::op get_type() const XAPIAN_NOEXCEPT XAPIAN_PURE_FUNCTION;
 
     std::string get_pattern() const { return pattern; }
@@ -492,6 +515,14 @@ class QueryWildcard : public Query::Internal {
     /// Return the fixed prefix from the wildcard pattern.
     std::string get_fixed_prefix() const { return prefix; }
 
+    /// Should candidate terms be found using a TermNgramIndex?
+    bool use_ngram_index() const { return !ngram_fragments.empty(); }
+
+    /// Literal parts of the pattern after the fixed prefix.
+    const std::vector<std::string>& get_ngram_fragments() const {
+	return ngram_fragments;
+    }
+
     std::string get_description() const;
 };
 
@@ -531,6 +562,25 @@ class QueryEditDistance : public Query::Internal {
      */
     int test(const std::string& candidate) const;
 
+    /** Find a prefix of @a candidate which no match can start with.
+     *
+     *  @return Length of the prefix in bytes, or 0 if there isn't one.
+     */
+    size_t hopeless_prefix_len(const std::string& candidate) const {
+	return edcalc.hopeless_prefix_len(candidate, edit_distance);
+    }
+
+    /** Find the terms this edit distance query expands to.
+     *
+     *  @param db	The database shard to expand in.
+     *  @param terms	Vector to append the terms to.
+     *
+     *  @exception Xapian::WildcardError is thrown if the expansion limit is
+     *		   exceeded and the limit type is WILDCARD_LIMIT_ERROR.
+     */
+    void expand(const Xapian::Database::Internal& db,
+		std::vector<std::string>& terms) const;
+
     Xapian::Query::op get_type() const XAPIAN_NOEXCEPT XAPIAN_PURE_FUNCTION;
 
     std::string get_pattern() const { return pattern; }
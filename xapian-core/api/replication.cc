@@ -32,6 +32,7 @@
 #include "backends/databaseinternal.h"
 #include "backends/databasereplicator.h"
 #include "debuglog.h"
+#include "fd.h"
 #include "filetests.h"
 #include "fileutils.h"
 #include "io_utils.h"
@@ -39,17 +40,29 @@
 #include "pack.h"
 #include "realtime.h"
 #include "net/remoteconnection.h"
+#include "posixy_wrapper.h"
+#include "replicate_utils.h"
 #include "replicationprotocol.h"
+#include "safedirent.h"
+#include "safefcntl.h"
 #include "safesysstat.h"
 #include "safeunistd.h"
 #include "net/length.h"
 #include "str.h"
 #include "unicode/description_append.h"
 
+#ifdef HAVE_POLL_H
+# include <poll.h>
+#else
+# include "safesysselect.h"
+#endif
+
 #include <cerrno>
 #include <fstream>
 #include <memory>
+#include <set>
 #include <string>
+#include <vector>
 
 using namespace std;
 using namespace Xapian;
@@ -59,6 +72,10 @@ using namespace Xapian;
 "# Automatically generated by Xapian::DatabaseReplica v" XAPIAN_VERSION ".\n" \
 "# Do not manually edit - replication operations may regenerate this file.\n"
 
+// The file which marks the offline database as a partial copy, which a copy
+// can be resumed into.
+#define PARTIAL_COPY_MARKER "partialcopy"
+
 [[noreturn]]
 static void
 throw_connection_closed_unexpectedly()
@@ -66,15 +83,28 @@ throw_connection_closed_unexpectedly()
     throw Xapian::NetworkError("Connection closed unexpectedly");
 }
 
-void
-DatabaseMaster::write_changesets_to_fd(int fd,
-				       const string & start_revision,
-				       ReplicationInfo * info) const
+/// Parse a REPL_REPLY_DB_FILEINFO message.
+static void
+parse_file_info(const string & buf, string & name, off_t & size)
+{
+    const char * p = buf.data();
+    const char * end = p + buf.size();
+    uint64_t size_;
+    if (!unpack_string(&p, end, name) || !unpack_uint(&p, end, &size_)) {
+	throw Xapian::NetworkError("Bad database copy file information");
+    }
+    size = off_t(size_);
+}
+
+/** Open the master database for sending changesets.
+ *
+ *  If it can't be opened, a REPL_REPLY_FAIL message is written to @a fd.
+ *
+ *  @return true if @a db was opened successfully.
+ */
+static bool
+open_master_db(const string & path, int fd, Database & db)
 {
-    LOGCALL_VOID(REPLICA, "DatabaseMaster::write_changesets_to_fd", fd | start_revision | info);
-    if (info != NULL)
-	info->clear();
-    Database db;
     try {
 	db = Database(path);
     } catch (const Xapian::DatabaseError & e) {
@@ -82,32 +112,153 @@ DatabaseMaster::write_changesets_to_fd(int fd,
 	conn.send_message(REPL_REPLY_FAIL,
 			  "Can't open database: " + e.get_msg(),
 			  0.0);
-	return;
+	return false;
     }
     if (db.internal->size() != 1) {
 	throw Xapian::InvalidOperationError("DatabaseMaster needs to be pointed at exactly one subdatabase");
     }
+    return true;
+}
+
+/** Extract the revision from @a start_revision.
+ *
+ *  @return true if the replica needs a copy of the whole database (because
+ *	    it doesn't have one, or has a copy of a different database).
+ */
+static bool
+parse_start_revision(const Database & db, const string & start_revision,
+		     string & revision)
+{
+    if (start_revision.empty())
+	return true;
 
     // Extract the UUID from start_revision and compare it to the database.
-    bool need_whole_db = false;
+    const char * ptr = start_revision.data();
+    const char * end = ptr + start_revision.size();
+    size_t uuid_length;
+    decode_length_and_check(&ptr, end, uuid_length);
+    string request_uuid(ptr, uuid_length);
+    ptr += uuid_length;
+    revision.assign(ptr, end - ptr);
+    return request_uuid != db.internal->get_uuid();
+}
+
+/** Wait for up to @a timeout seconds for the other end of @a fd to close.
+ *
+ *  @return true if @a timeout seconds passed without anything happening.
+ */
+static bool
+wait_for_close(int fd, double timeout)
+{
+#ifdef HAVE_POLL
+    struct pollfd fds;
+    fds.fd = fd;
+    fds.events = POLLIN;
+    int result = poll(&fds, 1, int(timeout * 1000));
+#else
+    if (fd >= FD_SETSIZE) {
+	// We can't wait on this fd, so just sleep.
+	RealTime::sleep(RealTime::now() + timeout);
+	return true;
+    }
+    fd_set fdset;
+    FD_ZERO(&fdset);
+    FD_SET(fd, &fdset);
+    struct timeval tv;
+    RealTime::to_timeval(timeout, &tv);
+    int result = select(fd + 1, &fdset, 0, &fdset, &tv);
+#endif
+    if (result < 0) {
+	// Interrupted by a signal, or a temporary failure to allocate memory -
+	// just wait again next time.
+	return errno == EINTR || errno == EAGAIN;
+    }
+    return result == 0;
+}
+
+void
+DatabaseMaster::write_changesets_to_fd(int fd,
+				       const string & start_revision,
+				       ReplicationInfo * info) const
+{
+    LOGCALL_VOID(REPLICA, "DatabaseMaster::write_changesets_to_fd", fd | start_revision | info);
+    if (info != NULL)
+	info->clear();
+    Database db;
+    if (!open_master_db(path, fd, db))
+	return;
+
     string revision;
-    if (start_revision.empty()) {
-	need_whole_db = true;
-    } else {
-	const char * ptr = start_revision.data();
-	const char * end = ptr + start_revision.size();
-	size_t uuid_length;
-	decode_length_and_check(&ptr, end, uuid_length);
-	string request_uuid(ptr, uuid_length);
-	ptr += uuid_length;
-	string db_uuid = db.internal->get_uuid();
-	if (request_uuid != db_uuid) {
-	    need_whole_db = true;
+    bool need_whole_db = parse_start_revision(db, start_revision, revision);
+    db.internal->write_changesets_to_fd(fd, revision, need_whole_db, compress,
+					info);
+}
+
+void
+DatabaseMaster::stream_changesets_to_fd(int fd,
+					const string & start_revision,
+					double check_interval) const
+{
+    LOGCALL_VOID(REPLICA, "DatabaseMaster::stream_changesets_to_fd", fd | start_revision | check_interval);
+    Database db;
+    if (!open_master_db(path, fd, db))
+	return;
+
+    string revision;
+    bool need_whole_db = parse_start_revision(db, start_revision, revision);
+    while (true) {
+	db.internal->write_changesets_to_fd(fd, revision, need_whole_db,
+					    compress, NULL);
+	// The backend reopens db as it goes and stops once it has sent the
+	// revision db is open at, so that's now the replica's revision.
+	need_whole_db = false;
+	revision.resize(0);
+	pack_uint(revision, db.get_revision());
+	string uuid = db.get_uuid();
+
+	double next_heartbeat = RealTime::now() + STREAM_HEARTBEAT_INTERVAL;
+	while (true) {
+	    if (!wait_for_close(fd, check_interval))
+		return;
+	    if (db.reopen())
+		break;
+	    double now = RealTime::now();
+	    if (now >= next_heartbeat) {
+		RemoteConnection conn(-1, fd);
+		conn.send_message(REPL_REPLY_END_OF_CHANGES, string(), 0.0);
+		next_heartbeat = now + STREAM_HEARTBEAT_INTERVAL;
+	    }
 	}
-	revision.assign(ptr, end - ptr);
+	// If the database has been replaced, the replica needs a new copy.
+	if (db.get_uuid() != uuid)
+	    need_whole_db = true;
     }
+}
+
+void
+DatabaseMaster::write_copy_ranges_to_fd(int fd,
+					const string & start_revision,
+					unsigned stream,
+					unsigned n_streams) const
+{
+    LOGCALL_VOID(REPLICA, "DatabaseMaster::write_copy_ranges_to_fd", fd | start_revision | stream | n_streams);
+    if (stream >= n_streams) {
+	throw Xapian::InvalidArgumentError("stream must be less than "
+					   "n_streams");
+    }
+    Database db;
+    if (!open_master_db(path, fd, db))
+	return;
 
-    db.internal->write_changesets_to_fd(fd, revision, need_whole_db, info);
+    string revision;
+    if (!parse_start_revision(db, start_revision, revision)) {
+	// The replica doesn't need a copy.
+	RemoteConnection conn(-1, fd);
+	conn.send_message(REPL_REPLY_END_OF_CHANGES, string(), 0.0);
+	return;
+    }
+    db.internal->write_copy_ranges_to_fd(fd, revision, compress,
+					 stream, n_streams);
 }
 
 string
@@ -175,6 +326,19 @@ class DatabaseReplica::Internal : public Xapian::Internal::intrusive_base {
     /// The remote connection we're using.
     RemoteConnection * conn;
 
+    /** Checksums of the ranges in the partial copy in the offline directory.
+     *
+     *  These are calculated lazily, and then kept up to date as ranges are
+     *  received.
+     */
+    mutable CopyRangeChecksums copy_checksums;
+
+    /// Is copy_checksums up to date?
+    mutable bool copy_checksums_valid = false;
+
+    /// The number of changesets applied to keep (0 for none).
+    unsigned max_changesets = 0;
+
     /** Update the stub database which points to a single database.
      *
      *  The stub database file is created at a separate path, and then
@@ -186,9 +350,57 @@ class DatabaseReplica::Internal : public Xapian::Internal::intrusive_base {
     /** Delete the offline database. */
     void remove_offline_db();
 
+    /// Is the offline database a partial copy?
+    bool have_partial_copy() const;
+
+    /// List the files in the partial copy.
+    vector<string> list_partial_copy() const;
+
+    /// Calculate copy_checksums from the files in the partial copy.
+    void calculate_copy_checksums() const;
+
+    /** Prepare to receive a copy in the offline directory.
+     *
+     *  A partial copy which is already there is kept, and anything else
+     *  is removed.
+     */
+    void start_partial_copy();
+
+    /** Open a file in the partial copy, and set its size.
+     *
+     *  @param name	The name of the file.
+     *  @param size	The size to set.  If @a shrink is false and the file
+     *			is already larger, this is set to its actual size.
+     *  @param shrink	Should the file be shrunk if it's larger than @a size?
+     *
+     *  @return		The open file descriptor.
+     */
+    int open_copy_file(const string & name, off_t & size, bool shrink);
+
+    /** Write the range in a REPL_REPLY_DB_FILERANGE message to a file.
+     *
+     *  @param fd	The file descriptor to write to.
+     *  @param name	The name of the file.
+     *  @param size	The size of the file.
+     *  @param buf	The message.
+     */
+    void apply_copy_range(int fd, const string & name, off_t size,
+			  const string & buf);
+
+    /// A connection which apply_copy_ranges() is reading from.
+    struct CopyStream;
+
+    /** Read a message from one of the connections in apply_copy_ranges().
+     *
+     *  @return false once the connection has sent all its ranges.
+     */
+    bool read_copy_stream(CopyStream & stream);
+
     /** Apply a set of DB copy messages from the connection.
+     *
+     *  @return false if the copy was cut short.
      */
-    void apply_db_copy(double end_time);
+    bool apply_db_copy(double end_time);
 
     /** Check that a message type is as expected.
      *
@@ -228,6 +440,14 @@ class DatabaseReplica::Internal : public Xapian::Internal::intrusive_base {
     bool apply_next_changeset(ReplicationInfo * info,
 			      double reader_close_time);
 
+    /// Receive parts of a copy of the whole database.
+    void apply_copy_ranges(const vector<int> & fds);
+
+    /// Keep changesets applied so the replica can be used as a master.
+    void set_relay_changesets(unsigned max_changesets_) {
+	max_changesets = max_changesets_;
+    }
+
     /// Return a string describing this object.
     string get_description() const { return path; }
 };
@@ -270,6 +490,20 @@ DatabaseReplica::apply_next_changeset(ReplicationInfo * info,
     RETURN(internal->apply_next_changeset(info, reader_close_time));
 }
 
+void
+DatabaseReplica::apply_copy_ranges(const vector<int> & fds)
+{
+    LOGCALL_VOID(REPLICA, "DatabaseReplica::apply_copy_ranges", fds);
+    internal->apply_copy_ranges(fds);
+}
+
+void
+DatabaseReplica::set_relay_changesets(unsigned max_changesets)
+{
+    LOGCALL_VOID(REPLICA, "DatabaseReplica::set_relay_changesets", max_changesets);
+    internal->set_relay_changesets(max_changesets);
+}
+
 string
 DatabaseReplica::get_description() const
 {
@@ -354,27 +588,42 @@ string
 DatabaseReplica::Internal::get_revision_info() const
 {
     LOGCALL(REPLICA, string, "DatabaseReplica::Internal::get_revision_info", NO_ARGS);
+    bool partial_copy = have_partial_copy();
+    string buf;
     if (live_db_corrupt) {
-	RETURN(string());
-    }
+	if (!partial_copy) {
+	    RETURN(string());
+	}
+	// An empty UUID ensures a copy will be sent, and we still need to
+	// describe the partial copy.
+	buf = encode_length(0);
+	pack_uint(buf, 0u);
+    } else {
+	switch (live_db.internal->size()) {
+	    case 0:
+		live_db = WritableDatabase(get_replica_path(live_id),
+					   Xapian::DB_OPEN);
+		break;
+	    case 1:
+		// OK
+		break;
+	    default:
+		throw Xapian::InvalidOperationError("DatabaseReplica needs to "
+						    "be pointed at exactly "
+						    "one subdatabase");
+	}
 
-    switch (live_db.internal->size()) {
-	case 0:
-	    live_db = WritableDatabase(get_replica_path(live_id), Xapian::DB_OPEN);
-	    break;
-	case 1:
-	    // OK
-	    break;
-	default:
-	    throw Xapian::InvalidOperationError("DatabaseReplica needs to be "
-						"pointed at exactly one "
-						"subdatabase");
+	string uuid = live_db.get_uuid();
+	buf = encode_length(uuid.size());
+	buf += uuid;
+	pack_uint(buf, live_db.get_revision());
     }
 
-    string uuid = live_db.get_uuid();
-    string buf = encode_length(uuid.size());
-    buf += uuid;
-    pack_uint(buf, live_db.get_revision());
+    if (partial_copy) {
+	if (!copy_checksums_valid)
+	    calculate_copy_checksums();
+	copy_checksums.serialise(buf);
+    }
     RETURN(buf);
 }
 
@@ -384,24 +633,250 @@ DatabaseReplica::Internal::remove_offline_db()
     // Delete the offline database.
     removedir(get_replica_path(live_id ^ 1));
     have_offline_db = false;
+    copy_checksums.clear();
+    copy_checksums_valid = false;
+}
+
+bool
+DatabaseReplica::Internal::have_partial_copy() const
+{
+    string marker = get_replica_path(live_id ^ 1);
+    marker += "/" PARTIAL_COPY_MARKER;
+    return file_exists(marker);
+}
+
+vector<string>
+DatabaseReplica::Internal::list_partial_copy() const
+{
+    string offline_path = get_replica_path(live_id ^ 1);
+    DIR * dir = opendir(offline_path.c_str());
+    if (!dir) {
+	throw Xapian::DatabaseError("Couldn't read directory '" +
+				    offline_path + "'", errno);
+    }
+    vector<string> names;
+    struct dirent * entry;
+    while ((entry = readdir(dir)) != NULL) {
+	string name(entry->d_name);
+	if (name == "." || name == ".." || name == PARTIAL_COPY_MARKER)
+	    continue;
+	names.push_back(name);
+    }
+    closedir(dir);
+    return names;
 }
 
 void
-DatabaseReplica::Internal::apply_db_copy(double end_time)
+DatabaseReplica::Internal::calculate_copy_checksums() const
 {
-    have_offline_db = true;
-    last_live_changeset_time = 0;
     string offline_path = get_replica_path(live_id ^ 1);
-    // If there's already an offline database, discard it.  This happens if one
-    // copy of the database was sent, but further updates were needed before it
-    // could be made live, and the remote end was then unable to send those
-    // updates (probably due to not having changesets available, or the remote
-    // database being replaced by a new database).
+    offline_path += '/';
+    copy_checksums.clear();
+    for (const string & name : list_partial_copy()) {
+	string filepath = offline_path + name;
+	FD fd(posixy_open(filepath.c_str(), O_RDONLY | O_CLOEXEC));
+	if (fd >= 0)
+	    copy_checksums.add_file(name, fd);
+    }
+    copy_checksums_valid = true;
+}
+
+void
+DatabaseReplica::Internal::start_partial_copy()
+{
+    if (have_partial_copy()) {
+	if (!copy_checksums_valid)
+	    calculate_copy_checksums();
+	return;
+    }
+
+    string offline_path = get_replica_path(live_id ^ 1);
     removedir(offline_path);
     if (mkdir(offline_path.c_str(), 0777)) {
 	throw Xapian::DatabaseError("Cannot make directory '" +
 				    offline_path + "'", errno);
     }
+    string marker = offline_path + "/" PARTIAL_COPY_MARKER;
+    FD fd(posixy_open(marker.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0666));
+    if (fd < 0) {
+	throw Xapian::DatabaseError("Cannot create '" + marker + "'", errno);
+    }
+    copy_checksums.clear();
+    copy_checksums_valid = true;
+}
+
+int
+DatabaseReplica::Internal::open_copy_file(const string & name, off_t & size,
+					  bool shrink)
+{
+    // Check that the filename doesn't contain '..'.  No valid database file
+    // contains .., so we don't need to check that the .. is a path.
+    if (name.find("..") != string::npos) {
+	throw NetworkError("Filename in database contains '..'");
+    }
+
+    string filepath = get_replica_path(live_id ^ 1);
+    filepath += '/';
+    filepath += name;
+    int fd = posixy_open(filepath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if (fd < 0) {
+	throw Xapian::DatabaseError("Cannot open '" + filepath + "'", errno);
+    }
+    off_t current_size = file_size(fd);
+    if (size > current_size || (shrink && size != current_size)) {
+	if (ftruncate(fd, size) < 0) {
+	    int saved_errno = errno;
+	    ::close(fd);
+	    throw Xapian::DatabaseError("Cannot set size of '" + filepath +
+					"'", saved_errno);
+	}
+    } else {
+	size = current_size;
+    }
+    copy_checksums.set_file_size(name, size);
+    return fd;
+}
+
+void
+DatabaseReplica::Internal::apply_copy_range(int fd, const string & name,
+					    off_t size, const string & buf)
+{
+    const char * p = buf.data();
+    const char * end = p + buf.size();
+    uint64_t offset, checksum;
+    if (!unpack_uint(&p, end, &offset) || !unpack_uint(&p, end, &checksum)) {
+	throw NetworkError("Bad database copy range");
+    }
+    size_t len = end - p;
+    if (fd < 0 ||
+	offset % DB_COPY_RANGE_SIZE != 0 ||
+	len > DB_COPY_RANGE_SIZE ||
+	offset + len > uint64_t(size)) {
+	throw NetworkError("Bad database copy range");
+    }
+    if (CopyRangeChecksums::checksum(p, len) != checksum) {
+	throw NetworkError("Checksum mismatch in database copy");
+    }
+    io_pwrite(fd, p, len, off_t(offset));
+    // If the range is short (because the file shrank on the master while it
+    // was being read) the rest of it is stale, so don't record the checksum.
+    if (len == DB_COPY_RANGE_SIZE || offset + len == uint64_t(size))
+	copy_checksums.set_range(name, off_t(offset), checksum);
+}
+
+struct DatabaseReplica::Internal::CopyStream {
+    /// The connection.
+    RemoteConnection conn;
+
+    /// The file which ranges are currently being received for.
+    FD file_fd;
+
+    /// The name of that file.
+    string filename;
+
+    /// The size of that file.
+    off_t file_size = 0;
+
+    /// Has this connection sent all its ranges?
+    bool done = false;
+
+    explicit CopyStream(int fd) : conn(fd, -1) { }
+};
+
+bool
+DatabaseReplica::Internal::read_copy_stream(CopyStream & stream)
+{
+    string buf;
+    int type = stream.conn.get_message(buf, 0.0);
+    switch (type) {
+	case REPL_REPLY_END_OF_CHANGES:
+	    return false;
+	case REPL_REPLY_DB_FILEINFO: {
+	    string name;
+	    off_t file_size;
+	    parse_file_info(buf, name, file_size);
+	    start_partial_copy();
+	    // Another connection may have seen a larger size, so don't shrink
+	    // the file - the copy is finished by apply_next_changeset().
+	    stream.file_fd = open_copy_file(name, file_size, false);
+	    stream.filename = name;
+	    stream.file_size = file_size;
+	    return true;
+	}
+	case REPL_REPLY_DB_FILERANGE:
+	    apply_copy_range(stream.file_fd, stream.filename, stream.file_size,
+			     buf);
+	    return true;
+	case REPL_REPLY_FAIL:
+	    throw NetworkError("Unable to fully synchronise: " + buf);
+	case -1:
+	    throw_connection_closed_unexpectedly();
+	default:
+	    throw NetworkError("Unknown replication protocol message (" +
+			       str(type) + ")");
+    }
+}
+
+void
+DatabaseReplica::Internal::apply_copy_ranges(const vector<int> & fds)
+{
+    LOGCALL_VOID(REPLICA, "DatabaseReplica::Internal::apply_copy_ranges", fds);
+    vector<unique_ptr<CopyStream>> streams;
+    for (int fd : fds) {
+	streams.emplace_back(new CopyStream(fd));
+    }
+
+    size_t active = streams.size();
+    while (active) {
+#ifdef HAVE_POLL
+	// Read from whichever connections have data, so one slow connection
+	// doesn't hold up the others.
+	vector<struct pollfd> pfds;
+	vector<CopyStream *> pstreams;
+	for (auto&& stream : streams) {
+	    if (stream->done)
+		continue;
+	    struct pollfd pfd;
+	    pfd.fd = stream->conn.get_read_fd();
+	    pfd.events = POLLIN;
+	    pfd.revents = 0;
+	    pfds.push_back(pfd);
+	    pstreams.push_back(stream.get());
+	}
+	if (poll(pfds.data(), pfds.size(), -1) < 0) {
+	    if (errno == EINTR || errno == EAGAIN)
+		continue;
+	    throw NetworkError("poll failed during database copy", errno);
+	}
+	for (size_t i = 0; i != pfds.size(); ++i) {
+	    if (pfds[i].revents && !read_copy_stream(*pstreams[i])) {
+		pstreams[i]->done = true;
+		--active;
+	    }
+	}
+#else
+	// Without poll(), just read from each connection in turn.
+	for (auto&& stream : streams) {
+	    if (!stream->done && !read_copy_stream(*stream)) {
+		stream->done = true;
+		--active;
+	    }
+	}
+#endif
+    }
+}
+
+bool
+DatabaseReplica::Internal::apply_db_copy(double end_time)
+{
+    have_offline_db = true;
+    last_live_changeset_time = 0;
+    string offline_path = get_replica_path(live_id ^ 1);
+    // If there's already an offline database, keep it if it's a copy (perhaps
+    // interrupted, or perhaps complete but needing further updates which the
+    // remote end was then unable to send) - the master will only have sent
+    // the ranges of it which don't match.  Anything else is discarded.
+    start_partial_copy();
 
     {
 	string buf;
@@ -416,16 +891,35 @@ DatabaseReplica::Internal::apply_db_copy(double end_time)
     }
 
     // Now, read the files for the database from the connection and create it.
+    set<string> filenames;
+    FD file_fd;
+    string filename;
+    off_t file_size = 0;
     while (true) {
-	string filename;
 	int type = conn->sniff_next_message_type(end_time);
 	if (type < 0 || type == REPL_REPLY_FAIL)
-	    return;
+	    return false;
 	if (type == REPL_REPLY_DB_FOOTER)
 	    break;
 
-	type = conn->get_message(filename, end_time);
+	string buf;
+	type = conn->get_message(buf, end_time);
+	if (type == REPL_REPLY_DB_FILERANGE) {
+	    apply_copy_range(file_fd, filename, file_size, buf);
+	    continue;
+	}
+	if (type == REPL_REPLY_DB_FILEINFO) {
+	    parse_file_info(buf, filename, file_size);
+	    file_fd = open_copy_file(filename, file_size, true);
+	    filenames.insert(filename);
+	    continue;
+	}
+
+	// An older master sends each file in a single message.
 	check_message_type(type, REPL_REPLY_DB_FILENAME);
+	filename = buf;
+	filenames.insert(filename);
+	copy_checksums_valid = false;
 
 	// Check that the filename doesn't contain '..'.  No valid database
 	// file contains .., so we don't need to check that the .. is a path.
@@ -435,7 +929,7 @@ DatabaseReplica::Internal::apply_db_copy(double end_time)
 
 	type = conn->sniff_next_message_type(end_time);
 	if (type < 0 || type == REPL_REPLY_FAIL)
-	    return;
+	    return false;
 
 	string filepath = offline_path + "/" + filename;
 	type = conn->receive_file(filepath, end_time);
@@ -446,6 +940,14 @@ DatabaseReplica::Internal::apply_db_copy(double end_time)
     int type = conn->get_message(offline_needed_revision, end_time);
     check_message_type(type, REPL_REPLY_DB_FOOTER);
     need_copy_next = false;
+
+    // Remove any files left from a partial copy which the master no longer
+    // has.
+    for (const string & name : list_partial_copy()) {
+	if (filenames.count(name) == 0)
+	    io_unlink(offline_path + "/" + name);
+    }
+    return true;
 }
 
 void
@@ -494,6 +996,7 @@ DatabaseReplica::Internal::possibly_make_offline_live()
     // will be thrown before we make the new database live.
     live_db = WritableDatabase(replica_path, Xapian::DB_OPEN);
     live_db_corrupt = false;
+    io_unlink(replica_path + "/" PARTIAL_COPY_MARKER);
     update_stub_database();
     remove_offline_db();
     return true;
@@ -522,9 +1025,13 @@ DatabaseReplica::Internal::apply_next_changeset(ReplicationInfo * info,
 		RETURN(false);
 	    }
 	    case REPL_REPLY_DB_HEADER:
-		// Apply the copy - remove offline db in case of any error.
+		// Apply the copy.  If it's cut short, keep what we received (if
+		// the master sent ranges) so the copy can be resumed.
 		try {
-		    apply_db_copy(0.0);
+		    if (!apply_db_copy(0.0)) {
+			have_offline_db = false;
+			break;
+		    }
 		    if (info != NULL)
 			++(info->fullcopy_count);
 		    string replica_uuid;
@@ -544,7 +1051,11 @@ DatabaseReplica::Internal::apply_next_changeset(ReplicationInfo * info,
 			need_copy_next = true;
 		    }
 		} catch (...) {
-		    remove_offline_db();
+		    if (have_partial_copy()) {
+			have_offline_db = false;
+		    } else {
+			remove_offline_db();
+		    }
 		    throw;
 		}
 		if (possibly_make_offline_live()) {
@@ -575,6 +1086,7 @@ DatabaseReplica::Internal::apply_next_changeset(ReplicationInfo * info,
 		    {
 			unique_ptr<DatabaseReplicator> replicator(
 				DatabaseReplicator::open(replica_path));
+			replicator->set_max_changesets(max_changesets);
 
 			// Ignore the returned revision number, since we are
 			// live so the changeset must be safe to apply to a
@@ -596,9 +1108,11 @@ DatabaseReplica::Internal::apply_next_changeset(ReplicationInfo * info,
 		{
 		    unique_ptr<DatabaseReplicator> replicator(
 			    DatabaseReplicator::open(get_replica_path(live_id ^ 1)));
+		    replicator->set_max_changesets(max_changesets);
 
 		    offline_revision = replicator->
 			    apply_changeset_from_conn(*conn, 0.0, false);
+		    copy_checksums_valid = false;
 
 		    if (info != NULL) {
 			++(info->changeset_count);
@@ -26,6 +26,7 @@
 #include "xapian/visibility.h"
 
 #include <string>
+#include <vector>
 
 namespace Xapian {
 
@@ -62,6 +63,9 @@ class XAPIAN_VISIBILITY_DEFAULT DatabaseMaster {
     /// The path to the master database.
     std::string path;
 
+    /// Should the changesets and database files written be compressed?
+    bool compress = false;
+
   public:
     /** Create a new DatabaseMaster for the database at the specified path.
      *
@@ -70,6 +74,14 @@ class XAPIAN_VISIBILITY_DEFAULT DatabaseMaster {
      */
     explicit DatabaseMaster(const std::string & path_) : path(path_) {}
 
+    /** Set whether to compress the changesets and database files written.
+     *
+     *  DatabaseReplica accepts either form, so this can be enabled without
+     *  changing the replicas.  It's worthwhile if the network is slower
+     *  than zlib.
+     */
+    void set_compression(bool compress_) { compress = compress_; }
+
     /** Write a set of changesets for upgrading the database to a file.
      *
      *  The changesets will be such that, if they are applied in order to a
@@ -102,6 +114,66 @@ class XAPIAN_VISIBILITY_DEFAULT DatabaseMaster {
 				const std::string & start_revision,
 				ReplicationInfo * info) const;
 
+    /** Write changesets to a file descriptor as the database changes.
+     *
+     *  This first writes the same as write_changesets_to_fd(), but rather
+     *  than returning it then keeps @a fd open and waits for the database
+     *  to change.  Each new revision is written as a set of changesets
+     *  (ending with the same end-of-changes marker) as soon as it is seen,
+     *  so a DatabaseReplica reading from the other end can apply it
+     *  without having to reconnect and ask.  If the database doesn't change
+     *  for a while, an empty set of changes is written periodically so that
+     *  socket timeouts don't expire on an idle connection.
+     *
+     *  The other end isn't expected to write anything to @a fd, so it must
+     *  be a socket or pipe - this method returns once @a fd becomes readable
+     *  or reports an error, which is taken to mean that the other end has
+     *  closed the connection.
+     *
+     *  @param fd       An open socket or pipe to write the changes to.
+     *
+     *  @param start_revision The starting revision of the database that the
+     *                  changesets are to be applied to, as for
+     *                  write_changesets_to_fd().
+     *
+     *  @param check_interval  How often to check for a new revision (in
+     *                  seconds).
+     *
+     *  @since Added in Xapian 1.5.0.
+     */
+    void stream_changesets_to_fd(int fd,
+				 const std::string & start_revision,
+				 double check_interval = 0.1) const;
+
+    /** Write part of a copy of the database to a file descriptor.
+     *
+     *  This allows a replica which needs a copy of the whole database to
+     *  receive it over several connections at once - see
+     *  DatabaseReplica::apply_copy_ranges().
+     *
+     *  The files in the database are divided into ranges, and this only
+     *  writes ranges whose index modulo @a n_streams is @a stream, and which
+     *  @a start_revision doesn't show that the replica already has.  If
+     *  @a start_revision shows that the replica doesn't need a copy, only
+     *  an end-of-changes marker is written.
+     *
+     *  @param fd       An open file descriptor to write the ranges to.
+     *
+     *  @param start_revision The revision of the replica, as returned by
+     *                  DatabaseReplica::get_revision_info().
+     *
+     *  @param stream   Which share of the ranges to write (0 to
+     *                  @a n_streams - 1).
+     *
+     *  @param n_streams  The number of shares the ranges are divided into.
+     *
+     *  @since Added in Xapian 1.5.0.
+     */
+    void write_copy_ranges_to_fd(int fd,
+				 const std::string & start_revision,
+				 unsigned stream,
+				 unsigned n_streams) const;
+
     /// Return a string describing this object.
     std::string get_description() const;
 };
@@ -148,6 +220,12 @@ class XAPIAN_VISIBILITY_DEFAULT DatabaseReplica {
      *  revision of the master database that the replica represents.  This
      *  information allows the master database to send the appropriate
      *  changeset to mirror whatever changes have been made on the master.
+     *
+     *  If a previous copy of the whole database was interrupted, it also
+     *  includes checksums of the parts of the copy which were received, so
+     *  that the master only needs to send the rest.  Calculating these
+     *  requires reading the partial copy, unless it was received by this
+     *  object.
      */
     std::string get_revision_info() const;
 
@@ -193,6 +271,49 @@ class XAPIAN_VISIBILITY_DEFAULT DatabaseReplica {
     bool apply_next_changeset(ReplicationInfo * info,
 			      double reader_close_time);
 
+    /** Receive parts of a copy of the whole database.
+     *
+     *  Each of @a fds should be reading the output of
+     *  DatabaseMaster::write_copy_ranges_to_fd() for a different @a stream,
+     *  all with the same @a n_streams and with @a start_revision set to the
+     *  result of get_revision_info().  The ranges are read from all of them
+     *  at once and stored in a partial copy of the database, and this
+     *  returns once all have been read.
+     *
+     *  The copy is completed by calling get_revision_info() again and then
+     *  applying the changes from DatabaseMaster::write_changesets_to_fd() in
+     *  the usual way - the master then only sends ranges which have changed
+     *  since.
+     *
+     *  If the master doesn't think a copy is needed, nothing is stored.
+     *
+     *  @param fds	The file descriptors to read from.  The caller is
+     *			responsible for closing them.
+     *
+     *  @since Added in Xapian 1.5.0.
+     */
+    void apply_copy_ranges(const std::vector<int> & fds);
+
+    /** Keep the changesets applied to the replica.
+     *
+     *  The changesets are stored in the replica's database in the same way
+     *  as a master database stores them when XAPIAN_MAX_CHANGESETS is set,
+     *  so a DatabaseMaster opened on the replica's path can send them on to
+     *  further replicas.  This allows a replica to relay updates, so
+     *  replicas can be arranged in a tree rather than all fetching from the
+     *  master.
+     *
+     *  A replica which is sent a copy of the whole database doesn't have
+     *  the changesets from before the copy, so replicas of it which are
+     *  further behind will be sent a copy in turn.
+     *
+     *  @param max_changesets	The number of changesets to keep (0 to not
+     *				keep any, which is the default).
+     *
+     *  @since Added in Xapian 1.5.0.
+     */
+    void set_relay_changesets(unsigned max_changesets);
+
     /// Return a string describing this object.
     std::string get_description() const;
 };
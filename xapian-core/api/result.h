@@ -81,6 +81,8 @@ class Result {
 
     void set_collapse_key(const std::string& k) { collapse_key = k; }
 
+    void set_collapse_key(std::string&& k) { collapse_key = std::move(k); }
+
     void set_sort_key(const std::string& k) { sort_key = k; }
 
     void unshard_docid(Xapian::doccount shard, Xapian::doccount n_shards) {
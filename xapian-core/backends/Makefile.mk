@@ -8,12 +8,16 @@ noinst_HEADERS +=\
 	backends/databasereplicator.h\
 	backends/documentinternal.h\
 	backends/empty_database.h\
+	backends/expansioncache.h\
 	backends/flint_lock.h\
 	backends/multi.h\
 	backends/positionlist.h\
 	backends/prefix_compressed_strings.h\
 	backends/slowvaluelist.h\
+	backends/termngramindex.h\
+	backends/termstatscache.h\
 	backends/uuids.h\
+	backends/valueblockmaxima.h\
 	backends/valuelist.h\
 	backends/valuestats.h
 
@@ -30,7 +34,9 @@ lib_src +=\
 	backends/documentinternal.cc\
 	backends/empty_database.cc\
 	backends/slowvaluelist.cc\
+	backends/termngramindex.cc\
 	backends/uuids.cc\
+	backends/valueblockmaxima.cc\
 	backends/valuelist.cc
 
 if BUILD_BACKEND_REMOTE
@@ -26,11 +26,13 @@
 #include "api/leafpostlist.h"
 #include "omassert.h"
 #include "slowvaluelist.h"
+#include "str.h"
 #include "xapian/error.h"
 
 #include <algorithm>
 #include <memory>
 #include <string>
+#include <vector>
 
 using namespace std;
 using Xapian::Internal::intrusive_ptr;
@@ -55,6 +57,18 @@ Database::Internal::keep_alive()
     // No-op except for remote databases.
 }
 
+void
+Database::Internal::set_term_stats_cache_size(size_t max_entries)
+{
+    term_stats_cache.set_max_entries(max_entries);
+}
+
+void
+Database::Internal::set_expansion_cache_size(size_t max_terms)
+{
+    expansion_cache.set_max_terms(max_terms);
+}
+
 void
 Database::Internal::readahead_for_query(const Xapian::Query &) const
 {
@@ -377,23 +391,115 @@ Database::Internal::request_document(Xapian::docid) const
 }
 
 void
-Database::Internal::write_changesets_to_fd(int, const string&, bool, ReplicationInfo*)
+Database::Internal::write_changesets_to_fd(int, const string&, bool, bool,
+					   ReplicationInfo*)
 {
     throw Xapian::UnimplementedError("This backend doesn't provide changesets");
 }
 
+void
+Database::Internal::write_copy_ranges_to_fd(int, const string&, bool,
+					    unsigned, unsigned)
+{
+    throw Xapian::UnimplementedError("This backend doesn't support "
+				     "replication");
+}
+
 Xapian::rev
 Database::Internal::get_revision() const
 {
     throw Xapian::UnimplementedError("This backend doesn't provide access to revision information");
 }
 
+bool
+Database::Internal::get_cache_revision(Xapian::rev& revision) const
+{
+    if (!is_read_only())
+	return false;
+    try {
+	revision = get_revision();
+    } catch (const Xapian::UnimplementedError&) {
+	return false;
+    }
+    return true;
+}
+
+const TermNgramIndex*
+Database::Internal::get_term_ngram_index() const
+{
+    Xapian::rev revision;
+    if (!get_cache_revision(revision))
+	return NULL;
+    if (!term_ngram_index || term_ngram_index_rev != revision) {
+	// Release any old index before building the new one.
+	term_ngram_index.reset();
+	term_ngram_index.reset(new TermNgramIndex(open_allterms(string())));
+	term_ngram_index_rev = revision;
+    }
+    return term_ngram_index.get();
+}
+
+intrusive_ptr<const Xapian::Internal::ValueBlockMaxima>
+Database::Internal::get_value_block_maxima(Xapian::valueno slot) const
+{
+    using Xapian::Internal::ValueBlockMaxima;
+    // The docids in a multi-shard database are interleaved, so blocks of
+    // them aren't useful.
+    if (size() != 1)
+	return NULL;
+    Xapian::rev revision;
+    if (!get_cache_revision(revision))
+	return NULL;
+    if (value_block_maxima_rev != revision) {
+	value_block_maxima.clear();
+	value_block_maxima_rev = revision;
+    }
+    auto& result = value_block_maxima[slot];
+    if (!result.get()) {
+	result = new ValueBlockMaxima(open_value_list(slot),
+				      get_lastdocid());
+    }
+    return result;
+}
+
+const vector<string>*
+Database::Internal::find_cached_expansion(const string& key) const
+{
+    Xapian::rev revision;
+    if (!get_cache_revision(revision))
+	return NULL;
+    return expansion_cache.find(key, revision);
+}
+
+const vector<string>*
+Database::Internal::cache_expansion(const string& key,
+				    vector<string>& terms) const
+{
+    Xapian::rev revision;
+    if (!get_cache_revision(revision))
+	return NULL;
+    return expansion_cache.insert(key, revision, terms);
+}
+
 string
 Database::Internal::get_uuid() const
 {
     return string();
 }
 
+string
+Database::Internal::get_server_status() const
+{
+    string status = "expansion_cache_hits ";
+    status += str(expansion_cache.get_hits());
+    status += "\nexpansion_cache_misses ";
+    status += str(expansion_cache.get_misses());
+    status += "\nwildcard_terms_checked ";
+    status += str(wildcard_terms_checked);
+    status += '\n';
+    return status;
+}
+
 void
 Database::Internal::invalidate_doc_object(Xapian::Document::Internal*) const
 {
@@ -22,7 +22,11 @@
 #ifndef XAPIAN_INCLUDED_DATABASEINTERNAL_H
 #define XAPIAN_INCLUDED_DATABASEINTERNAL_H
 
+#include "expansioncache.h"
 #include "internaltypes.h"
+#include "termngramindex.h"
+#include "termstatscache.h"
+#include "valueblockmaxima.h"
 
 #include <xapian/database.h>
 #include <xapian/document.h>
@@ -33,7 +37,10 @@
 #include <xapian/types.h>
 #include <xapian/valueiterator.h>
 
+#include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 typedef Xapian::TermIterator::Internal TermList;
 typedef Xapian::PositionIterator::Internal PositionList;
@@ -66,6 +73,26 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
     /// The "action required" helper for the dtor_called() helper.
     void dtor_called_();
 
+    /// Index returned by get_term_ngram_index(), built on demand.
+    mutable std::unique_ptr<TermNgramIndex> term_ngram_index;
+
+    /// The revision which term_ngram_index was built from.
+    mutable Xapian::rev term_ngram_index_rev = 0;
+
+    /// Cache used by find_cached_expansion() and cache_expansion().
+    mutable ExpansionCache expansion_cache;
+
+    /// Block maxima returned by get_value_block_maxima(), built on demand.
+    mutable std::map<Xapian::valueno,
+		     Xapian::Internal::intrusive_ptr<const
+			 Xapian::Internal::ValueBlockMaxima>> value_block_maxima;
+
+    /// The revision which value_block_maxima were built from.
+    mutable Xapian::rev value_block_maxima_rev = 0;
+
+    /// Number of terms checked by wildcard expansions.
+    mutable unsigned long long wildcard_terms_checked = 0;
+
   protected:
     /// Transaction state enum.
     enum transaction_state {
@@ -89,6 +116,13 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
     /// Current transaction state.
     transaction_state state;
 
+    /** Cache of term statistics.
+     *
+     *  Backends may use this to cache the results of get_freqs() and
+     *  get_wdf_upper_bound() for read-only shards.
+     */
+    mutable TermStatsCache term_stats_cache;
+
     /// Test if this shard is read-only.
     bool is_read_only() const {
 	return state == TRANSACTION_READONLY;
@@ -126,8 +160,28 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 
     virtual size_type size() const;
 
+    /** Return the revision to key caches on.
+     *
+     *  @return false if caching isn't supported for this shard, which is
+     *		the case unless it is read-only and provides revision
+     *		information.
+     */
+    bool get_cache_revision(Xapian::rev& revision) const;
+
     virtual void keep_alive();
 
+    /** Set the maximum number of terms to cache statistics for.
+     *
+     *  @param max_entries	Maximum number of terms (0 disables the cache).
+     */
+    virtual void set_term_stats_cache_size(size_t max_entries);
+
+    /** Set the maximum total number of terms in cached expansions.
+     *
+     *  @param max_terms	Maximum number of terms (0 disables the cache).
+     */
+    virtual void set_expansion_cache_size(size_t max_terms);
+
     virtual void readahead_for_query(const Query& query) const;
 
     virtual doccount get_doccount() const = 0;
@@ -240,6 +294,57 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 
     virtual TermList* open_allterms(const std::string& prefix) const = 0;
 
+    /** Return an n-gram index of the terms in this shard.
+     *
+     *  The index is built on the first call and kept until the shard's
+     *  revision changes, so this is only supported for read-only shards
+     *  which provide revision information - for other shards NULL is
+     *  returned and the caller should fall back to using open_allterms().
+     */
+    const TermNgramIndex* get_term_ngram_index() const;
+
+    /** Note that expanding a wildcard checked a term against the pattern.
+     *
+     *  The count is reported by get_server_status(), which allows checking
+     *  how many terms get_term_ngram_index() saves checking.
+     */
+    void note_wildcard_term_checked() const { ++wildcard_terms_checked; }
+
+    /** Look up the cached expansion of a wildcard or edit distance query.
+     *
+     *  @param key	The serialised subquery.
+     *
+     *  @return	The terms it expands to in this shard, or NULL if not cached
+     *		(which is always the case for shards which aren't read-only or
+     *		don't provide revision information).  The pointer remains valid
+     *		until the next call to cache_expansion().
+     */
+    const std::vector<std::string>*
+    find_cached_expansion(const std::string& key) const;
+
+    /** Cache the expansion of a wildcard or edit distance query.
+     *
+     *  @param key	The serialised subquery.
+     *  @param terms	The terms it expands to.  If cached, these are moved
+     *			into the cache.
+     *
+     *  @return	Pointer to the cached terms (valid until the next call to
+     *		cache_expansion()), or NULL if they weren't cached.
+     */
+    const std::vector<std::string>*
+    cache_expansion(const std::string& key,
+		    std::vector<std::string>& terms) const;
+
+    /** Return upper bounds on the values in a slot for blocks of docids.
+     *
+     *  These are built on the first call for each slot and kept until the
+     *  shard's revision changes, so like get_term_ngram_index() this is only
+     *  supported for read-only shards which provide revision information -
+     *  for other shards NULL is returned.
+     */
+    Xapian::Internal::intrusive_ptr<const Xapian::Internal::ValueBlockMaxima>
+    get_value_block_maxima(Xapian::valueno slot) const;
+
     virtual PositionList* open_position_list(docid did,
 					     const std::string& term) const = 0;
 
@@ -416,12 +521,31 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
      *
      *  This call may reopen the database, leaving it pointing to a more
      *  recent version of the database.
+     *
+     *  If @a compress is true, the changesets and database files are sent
+     *  compressed.
      */
     virtual void write_changesets_to_fd(int fd,
 					const std::string& start_revision,
 					bool need_whole_db,
+					bool compress,
 					ReplicationInfo* info);
 
+    /** Write part of a copy of the database to a file descriptor.
+     *
+     *  The files are divided into ranges, and only ranges whose index modulo
+     *  @a n_streams is @a stream are written, and then only if the checksums
+     *  after the revision in @a start_revision don't show that the replica
+     *  already has them.
+     *
+     *  If @a compress is true, the ranges are sent compressed.
+     */
+    virtual void write_copy_ranges_to_fd(int fd,
+					 const std::string& start_revision,
+					 bool compress,
+					 unsigned stream,
+					 unsigned n_streams);
+
     /// Get revision number of database (if meaningful).
     virtual Xapian::rev get_revision() const;
 
@@ -437,6 +561,13 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
      */
     virtual std::string get_uuid() const;
 
+    /** Get a report of status counters for this shard.
+     *
+     *  The default implementation reports the counters kept by this class
+     *  for local shards, while remote shards report those of the server.
+     */
+    virtual std::string get_server_status() const;
+
     /** Notify the database that document is no longer valid.
      *
      *  This is used to invalidate references to a document kept by a
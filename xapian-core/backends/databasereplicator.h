@@ -82,6 +82,17 @@ class DatabaseReplicator {
 						      double end_time,
 						      bool db_valid) const = 0;
 
+	/** Keep the changesets applied to the replica.
+	 *
+	 *  They're stored in the same way as the backend stores changesets
+	 *  for a master database, so the replica can in turn be used as a
+	 *  master.
+	 *
+	 *  @param max_changesets The number of changesets to keep (0 to
+	 *  not keep any, which is the default).
+	 */
+	virtual void set_max_changesets(unsigned max_changesets) = 0;
+
 	/** Get a UUID for the replica.
 	 *
 	 *  If the UUID cannot be read (for example, because the database is
@@ -22,13 +22,16 @@
 
 #include <xapian/dbfactory.h>
 
+#include "backends/remote/remote-database.h"
 #include "debuglog.h"
 #include "net/progclient.h"
 #include "net/remotetcpclient.h"
 
 #include <string>
+#include <vector>
 
 using namespace std;
+using Xapian::Internal::intrusive_ptr;
 
 namespace Xapian {
 
@@ -37,8 +40,8 @@ Remote::open(const string &host, unsigned int port, unsigned timeout_,
 	     unsigned connect_timeout)
 {
     LOGCALL_STATIC(API, Database, "Remote::open", host | port | timeout_ | connect_timeout);
-    RETURN(Database(new RemoteTcpClient(host, port, timeout_ * 1e-3,
-					connect_timeout * 1e-3, false, 0)));
+    RETURN(Database(RemoteTcpClient::open(host, port, timeout_ * 1e-3,
+					  connect_timeout * 1e-3, false, 0)));
 }
 
 WritableDatabase
@@ -69,4 +72,43 @@ Remote::open_writable(const string &program, const string &args,
 					   timeout_ * 1e-3, true, flags)));
 }
 
+Database
+Remote::replica_set(const vector<Database>& replicas, double hedge_percentile)
+{
+    LOGCALL_STATIC(API, Database, "Remote::replica_set", replicas.size() | hedge_percentile);
+    if (replicas.empty()) {
+	throw InvalidArgumentError("No replicas specified");
+    }
+    if (!(hedge_percentile > 0.0 && hedge_percentile <= 100.0)) {
+	throw InvalidArgumentError("hedge_percentile must be > 0 and <= 100");
+    }
+    vector<intrusive_ptr<RemoteDatabase>> servers;
+    for (auto&& db : replicas) {
+	Database::Internal* internal = db.internal.get();
+	if (internal->size() != 1 ||
+	    internal->get_backend_info(NULL) != BACKEND_REMOTE) {
+	    throw InvalidArgumentError("Replicas must be remote databases");
+	}
+	auto remote = static_cast<RemoteDatabase*>(internal);
+	if (remote->has_replicas()) {
+	    throw InvalidArgumentError("Replica already has replicas");
+	}
+	for (auto&& server : servers) {
+	    if (server.get() == remote) {
+		throw InvalidArgumentError("Replica specified more than once");
+	    }
+	}
+	servers.emplace_back(remote);
+    }
+    RETURN(Database(new RemoteDatabase(std::move(servers),
+				       hedge_percentile)));
+}
+
+void
+Remote::set_connection_pool_size(unsigned size)
+{
+    LOGCALL_STATIC_VOID(API, "Remote::set_connection_pool_size", size);
+    RemoteTcpClient::set_pool_size(size);
+}
+
 }
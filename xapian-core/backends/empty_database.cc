@@ -243,6 +243,7 @@ void
 EmptyDatabase::write_changesets_to_fd(int,
 				      const std::string&,
 				      bool,
+				      bool,
 				      Xapian::ReplicationInfo*)
 {
     throw Xapian::InvalidOperationError("write_changesets_to_fd() with "
@@ -97,6 +97,7 @@ class EmptyDatabase : public Xapian::Database::Internal {
     void write_changesets_to_fd(int fd,
 				const std::string& start_revision,
 				bool need_whole_db,
+				bool compress,
 				Xapian::ReplicationInfo* info);
 
     void invalidate_doc_object(Xapian::Document::Internal* obj) const;
@@ -0,0 +1,124 @@
+/** @file expansioncache.h
+ * @brief LRU cache of wildcard and edit distance expansions
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_EXPANSIONCACHE_H
+#define XAPIAN_INCLUDED_EXPANSIONCACHE_H
+
+#include <xapian/types.h>
+
+#include "lrucache.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/** LRU cache of the terms which queries expand to in a database shard.
+ *
+ *  Expanding OP_WILDCARD and OP_EDIT_DISTANCE requires scanning the term
+ *  list, and the same query is often run repeatedly (e.g. to fetch further
+ *  pages of results, or as a user types a query).  This caches the list of
+ *  terms each expanded to, keyed by the serialised subquery.
+ *
+ *  Like TermStatsCache, the cache is tied to a revision of the shard.
+ *
+ *  The size is limited by the total number of terms in all the cached
+ *  expansions.
+ */
+class ExpansionCache {
+    /// Size function counting the terms in an expansion.
+    struct CountTerms {
+	size_t operator()(const std::vector<std::string>& terms) const {
+	    return terms.size();
+	}
+    };
+
+    /// The cached expansions.
+    LRUCache<std::vector<std::string>, CountTerms> cache{DEFAULT_MAX_TERMS};
+
+    /// The revision the cached expansions are for.
+    Xapian::rev revision = 0;
+
+    unsigned long long hits = 0;
+
+    unsigned long long misses = 0;
+
+    /// Discard everything if @a current_revision isn't the cached revision.
+    void check_revision(Xapian::rev current_revision) {
+	if (current_revision != revision) {
+	    cache.clear();
+	    revision = current_revision;
+	}
+    }
+
+  public:
+    /// Default maximum total number of terms.
+    static constexpr size_t DEFAULT_MAX_TERMS = 16384;
+
+    /** Set the maximum total number of terms to cache.
+     *
+     *  0 disables caching.  If there are currently more terms cached than
+     *  the new limit, the least recently used entries are discarded.
+     */
+    void set_max_terms(size_t max_terms) {
+	cache.set_max_size(max_terms);
+    }
+
+    /** Look up a cached expansion.
+     *
+     *  @return Pointer to the cached list of terms, or NULL if not cached.
+     *		The pointer remains valid until the next call to a non-const
+     *		method.
+     */
+    const std::vector<std::string>* find(const std::string& key,
+					 Xapian::rev current_revision) {
+	check_revision(current_revision);
+	auto result = cache.find(key);
+	if (result) {
+	    ++hits;
+	} else {
+	    ++misses;
+	}
+	return result;
+    }
+
+    /** Add an expansion to the cache.
+     *
+     *  If the expansion is cached, the contents of @a terms are moved into
+     *  the cache, leaving @a terms empty.
+     *
+     *  @return Pointer to the cached list of terms, or NULL if the expansion
+     *		is too large to cache (in which case @a terms is unchanged).
+     *		The pointer remains valid until the next call to a non-const
+     *		method.
+     */
+    const std::vector<std::string>* insert(const std::string& key,
+					   Xapian::rev current_revision,
+					   std::vector<std::string>& terms) {
+	check_revision(current_revision);
+	auto result = cache.insert(key, std::move(terms));
+	if (result)
+	    terms.clear();
+	return result;
+    }
+
+    unsigned long long get_hits() const { return hits; }
+
+    unsigned long long get_misses() const { return misses; }
+};
+
+#endif // XAPIAN_INCLUDED_EXPANSIONCACHE_H
@@ -62,15 +62,18 @@ GlassChanges::start(glass_revision_number_t old_rev,
 	return NULL;
     }
 
-    // Always check max_changesets for modification since last revision.
-    const char *p = getenv("XAPIAN_MAX_CHANGESETS");
-    if (p && *p) {
-	if (!parse_unsigned(p, max_changesets)) {
-	    throw Xapian::InvalidArgumentError("XAPIAN_MAX_CHANGESETS must be "
-					       "a non-negative integer");
+    if (!max_changesets_fixed) {
+	// Always check max_changesets for modification since last revision.
+	const char *p = getenv("XAPIAN_MAX_CHANGESETS");
+	if (p && *p) {
+	    if (!parse_unsigned(p, max_changesets)) {
+		throw Xapian::InvalidArgumentError("XAPIAN_MAX_CHANGESETS "
+						   "must be a non-negative "
+						   "integer");
+	    }
+	} else {
+	    max_changesets = 0;
 	}
-    } else {
-	max_changesets = 0;
     }
 
     if (max_changesets == 0)
@@ -39,6 +39,9 @@ class GlassChanges {
      */
     glass_revision_number_t max_changesets;
 
+    /// Has max_changesets been set by set_max_changesets()?
+    bool max_changesets_fixed;
+
     /** The oldest changeset which might exist on disk.
      *
      *  Used to optimise removal of old changesets by giving us a point to
@@ -50,6 +53,7 @@ class GlassChanges {
     explicit GlassChanges(const std::string & db_dir)
 	: changes_fd(-1),
 	  changes_stem(db_dir + "/changes"),
+	  max_changesets_fixed(false),
 	  oldest_changeset(0) { }
 
     ~GlassChanges();
@@ -64,6 +68,16 @@ class GlassChanges {
 	write_block(s.data(), s.size());
     }
 
+    /** Set the maximum number of changesets to keep.
+     *
+     *  By default this is read from XAPIAN_MAX_CHANGESETS each time start()
+     *  is called.
+     */
+    void set_max_changesets(glass_revision_number_t n) {
+	max_changesets = n;
+	max_changesets_fixed = true;
+    }
+
     void set_oldest_changeset(glass_revision_number_t rev) {
 	oldest_changeset = rev;
     }
@@ -57,6 +57,7 @@
 #include "parseint.h"
 #include "net/remoteconnection.h"
 #include "api/replication.h"
+#include "replicate_utils.h"
 #include "replicationprotocol.h"
 #include "net/length.h"
 #include "posixy_wrapper.h"
@@ -432,8 +433,65 @@ GlassDatabase::get_database_write_lock(int flags, bool creating)
     }
 }
 
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+/** The files in a database copy.
+ *
+ *  The tables which we want to be cached best after the copy finishes are
+ *  sent last.
+ */
+static const char db_copy_filenames[] =
+    "termlist." GLASS_TABLE_EXTENSION "\0"
+    "synonym." GLASS_TABLE_EXTENSION "\0"
+    "spelling." GLASS_TABLE_EXTENSION "\0"
+    "docdata." GLASS_TABLE_EXTENSION "\0"
+    "position." GLASS_TABLE_EXTENSION "\0"
+    "postlist." GLASS_TABLE_EXTENSION "\0"
+    "iamglass\0";
+
+/** Send the ranges of a file in a database copy.
+ *
+ *  Ranges which the replica already has aren't sent, and only ranges whose
+ *  index modulo @a n_streams is @a stream are considered.  Ranges are
+ *  numbered across all the files in the copy, starting from @a range_index,
+ *  which is updated to the index after the last range of this file.
+ */
+static void
+send_file_ranges(RemoteConnection & conn, const string & name, int fd,
+		 const CopyRangeChecksums & have, unsigned & range_index,
+		 unsigned stream, unsigned n_streams, double end_time)
+{
+    off_t size = file_size(fd);
+    if (errno)
+	throw Xapian::DatabaseError("Couldn't stat '" + name + "'", errno);
+    string buf;
+    pack_string(buf, name);
+    pack_uint(buf, uint64_t(size));
+    conn.send_message(REPL_REPLY_DB_FILEINFO, buf, end_time);
+
+    unique_ptr<char[]> data(new char[DB_COPY_RANGE_SIZE]);
+    for (off_t offset = 0; offset < size; offset += DB_COPY_RANGE_SIZE) {
+	if (range_index++ % n_streams != stream)
+	    continue;
+	// Insist on the whole range - a short read would otherwise be sent as
+	// a shorter range, which wouldn't match the replica's checksums.
+	size_t len = size_t(min(size - offset, off_t(DB_COPY_RANGE_SIZE)));
+	(void)io_pread(fd, data.get(), len, offset, len);
+	uint64_t checksum = CopyRangeChecksums::checksum(data.get(), len);
+	if (have.has_range(name, offset, len, checksum))
+	    continue;
+	buf.resize(0);
+	pack_uint(buf, uint64_t(offset));
+	pack_uint(buf, checksum);
+	buf.append(data.get(), len);
+	conn.send_message(REPL_REPLY_DB_FILERANGE, buf, end_time);
+    }
+}
+#endif
+
 void
-GlassDatabase::send_whole_database(RemoteConnection & conn, double end_time)
+GlassDatabase::send_whole_database(RemoteConnection & conn,
+				   const CopyRangeChecksums & have,
+				   double end_time)
 {
     LOGCALL_VOID(DB, "GlassDatabase::send_whole_database", conn | end_time);
 #ifdef XAPIAN_HAS_REMOTE_BACKEND
@@ -445,42 +503,79 @@ GlassDatabase::send_whole_database(RemoteConnection & conn, double end_time)
     pack_uint(buf, get_revision());
     conn.send_message(REPL_REPLY_DB_HEADER, buf, end_time);
 
-    // Send all the tables.  The tables which we want to be cached best after
-    // the copy finishes are sent last.
-    static const char filenames[] =
-	"termlist." GLASS_TABLE_EXTENSION "\0"
-	"synonym." GLASS_TABLE_EXTENSION "\0"
-	"spelling." GLASS_TABLE_EXTENSION "\0"
-	"docdata." GLASS_TABLE_EXTENSION "\0"
-	"position." GLASS_TABLE_EXTENSION "\0"
-	"postlist." GLASS_TABLE_EXTENSION "\0"
-	"iamglass\0";
+    // Send all the tables.
     string filepath = db_dir;
     filepath += '/';
-    const char * p = filenames;
+    unsigned range_index = 0;
+    const char * p = db_copy_filenames;
     do {
 	size_t len = strlen(p);
 	filepath.replace(db_dir.size() + 1, string::npos, p, len);
 	FD fd(posixy_open(filepath.c_str(), O_RDONLY | O_CLOEXEC));
 	if (fd >= 0) {
-	    conn.send_message(REPL_REPLY_DB_FILENAME, string(p, len), end_time);
-	    conn.send_file(REPL_REPLY_DB_FILEDATA, fd, end_time);
+	    send_file_ranges(conn, string(p, len), fd, have, range_index,
+			     0, 1, end_time);
 	}
 	p += len + 1;
     } while (*p);
 #else
     (void)conn;
+    (void)have;
     (void)end_time;
 #endif
 }
 
+void
+GlassDatabase::write_copy_ranges_to_fd(int fd,
+				       const string & revision,
+				       bool compress,
+				       unsigned stream,
+				       unsigned n_streams)
+{
+    LOGCALL_VOID(DB, "GlassDatabase::write_copy_ranges_to_fd", fd | revision | compress | stream | n_streams);
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+    CopyRangeChecksums have;
+    const char * rev_ptr = revision.data();
+    const char * rev_end = rev_ptr + revision.size();
+    glass_revision_number_t rev_num;
+    if (unpack_uint(&rev_ptr, rev_end, &rev_num)) {
+	have.unserialise(rev_ptr, rev_end);
+    }
+
+    RemoteConnection conn(-1, fd, string());
+    conn.set_compression(compress);
+    string filepath = db_dir;
+    filepath += '/';
+    unsigned range_index = 0;
+    const char * p = db_copy_filenames;
+    do {
+	size_t len = strlen(p);
+	filepath.replace(db_dir.size() + 1, string::npos, p, len);
+	FD file_fd(posixy_open(filepath.c_str(), O_RDONLY | O_CLOEXEC));
+	if (file_fd >= 0) {
+	    send_file_ranges(conn, string(p, len), file_fd, have,
+			     range_index, stream, n_streams, 0.0);
+	}
+	p += len + 1;
+    } while (*p);
+    conn.send_message(REPL_REPLY_END_OF_CHANGES, string(), 0.0);
+#else
+    (void)fd;
+    (void)revision;
+    (void)compress;
+    (void)stream;
+    (void)n_streams;
+#endif
+}
+
 void
 GlassDatabase::write_changesets_to_fd(int fd,
 				      const string & revision,
 				      bool need_whole_db,
+				      bool compress,
 				      ReplicationInfo * info)
 {
-    LOGCALL_VOID(DB, "GlassDatabase::write_changesets_to_fd", fd | revision | need_whole_db | info);
+    LOGCALL_VOID(DB, "GlassDatabase::write_changesets_to_fd", fd | revision | need_whole_db | compress | info);
 #ifdef XAPIAN_HAS_REMOTE_BACKEND
     int whole_db_copies_left = MAX_DB_COPIES_PER_CONVERSATION;
     glass_revision_number_t start_rev_num = 0;
@@ -488,13 +583,18 @@ GlassDatabase::write_changesets_to_fd(int fd,
 
     glass_revision_number_t needed_rev_num = 0;
 
+    // Any partial copy the replica has is described after the revision.
+    CopyRangeChecksums have;
     const char * rev_ptr = revision.data();
     const char * rev_end = rev_ptr + revision.size();
     if (!unpack_uint(&rev_ptr, rev_end, &start_rev_num)) {
 	need_whole_db = true;
+    } else {
+	have.unserialise(rev_ptr, rev_end);
     }
 
     RemoteConnection conn(-1, fd, string());
+    conn.set_compression(compress);
 
     // While the starting revision number is less than the latest revision
     // number, look for a changeset, and write it.
@@ -519,7 +619,7 @@ GlassDatabase::write_changesets_to_fd(int fd,
 	    start_rev_num = get_revision();
 	    start_uuid = get_uuid();
 
-	    send_whole_database(conn, 0.0);
+	    send_whole_database(conn, have, 0.0);
 	    if (info != NULL)
 		++(info->fullcopy_count);
 
@@ -601,6 +701,7 @@ GlassDatabase::write_changesets_to_fd(int fd,
     (void)fd;
     (void)revision;
     (void)need_whole_db;
+    (void)compress;
     (void)info;
 #endif
 }
@@ -750,6 +851,19 @@ GlassDatabase::get_unique_terms(Xapian::docid did) const
     RETURN(GlassTermList(ptrtothis, did).get_unique_terms());
 }
 
+TermStats
+GlassDatabase::get_term_stats(const string & term) const
+{
+    Assert(is_read_only());
+    return term_stats_cache.get(term, version_file.get_revision(),
+				[&](TermStats& stats) {
+				    postlist_table.get_freqs(term,
+							     &stats.termfreq,
+							     &stats.collfreq,
+							     &stats.wdf_upper_bound);
+				});
+}
+
 void
 GlassDatabase::get_freqs(const string & term,
 			 Xapian::doccount * termfreq_ptr,
@@ -757,7 +871,15 @@ GlassDatabase::get_freqs(const string & term,
 {
     LOGCALL_VOID(DB, "GlassDatabase::get_freqs", term | termfreq_ptr | collfreq_ptr);
     Assert(!term.empty());
-    postlist_table.get_freqs(term, termfreq_ptr, collfreq_ptr);
+    if (!is_read_only()) {
+	postlist_table.get_freqs(term, termfreq_ptr, collfreq_ptr);
+	return;
+    }
+    TermStats stats = get_term_stats(term);
+    if (termfreq_ptr)
+	*termfreq_ptr = stats.termfreq;
+    if (collfreq_ptr)
+	*collfreq_ptr = stats.collfreq;
 }
 
 Xapian::doccount
@@ -798,7 +920,11 @@ GlassDatabase::get_wdf_upper_bound(const string & term) const
 {
     Assert(!term.empty());
     Xapian::termcount wdfub;
-    postlist_table.get_freqs(term, NULL, NULL, &wdfub);
+    if (is_read_only()) {
+	wdfub = get_term_stats(term).wdf_upper_bound;
+    } else {
+	postlist_table.get_freqs(term, NULL, NULL, &wdfub);
+    }
     return min(wdfub, version_file.get_wdf_upper_bound());
 }
 
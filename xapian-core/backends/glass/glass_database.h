@@ -49,6 +49,7 @@
 class GlassTermList;
 class GlassAllDocsPostList;
 class HoneyDatabase;
+class CopyRangeChecksums;
 class RemoteConnection;
 
 /** A backend designed for efficient indexing and retrieval, using
@@ -197,8 +198,13 @@ class GlassDatabase : public Xapian::Database::Internal {
 	void cancel();
 
 	/** Send a set of messages which transfer the whole database.
+	 *
+	 *  Ranges of the files which @a have shows the replica already has
+	 *  aren't sent.
 	 */
-	void send_whole_database(RemoteConnection & conn, double end_time);
+	void send_whole_database(RemoteConnection & conn,
+				 const CopyRangeChecksums & have,
+				 double end_time);
 
 	/** Get the revision stored in a changeset.
 	 */
@@ -206,6 +212,12 @@ class GlassDatabase : public Xapian::Database::Internal {
 				     glass_revision_number_t * startrev,
 				     glass_revision_number_t * endrev) const;
 
+	/** Get the statistics for a term, using term_stats_cache.
+	 *
+	 *  Only valid for a read-only database.
+	 */
+	TermStats get_term_stats(const string & term) const;
+
     public:
 	/** Create and open a glass database.
 	 *
@@ -286,7 +298,13 @@ class GlassDatabase : public Xapian::Database::Internal {
 	void write_changesets_to_fd(int fd,
 				    const string & start_revision,
 				    bool need_whole_db,
+				    bool compress,
 				    Xapian::ReplicationInfo * info);
+	void write_copy_ranges_to_fd(int fd,
+				     const string & start_revision,
+				     bool compress,
+				     unsigned stream,
+				     unsigned n_streams);
 	/** Get the revision number which the tables are opened at.
 	 *
 	 *  @return the current revision number.
@@ -27,6 +27,7 @@
 #include "xapian/error.h"
 
 #include "../flint_lock.h"
+#include "glass_changes.h"
 #include "glass_defs.h"
 #include "glass_replicate_internal.h"
 #include "glass_version.h"
@@ -36,14 +37,17 @@
 #include "internaltypes.h"
 #include "io_utils.h"
 #include "pack.h"
+#include "parseint.h"
 #include "posixy_wrapper.h"
 #include "net/remoteconnection.h"
 #include "replicationprotocol.h"
+#include "safedirent.h"
 #include "str.h"
 #include "stringutils.h"
 
 #include <algorithm>
 #include <cerrno>
+#include <memory>
 
 [[noreturn]]
 static void
@@ -63,6 +67,30 @@ static const char * dbnames =
 	"/spelling." GLASS_TABLE_EXTENSION "\0"
 	"/synonym." GLASS_TABLE_EXTENSION;
 
+/** Find the oldest changeset kept in @a db_dir.
+ *
+ *  Returns @a rev if there are none older than that.
+ */
+static glass_revision_number_t
+find_oldest_changeset(const string & db_dir, glass_revision_number_t rev)
+{
+    DIR * dir = opendir(db_dir.c_str());
+    if (!dir)
+	return rev;
+    while (struct dirent * entry = readdir(dir)) {
+	const char * name = entry->d_name;
+	if (!startswith(name, "changes"))
+	    continue;
+	glass_revision_number_t changeset;
+	if (parse_unsigned(name + CONST_STRLEN("changes"), changeset) &&
+	    changeset < rev) {
+	    rev = changeset;
+	}
+    }
+    closedir(dir);
+    return rev;
+}
+
 GlassDatabaseReplicator::GlassDatabaseReplicator(const string & db_dir_)
     : db_dir(db_dir_)
 {
@@ -121,7 +149,8 @@ GlassDatabaseReplicator::check_revision_at_least(const string & rev,
 void
 GlassDatabaseReplicator::process_changeset_chunk_version(string & buf,
 							 RemoteConnection & conn,
-							 double end_time) const
+							 double end_time,
+							 GlassChanges * changes) const
 {
     const char *ptr = buf.data();
     const char *end = ptr + buf.size();
@@ -165,6 +194,15 @@ GlassDatabaseReplicator::process_changeset_chunk_version(string & buf,
 	throw DatabaseError(msg, errno);
     }
 
+    if (changes) {
+	string changes_buf;
+	changes_buf += '\xfe';
+	pack_uint(changes_buf, rev);
+	pack_uint(changes_buf, size);
+	changes->write_block(changes_buf);
+	changes->write_block(buf.data(), size);
+    }
+
     buf.erase(0, size);
 }
 
@@ -173,7 +211,8 @@ GlassDatabaseReplicator::process_changeset_chunk_blocks(Glass::table_type table,
 							unsigned v,
 							string & buf,
 							RemoteConnection & conn,
-							double end_time) const
+							double end_time,
+							GlassChanges * changes) const
 {
     const char *ptr = buf.data();
     const char *end = ptr + buf.size();
@@ -210,6 +249,15 @@ GlassDatabaseReplicator::process_changeset_chunk_blocks(Glass::table_type table,
     }
 
     io_write_block(fd, buf.data(), changeset_blocksize, block_number);
+
+    if (changes) {
+	string changes_buf;
+	changes_buf += char(table | (v << 3));
+	pack_uint(changes_buf, block_number);
+	changes->write_block(changes_buf);
+	changes->write_block(buf.data(), changeset_blocksize);
+    }
+
     buf.erase(0, changeset_blocksize);
 }
 
@@ -284,6 +332,16 @@ GlassDatabaseReplicator::apply_changeset_from_conn(RemoteConnection & conn,
 	// on.
     }
 
+    // If we're keeping changesets, write out this one as we apply it.
+    unique_ptr<GlassChanges> changes;
+    if (max_changesets) {
+	changes.reset(new GlassChanges(db_dir));
+	changes->set_max_changesets(max_changesets);
+	changes->set_oldest_changeset(find_oldest_changeset(db_dir, startrev));
+	if (!changes->start(startrev, endrev, 0))
+	    changes.reset();
+    }
+
     // Clear the bits of the buffer which have been read.
     buf.erase(0, ptr - buf.data());
 
@@ -310,7 +368,8 @@ GlassDatabaseReplicator::apply_changeset_from_conn(RemoteConnection & conn,
 	if (chunk_type == 0xfe) {
 	    // Version file.
 	    buf.erase(0, ptr - buf.data());
-	    process_changeset_chunk_version(buf, conn, end_time);
+	    process_changeset_chunk_version(buf, conn, end_time,
+					    changes.get());
 	    continue;
 	}
 	size_t table_code = (chunk_type & 0x07);
@@ -321,7 +380,8 @@ GlassDatabaseReplicator::apply_changeset_from_conn(RemoteConnection & conn,
 
 	// Process the chunk
 	buf.erase(0, ptr - buf.data());
-	process_changeset_chunk_blocks(table, v, buf, conn, end_time);
+	process_changeset_chunk_blocks(table, v, buf, conn, end_time,
+				       changes.get());
     }
 
     if (ptr != end)
@@ -332,6 +392,9 @@ GlassDatabaseReplicator::apply_changeset_from_conn(RemoteConnection & conn,
 
     commit();
 
+    if (changes)
+	changes->commit(endrev, 0);
+
     RETURN(buf);
 }
 
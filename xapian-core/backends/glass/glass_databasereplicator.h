@@ -26,6 +26,8 @@
 #include "backends/databasereplicator.h"
 #include "glass_defs.h"
 
+class GlassChanges;
+
 class GlassDatabaseReplicator : public Xapian::DatabaseReplicator {
     private:
 	/** Path of database.
@@ -38,11 +40,16 @@ class GlassDatabaseReplicator : public Xapian::DatabaseReplicator {
 	 */
 	mutable int fds[Glass::MAX_];
 
+	/** The number of changesets to keep (0 for none).
+	 */
+	glass_revision_number_t max_changesets = 0;
+
 	/** Process a chunk which holds a version file.
 	 */
 	void process_changeset_chunk_version(std::string & buf,
 					     RemoteConnection & conn,
-					     double end_time) const;
+					     double end_time,
+					     GlassChanges * changes) const;
 
 	/** Process a chunk which holds a list of changed blocks in the
 	 *  database.
@@ -51,7 +58,8 @@ class GlassDatabaseReplicator : public Xapian::DatabaseReplicator {
 					    unsigned v,
 					    std::string & buf,
 					    RemoteConnection & conn,
-					    double end_time) const;
+					    double end_time,
+					    GlassChanges * changes) const;
 
 	void commit() const;
 
@@ -67,6 +75,9 @@ class GlassDatabaseReplicator : public Xapian::DatabaseReplicator {
 	std::string apply_changeset_from_conn(RemoteConnection & conn,
 					      double end_time,
 					      bool valid) const;
+	void set_max_changesets(unsigned max_changesets_) {
+	    max_changesets = max_changesets_;
+	}
 	std::string get_uuid() const;
 	//@}
 };
@@ -164,12 +164,26 @@ HoneyDatabase::get_unique_terms(Xapian::docid did) const
     return HoneyTermList(this, did).get_unique_terms();
 }
 
+TermStats
+HoneyDatabase::get_term_stats(const string& term) const
+{
+    return term_stats_cache.get(term, version_file.get_revision(),
+				[&](TermStats& stats) {
+				    postlist_table.get_freqs(term,
+							     &stats.termfreq,
+							     &stats.collfreq,
+							     &stats.wdf_upper_bound);
+				});
+}
+
 void
 HoneyDatabase::get_freqs(const string& term,
 			 Xapian::doccount* termfreq_ptr,
 			 Xapian::termcount* collfreq_ptr) const
 {
-    postlist_table.get_freqs(term, termfreq_ptr, collfreq_ptr);
+    TermStats stats = get_term_stats(term);
+    if (termfreq_ptr) *termfreq_ptr = stats.termfreq;
+    if (collfreq_ptr) *collfreq_ptr = stats.collfreq;
 }
 
 Xapian::doccount
@@ -214,7 +228,7 @@ HoneyDatabase::get_wdf_upper_bound(const string& term) const
 	// coll_freq, and the first wdf value, which more often than not is
 	// actually the exact bound (in 77% of cases in an example database of
 	// wikipedia data).
-	wdf_bound = min(wdf_bound, postlist_table.get_wdf_upper_bound(term));
+	wdf_bound = min(wdf_bound, get_term_stats(term).wdf_upper_bound);
     }
     return wdf_bound;
 }
@@ -84,6 +84,9 @@ class HoneyDatabase : public Xapian::Database::Internal {
     [[noreturn]]
     void throw_termlist_table_close_exception() const;
 
+    /// Get the statistics for a term, using term_stats_cache.
+    TermStats get_term_stats(const std::string& term) const;
+
   public:
     explicit
     HoneyDatabase(const std::string& path_, int flags = Xapian::DB_READONLY_);
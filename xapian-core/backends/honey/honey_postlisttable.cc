@@ -58,12 +58,14 @@ HoneyPostListTable::open_post_list(const HoneyDatabase* db,
 void
 HoneyPostListTable::get_freqs(const std::string& term,
 			      Xapian::doccount* termfreq_ptr,
-			      Xapian::termcount* collfreq_ptr) const
+			      Xapian::termcount* collfreq_ptr,
+			      Xapian::termcount* wdfub_ptr) const
 {
     string chunk;
     if (!get_exact_entry(Honey::make_postingchunk_key(term), chunk)) {
 	if (termfreq_ptr) *termfreq_ptr = 0;
 	if (collfreq_ptr) *collfreq_ptr = 0;
+	if (wdfub_ptr) *wdfub_ptr = 0;
 	return;
     }
 
@@ -71,8 +73,18 @@ HoneyPostListTable::get_freqs(const std::string& term,
     const char* pend = p + chunk.size();
     Xapian::doccount tf;
     Xapian::termcount cf;
-    if (!decode_initial_chunk_header_freqs(&p, pend, tf, cf))
-	throw Xapian::DatabaseCorruptError("Postlist initial chunk header");
+    if (wdfub_ptr) {
+	Xapian::docid first;
+	Xapian::docid last;
+	Xapian::docid chunk_last;
+	Xapian::termcount first_wdf;
+	if (!decode_initial_chunk_header(&p, pend, tf, cf, first, last,
+					 chunk_last, first_wdf, *wdfub_ptr))
+	    throw Xapian::DatabaseCorruptError("Postlist initial chunk header");
+    } else {
+	if (!decode_initial_chunk_header_freqs(&p, pend, tf, cf))
+	    throw Xapian::DatabaseCorruptError("Postlist initial chunk header");
+    }
     if (termfreq_ptr) *termfreq_ptr = tf;
     if (collfreq_ptr) *collfreq_ptr = cf;
 }
@@ -132,27 +144,3 @@ HoneyPostListTable::get_used_docid_range(Xapian::doccount doccount,
     // We've reached the end of the table (only possible if there are no terms
     // at all!)
 }
-
-Xapian::termcount
-HoneyPostListTable::get_wdf_upper_bound(const std::string& term) const
-{
-    string chunk;
-    if (!get_exact_entry(Honey::make_postingchunk_key(term), chunk)) {
-	// Term not present.
-	return 0;
-    }
-
-    const char* p = chunk.data();
-    const char* pend = p + chunk.size();
-    Xapian::doccount tf;
-    Xapian::termcount cf;
-    Xapian::docid first;
-    Xapian::docid last;
-    Xapian::docid chunk_last;
-    Xapian::termcount first_wdf;
-    Xapian::termcount wdf_max;
-    if (!decode_initial_chunk_header(&p, pend, tf, cf, first, last, chunk_last,
-				     first_wdf, wdf_max))
-	throw Xapian::DatabaseCorruptError("Postlist initial chunk header");
-    return wdf_max;
-}
@@ -60,14 +60,13 @@ class HoneyPostListTable : public HoneyTable {
 
     void get_freqs(const std::string& term,
 		   Xapian::doccount* termfreq_ptr,
-		   Xapian::termcount* collfreq_ptr) const;
+		   Xapian::termcount* collfreq_ptr,
+		   Xapian::termcount* wdfub_ptr = NULL) const;
 
     void get_used_docid_range(Xapian::doccount doccount,
 			      Xapian::docid& first,
 			      Xapian::docid& last) const;
 
-    Xapian::termcount get_wdf_upper_bound(const std::string& term) const;
-
     std::string get_metadata(const std::string& key) const {
 	std::string value;
 	(void)get_exact_entry(std::string("\0", 2) + key, value);
@@ -372,6 +372,22 @@ MultiDatabase::keep_alive()
     }
 }
 
+void
+MultiDatabase::set_term_stats_cache_size(size_t max_entries)
+{
+    for (auto&& shard : shards) {
+	shard->set_term_stats_cache_size(max_entries);
+    }
+}
+
+void
+MultiDatabase::set_expansion_cache_size(size_t max_terms)
+{
+    for (auto&& shard : shards) {
+	shard->set_expansion_cache_size(max_terms);
+    }
+}
+
 TermList*
 MultiDatabase::open_spelling_termlist(const string& word) const
 {
@@ -502,6 +518,16 @@ MultiDatabase::get_uuid() const
     return uuid;
 }
 
+string
+MultiDatabase::get_server_status() const
+{
+    string status;
+    for (auto&& shard : shards) {
+	status += shard->get_server_status();
+    }
+    return status;
+}
+
 bool
 MultiDatabase::locked() const
 {
@@ -517,6 +543,7 @@ void
 MultiDatabase::write_changesets_to_fd(int,
 				      const std::string&,
 				      bool,
+				      bool,
 				      Xapian::ReplicationInfo*)
 {
     throw Xapian::InvalidOperationError("write_changesets_to_fd() with "
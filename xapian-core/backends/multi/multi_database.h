@@ -36,6 +36,7 @@ struct ReplicationInfo;
 /// Sharded database backend.
 class MultiDatabase : public Xapian::Database::Internal {
     friend class Matcher;
+    friend class RemoteServer;
     friend class ValueStreamDocument;
     friend class Xapian::Database;
 
@@ -110,6 +111,10 @@ class MultiDatabase : public Xapian::Database::Internal {
 
     void keep_alive();
 
+    void set_term_stats_cache_size(size_t max_entries);
+
+    void set_expansion_cache_size(size_t max_terms);
+
     TermList* open_spelling_termlist(const std::string& word) const;
 
     TermList* open_spelling_wordlist() const;
@@ -126,11 +131,14 @@ class MultiDatabase : public Xapian::Database::Internal {
 
     std::string get_uuid() const;
 
+    std::string get_server_status() const;
+
     bool locked() const;
 
     void write_changesets_to_fd(int fd,
 				const std::string& start_revision,
 				bool need_whole_db,
+				bool compress,
 				Xapian::ReplicationInfo* info);
 
     void invalidate_doc_object(Xapian::Document::Internal* obj) const;
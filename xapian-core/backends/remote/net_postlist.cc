@@ -26,6 +26,8 @@
 #include "net/length.h"
 #include "unicode/description_append.h"
 
+#include <algorithm>
+
 using namespace std;
 
 Xapian::doccount
@@ -59,6 +61,27 @@ NetworkPostList::open_position_list() const
     return db->open_position_list(lastdocid, term);
 }
 
+bool
+NetworkPostList::fetch_chunk(Xapian::docid did)
+{
+    Xapian::doccount dummy;
+    more = db->read_post_list(term, did, chunk_size, postings, dummy);
+    pos = postings.data();
+    pos_end = pos + postings.size();
+    lastdocid = did - 1;
+    return pos != pos_end;
+}
+
+void
+NetworkPostList::decode_posting()
+{
+    Xapian::docid inc;
+    decode_length(&pos, pos_end, inc);
+    lastdocid += inc + 1;
+
+    decode_length(&pos, pos_end, lastwdf);
+}
+
 PostList *
 NetworkPostList::next(double)
 {
@@ -70,15 +93,19 @@ NetworkPostList::next(double)
     }
 
     if (pos == pos_end) {
-	pos = NULL;
-    } else {
-	Xapian::docid inc;
-	decode_length(&pos, pos_end, inc);
-	lastdocid += inc + 1;
-
-	decode_length(&pos, pos_end, lastwdf);
+	if (!more) {
+	    pos = NULL;
+	    return NULL;
+	}
+	// We're iterating through the postings, so fetch larger chunks.
+	chunk_size = min(chunk_size * 2, MAX_CHUNK_SIZE);
+	if (!fetch_chunk(lastdocid + 1)) {
+	    pos = NULL;
+	    return NULL;
+	}
     }
 
+    decode_posting();
     return NULL;
 }
 
@@ -87,8 +114,21 @@ NetworkPostList::skip_to(Xapian::docid did, double min_weight)
 {
     if (!started)
 	next(min_weight);
-    while (pos && lastdocid < did)
-	next(min_weight);
+    while (pos && lastdocid < did) {
+	if (pos == pos_end) {
+	    if (!more) {
+		pos = NULL;
+		break;
+	    }
+	    // Ask the server to skip rather than sending the postings before
+	    // did.
+	    if (!fetch_chunk(did)) {
+		pos = NULL;
+		break;
+	    }
+	}
+	decode_posting();
+    }
     return NULL;
 }
 
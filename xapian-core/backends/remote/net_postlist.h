@@ -32,12 +32,22 @@
 using namespace std;
 
 /** A postlist in a remote database.
+ *
+ *  The postings are fetched from the server in chunks as they're needed.
+ *  The chunk size starts small (since often only some of the postings are
+ *  needed) and doubles each time a further chunk is needed by next(), while
+ *  skip_to() beyond the current chunk asks the server to skip.
  */
 class NetworkPostList : public LeafPostList {
-    friend class RemoteDatabase;
+    /// Number of postings to fetch in the first chunk.
+    static constexpr Xapian::doccount INITIAL_CHUNK_SIZE = 1024;
+
+    /// Maximum number of postings to fetch in one chunk.
+    static constexpr Xapian::doccount MAX_CHUNK_SIZE = 65536;
 
     Xapian::Internal::intrusive_ptr<const RemoteDatabase> db;
 
+    /// The encoded postings in the current chunk.
     string postings;
     bool started;
     const char * pos;
@@ -49,12 +59,20 @@ class NetworkPostList : public LeafPostList {
 
     Xapian::doccount termfreq;
 
-    /// Append a posting to the end of the postlist.
-    void append_posting(const string & serialised) {
-	Assert(pos == NULL);
-	Assert(!started);
-	postings.append(serialised);
-    }
+    /// Number of postings to fetch in the next chunk.
+    Xapian::doccount chunk_size;
+
+    /// Are there further postings on the server after the current chunk?
+    bool more;
+
+    /** Fetch the chunk of postings starting at @a did.
+     *
+     *  @return true if the chunk contains any postings.
+     */
+    bool fetch_chunk(Xapian::docid did);
+
+    /// Decode the next posting in the current chunk.
+    void decode_posting();
 
   public:
     /// Constructor.
@@ -62,9 +80,10 @@ class NetworkPostList : public LeafPostList {
 		    const string & term_)
 	: LeafPostList(term_),
 	  db(db_), started(false), pos(NULL), pos_end(NULL),
-	  lastdocid(0), lastwdf(0), termfreq(0)
+	  lastdocid(0), lastwdf(0), termfreq(0),
+	  chunk_size(INITIAL_CHUNK_SIZE)
     {
-	termfreq = db->read_post_list(term, *this);
+	more = db->read_post_list(term, 0, chunk_size, postings, termfreq);
     }
 
     /// Get number of documents indexed by this term.
@@ -43,11 +43,17 @@
 #include "stringutils.h" // For STRINGIZE().
 #include "weight/weightinternal.h"
 
+#include <algorithm>
 #include <cerrno>
+#include <cmath>
 #include <memory>
 #include <string>
 #include <vector>
 
+#ifdef HAVE_POLL_H
+# include <poll.h>
+#endif
+
 #include "xapian/constants.h"
 #include "xapian/error.h"
 #include "xapian/matchspy.h"
@@ -55,6 +61,18 @@
 using namespace std;
 using Xapian::Internal::intrusive_ptr;
 
+/// Number of recent query times to keep for choosing when to hedge.
+static constexpr size_t MAX_QUERY_TIMES = 100;
+
+/// Don't hedge queries until we have this many query times.
+static constexpr size_t MIN_QUERY_TIMES = 10;
+
+/// Seconds to wait before retrying a replica the first time it fails.
+static constexpr double MIN_RETRY_DELAY = 1.0;
+
+/// Longest time in seconds to wait before retrying a failed replica.
+static constexpr double MAX_RETRY_DELAY = 60.0;
+
 [[noreturn]]
 static void
 throw_handshake_failed(const string & context)
@@ -72,7 +90,7 @@ throw_connection_closed_unexpectedly()
 
 RemoteDatabase::RemoteDatabase(int fd, double timeout_,
 			       const string & context_, bool writable,
-			       int flags)
+			       int flags, bool reused)
     : Xapian::Database::Internal(writable ?
 				 TRANSACTION_NONE :
 				 TRANSACTION_READONLY),
@@ -91,6 +109,16 @@ RemoteDatabase::RemoteDatabase(int fd, double timeout_,
     }
 #endif
 
+    if (reused) {
+	// The server may still have the database open at an old revision, so
+	// reopen it, and get the current stats.  These replies also tell us
+	// the connection still works.  Send both messages before reading
+	// either reply to avoid an extra round trip.
+	send_message(MSG_REOPEN, string());
+	send_message(MSG_UPDATE, string());
+	string message;
+	(void)get_message_or_done(message, REPLY_UPDATE);
+    }
     update_stats(MSG_MAX);
 
     if (writable) {
@@ -103,10 +131,156 @@ RemoteDatabase::RemoteDatabase(int fd, double timeout_,
     }
 }
 
+/// Build the context string for a replica set.
+static string
+replica_set_context(const vector<intrusive_ptr<RemoteDatabase>>& replicas)
+{
+    string result("remote:replicas(");
+    for (auto&& replica : replicas) {
+	string context;
+	(void)replica->get_backend_info(&context);
+	if (&replica != &replicas.front())
+	    result += ',';
+	result += context;
+    }
+    result += ')';
+    return result;
+}
+
+RemoteDatabase::RemoteDatabase(vector<intrusive_ptr<RemoteDatabase>>&& replicas_,
+			       double hedge_percentile_)
+    : Xapian::Database::Internal(TRANSACTION_READONLY),
+      link(-1, -1, replica_set_context(replicas_)),
+      context(replica_set_context(replicas_)),
+      cached_stats_valid(),
+      mru_valstats(),
+      mru_slot(Xapian::BAD_VALUENO),
+      replicas(std::move(replicas_)),
+      hedge_percentile(hedge_percentile_),
+      timeout(replicas.front()->timeout)
+{
+    for (auto&& replica : replicas) {
+	if (!replica->is_read_only()) {
+	    throw Xapian::InvalidArgumentError("Replicas must be opened "
+					       "read-only");
+	}
+	// Use the longest timeout when waiting for a reply from any of them.
+	if (timeout != 0.0 &&
+	    (replica->timeout == 0.0 || replica->timeout > timeout)) {
+	    timeout = replica->timeout;
+	}
+    }
+}
+
+RemoteDatabase*
+RemoteDatabase::reconnect() const
+{
+    return NULL;
+}
+
+bool
+RemoteDatabase::server_failed(const RemoteDatabase* server) const
+{
+    if (!server->failed) {
+	server->failed = true;
+	server->retry_delay = max(MIN_RETRY_DELAY,
+				  min(server->retry_delay * 2,
+				      MAX_RETRY_DELAY));
+	server->retry_time = RealTime::now() + server->retry_delay;
+    }
+    for (auto&& replica : replicas) {
+	if (!replica->failed)
+	    return true;
+    }
+    return false;
+}
+
+void
+RemoteDatabase::retry_failed() const
+{
+    double now = 0.0;
+    for (auto&& replica : replicas) {
+	if (!replica->failed)
+	    continue;
+	if (now == 0.0)
+	    now = RealTime::now();
+	// Only pointers are kept to the servers running the current query, so
+	// those can't be replaced (and a failed one only stays in in_flight
+	// until the exception it caused reaches the caller).
+	if (now < replica->retry_time ||
+	    replica.get() == query_server ||
+	    find(in_flight.begin(), in_flight.end(), replica.get()) !=
+		in_flight.end()) {
+	    continue;
+	}
+	RemoteDatabase* fresh = NULL;
+	try {
+	    fresh = replica->reconnect();
+	} catch (const Xapian::Error&) {
+	}
+	if (!fresh) {
+	    // Try again later, waiting longer.
+	    replica->failed = false;
+	    (void)server_failed(replica.get());
+	    continue;
+	}
+	// Carry over the delay so a server which keeps failing is retried
+	// less and less often.
+	fresh->retry_delay = replica->retry_delay;
+	if (last_answered == replica.get())
+	    last_answered = NULL;
+	replica = fresh;
+    }
+}
+
+const RemoteDatabase*
+RemoteDatabase::choose_server() const
+{
+    retry_failed();
+    auto usable = [](const RemoteDatabase* server) {
+	return !server->failed && !server->unread_replies;
+    };
+    if (last_answered && usable(last_answered))
+	return last_answered;
+    for (auto&& replica : replicas) {
+	if (usable(replica.get()))
+	    return replica.get();
+    }
+    for (auto&& replica : replicas) {
+	if (!replica->failed)
+	    return replica.get();
+    }
+    throw Xapian::NetworkError("No working replicas", context);
+}
+
+template<typename Op>
+auto
+RemoteDatabase::with_server(Op op) const -> decltype(op(this))
+{
+    while (true) {
+	const RemoteDatabase* server = choose_server();
+	try {
+	    return op(server);
+	} catch (const Xapian::NetworkError&) {
+	    if (!server_failed(server))
+		throw;
+	} catch (const Xapian::DatabaseClosedError&) {
+	    if (!server_failed(server))
+		throw;
+	}
+    }
+}
+
 Xapian::termcount
 RemoteDatabase::positionlist_count(Xapian::docid did,
 				   const std::string& term) const
 {
+    if (!replicas.empty()) {
+	return with_server([&](const RemoteDatabase* server) {
+	    return server->positionlist_count(did, term);
+	});
+    }
+
     if (cached_stats_valid && !has_positional_info)
 	return 0;
 
@@ -127,6 +301,23 @@ RemoteDatabase::positionlist_count(Xapian::docid did,
 void
 RemoteDatabase::keep_alive()
 {
+    if (!replicas.empty()) {
+	for (auto&& replica : replicas) {
+	    if (replica->failed)
+		continue;
+	    try {
+		replica->keep_alive();
+	    } catch (const Xapian::NetworkError&) {
+		if (!server_failed(replica.get()))
+		    throw;
+	    } catch (const Xapian::DatabaseClosedError&) {
+		if (!server_failed(replica.get()))
+		    throw;
+	    }
+	}
+	return;
+    }
+
     send_message(MSG_KEEPALIVE, string());
     string message;
     get_message(message, REPLY_DONE);
@@ -135,6 +326,12 @@ RemoteDatabase::keep_alive()
 TermList*
 RemoteDatabase::open_metadata_keylist(const std::string& prefix) const
 {
+    if (!replicas.empty()) {
+	return with_server([&](const RemoteDatabase* server) {
+	    return server->open_metadata_keylist(prefix);
+	});
+    }
+
     send_message(MSG_METADATAKEYLIST, prefix);
     string message;
     get_message(message, REPLY_METADATAKEYLIST);
@@ -146,6 +343,12 @@ RemoteDatabase::open_term_list(Xapian::docid did) const
 {
     Assert(did);
 
+    if (!replicas.empty()) {
+	return with_server([&](const RemoteDatabase* server) {
+	    return server->open_term_list(did);
+	});
+    }
+
     // Ensure that total_length and doccount are up-to-date.
     if (!cached_stats_valid) update_stats();
 
@@ -178,6 +381,12 @@ RemoteDatabase::open_term_list_direct(Xapian::docid did) const
 TermList*
 RemoteDatabase::open_allterms(const string& prefix) const
 {
+    if (!replicas.empty()) {
+	return with_server([&](const RemoteDatabase* server) {
+	    return server->open_allterms(prefix);
+	});
+    }
+
     send_message(MSG_ALLTERMS, prefix);
     string message;
     get_message(message, REPLY_ALLTERMS);
@@ -193,32 +402,48 @@ RemoteDatabase::open_post_list(const string& term) const
 LeafPostList *
 RemoteDatabase::open_leaf_post_list(const string& term, bool) const
 {
-    return new NetworkPostList(intrusive_ptr<const RemoteDatabase>(this), term);
+    // The postlist reads its postings from the server chosen here.
+    const RemoteDatabase* server = replicas.empty() ? this : choose_server();
+    return new NetworkPostList(intrusive_ptr<const RemoteDatabase>(server),
+			       term);
 }
 
-Xapian::doccount
-RemoteDatabase::read_post_list(const string &term, NetworkPostList & pl) const
+bool
+RemoteDatabase::read_post_list(const string& term,
+			       Xapian::docid did,
+			       Xapian::doccount max_postings,
+			       string& chunk,
+			       Xapian::doccount& termfreq) const
 {
-    send_message(MSG_POSTLIST, term);
-
-    string message;
-    get_message(message, REPLY_POSTLISTSTART);
-
-    const char * p = message.data();
-    const char * p_end = p + message.size();
-    Xapian::doccount termfreq;
-    decode_length(&p, p_end, termfreq);
+    string message = encode_length(did);
+    message += encode_length(max_postings);
+    message += term;
+    send_message(MSG_POSTLIST, message);
 
-    while (get_message_or_done(message, REPLY_POSTLISTITEM)) {
-	pl.append_posting(message);
+    if (did == 0) {
+	get_message(message, REPLY_POSTLISTSTART);
+	const char * p = message.data();
+	const char * p_end = p + message.size();
+	decode_length(&p, p_end, termfreq);
     }
 
-    return termfreq;
+    get_message(chunk, REPLY_POSTLISTCHUNK);
+    if (chunk.empty())
+	throw Xapian::NetworkError("Bad REPLY_POSTLISTCHUNK");
+    bool more = (chunk[0] != '0');
+    chunk.erase(0, 1);
+    return more;
 }
 
 PositionList *
 RemoteDatabase::open_position_list(Xapian::docid did, const string &term) const
 {
+    if (!replicas.empty()) {
+	return with_server([&](const RemoteDatabase* server) {
+	    return server->open_position_list(did, term);
+	});
+    }
+
     send_message(MSG_POSITIONLIST, encode_length(did) + term);
 
     Xapian::VecCOW<Xapian::termpos> positions;
@@ -240,6 +465,11 @@ RemoteDatabase::open_position_list(Xapian::docid did, const string &term) const
 bool
 RemoteDatabase::has_positions() const
 {
+    if (!replicas.empty()) {
+	return with_server([](const RemoteDatabase* server) {
+	    return server->has_positions();
+	});
+    }
     if (!cached_stats_valid) update_stats();
     return has_positional_info;
 }
@@ -248,12 +478,35 @@ bool
 RemoteDatabase::reopen()
 {
     mru_slot = Xapian::BAD_VALUENO;
+    fetched_docs.clear();
+    if (!replicas.empty()) {
+	retry_failed();
+	bool changed = false;
+	for (auto&& replica : replicas) {
+	    if (replica->failed)
+		continue;
+	    try {
+		if (replica->reopen())
+		    changed = true;
+	    } catch (const Xapian::NetworkError&) {
+		if (!server_failed(replica.get()))
+		    throw;
+	    } catch (const Xapian::DatabaseClosedError&) {
+		if (!server_failed(replica.get()))
+		    throw;
+	    }
+	}
+	return changed;
+    }
     return update_stats(MSG_REOPEN);
 }
 
 void
 RemoteDatabase::close()
 {
+    for (auto&& replica : replicas) {
+	replica->close();
+    }
     do_close();
 }
 
@@ -280,10 +533,31 @@ RemoteDatabase::close()
 // the match, and so we can ignore the lazy flag here without affecting matcher
 // performance.
 Xapian::Document::Internal *
-RemoteDatabase::open_document(Xapian::docid did, bool /*lazy*/) const
+RemoteDatabase::open_document(Xapian::docid did, bool lazy) const
 {
     Assert(did);
 
+    if (!replicas.empty()) {
+	return with_server([&](const RemoteDatabase* server) {
+	    return server->open_document(did, lazy);
+	});
+    }
+
+    auto i = fetched_docs.find(did);
+    if (i == fetched_docs.end() && !requested_docs.empty()) {
+	fetch_documents(did);
+	i = fetched_docs.find(did);
+    }
+    if (i != fetched_docs.end()) {
+	// Copy rather than move the values, as the caller may well open the
+	// same document again.
+	auto values = i->second.values;
+	return new RemoteDocument(this, did, i->second.data,
+				  std::move(values));
+    }
+
+    // If the document doesn't exist, it won't have been fetched above, and
+    // we report that here.
     send_message(MSG_DOCUMENT, encode_length(did));
     string doc_data;
     map<Xapian::valueno, string> values;
@@ -301,6 +575,66 @@ RemoteDatabase::open_document(Xapian::docid did, bool /*lazy*/) const
     return new RemoteDocument(this, did, doc_data, std::move(values));
 }
 
+void
+RemoteDatabase::request_document(Xapian::docid did) const
+{
+    Assert(did);
+    if (!replicas.empty()) {
+	choose_server()->request_document(did);
+	return;
+    }
+    if (fetched_docs.find(did) == fetched_docs.end())
+	requested_docs.push_back(did);
+}
+
+void
+RemoteDatabase::fetch_documents(Xapian::docid did) const
+{
+    vector<Xapian::docid> docids;
+    swap(docids, requested_docs);
+    docids.push_back(did);
+    sort(docids.begin(), docids.end());
+    docids.erase(unique(docids.begin(), docids.end()), docids.end());
+
+    string message;
+    Xapian::docid prev_did = 0;
+    for (Xapian::docid requested_did : docids) {
+	message += encode_length(requested_did - prev_did);
+	prev_did = requested_did;
+    }
+    send_message(MSG_DOCUMENTS, message);
+    get_message(message, REPLY_DOCUMENTS);
+
+    map<Xapian::docid, FetchedDocument> docs;
+    const char * p = message.data();
+    const char * p_end = p + message.size();
+    for (Xapian::docid requested_did : docids) {
+	if (p == p_end || (*p != '0' && *p != '1'))
+	    throw Xapian::NetworkError("Bad REPLY_DOCUMENTS message");
+	if (*p++ == '0')
+	    continue;
+	FetchedDocument& doc = docs[requested_did];
+	size_t len;
+	decode_length_and_check(&p, p_end, len);
+	doc.data.assign(p, len);
+	p += len;
+	Xapian::valueno count;
+	decode_length(&p, p_end, count);
+	Xapian::valueno slot = 0;
+	while (count--) {
+	    Xapian::valueno inc;
+	    decode_length(&p, p_end, inc);
+	    slot += inc;
+	    decode_length_and_check(&p, p_end, len);
+	    doc.values.emplace_hint(doc.values.end(), slot, string(p, len));
+	    p += len;
+	}
+    }
+    if (p != p_end)
+	throw Xapian::NetworkError("Bad REPLY_DOCUMENTS message");
+    swap(fetched_docs, docs);
+}
+
 bool
 RemoteDatabase::update_stats(message_type msg_code, const string & body) const
 {
@@ -354,6 +688,10 @@ RemoteDatabase::update_stats(message_type msg_code, const string & body) const
 	throw Xapian::NetworkError("Bad stats update message received", context);
     }
     has_positional_info = (*p++ == '1');
+    if (p == p_end) {
+	throw Xapian::NetworkError("Bad stats update message received", context);
+    }
+    link.set_compression(*p++ == '1');
     decode_length(&p, p_end, total_length);
     uuid.assign(p, p_end);
     cached_stats_valid = true;
@@ -363,6 +701,11 @@ RemoteDatabase::update_stats(message_type msg_code, const string & body) const
 Xapian::doccount
 RemoteDatabase::get_doccount() const
 {
+    if (!replicas.empty()) {
+	return with_server([](const RemoteDatabase* server) {
+	    return server->get_doccount();
+	});
+    }
     if (!cached_stats_valid) update_stats();
     return doccount;
 }
@@ -370,6 +713,11 @@ RemoteDatabase::get_doccount() const
 Xapian::docid
 RemoteDatabase::get_lastdocid() const
 {
+    if (!replicas.empty()) {
+	return with_server([](const RemoteDatabase* server) {
+	    return server->get_lastdocid();
+	});
+    }
     if (!cached_stats_valid) update_stats();
     return lastdocid;
 }
@@ -377,6 +725,11 @@ RemoteDatabase::get_lastdocid() const
 Xapian::totallength
 RemoteDatabase::get_total_length() const
 {
+    if (!replicas.empty()) {
+	return with_server([](const RemoteDatabase* server) {
+	    return server->get_total_length();
+	});
+    }
     if (!cached_stats_valid) update_stats();
     return total_length;
 }
@@ -387,6 +740,11 @@ RemoteDatabase::term_exists(const string & tname) const
     if (tname.empty()) {
 	return get_doccount() != 0;
     }
+    if (!replicas.empty()) {
+	return with_server([&](const RemoteDatabase* server) {
+	    return server->term_exists(tname);
+	});
+    }
     send_message(MSG_TERMEXISTS, tname);
     string message;
     reply_type type = get_message(message,
@@ -401,6 +759,12 @@ RemoteDatabase::get_freqs(const string & term,
 			  Xapian::termcount * collfreq_ptr) const
 {
     Assert(!term.empty());
+    if (!replicas.empty()) {
+	with_server([&](const RemoteDatabase* server) {
+	    server->get_freqs(term, termfreq_ptr, collfreq_ptr);
+	});
+	return;
+    }
     string message;
     const char * p;
     const char * p_end;
@@ -453,6 +817,11 @@ RemoteDatabase::read_value_stats(Xapian::valueno slot) const
 Xapian::doccount
 RemoteDatabase::get_value_freq(Xapian::valueno slot) const
 {
+    if (!replicas.empty()) {
+	return with_server([&](const RemoteDatabase* server) {
+	    return server->get_value_freq(slot);
+	});
+    }
     read_value_stats(slot);
     return mru_valstats.freq;
 }
@@ -460,6 +829,11 @@ RemoteDatabase::get_value_freq(Xapian::valueno slot) const
 std::string
 RemoteDatabase::get_value_lower_bound(Xapian::valueno slot) const
 {
+    if (!replicas.empty()) {
+	return with_server([&](const RemoteDatabase* server) {
+	    return server->get_value_lower_bound(slot);
+	});
+    }
     read_value_stats(slot);
     return mru_valstats.lower_bound;
 }
@@ -467,6 +841,11 @@ RemoteDatabase::get_value_lower_bound(Xapian::valueno slot) const
 std::string
 RemoteDatabase::get_value_upper_bound(Xapian::valueno slot) const
 {
+    if (!replicas.empty()) {
+	return with_server([&](const RemoteDatabase* server) {
+	    return server->get_value_upper_bound(slot);
+	});
+    }
     read_value_stats(slot);
     return mru_valstats.upper_bound;
 }
@@ -474,18 +853,33 @@ RemoteDatabase::get_value_upper_bound(Xapian::valueno slot) const
 Xapian::termcount
 RemoteDatabase::get_doclength_lower_bound() const
 {
+    if (!replicas.empty()) {
+	return with_server([](const RemoteDatabase* server) {
+	    return server->get_doclength_lower_bound();
+	});
+    }
     return doclen_lbound;
 }
 
 Xapian::termcount
 RemoteDatabase::get_doclength_upper_bound() const
 {
+    if (!replicas.empty()) {
+	return with_server([](const RemoteDatabase* server) {
+	    return server->get_doclength_upper_bound();
+	});
+    }
     return doclen_ubound;
 }
 
 Xapian::termcount
-RemoteDatabase::get_wdf_upper_bound(const string &) const
+RemoteDatabase::get_wdf_upper_bound(const string& term) const
 {
+    if (!replicas.empty()) {
+	return with_server([&](const RemoteDatabase* server) {
+	    return server->get_wdf_upper_bound(term);
+	});
+    }
     // The default implementation returns get_collection_freq(), but we
     // don't want the overhead of a remote message and reply per query
     // term, and we can get called in the middle of a remote exchange
@@ -497,6 +891,11 @@ Xapian::termcount
 RemoteDatabase::get_doclength(Xapian::docid did) const
 {
     Assert(did != 0);
+    if (!replicas.empty()) {
+	return with_server([&](const RemoteDatabase* server) {
+	    return server->get_doclength(did);
+	});
+    }
     send_message(MSG_DOCLENGTH, encode_length(did));
     string message;
     get_message(message, REPLY_DOCLENGTH);
@@ -514,6 +913,11 @@ Xapian::termcount
 RemoteDatabase::get_unique_terms(Xapian::docid did) const
 {
     Assert(did != 0);
+    if (!replicas.empty()) {
+	return with_server([&](const RemoteDatabase* server) {
+	    return server->get_unique_terms(did);
+	});
+    }
     send_message(MSG_UNIQUETERMS, encode_length(did));
     string message;
     get_message(message, REPLY_UNIQUETERMS);
@@ -527,6 +931,27 @@ RemoteDatabase::get_unique_terms(Xapian::docid did) const
     return doclen;
 }
 
+/** Is a reply of @a type the last one the server sends for a request?
+ *
+ *  The other replies are followed by more replies (or for REPLY_STATS, by
+ *  MSG_GETMSET from us and then REPLY_RESULTS).
+ */
+static bool
+ends_request(int type)
+{
+    switch (type) {
+	case REPLY_STATS:
+	case REPLY_TERMLIST0:
+	case REPLY_POSTLISTSTART:
+	case REPLY_POSITIONLIST:
+	case REPLY_DOCDATA:
+	case REPLY_VALUE:
+	    return false;
+	default:
+	    return true;
+    }
+}
+
 reply_type
 RemoteDatabase::get_message(string &result,
 			    reply_type required_type,
@@ -543,6 +968,9 @@ RemoteDatabase::get_message(string &result,
 	errmsg += str(type);
 	throw Xapian::NetworkError(errmsg);
     }
+    // The greeting when we connect isn't a reply to a request.
+    if (ends_request(type) && pending_replies)
+	--pending_replies;
     if (type == REPLY_EXCEPTION) {
 	unserialise_error(result, "REMOTE:", context);
     }
@@ -564,6 +992,23 @@ RemoteDatabase::get_message(string &result,
 void
 RemoteDatabase::send_message(message_type type, const string &message) const
 {
+    while (rare(unread_replies)) {
+	// Read the reply to a hedged query which another replica answered
+	// first.
+	--unread_replies;
+	string reply;
+	try {
+	    get_message(reply, REPLY_RESULTS);
+	} catch (const Xapian::NetworkError&) {
+	    throw;
+	} catch (const Xapian::Error&) {
+	    // The server's exception for the abandoned query.
+	}
+    }
+
+    // MSG_GETMSET continues the conversation started by MSG_QUERY.
+    if (type != MSG_GETMSET)
+	++pending_replies;
     double end_time = RealTime::end_time(timeout);
     link.send_message(static_cast<unsigned char>(type), message, end_time);
 }
@@ -587,6 +1032,20 @@ RemoteDatabase::do_close()
     link.do_close();
 }
 
+int
+RemoteDatabase::release_connection()
+{
+    Assert(is_read_only());
+    dtor_called();
+    if (pending_replies) {
+	// Replies are still to come, which whoever reused the connection
+	// would read instead of the replies to their own requests.
+	link.do_close();
+	return -1;
+    }
+    return link.release();
+}
+
 void
 RemoteDatabase::set_query(const Xapian::Query& query,
 			  Xapian::termcount qlen,
@@ -597,11 +1056,33 @@ RemoteDatabase::set_query(const Xapian::Query& query,
 			  Xapian::Enquire::Internal::sort_setting sort_by,
 			  bool sort_value_forward,
 			  double time_limit,
+			  bool hard_time_limit,
+			  double pruning_factor,
 			  int percent_threshold, double weight_threshold,
 			  const Xapian::Weight& wtscheme,
 			  const Xapian::RSet &omrset,
-			  const vector<opt_ptr_spy>& matchspies) const
+			  const vector<opt_ptr_spy>& matchspies,
+			  bool shard_stats) const
 {
+    query_server = NULL;
+    if (!replicas.empty() && !shard_stats) {
+	// The stats and MSet have to be exchanged with the server which we
+	// sent the query to, so the query can't be hedged.
+	query_server = choose_server();
+	try {
+	    query_server->set_query(query, qlen, collapse_key, collapse_max,
+				    order, sort_key, sort_by,
+				    sort_value_forward, time_limit,
+				    hard_time_limit, pruning_factor,
+				    percent_threshold, weight_threshold,
+				    wtscheme, omrset, matchspies, false);
+	} catch (const Xapian::NetworkError&) {
+	    (void)server_failed(query_server);
+	    throw;
+	}
+	return;
+    }
+
     string tmp = query.serialise();
     string message = encode_length(tmp.size());
     message += tmp;
@@ -615,6 +1096,8 @@ RemoteDatabase::set_query(const Xapian::Query& query,
     message += char('0' + sort_by);
     message += char('0' + sort_value_forward);
     message += serialise_double(time_limit);
+    message += char('0' + hard_time_limit);
+    message += serialise_double(pruning_factor);
     message += char(percent_threshold);
     message += serialise_double(weight_threshold);
 
@@ -643,12 +1126,30 @@ RemoteDatabase::set_query(const Xapian::Query& query,
 	message += tmp;
     }
 
+    if (shard_stats) {
+	// We need the range of the MSet too, so send_global_stats() sends
+	// this.
+	swap(pending_query, message);
+	return;
+    }
+
+    pending_query.resize(0);
+    message.insert(0, 1, '0');
     send_message(MSG_QUERY, message);
 }
 
 void
 RemoteDatabase::get_remote_stats(Xapian::Weight::Internal& out) const
 {
+    if (query_server) {
+	try {
+	    query_server->get_remote_stats(out);
+	} catch (const Xapian::NetworkError&) {
+	    (void)server_failed(query_server);
+	    throw;
+	}
+	return;
+    }
     string message;
     get_message(message, REPLY_STATS);
     unserialise_stats(message, out);
@@ -660,6 +1161,54 @@ RemoteDatabase::send_global_stats(Xapian::doccount first,
 				  Xapian::doccount check_at_least,
 				  const Xapian::Weight::Internal &stats) const
 {
+    if (!pending_query.empty()) {
+	string message(1, '1');
+	message += encode_length(first);
+	message += encode_length(maxitems);
+	message += encode_length(check_at_least);
+	message += pending_query;
+	pending_query.resize(0);
+	if (replicas.empty()) {
+	    send_message(MSG_QUERY, message);
+	    return;
+	}
+
+	swap(hedged_query, message);
+	// If the last query was abandoned, the replies to it still need to be
+	// read.
+	for (auto replica : in_flight)
+	    ++replica->unread_replies;
+	in_flight.clear();
+	hedge_time = 0.0;
+	retry_failed();
+	query_start = RealTime::now();
+	if (!send_to_replica()) {
+	    throw Xapian::NetworkError("Failed to send query to any replica",
+				       context);
+	}
+#ifdef HAVE_POLL
+	if (query_times.size() >= MIN_QUERY_TIMES) {
+	    vector<double> times(query_times);
+	    size_t i = size_t(times.size() * hedge_percentile / 100.0);
+	    i = min(i, times.size() - 1);
+	    nth_element(times.begin(), times.begin() + i, times.end());
+	    hedge_time = query_start + times[i];
+	}
+#endif
+	return;
+    }
+
+    if (query_server) {
+	try {
+	    query_server->send_global_stats(first, maxitems, check_at_least,
+					    stats);
+	} catch (const Xapian::NetworkError&) {
+	    (void)server_failed(query_server);
+	    throw;
+	}
+	return;
+    }
+
     string message = encode_length(first);
     message += encode_length(maxitems);
     message += encode_length(check_at_least);
@@ -667,11 +1216,171 @@ RemoteDatabase::send_global_stats(Xapian::doccount first,
     send_message(MSG_GETMSET, message);
 }
 
+int
+RemoteDatabase::get_read_fd() const
+{
+    if (!in_flight.empty())
+	return in_flight.front()->get_read_fd();
+    if (query_server)
+	return query_server->get_read_fd();
+    return link.get_read_fd();
+}
+
+void
+RemoteDatabase::get_read_fds(vector<int>& fds) const
+{
+    if (in_flight.empty()) {
+	fds.push_back(get_read_fd());
+	return;
+    }
+    for (auto replica : in_flight) {
+	fds.push_back(replica->get_read_fd());
+    }
+}
+
+bool
+RemoteDatabase::send_to_replica() const
+{
+    // Prefer servers which don't have to send the replies to abandoned
+    // queries first.
+    for (int pass = 0; pass != 2; ++pass) {
+	for (auto&& r : replicas) {
+	    const RemoteDatabase* replica = r.get();
+	    if (replica->failed ||
+		(pass == 0 && replica->unread_replies) ||
+		find(in_flight.begin(), in_flight.end(), replica) !=
+		    in_flight.end()) {
+		continue;
+	    }
+	    try {
+		replica->send_message(MSG_QUERY, hedged_query);
+	    } catch (const Xapian::Error&) {
+		(void)server_failed(replica);
+		continue;
+	    }
+	    in_flight.push_back(replica);
+	    return true;
+	}
+    }
+    return false;
+}
+
+void
+RemoteDatabase::send_hedge() const
+{
+    hedge_time = 0.0;
+    (void)send_to_replica();
+}
+
+void
+RemoteDatabase::get_hedged_reply(string& message) const
+{
+    // The replicas which don't answer first still send a reply, which will
+    // need to be read before they're next used.
+    auto finish = [this](const RemoteDatabase* answered) {
+	for (auto replica : in_flight) {
+	    if (replica != answered)
+		++replica->unread_replies;
+	}
+	in_flight.clear();
+	hedge_time = 0.0;
+	if (answered) {
+	    last_answered = answered;
+	    answered->retry_delay = 0.0;
+	}
+    };
+
+    double end_time = RealTime::end_time(timeout);
+    while (true) {
+	const RemoteDatabase* replica = in_flight.front();
+#ifdef HAVE_POLL
+	if (in_flight.size() > 1 || hedge_time != 0.0) {
+	    vector<struct pollfd> fds(in_flight.size());
+	    for (size_t i = 0; i != in_flight.size(); ++i) {
+		fds[i].fd = in_flight[i]->get_read_fd();
+		fds[i].events = POLLIN;
+		fds[i].revents = 0;
+	    }
+	    double wait_until = end_time;
+	    if (hedge_time != 0.0 && (wait_until == 0.0 || hedge_time < wait_until))
+		wait_until = hedge_time;
+	    int timeout_ms = -1;
+	    if (wait_until != 0.0) {
+		double delay = wait_until - RealTime::now();
+		timeout_ms = delay > 0.0 ? int(ceil(delay * 1000.0)) : 0;
+	    }
+	    int res = poll(fds.data(), fds.size(), timeout_ms);
+	    if (res < 0) {
+		if (errno == EINTR || errno == EAGAIN)
+		    continue;
+		throw Xapian::NetworkError("poll() failed waiting for replicas",
+					   context, errno);
+	    }
+	    if (res == 0) {
+		if (hedge_time != 0.0 && RealTime::now() >= hedge_time) {
+		    send_hedge();
+		    continue;
+		}
+		if (end_time != 0.0 && RealTime::now() >= end_time) {
+		    finish(NULL);
+		    throw Xapian::NetworkTimeoutError("Timeout expired while "
+						      "waiting for replicas",
+						      context);
+		}
+		continue;
+	    }
+	    size_t i = 0;
+	    while (!fds[i].revents) ++i;
+	    replica = in_flight[i];
+	}
+#endif
+	try {
+	    replica->get_message(message, REPLY_RESULTS);
+	} catch (const Xapian::NetworkError&) {
+	    // Stop using this replica, and try another if none are running
+	    // the query.
+	    (void)server_failed(replica);
+	    in_flight.erase(find(in_flight.begin(), in_flight.end(), replica));
+	    if (in_flight.empty() && !send_to_replica())
+		throw;
+	    continue;
+	} catch (...) {
+	    finish(replica);
+	    throw;
+	}
+	finish(replica);
+
+	double elapsed = RealTime::now() - query_start;
+	if (query_times.size() < MAX_QUERY_TIMES) {
+	    query_times.push_back(elapsed);
+	} else {
+	    query_times[query_times_pos] = elapsed;
+	    query_times_pos = (query_times_pos + 1) % MAX_QUERY_TIMES;
+	}
+	return;
+    }
+}
+
 Xapian::MSet
 RemoteDatabase::get_mset(const vector<opt_ptr_spy>& matchspies) const
 {
+    if (query_server) {
+	const RemoteDatabase* server = query_server;
+	query_server = NULL;
+	try {
+	    return server->get_mset(matchspies);
+	} catch (const Xapian::NetworkError&) {
+	    (void)server_failed(server);
+	    throw;
+	}
+    }
+
     string message;
-    get_message(message, REPLY_RESULTS);
+    if (in_flight.empty()) {
+	get_message(message, REPLY_RESULTS);
+    } else {
+	get_hedged_reply(message);
+    }
     const char * p = message.data();
     const char * p_end = p + message.size();
 
@@ -704,6 +1413,7 @@ RemoteDatabase::cancel()
 {
     cached_stats_valid = false;
     mru_slot = Xapian::BAD_VALUENO;
+    fetched_docs.clear();
 
     send_message(MSG_CANCEL, string());
     string dummy;
@@ -715,6 +1425,7 @@ RemoteDatabase::add_document(const Xapian::Document & doc)
 {
     cached_stats_valid = false;
     mru_slot = Xapian::BAD_VALUENO;
+    fetched_docs.clear();
 
     send_message(MSG_ADDDOCUMENT, serialise_document(doc));
 
@@ -733,6 +1444,7 @@ RemoteDatabase::delete_document(Xapian::docid did)
 {
     cached_stats_valid = false;
     mru_slot = Xapian::BAD_VALUENO;
+    fetched_docs.clear();
 
     send_message(MSG_DELETEDOCUMENT, encode_length(did));
     string dummy;
@@ -744,6 +1456,7 @@ RemoteDatabase::delete_document(const std::string & unique_term)
 {
     cached_stats_valid = false;
     mru_slot = Xapian::BAD_VALUENO;
+    fetched_docs.clear();
 
     send_message(MSG_DELETEDOCUMENTTERM, unique_term);
     string dummy;
@@ -756,6 +1469,7 @@ RemoteDatabase::replace_document(Xapian::docid did,
 {
     cached_stats_valid = false;
     mru_slot = Xapian::BAD_VALUENO;
+    fetched_docs.clear();
 
     string message = encode_length(did);
     message += serialise_document(doc);
@@ -771,6 +1485,7 @@ RemoteDatabase::replace_document(const std::string & unique_term,
 {
     cached_stats_valid = false;
     mru_slot = Xapian::BAD_VALUENO;
+    fetched_docs.clear();
 
     string message = encode_length(unique_term.size());
     message += unique_term;
@@ -790,12 +1505,36 @@ RemoteDatabase::replace_document(const std::string & unique_term,
 string
 RemoteDatabase::get_uuid() const
 {
+    if (!replicas.empty()) {
+	return with_server([](const RemoteDatabase* server) {
+	    return server->get_uuid();
+	});
+    }
     return uuid;
 }
 
+string
+RemoteDatabase::get_server_status() const
+{
+    if (!replicas.empty()) {
+	return with_server([](const RemoteDatabase* server) {
+	    return server->get_server_status();
+	});
+    }
+    send_message(MSG_STATUS, string());
+    string status;
+    get_message(status, REPLY_STATUS);
+    return status;
+}
+
 string
 RemoteDatabase::get_metadata(const string & key) const
 {
+    if (!replicas.empty()) {
+	return with_server([&](const RemoteDatabase* server) {
+	    return server->get_metadata(key);
+	});
+    }
     send_message(MSG_GETMETADATA, key);
     string metadata;
     get_message(metadata, REPLY_METADATA);
@@ -30,6 +30,9 @@
 #include "backends/valuestats.h"
 #include "xapian/weight.h"
 
+#include <map>
+#include <vector>
+
 namespace Xapian {
     class RSet;
 }
@@ -87,6 +90,146 @@ class RemoteDatabase : public Xapian::Database::Internal {
      */
     mutable Xapian::valueno mru_slot;
 
+    /** MSG_QUERY message waiting to be sent by send_global_stats().
+     *
+     *  Empty unless set_query() was called with @a shard_stats true.
+     */
+    mutable std::string pending_query;
+
+    /** The servers in this replica set.
+     *
+     *  Empty unless this object was created by the replica set constructor,
+     *  in which case it has no connection of its own and every operation is
+     *  passed on to one of these.  Queries which use the shard's own
+     *  statistics are sent to the first working server.  If it's slow to
+     *  reply, the query is also sent to another ("hedged"), and whichever
+     *  reply arrives first is used.
+     *
+     *  A server which has failed is replaced by a new connection to it
+     *  once its retry_time has passed.
+     */
+    mutable std::vector<Xapian::Internal::intrusive_ptr<RemoteDatabase>> replicas;
+
+    /// Percentile of recent query times after which to send a hedged query.
+    double hedge_percentile = 0.0;
+
+    /// Recent query times in seconds, used as a ring buffer.
+    mutable std::vector<double> query_times;
+
+    /// Index in query_times to store the next time at.
+    mutable size_t query_times_pos = 0;
+
+    /// MSG_QUERY message for the query in progress, when there are replicas.
+    mutable std::string hedged_query;
+
+    /// The servers in the replica set which hedged_query is waiting for.
+    mutable std::vector<const RemoteDatabase*> in_flight;
+
+    /// When hedged_query was first sent.
+    mutable double query_start = 0.0;
+
+    /// When to send hedged_query to another replica (0.0 for never).
+    mutable double hedge_time = 0.0;
+
+    /// Number of replies to abandoned hedged queries still to be read.
+    mutable unsigned unread_replies = 0;
+
+    /** Number of requests sent whose replies haven't all been read.
+     *
+     *  The connection can only be reused by another RemoteDatabase when this
+     *  is zero - otherwise it would read the replies to our requests.
+     */
+    mutable unsigned pending_replies = 0;
+
+    /// Has communicating with this server as part of a replica set failed?
+    mutable bool failed = false;
+
+    /// If failed, when to try connecting to this server again.
+    mutable double retry_time = 0.0;
+
+    /** Seconds to wait after this server fails before trying it again.
+     *
+     *  Doubles each time it fails, and is reset once it answers a query.
+     */
+    mutable double retry_delay = 0.0;
+
+    /// The server in the replica set which answered the last hedged query.
+    mutable const RemoteDatabase* last_answered = NULL;
+
+    /** The server in the replica set running the current query.
+     *
+     *  Set when the query doesn't use the shard's own statistics, as then
+     *  the whole exchange with the server has to be with the same one.
+     */
+    mutable const RemoteDatabase* query_server = NULL;
+
+    /** Documents which request_document() has said will be wanted soon.
+     *
+     *  The next call to open_document() fetches all of these at once.
+     */
+    mutable std::vector<Xapian::docid> requested_docs;
+
+    /// The data and values of a document fetched by fetch_documents().
+    struct FetchedDocument {
+	std::string data;
+
+	std::map<Xapian::valueno, std::string> values;
+    };
+
+    /** Documents fetched by the last call to fetch_documents().
+     *
+     *  Cleared if the database is reopened or modified.
+     */
+    mutable std::map<Xapian::docid, FetchedDocument> fetched_docs;
+
+    /** Fetch requested_docs and @a did using a single MSG_DOCUMENTS.
+     *
+     *  The documents which exist are stored in fetched_docs.
+     */
+    void fetch_documents(Xapian::docid did) const;
+
+    /** Send hedged_query to a working replica which isn't already running it.
+     *
+     *  @return true if it was sent, false if there are no more replicas.
+     */
+    bool send_to_replica() const;
+
+    /// Read the reply to hedged_query from whichever replica answers first.
+    void get_hedged_reply(std::string& message) const;
+
+    /** Choose the server in the replica set to pass an operation on to.
+     *
+     *  This is the server which answered the last hedged query (so document
+     *  ids refer to the same revision as the last MSet), or failing that the
+     *  first working one, skipping any which still have to send replies to
+     *  abandoned queries - otherwise we'd have to wait for a slow server to
+     *  finish a query whose results we don't want.  If every working server
+     *  is busy, the first is returned.
+     *
+     *  Xapian::NetworkError is thrown if no server is working.
+     */
+    const RemoteDatabase* choose_server() const;
+
+    /** Note that communicating with @a server in the replica set failed.
+     *
+     *  @return true if there's another working server to try.
+     */
+    bool server_failed(const RemoteDatabase* server) const;
+
+    /// Reconnect to failed servers in the replica set which are due a retry.
+    void retry_failed() const;
+
+    /** Perform an operation using a server chosen by choose_server().
+     *
+     *  If communicating with the server fails, it's marked as failed and the
+     *  operation is retried with another server.
+     *
+     *  @param op	Function object taking a const RemoteDatabase* which
+     *			performs the operation.
+     */
+    template<typename Op>
+    auto with_server(Op op) const -> decltype(op(this));
+
     bool update_stats(message_type msg_code = MSG_UPDATE,
 		      const std::string & body = std::string()) const;
 
@@ -104,9 +247,28 @@ class RemoteDatabase : public Xapian::Database::Internal {
      *  @param context_ The context to return with any error messages.
      *	@param writable	Is this a WritableDatabase?
      *	@param flags	Xapian::DB_RETRY_LOCK or 0.
+     *	@param reused	Has the connection been used by a RemoteDatabase
+     *			before?  If so, there's no greeting from the server
+     *			to read.
      */
     RemoteDatabase(int fd, double timeout_, const std::string& context_,
-		   bool writable, int flags);
+		   bool writable, int flags, bool reused = false);
+
+  public:
+    /** Construct a replica set.
+     *
+     *  Xapian::InvalidArgumentError is thrown if any of the servers is
+     *  writable.
+     *
+     *  @param replicas_	The servers with copies of the database, each a
+     *				RemoteDatabase opened on its own connection.
+     *  @param hedge_percentile_	Percentile of recent query times after
+     *					which to send a hedged query.
+     */
+    RemoteDatabase(std::vector<Xapian::Internal::intrusive_ptr<RemoteDatabase>>&& replicas_,
+		   double hedge_percentile_);
+
+  protected:
 
     /// Receive a message from the server.
     reply_type get_message(std::string& message,
@@ -129,11 +291,30 @@ class RemoteDatabase : public Xapian::Database::Internal {
     /// Close the socket
     void do_close();
 
+    /** Give up the connection so it can be reused.
+     *
+     *  Use instead of do_close().  Only valid for a read-only database.
+     *
+     *  @return The fd, or -1 if the connection wasn't idle (in which case
+     *		it has been closed).
+     */
+    int release_connection();
+
     bool get_posting(Xapian::docid& did, double& w, std::string& value);
 
     /// The timeout value used in network communications, in seconds.
     double timeout;
 
+    /** Open a new connection to the same server.
+     *
+     *  Used to retry a server in a replica set after it has failed.  The
+     *  default implementation returns NULL.
+     *
+     *  @return A new read-only RemoteDatabase, or NULL if reconnecting
+     *		isn't supported.
+     */
+    virtual RemoteDatabase* reconnect() const;
+
   public:
     /** Get the length of the position list.
      *
@@ -161,11 +342,20 @@ class RemoteDatabase : public Xapian::Database::Internal {
      * @param sort_value_forward	Sort order for values.
      * @param time_limit_		Seconds to reduce check_at_least after
      *					(or <= 0 for no limit).
+     * @param hard_time_limit		Stop the match once time_limit is
+     *					reached?
+     * @param pruning_factor		Factor to scale the weight needed to
+     *					prune by (1.0 for exact results).
      * @param percent_threshold		Lower bound on percentage score.
      * @param weight_threshold		Lower bound on weight.
      * @param wtscheme			Weighting scheme.
      * @param omrset			The rset.
      * @param matchspies                The matchspies to use.
+     * @param shard_stats		Should the server weight using its own
+     *					statistics?  If so, the query is sent
+     *					by send_global_stats() along with the
+     *					range of the MSet wanted, and the MSet
+     *					is returned in a single round trip.
      */
     void set_query(const Xapian::Query& query,
 		   Xapian::termcount qlen,
@@ -176,24 +366,46 @@ class RemoteDatabase : public Xapian::Database::Internal {
 		   Xapian::Enquire::Internal::sort_setting sort_by,
 		   bool sort_value_forward,
 		   double time_limit,
+		   bool hard_time_limit,
+		   double pruning_factor,
 		   int percent_threshold, double weight_threshold,
 		   const Xapian::Weight& wtscheme,
 		   const Xapian::RSet &omrset,
-		   const std::vector<opt_ptr_spy>& matchspies) const;
+		   const std::vector<opt_ptr_spy>& matchspies,
+		   bool shard_stats) const;
 
     /** Get the underlying fd this remote connection reads from.
      *
      *  This allows the matcher to efficiently wait for remote databases to be
-     *  ready in parallel using poll() or select().
+     *  ready in parallel using poll() or select().  For a replica set, this
+     *  is the fd of the server the current query was sent to.
      */
-    int get_read_fd() const {
-	return link.get_read_fd();
-    }
+    int get_read_fd() const;
+
+    /// Is this database a replica set?
+    bool has_replicas() const { return !replicas.empty(); }
+
+    /** Get the fds to wait on for the reply to the current query.
+     *
+     *  Like get_read_fd(), but if the query has been sent to replicas, the
+     *  fds for all of them are added.
+     */
+    void get_read_fds(std::vector<int>& fds) const;
+
+    /// When to call send_hedge() (0.0 for never).
+    double get_hedge_time() const { return hedge_time; }
+
+    /// Send the current query to another replica.
+    void send_hedge() const;
 
     /// Get the stats from the remote server.
     void get_remote_stats(Xapian::Weight::Internal& out) const;
 
-    /// Send the global stats to the remote server.
+    /** Send the global stats to the remote server.
+     *
+     *  If set_query() was called with @a shard_stats true, @a stats is
+     *  ignored and the query is sent instead.
+     */
     void send_global_stats(Xapian::doccount first,
 			   Xapian::doccount maxitems,
 			   Xapian::doccount check_at_least,
@@ -223,7 +435,23 @@ class RemoteDatabase : public Xapian::Database::Internal {
 
     LeafPostList* open_leaf_post_list(const std::string& term, bool) const;
 
-    Xapian::doccount read_post_list(const std::string& term, NetworkPostList & pl) const;
+    /** Fetch a chunk of a postlist from the server.
+     *
+     *  @param term		The term.
+     *  @param did		Fetch postings from this docid onwards, or 0 to
+     *				start from the beginning and also fetch the
+     *				term's frequency.
+     *  @param max_postings	The maximum number of postings to fetch.
+     *  @param chunk		Set to the encoded postings.
+     *  @param termfreq		Set to the term's frequency if @a did is 0.
+     *
+     *  @return true if there are further postings after those in @a chunk.
+     */
+    bool read_post_list(const std::string& term,
+			Xapian::docid did,
+			Xapian::doccount max_postings,
+			std::string& chunk,
+			Xapian::doccount& termfreq) const;
 
     PositionList * open_position_list(Xapian::docid did,
 				      const std::string& tname) const;
@@ -231,6 +459,14 @@ class RemoteDatabase : public Xapian::Database::Internal {
     /// Get a remote document.
     Xapian::Document::Internal * open_document(Xapian::docid did, bool lazy) const;
 
+    /** Note that a document will be wanted soon.
+     *
+     *  The requested documents are fetched together by the next call to
+     *  open_document(), so displaying a page of results only needs one
+     *  round trip to the server.
+     */
+    void request_document(Xapian::docid did) const;
+
     /// Get the document count.
     Xapian::doccount get_doccount() const;
 
@@ -274,6 +510,8 @@ class RemoteDatabase : public Xapian::Database::Internal {
 
     std::string get_uuid() const;
 
+    std::string get_server_status() const;
+
     std::string get_metadata(const std::string& key) const;
 
     void set_metadata(const std::string& key, const std::string& value);
@@ -0,0 +1,158 @@
+/** @file termngramindex.cc
+ * @brief In-memory index of the byte n-grams in a shard's terms
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "termngramindex.h"
+
+#include "alltermslist.h"
+#include "omassert.h"
+#include "stringutils.h"
+#include "xapian/error.h"
+
+#include <algorithm>
+#include <memory>
+
+using namespace std;
+
+/// List of candidate terms found using a TermNgramIndex.
+class NgramCandidateList : public AllTermsList {
+    /// The candidate terms, in sorted order.
+    vector<string> terms;
+
+    /// Position in terms.
+    vector<string>::const_iterator it;
+
+    /// Has next() or skip_to() been called yet?
+    bool started = false;
+
+  public:
+    explicit NgramCandidateList(vector<string>&& terms_)
+	: terms(std::move(terms_)) { }
+
+    Xapian::termcount get_approx_size() const {
+	return terms.size();
+    }
+
+    string get_termname() const {
+	Assert(started);
+	Assert(!at_end());
+	return *it;
+    }
+
+    Xapian::doccount get_termfreq() const {
+	throw Xapian::InvalidOperationError("NgramCandidateList::get_termfreq() "
+					    "not meaningful");
+    }
+
+    TermList* next() {
+	if (!started) {
+	    started = true;
+	    it = terms.begin();
+	} else {
+	    Assert(!at_end());
+	    ++it;
+	}
+	return NULL;
+    }
+
+    TermList* skip_to(const string& term) {
+	if (!started) {
+	    started = true;
+	    it = terms.begin();
+	}
+	it = lower_bound(it, vector<string>::const_iterator(terms.end()), term);
+	return NULL;
+    }
+
+    bool at_end() const {
+	return started && it == terms.end();
+    }
+};
+
+TermNgramIndex::TermNgramIndex(TermList* allterms)
+{
+    unique_ptr<TermList> t(allterms);
+    while (t->next(), !t->at_end()) {
+	const string& term = t->get_termname();
+	AssertRel(term_offsets.size(), <, size_t(UINT32_MAX));
+	uint32_t idx = term_offsets.size();
+	term_offsets.push_back(term_data.size());
+	term_data += term;
+	if (term.size() < N) continue;
+	for (size_t i = 0; i <= term.size() - N; ++i) {
+	    auto& pl = postings[ngram_key(term.data() + i)];
+	    // Only record each term once per n-gram.
+	    if (pl.empty() || pl.back() != idx)
+		pl.push_back(idx);
+	}
+    }
+    term_offsets.push_back(term_data.size());
+}
+
+TermList*
+TermNgramIndex::open_candidates(const string& prefix,
+				const vector<string>& fragments) const
+{
+    // Find the posting list for every n-gram which candidates must contain.
+    vector<const vector<uint32_t>*> lists;
+    auto add_ngrams = [&](const string& s) {
+	if (s.size() < N) return true;
+	for (size_t i = 0; i <= s.size() - N; ++i) {
+	    auto pl = postings.find(ngram_key(s.data() + i));
+	    if (pl == postings.end()) return false;
+	    lists.push_back(&pl->second);
+	}
+	return true;
+    };
+    vector<string> result;
+    if (!add_ngrams(prefix))
+	return new NgramCandidateList(std::move(result));
+    for (auto&& fragment : fragments) {
+	if (!add_ngrams(fragment))
+	    return new NgramCandidateList(std::move(result));
+    }
+    Assert(!lists.empty());
+
+    // Intersect, starting from the shortest list.
+    sort(lists.begin(), lists.end());
+    lists.erase(unique(lists.begin(), lists.end()), lists.end());
+    sort(lists.begin(), lists.end(),
+	 [](const vector<uint32_t>* a, const vector<uint32_t>* b) {
+	     return a->size() < b->size();
+	 });
+    vector<uint32_t> candidates(*lists.front());
+    for (auto i = lists.begin() + 1; i != lists.end(); ++i) {
+	if (candidates.empty()) break;
+	const vector<uint32_t>& pl = **i;
+	auto new_end = remove_if(candidates.begin(), candidates.end(),
+				 [&](uint32_t idx) {
+				     return !binary_search(pl.begin(),
+							   pl.end(), idx);
+				 });
+	candidates.erase(new_end, candidates.end());
+    }
+
+    result.reserve(candidates.size());
+    for (auto idx : candidates) {
+	string term = get_term(idx);
+	if (startswith(term, prefix))
+	    result.push_back(std::move(term));
+    }
+    return new NgramCandidateList(std::move(result));
+}
@@ -0,0 +1,104 @@
+/** @file termngramindex.h
+ * @brief In-memory index of the byte n-grams in a shard's terms
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_TERMNGRAMINDEX_H
+#define XAPIAN_INCLUDED_TERMNGRAMINDEX_H
+
+#include "api/termlist.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/** Index of the 3-byte substrings of every term in a database shard.
+ *
+ *  Used to find candidate terms for OP_WILDCARD patterns which don't have a
+ *  usefully long fixed prefix (e.g. "*phone"), which would otherwise require
+ *  checking every term in the shard.
+ *
+ *  The terms are stored in sorted order in a single string to avoid the
+ *  per-object overhead of std::string, and each n-gram maps to an ascending
+ *  list of indices into the terms.
+ */
+class TermNgramIndex {
+    /// Length of the n-grams indexed.
+    static constexpr size_t N = 3;
+
+    /// The terms, concatenated in sorted order.
+    std::string term_data;
+
+    /** Offset of the start of each term in term_data.
+     *
+     *  There's an extra entry at the end holding term_data.size(), so term i
+     *  is the bytes from term_offsets[i] to term_offsets[i + 1].
+     */
+    std::vector<size_t> term_offsets;
+
+    /// Map from n-gram to the ascending list of terms containing it.
+    std::unordered_map<uint32_t, std::vector<uint32_t>> postings;
+
+    static uint32_t ngram_key(const char* p) {
+	return uint32_t(static_cast<unsigned char>(p[0])) << 16 |
+	       uint32_t(static_cast<unsigned char>(p[1])) << 8 |
+	       uint32_t(static_cast<unsigned char>(p[2]));
+    }
+
+  public:
+    /** Build the index.
+     *
+     *  @param allterms	TermList over every term in the shard, which must be
+     *			in sorted order.  Ownership is taken.
+     */
+    explicit TermNgramIndex(TermList* allterms);
+
+    /// The number of terms indexed.
+    size_t size() const { return term_offsets.size() - 1; }
+
+    /// Return the term with index @a i.
+    std::string get_term(size_t i) const {
+	return std::string(term_data, term_offsets[i],
+			   term_offsets[i + 1] - term_offsets[i]);
+    }
+
+    /** Test if a pattern fragment can be used to look up candidates.
+     *
+     *  Only fragments of at least N bytes contain an n-gram.
+     */
+    static bool usable_fragment(const std::string& fragment) {
+	return fragment.size() >= N;
+    }
+
+    /** Open a list of candidate terms.
+     *
+     *  The returned list contains, in sorted order, every term which starts
+     *  with @a prefix and contains every n-gram in @a prefix and each of
+     *  @a fragments.  Terms in the list need to be checked against the full
+     *  pattern by the caller, since the n-grams may occur in the wrong order
+     *  or in the wrong places.
+     *
+     *  @param prefix	Fixed prefix which every candidate must start with.
+     *  @param fragments	Literal substrings which every candidate must
+     *			contain, at least one of which must be a
+     *			usable_fragment().
+     */
+    TermList* open_candidates(const std::string& prefix,
+			      const std::vector<std::string>& fragments) const;
+};
+
+#endif // XAPIAN_INCLUDED_TERMNGRAMINDEX_H
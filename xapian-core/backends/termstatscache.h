@@ -0,0 +1,99 @@
+/** @file termstatscache.h
+ * @brief LRU cache of per-term statistics
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_TERMSTATSCACHE_H
+#define XAPIAN_INCLUDED_TERMSTATSCACHE_H
+
+#include <xapian/types.h>
+
+#include "lrucache.h"
+
+#include <string>
+
+/// Statistics for a term in a database shard.
+struct TermStats {
+    /// Number of documents indexed by the term.
+    Xapian::doccount termfreq;
+
+    /// Number of occurrences of the term.
+    Xapian::termcount collfreq;
+
+    /// Upper bound on the wdf of the term, as stored for the term itself.
+    Xapian::termcount wdf_upper_bound;
+};
+
+/** LRU cache of TermStats for a database shard.
+ *
+ *  Preparing a query needs the term frequency (and often the collection
+ *  frequency and wdf upper bound) of every term, each of which is a B-tree
+ *  lookup.  This caches them for recently used terms.
+ *
+ *  The cache is tied to a revision of the shard and is emptied if used with a
+ *  different revision, so it is only suitable for read-only shards (where the
+ *  revision changes whenever the data visible does).
+ */
+class TermStatsCache {
+    /// The cached statistics.
+    LRUCache<TermStats> cache{DEFAULT_MAX_ENTRIES};
+
+    /// The revision the cached statistics are for.
+    Xapian::rev revision = 0;
+
+  public:
+    /// Default maximum number of entries.
+    static constexpr size_t DEFAULT_MAX_ENTRIES = 1024;
+
+    /** Set the maximum number of entries to cache.
+     *
+     *  0 disables caching.  If there are currently more entries than the new
+     *  limit, the least recently used are discarded.
+     */
+    void set_max_entries(size_t max_entries) {
+	cache.set_max_size(max_entries);
+    }
+
+    /** Return the statistics for @a term.
+     *
+     *  @param term		The term to look up.
+     *  @param current_revision	The shard's current revision - if this differs
+     *				from the revision cached entries are for, they
+     *				are discarded.
+     *  @param fetch		Functor to call with a TermStats& to fill in if
+     *				@a term isn't cached.
+     */
+    template<typename F>
+    TermStats get(const std::string& term,
+		  Xapian::rev current_revision,
+		  F fetch) {
+	if (current_revision != revision) {
+	    cache.clear();
+	    revision = current_revision;
+	}
+
+	const TermStats* cached = cache.find(term);
+	if (cached)
+	    return *cached;
+
+	TermStats stats;
+	fetch(stats);
+	cache.insert(term, TermStats(stats));
+	return stats;
+    }
+};
+
+#endif // XAPIAN_INCLUDED_TERMSTATSCACHE_H
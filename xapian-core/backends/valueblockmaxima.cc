@@ -0,0 +1,71 @@
+/** @file valueblockmaxima.cc
+ * @brief Upper bounds on the values in a slot for each block of docids
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "valueblockmaxima.h"
+
+#include "xapian/queryparser.h" // For sortable_unserialise().
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+using namespace std;
+
+namespace Xapian {
+namespace Internal {
+
+ValueBlockMaxima::ValueBlockMaxima(ValueList* values, Xapian::docid last_docid)
+{
+    unique_ptr<ValueList> vl(values);
+    if (last_docid == 0) return;
+
+    while ((Xapian::docid(1) << shift) < MIN_BLOCK_SIZE) ++shift;
+    while (block(last_docid) >= MAX_BLOCKS) ++shift;
+
+    // Blocks without any values can't contribute, so give them a maximum
+    // below any weight.
+    block_max.resize(block(last_docid) + 1, -HUGE_VAL);
+    while (vl->next(), !vl->at_end()) {
+	double& m = block_max[block(vl->get_docid())];
+	m = max(m, sortable_unserialise(vl->get_value()));
+    }
+
+    suffix_max.resize(block_max.size());
+    double m = -HUGE_VAL;
+    for (size_t b = block_max.size(); b-- > 0; ) {
+	m = max(m, block_max[b]);
+	suffix_max[b] = m;
+    }
+}
+
+Xapian::docid
+ValueBlockMaxima::skip_low_blocks(Xapian::docid did, double min_wt) const
+{
+    size_t b = block(did);
+    if (b >= block_max.size()) return 0;
+    if (block_max[b] >= min_wt) return did;
+    // Don't bother scanning if nothing later is high enough.
+    if (suffix_max[b] < min_wt) return 0;
+    while (block_max[++b] < min_wt) { }
+    return (Xapian::docid(b) << shift) + 1;
+}
+
+}
+}
@@ -0,0 +1,90 @@
+/** @file valueblockmaxima.h
+ * @brief Upper bounds on the values in a slot for each block of docids
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_VALUEBLOCKMAXIMA_H
+#define XAPIAN_INCLUDED_VALUEBLOCKMAXIMA_H
+
+#include "backends/valuelist.h"
+#include "xapian/intrusive_ptr.h"
+#include <xapian/types.h>
+
+#include <vector>
+
+namespace Xapian {
+namespace Internal {
+
+/** The maximum of the values in a slot for each block of docids.
+ *
+ *  The values are interpreted as by sortable_unserialise(), so this allows
+ *  ValueWeightPostingSource to bound the weight it can return for a range of
+ *  docids much more tightly than the upper bound for the whole slot does -
+ *  e.g. for a static document quality score, especially if the shard has been
+ *  reordered by it.
+ *
+ *  Blocks are fixed-size ranges of docids.  The size is a power of two, at
+ *  least MIN_BLOCK_SIZE, chosen so there are at most MAX_BLOCKS blocks.
+ */
+class ValueBlockMaxima : public intrusive_base {
+    /// log2 of the number of docids in each block.
+    unsigned shift = 0;
+
+    /// The maximum value in each block.
+    std::vector<double> block_max;
+
+    /// The maximum value in each block and all the blocks after it.
+    std::vector<double> suffix_max;
+
+    /// Return the index of the block containing @a did.
+    size_t block(Xapian::docid did) const {
+	return (did - 1) >> shift;
+    }
+
+  public:
+    /// Minimum number of docids in a block.
+    static constexpr Xapian::docid MIN_BLOCK_SIZE = 128;
+
+    /// Maximum number of blocks.
+    static constexpr size_t MAX_BLOCKS = 32768;
+
+    /** Build the block maxima.
+     *
+     *  @param values	The value stream to read.  Ownership is taken.
+     *  @param last_docid	The highest docid in use in the shard.
+     */
+    ValueBlockMaxima(ValueList* values, Xapian::docid last_docid);
+
+    /// Return an upper bound on the values from docid @a did onwards.
+    double get_max_from(Xapian::docid did) const {
+	size_t b = block(did);
+	if (b >= suffix_max.size()) return 0.0;
+	return suffix_max[b];
+    }
+
+    /** Find the first docid which might have a value of at least @a min_wt.
+     *
+     *  @return @a did if the block containing @a did might, otherwise the
+     *		first docid of the next block which might, or 0 if there's
+     *		no such block.
+     */
+    Xapian::docid skip_low_blocks(Xapian::docid did, double min_wt) const;
+};
+
+}
+}
+
+#endif // XAPIAN_INCLUDED_VALUEBLOCKMAXIMA_H
@@ -48,7 +48,9 @@ endif
 bin_xapian_check_SOURCES = bin/xapian-check.cc
 bin_xapian_check_LDADD = $(ldflags) $(libxapian_la)
 
-bin_xapian_compact_SOURCES = bin/xapian-compact.cc
+bin_xapian_compact_CPPFLAGS = $(AM_CPPFLAGS)
+bin_xapian_compact_SOURCES = bin/xapian-compact.cc\
+	common/fileutils.cc
 bin_xapian_compact_LDADD = $(ldflags) libgetopt.la $(libxapian_la)
 
 bin_xapian_delve_SOURCES = bin/xapian-delve.cc
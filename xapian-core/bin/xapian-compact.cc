@@ -24,11 +24,19 @@
 
 #include <xapian.h>
 
+#include <algorithm>
+#include <cerrno>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "fileutils.h"
 #include "gnu_getopt.h"
+#include "parseint.h"
+#include "safesysstat.h"
 
 #include "backends/glass/glass_defs.h"
 
@@ -40,6 +48,8 @@ using namespace std;
 #define OPT_HELP 1
 #define OPT_VERSION 2
 #define OPT_NO_RENUMBER 3
+#define OPT_REORDER_BY_VALUE 4
+#define OPT_REORDER_REVERSE 5
 
 static void show_usage() {
     cout << "Usage: " PROG_NAME " [OPTIONS] SOURCE_DATABASE... DESTINATION_DATABASE\n\n"
@@ -61,6 +71,19 @@ static void show_usage() {
 "                     unique ids from an external source).  Currently this\n"
 "                     option is only supported when merging databases if they\n"
 "                     have disjoint ranges of used document ids\n"
+"      --reorder-by-value=SLOT\n"
+"                     Renumber the documents in ascending order of the value\n"
+"                     in SLOT (e.g. a static rank or a date), which tends to\n"
+"                     make postlists more compact and means docid order can be\n"
+"                     used to return results in that order.  Documents without\n"
+"                     a value in SLOT come first (or last with\n"
+"                     --reorder-reverse).  This works by copying the documents\n"
+"                     to a temporary database (in a new directory named\n"
+"                     DESTINATION with \".reorder-XXXXXX\" appended), so needs\n"
+"                     extra disk space and time\n"
+"      --reorder-reverse\n"
+"                     Use descending order for --reorder-by-value, so\n"
+"                     documents without a value in SLOT come last\n"
 "  -s, --single-file  Produce a single file database\n"
 "  --help             display this help and exit\n"
 "  --version          output version information and exit" << endl;
@@ -108,6 +131,116 @@ MyCompactor::resolve_duplicate_metadata(const string & key,
     return tags[0];
 }
 
+/** Create a new empty directory for the temporary database used for
+ *  reordering.
+ *
+ *  The name is @a destdir with ".reorder-" and a unique suffix appended.  We
+ *  never reuse an existing directory, so we can safely remove the one we
+ *  return once we're done with it.
+ */
+static string
+make_reorder_tmpdir(const string& destdir)
+{
+#ifdef HAVE_MKDTEMP
+    string tmpdir = destdir + ".reorder-XXXXXX";
+    if (mkdtemp(&tmpdir[0]))
+	return tmpdir;
+#else
+    // mkdir() fails if the directory already exists.
+    for (unsigned n = 0; n != 1000; ++n) {
+	string tmpdir = destdir + ".reorder-" + to_string(n);
+	if (mkdir(tmpdir.c_str(), 0700) == 0)
+	    return tmpdir;
+	if (errno != EEXIST)
+	    break;
+    }
+#endif
+    throw Xapian::DatabaseCreateError("Couldn't create temporary directory "
+				      "for reordering next to " + destdir,
+				      errno);
+}
+
+/// Remove the temporary database used for reordering after a failure.
+static void
+remove_reorder_tmpdir(const string& tmpdir)
+{
+    if (tmpdir.empty())
+	return;
+    try {
+	removedir(tmpdir);
+    } catch (const Xapian::Error &) {
+	// We're already reporting an error, which is more useful.
+    }
+}
+
+/** Copy the contents of @a src to a new glass database in @a tmpdir.
+ *
+ *  @a tmpdir should be an empty directory.
+ *
+ *  The documents are renumbered in order of their value in @a slot.
+ */
+static void
+reorder_by_value(const Xapian::Database& src, const string& tmpdir,
+		 Xapian::valueno slot, bool reverse, MyCompactor& compactor)
+{
+    compactor.set_status("reorder", string());
+
+    // Pair up each docid with its value.
+    vector<pair<string, Xapian::docid>> order;
+    order.reserve(src.get_doccount());
+    Xapian::ValueIterator v = src.valuestream_begin(slot);
+    const Xapian::ValueIterator v_end = src.valuestream_end(slot);
+    for (Xapian::PostingIterator p = src.postlist_begin(string());
+	 p != src.postlist_end(string()); ++p) {
+	Xapian::docid did = *p;
+	string value;
+	if (v != v_end) {
+	    v.skip_to(did);
+	    if (v != v_end && v.get_docid() == did)
+		value = *v;
+	}
+	order.emplace_back(std::move(value), did);
+    }
+
+    // Use a stable sort so documents with the same value stay in the same
+    // relative order.
+    if (reverse) {
+	stable_sort(order.begin(), order.end(),
+		    [](const pair<string, Xapian::docid>& a,
+		       const pair<string, Xapian::docid>& b) {
+			return a.first > b.first;
+		    });
+    } else {
+	stable_sort(order.begin(), order.end(),
+		    [](const pair<string, Xapian::docid>& a,
+		       const pair<string, Xapian::docid>& b) {
+			return a.first < b.first;
+		    });
+    }
+
+    Xapian::WritableDatabase tmp(tmpdir,
+				 Xapian::DB_CREATE | Xapian::DB_BACKEND_GLASS);
+    for (auto&& i : order) {
+	tmp.add_document(src.get_document(i.second));
+    }
+
+    // Copy the data which isn't tied to documents.
+    for (auto t = src.spellings_begin(); t != src.spellings_end(); ++t) {
+	tmp.add_spelling(*t, t.get_termfreq());
+    }
+    for (auto t = src.synonym_keys_begin(); t != src.synonym_keys_end(); ++t) {
+	for (auto s = src.synonyms_begin(*t); s != src.synonyms_end(*t); ++s) {
+	    tmp.add_synonym(*t, *s);
+	}
+    }
+    for (auto t = src.metadata_keys_begin(); t != src.metadata_keys_end(); ++t) {
+	tmp.set_metadata(*t, src.get_metadata(*t));
+    }
+    tmp.commit();
+
+    compactor.set_status("reorder", "done");
+}
+
 int
 main(int argc, char **argv)
 {
@@ -119,6 +252,8 @@ main(int argc, char **argv)
 	{"blocksize",	required_argument, 0, 'b'},
 	{"backend",	required_argument, 0, 'B'},
 	{"no-renumber", no_argument, 0, OPT_NO_RENUMBER},
+	{"reorder-by-value", required_argument, 0, OPT_REORDER_BY_VALUE},
+	{"reorder-reverse", no_argument, 0, OPT_REORDER_REVERSE},
 	{"single-file", no_argument, 0, 's'},
 	{"quiet",	no_argument, 0, 'q'},
 	{"help",	no_argument, 0, OPT_HELP},
@@ -131,6 +266,9 @@ main(int argc, char **argv)
     unsigned backend = 0;
     unsigned flags = 0;
     size_t block_size = 0;
+    bool reorder = false;
+    Xapian::valueno reorder_slot = 0;
+    bool reorder_reverse = false;
 
     int c;
     while ((c = gnu_getopt_long(argc, argv, opts, long_opts, 0)) != -1) {
@@ -180,6 +318,18 @@ main(int argc, char **argv)
 	    case OPT_NO_RENUMBER:
 		flags |= Xapian::DBCOMPACT_NO_RENUMBER;
 		break;
+	    case OPT_REORDER_BY_VALUE:
+		if (!parse_unsigned(optarg, reorder_slot)) {
+		    cerr << PROG_NAME": Bad value '" << optarg << "' passed "
+			    "for reorder-by-value, must be a value slot number"
+			 << endl;
+		    exit(1);
+		}
+		reorder = true;
+		break;
+	    case OPT_REORDER_REVERSE:
+		reorder_reverse = true;
+		break;
 	    case 's':
 		flags |= Xapian::DBCOMPACT_SINGLE_FILE;
 		break;
@@ -207,19 +357,38 @@ main(int argc, char **argv)
     // Path to the database to create.
     string destdir = argv[argc - 1];
 
+    if (reorder && (flags & Xapian::DBCOMPACT_NO_RENUMBER)) {
+	cerr << PROG_NAME": --reorder-by-value and --no-renumber can't be used "
+		"together" << endl;
+	exit(1);
+    }
+
     flags |= backend | level;
 
+    string tmpdir;
     try {
 	Xapian::Database src;
 	for (int i = optind; i < argc - 1; ++i) {
 	    src.add_database(Xapian::Database(argv[i]));
 	}
+	if (reorder) {
+	    tmpdir = make_reorder_tmpdir(destdir);
+	    reorder_by_value(src, tmpdir, reorder_slot, reorder_reverse,
+			     compactor);
+	    src = Xapian::Database(tmpdir);
+	}
 	src.compact(destdir, flags, block_size, compactor);
+	if (!tmpdir.empty()) {
+	    src.close();
+	    removedir(tmpdir);
+	}
     } catch (const Xapian::Error &error) {
 	cerr << argv[0] << ": " << error.get_description() << endl;
+	remove_reorder_tmpdir(tmpdir);
 	exit(1);
     } catch (const char * msg) {
 	cerr << argv[0] << ": " << msg << endl;
+	remove_reorder_tmpdir(tmpdir);
 	exit(1);
     }
 }
@@ -37,10 +37,12 @@ using namespace std;
 #define OPT_HELP 1
 #define OPT_VERSION 2
 
-static const char * opts = "t:w";
+static const char * opts = "t:wzc:";
 static const struct option long_opts[] = {
     {"timeout",		required_argument,	0, 't'},
     {"writable",	no_argument,		0, 'w'},
+    {"compress",	no_argument,		0, 'z'},
+    {"cache-size",	required_argument,	0, 'c'},
     {"help",		no_argument,		0, OPT_HELP},
     {"version",		no_argument,		0, OPT_VERSION},
     {NULL, 0, 0, 0}
@@ -51,6 +53,11 @@ static void show_usage() {
 "Options:\n"
 "  --timeout MSECS         set timeout\n"
 "  --writable              allow updates (only one database directory allowed)\n"
+"  --compress              compress large messages sent to the client\n"
+"  --cache-size BYTES      cache the results of queries, using up to BYTES\n"
+"                          for each of the statistics and results caches\n"
+"                          (default 0, which disables caching).  The caches\n"
+"                          last only as long as this connection\n"
 "  --help                  display this help and exit\n"
 "  --version               output version information and exit" << endl;
 }
@@ -59,6 +66,8 @@ int main(int argc, char **argv)
 {
     double timeout = 60.0;
     bool writable = false;
+    bool compress = false;
+    size_t cache_size = 0;
     bool syntax_error = false;
 
     int c;
@@ -83,6 +92,16 @@ int main(int argc, char **argv)
 	    case 'w':
 		writable = true;
 		break;
+	    case 'z':
+		compress = true;
+		break;
+	    case 'c':
+		if (!parse_unsigned(optarg, cache_size)) {
+		    cout << "cache size must be a non-negative integer" << endl;
+		    show_usage();
+		    exit(1);
+		}
+		break;
 	    default:
 		syntax_error = true;
 	}
@@ -109,7 +128,9 @@ int main(int argc, char **argv)
     try {
 	// We communicate with the client via stdin (fd 0) and stdout (fd 1).
 	// Note that RemoteServer closes these fds.
-	RemoteServer server(dbnames, 0, 1, timeout, timeout, writable);
+	RemoteServer server(dbnames, 0, 1, timeout, timeout, writable,
+			    compress);
+	server.set_cache_size(cache_size);
 
 	// If you have defined your own weighting scheme, register it here
 	// like so:
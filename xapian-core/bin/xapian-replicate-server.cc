@@ -45,6 +45,9 @@ static void show_usage() {
 "  -I, --interface=ADDR  listen on interface ADDR\n"
 "  -p, --port=PORT   port to listen on\n"
 "  -o, --one-shot    serve a single connection and exit\n"
+"  -c, --check-interval=MS  check for changes to send to streaming clients\n"
+"                    every MS milliseconds (default: 100)\n"
+"  -z, --compress    compress the database files and changesets sent\n"
 "  --help            display this help and exit\n"
 "  --version         output version information and exit" << endl;
 }
@@ -52,11 +55,13 @@ static void show_usage() {
 int
 main(int argc, char **argv)
 {
-    const char * opts = "I:p:o";
+    const char * opts = "I:p:oc:z";
     static const struct option long_opts[] = {
 	{"interface",	required_argument,	0, 'I'},
 	{"port",	required_argument,	0, 'p'},
 	{"one-shot",	no_argument,		0, 'o'},
+	{"check-interval",	required_argument,	0, 'c'},
+	{"compress",	no_argument,		0, 'z'},
 	{"help",	no_argument, 0, OPT_HELP},
 	{"version",	no_argument, 0, OPT_VERSION},
 	{NULL,		0, 0, 0}
@@ -66,6 +71,8 @@ main(int argc, char **argv)
     int port = 0;
 
     bool one_shot = false;
+    unsigned check_interval = 100;
+    bool compress = false;
 
     int c;
     while ((c = gnu_getopt_long(argc, argv, opts, long_opts, 0)) != -1) {
@@ -84,6 +91,17 @@ main(int argc, char **argv)
 	    case 'o':
 		one_shot = true;
 		break;
+	    case 'c':
+		if (!parse_unsigned(optarg, check_interval) ||
+		    check_interval == 0) {
+		    cerr << "Error: check interval must be a positive "
+			    "integer" << endl;
+		    exit(1);
+		}
+		break;
+	    case 'z':
+		compress = true;
+		break;
 	    case OPT_HELP:
 		cout << PROG_NAME " - " PROG_DESC "\n\n";
 		show_usage();
@@ -106,7 +124,8 @@ main(int argc, char **argv)
     string dbpath(argv[optind]);
 
     try {
-	ReplicateTcpServer server(host, port, dbpath);
+	ReplicateTcpServer server(host, port, dbpath, compress);
+	server.set_check_interval(check_interval * 0.001);
 	if (one_shot) {
 	    server.run_once();
 	} else {
@@ -64,6 +64,14 @@ static void show_usage() {
 "  -f, --force-copy    force a full copy of the database to be sent (and then\n"
 "                      replicate as normal)\n"
 "  -o, --one-shot      replicate only once and then exit\n"
+"  -R, --relay=N       keep the last N changesets applied, so that this replica\n"
+"                      can be served to further replicas by\n"
+"                      xapian-replicate-server (default: 0)\n"
+"  -P, --parallel=N    if a full copy of the database is needed, receive it over\n"
+"                      N connections at once (default: 1)\n"
+"  -s, --stream        keep the connection open and have the master send changes\n"
+"                      as they happen (for low lag, also reduce --reader-time);\n"
+"                      --interval is then the delay before reconnecting\n"
 "  -q, --quiet         only report errors\n"
 "  -v, --verbose       be more verbose\n"
 "  --help              display this help and exit\n"
@@ -73,7 +81,7 @@ static void show_usage() {
 int
 main(int argc, char **argv)
 {
-    const char * opts = "h:p:m:i:r:t:ofqv";
+    const char * opts = "h:p:m:i:r:t:oR:P:sfqv";
     static const struct option long_opts[] = {
 	{"host",	required_argument,	0, 'h'},
 	{"port",	required_argument,	0, 'p'},
@@ -82,6 +90,9 @@ main(int argc, char **argv)
 	{"reader-time",	required_argument,	0, 'r'},
 	{"timeout",	required_argument,	0, 't'},
 	{"one-shot",	no_argument,		0, 'o'},
+	{"relay",	required_argument,	0, 'R'},
+	{"parallel",	required_argument,	0, 'P'},
+	{"stream",	no_argument,		0, 's'},
 	{"force-copy",	no_argument,		0, 'f'},
 	{"quiet",	no_argument,		0, 'q'},
 	{"verbose",	no_argument,		0, 'v'},
@@ -95,6 +106,9 @@ main(int argc, char **argv)
     string masterdb;
     int interval = DEFAULT_INTERVAL;
     bool one_shot = false;
+    bool stream = false;
+    unsigned n_streams = 1;
+    unsigned max_changesets = 0;
     enum { NORMAL, VERBOSE, QUIET } verbosity = NORMAL;
     bool force_copy = false;
     int reader_close_time = READER_CLOSE_TIME;
@@ -153,6 +167,23 @@ main(int argc, char **argv)
 	    case 'o':
 		one_shot = true;
 		break;
+	    case 'R':
+		if (!parse_unsigned(optarg, max_changesets)) {
+		    cout << "relay must be a non-negative integer" << endl;
+		    show_usage();
+		    exit(1);
+		}
+		break;
+	    case 'P':
+		if (!parse_unsigned(optarg, n_streams) || n_streams == 0) {
+		    cout << "parallel must be a positive integer" << endl;
+		    show_usage();
+		    exit(1);
+		}
+		break;
+	    case 's':
+		stream = true;
+		break;
 	    case 'q':
 		verbosity = QUIET;
 		break;
@@ -201,13 +232,39 @@ main(int argc, char **argv)
 		cout << "Connecting to " << host << ":" << port << endl;
 	    }
 	    ReplicateTcpClient client(host, port, 10.0, timeout);
+	    client.set_relay_changesets(max_changesets);
+	    if (stream && !one_shot) {
+		if (verbosity == VERBOSE) {
+		    cout << "Streaming updates for " << dbpath << " from "
+			 << masterdb << endl;
+		}
+		client.start_streaming(dbpath, masterdb, force_copy,
+				       n_streams);
+		force_copy = false;
+		// This only ends by throwing an exception, e.g. if the
+		// connection to the master is lost.
+		while (true) {
+		    Xapian::ReplicationInfo info;
+		    client.apply_streamed_changes(info, reader_close_time);
+		    if (verbosity == VERBOSE &&
+			(info.changeset_count || info.fullcopy_count)) {
+			cout << "Update received: "
+			     << info.fullcopy_count << " copies, "
+			     << info.changeset_count << " changesets, "
+			     << (info.changed ? "new live database"
+					      : "no changes to live database")
+			     << endl;
+		    }
+		}
+	    }
 	    if (verbosity == VERBOSE) {
 		cout << "Getting update for " << dbpath << " from "
 		     << masterdb << endl;
 	    }
 	    Xapian::ReplicationInfo info;
 	    client.update_from_master(dbpath, masterdb, info,
-				      reader_close_time, force_copy);
+				      reader_close_time, force_copy,
+				      n_streams);
 	    if (verbosity == VERBOSE) {
 		cout << "Update complete: "
 		     << info.fullcopy_count << " copies, "
@@ -56,7 +56,7 @@ const int MSECS_ACTIVE_TIMEOUT_DEFAULT = 15000;
 #define OPT_HELP 1
 #define OPT_VERSION 2
 
-static const char * opts = "I:p:a:i:t:oqw";
+static const char * opts = "I:p:a:i:t:oqwzc:";
 static const struct option long_opts[] = {
     {"interface",	required_argument,	0, 'I'},
     {"port",		required_argument,	0, 'p'},
@@ -66,6 +66,8 @@ static const struct option long_opts[] = {
     {"one-shot",	no_argument,		0, 'o'},
     {"quiet",		no_argument,		0, 'q'},
     {"writable",	no_argument,		0, 'w'},
+    {"compress",	no_argument,		0, 'z'},
+    {"cache-size",	required_argument,	0, 'c'},
     {"help",		no_argument,		0, OPT_HELP},
     {"version",		no_argument,		0, OPT_VERSION},
     {NULL, 0, 0, 0}
@@ -83,6 +85,11 @@ static void show_usage() {
 "  --one-shot              serve a single connection and exit\n"
 "  --quiet                 disable information messages to stdout\n"
 "  --writable              allow updates (only one database directory allowed)\n"
+"  --compress              compress large messages sent to clients\n"
+"  --cache-size BYTES      cache the results of queries, using up to BYTES\n"
+"                          for each of the statistics and results caches\n"
+"                          (default 0, which disables caching).  The caches\n"
+"                          are shared by all connections\n"
 "  --help                  display this help and exit\n"
 "  --version               output version information and exit" << endl;
 }
@@ -96,6 +103,8 @@ int main(int argc, char **argv) {
     bool one_shot = false;
     bool verbose = true;
     bool writable = false;
+    bool compress = false;
+    size_t cache_size = 0;
     bool syntax_error = false;
 
     int c;
@@ -155,6 +164,15 @@ int main(int argc, char **argv) {
 	    case 'w':
 		writable = true;
 		break;
+	    case 'z':
+		compress = true;
+		break;
+	    case 'c':
+		if (!parse_unsigned(optarg, cache_size)) {
+		    cerr << "Cache size must be >= 0" << endl;
+		    exit(1);
+		}
+		break;
 	    default:
 		syntax_error = true;
 	}
@@ -200,7 +218,8 @@ int main(int argc, char **argv) {
 	}
 
 	RemoteTcpServer server(dbnames, host, port, active_timeout,
-			       idle_timeout, writable, verbose);
+			       idle_timeout, writable, verbose, compress);
+	server.set_cache_size(cache_size);
 
 	if (verbose)
 	    cout << "Listening..." << endl;
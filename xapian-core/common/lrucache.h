@@ -0,0 +1,132 @@
+/** @file lrucache.h
+ * @brief Least recently used cache keyed by string
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_LRUCACHE_H
+#define XAPIAN_INCLUDED_LRUCACHE_H
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+/// Default size function for LRUCache, which counts each entry as 1.
+template<typename V>
+struct LRUCacheCountEntries {
+    size_t operator()(const V&) const { return 1; }
+};
+
+/** Cache of values keyed by string, discarding the least recently used.
+ *
+ *  @param V	The type of the values.
+ *  @param S	Functor type returning the size of a value, in whatever units
+ *		the maximum size is in (default: each entry has size 1, so
+ *		the maximum size is the maximum number of entries).
+ */
+template<typename V, typename S = LRUCacheCountEntries<V>>
+class LRUCache {
+    struct Entry {
+	V value;
+
+	/// Position of this entry in lru.
+	std::list<const std::string*>::iterator lru_pos;
+    };
+
+    /// The cached values.
+    std::unordered_map<std::string, Entry> entries;
+
+    /** The keys of entries, most recently used first.
+     *
+     *  Pointers to the keys in an unordered_map remain valid until the
+     *  entry is erased, even if the table is rehashed.
+     */
+    std::list<const std::string*> lru;
+
+    /// Maximum total size.  0 disables caching.
+    size_t max_size;
+
+    /// Total size of the values in entries.
+    size_t total_size = 0;
+
+    /// Evict the least recently used entry.
+    void evict() {
+	auto i = entries.find(*lru.back());
+	total_size -= S()(i->second.value);
+	entries.erase(i);
+	lru.pop_back();
+    }
+
+  public:
+    explicit LRUCache(size_t max_size_) : max_size(max_size_) {}
+
+    /** Set the maximum total size.
+     *
+     *  0 disables caching.  If more than the new limit is currently cached,
+     *  the least recently used entries are discarded.
+     */
+    void set_max_size(size_t max_size_) {
+	max_size = max_size_;
+	while (total_size > max_size)
+	    evict();
+    }
+
+    size_t get_max_size() const { return max_size; }
+
+    /// Discard all the entries.
+    void clear() {
+	entries.clear();
+	lru.clear();
+	total_size = 0;
+    }
+
+    /** Look up a value, marking it as most recently used.
+     *
+     *  @return Pointer to the cached value, or NULL if not cached.  The
+     *		pointer remains valid until the next call to a non-const
+     *		method.
+     */
+    V* find(const std::string& key) {
+	auto i = entries.find(key);
+	if (i == entries.end())
+	    return NULL;
+	lru.splice(lru.begin(), lru, i->second.lru_pos);
+	return &i->second.value;
+    }
+
+    /** Add a value to the cache.
+     *
+     *  @a value is only moved from if it is cached.
+     *
+     *  @return Pointer to the cached value, or NULL if @a value is too large
+     *		to cache or @a key is already cached.  The pointer remains
+     *		valid until the next call to a non-const method.
+     */
+    V* insert(const std::string& key, V&& value) {
+	size_t size = S()(value);
+	if (max_size == 0 || size > max_size || entries.count(key))
+	    return NULL;
+	while (total_size + size > max_size)
+	    evict();
+	auto i = entries.emplace(key, Entry{std::move(value), lru.end()}).first;
+	total_size += size;
+	lru.push_front(&i->first);
+	i->second.lru_pos = lru.begin();
+	return &i->second.value;
+    }
+};
+
+#endif // XAPIAN_INCLUDED_LRUCACHE_H
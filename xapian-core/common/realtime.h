@@ -92,7 +92,7 @@ inline double end_time(double timeout) {
 }
 
 #ifndef __WIN32__
-# if defined HAVE_NANOSLEEP || defined HAVE_TIMER_CREATE
+# ifdef HAVE_NANOSLEEP
 /// Fill in struct timespec from number of seconds in a double.
 inline void to_timespec(double t, struct timespec *ts) {
     double secs;
@@ -25,8 +25,11 @@
 
 #include "xapian/error.h"
 
+#include "filetests.h"
 #include "io_utils.h"
+#include "pack.h"
 #include "posixy_wrapper.h"
+#include "replicationprotocol.h"
 
 #include "safefcntl.h"
 #include "safesysstat.h"
@@ -34,9 +37,13 @@
 
 #include <sys/types.h>
 
+#include <algorithm>
 #include <cerrno>
+#include <memory>
 #include <string>
 
+#include <zlib.h>
+
 using namespace std;
 
 int
@@ -64,3 +71,121 @@ write_and_clear_changes(int changes_fd, string & buf, size_t bytes)
     }
     buf.erase(0, bytes);
 }
+
+uint64_t
+CopyRangeChecksums::checksum(const char * p, size_t len)
+{
+    // Combine two 32-bit checksums, so that a range which happens to match
+    // is very unlikely indeed.
+    const Bytef * data = reinterpret_cast<const Bytef *>(p);
+    uint64_t result = crc32(0, data, uInt(len));
+    result <<= 32;
+    result |= adler32(1, data, uInt(len));
+    return result;
+}
+
+void
+CopyRangeChecksums::set_file_size(const string & name, off_t size)
+{
+    FileRanges & file = files[name];
+    if (size == file.size && !file.checksums.empty())
+	return;
+
+    // The last range of the old and new sizes may change length, so forget
+    // them.
+    size_t old_last = size_t(file.size / DB_COPY_RANGE_SIZE);
+    size_t n_ranges = size_t((size + DB_COPY_RANGE_SIZE - 1) /
+			     DB_COPY_RANGE_SIZE);
+    file.checksums.resize(n_ranges, 0);
+    if (old_last < n_ranges)
+	file.checksums[old_last] = 0;
+    if (size % DB_COPY_RANGE_SIZE)
+	file.checksums[n_ranges - 1] = 0;
+    file.size = size;
+}
+
+void
+CopyRangeChecksums::set_range(const string & name, off_t offset,
+			      uint64_t checksum)
+{
+    auto i = files.find(name);
+    if (i == files.end())
+	return;
+    size_t index = size_t(offset / DB_COPY_RANGE_SIZE);
+    if (index < i->second.checksums.size())
+	i->second.checksums[index] = checksum;
+}
+
+void
+CopyRangeChecksums::add_file(const string & name, int fd)
+{
+    off_t size = file_size(fd);
+    if (errno)
+	throw Xapian::DatabaseError("Couldn't stat file '" + name + "'", errno);
+    set_file_size(name, size);
+    unique_ptr<char[]> buf(new char[DB_COPY_RANGE_SIZE]);
+    for (off_t offset = 0; offset < size; offset += DB_COPY_RANGE_SIZE) {
+	size_t len = io_pread(fd, buf.get(), DB_COPY_RANGE_SIZE, offset);
+	if (offset + off_t(len) != size && len != DB_COPY_RANGE_SIZE) {
+	    // The file is shorter than it was - just ignore the rest.
+	    break;
+	}
+	set_range(name, offset, checksum(buf.get(), len));
+    }
+}
+
+bool
+CopyRangeChecksums::has_range(const string & name, off_t offset, size_t len,
+			      uint64_t checksum_) const
+{
+    auto i = files.find(name);
+    if (i == files.end())
+	return false;
+    const FileRanges & file = i->second;
+    size_t index = size_t(offset / DB_COPY_RANGE_SIZE);
+    if (index >= file.checksums.size())
+	return false;
+    off_t our_len = min(file.size - offset, off_t(DB_COPY_RANGE_SIZE));
+    uint64_t our_checksum = file.checksums[index];
+    return off_t(len) == our_len && our_checksum != 0 &&
+	   our_checksum == checksum_;
+}
+
+void
+CopyRangeChecksums::serialise(string & buf) const
+{
+    for (auto&& i : files) {
+	pack_string(buf, i.first);
+	pack_uint(buf, uint64_t(i.second.size));
+	for (uint64_t c : i.second.checksums) {
+	    pack_uint(buf, c);
+	}
+    }
+}
+
+void
+CopyRangeChecksums::unserialise(const char * p, const char * end)
+{
+    files.clear();
+    while (p != end) {
+	string name;
+	uint64_t size;
+	if (!unpack_string(&p, end, name) || !unpack_uint(&p, end, &size)) {
+	    throw Xapian::NetworkError("Bad database copy checksums");
+	}
+	FileRanges & file = files[name];
+	file.size = off_t(size);
+	uint64_t n_ranges = (size + DB_COPY_RANGE_SIZE - 1) /
+			    DB_COPY_RANGE_SIZE;
+	// Each checksum takes at least one byte.
+	if (n_ranges > uint64_t(end - p)) {
+	    throw Xapian::NetworkError("Bad database copy checksums");
+	}
+	file.checksums.resize(size_t(n_ranges));
+	for (auto&& c : file.checksums) {
+	    if (!unpack_uint(&p, end, &c)) {
+		throw Xapian::NetworkError("Bad database copy checksums");
+	    }
+	}
+    }
+}
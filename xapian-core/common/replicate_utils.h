@@ -21,7 +21,12 @@
 #ifndef XAPIAN_INCLUDED_REPLICATE_UTILS_H
 #define XAPIAN_INCLUDED_REPLICATE_UTILS_H
 
+#include <cstdint>
+#include <map>
 #include <string>
+#include <vector>
+
+#include <sys/types.h>
 
 /** Create a new changeset file, and return an open fd for writing to it.
  *
@@ -53,4 +58,67 @@ create_changeset_file(const std::string & changeset_dir,
 void
 write_and_clear_changes(int changes_fd, std::string & buf, size_t bytes);
 
+/** Checksums of the ranges of the files in a partial database copy.
+ *
+ *  A replica appends these to the revision it sends to the master, and the
+ *  master then doesn't send any range of a database copy which the replica
+ *  already has.  This allows a copy to be resumed, or to be received over
+ *  several connections at once.
+ *
+ *  Files are divided into ranges of DB_COPY_RANGE_SIZE bytes (the last range
+ *  of a file may be shorter).  A checksum of 0 means "unknown".
+ */
+class CopyRangeChecksums {
+    struct FileRanges {
+	/// The size of the file.
+	off_t size = 0;
+
+	/// The checksum of each range of the file.
+	std::vector<std::uint64_t> checksums;
+    };
+
+    /// The files, keyed by name.
+    std::map<std::string, FileRanges> files;
+
+  public:
+    /// Calculate the checksum of a range.
+    static std::uint64_t checksum(const char * p, size_t len);
+
+    bool empty() const { return files.empty(); }
+
+    void clear() { files.clear(); }
+
+    /** Set the size of a file.
+     *
+     *  Any ranges which this changes the length of are forgotten.
+     */
+    void set_file_size(const std::string & name, off_t size);
+
+    /// Set the checksum of the range of a file starting at @a offset.
+    void set_range(const std::string & name, off_t offset,
+		   std::uint64_t checksum);
+
+    /// Read the file open as @a fd and calculate the checksum of each range.
+    void add_file(const std::string & name, int fd);
+
+    /** Do we have a matching copy of a range?
+     *
+     *  @param name	The name of the file.
+     *  @param offset	The offset of the range in the file.
+     *  @param len	The length of the range.
+     *  @param checksum	The checksum of the range.
+     */
+    bool has_range(const std::string & name, off_t offset, size_t len,
+		   std::uint64_t checksum) const;
+
+    /// Append a serialised form of the checksums to @a buf.
+    void serialise(std::string & buf) const;
+
+    /** Unserialise checksums serialised by serialise().
+     *
+     *  @exception Xapian::NetworkError if the data isn't valid.
+     */
+    void unserialise(const char * p, const char * end);
+};
+
 #endif // XAPIAN_INCLUDED_REPLICATE_UTILS_H
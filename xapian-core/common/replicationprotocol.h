@@ -23,7 +23,11 @@
 
 // Versions:
 // 1: Initial support
-#define XAPIAN_REPLICATION_PROTOCOL_MAJOR_VERSION 1
+// 2: Database copies are sent as checksummed ranges, which a replica can
+//    resume or receive over several connections.  Each connection starts
+//    with a 'V' message giving the client's version, and the server only
+//    compresses messages if the client says it accepts them.
+#define XAPIAN_REPLICATION_PROTOCOL_MAJOR_VERSION 2
 #define XAPIAN_REPLICATION_PROTOCOL_MINOR_VERSION 0
 
 // Reply types (master -> slave)
@@ -31,10 +35,12 @@ enum replicate_reply_type {
     REPL_REPLY_END_OF_CHANGES,	// No more changes to transfer.
     REPL_REPLY_FAIL,		// Couldn't generate full set of changes.
     REPL_REPLY_DB_HEADER,	// The start of a whole DB copy.
-    REPL_REPLY_DB_FILENAME,	// The name of a file in a DB copy.
-    REPL_REPLY_DB_FILEDATA,	// Contents of a file in a DB copy.
+    REPL_REPLY_DB_FILENAME,	// The name of a file in a DB copy (old).
+    REPL_REPLY_DB_FILEDATA,	// Contents of a file in a DB copy (old).
     REPL_REPLY_DB_FOOTER,	// End of a whole DB copy.
-    REPL_REPLY_CHANGESET	// A changeset file is being sent.
+    REPL_REPLY_CHANGESET,	// A changeset file is being sent.
+    REPL_REPLY_DB_FILEINFO,	// The name and size of a file in a DB copy.
+    REPL_REPLY_DB_FILERANGE	// A range of a file in a DB copy.
 };
 
 // The maximum number of copies of a database to send in a single conversation.
@@ -42,4 +48,14 @@ enum replicate_reply_type {
 // sent.
 #define MAX_DB_COPIES_PER_CONVERSATION 5
 
+// When streaming changes, the interval in seconds after which an empty set of
+// changes is sent if the database hasn't changed, so that socket timeouts on
+// the replica don't expire.
+#define STREAM_HEARTBEAT_INTERVAL 10.0
+
+// The size of the ranges which the files in a database copy are sent in.  Each
+// range is checksummed, and only needs to be sent if the replica doesn't
+// already have it.
+#define DB_COPY_RANGE_SIZE (8 * 1024 * 1024)
+
 #endif // XAPIAN_INCLUDED_REPLICATIONPROTOCOL_H
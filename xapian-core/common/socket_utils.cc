@@ -21,6 +21,7 @@
 #include <config.h>
 #include "socket_utils.h"
 
+#include <cerrno>
 #include <limits>
 
 #include "realtime.h"
@@ -103,6 +104,17 @@ set_socket_timeouts(int fd, double timeout)
 #endif
 }
 
+int
+peek_socket_byte(int fd)
+{
+    char ch;
+    int n;
+    do {
+	n = recv(fd, &ch, 1, MSG_PEEK);
+    } while (n < 0 && errno == EINTR);
+    return n == 1 ? static_cast<unsigned char>(ch) : -1;
+}
+
 int
 pretty_ip6(const void* p, char* buf)
 {
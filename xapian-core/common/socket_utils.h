@@ -49,6 +49,14 @@ inline void close_fd_or_socket(int fd) { close(fd); }
  */
 void set_socket_timeouts(int fd, double timeout);
 
+/** Look at the next byte to be read from socket @a fd without reading it.
+ *
+ *  Blocks until a byte is available.
+ *
+ *  @return The byte, or -1 on EOF or error.
+ */
+int peek_socket_byte(int fd);
+
 constexpr size_t PRETTY_IP6_LEN =
     (INET6_ADDRSTRLEN > INET_ADDRSTRLEN ? INET6_ADDRSTRLEN : INET_ADDRSTRLEN);
 
@@ -428,6 +428,63 @@ class XAPIAN_VISIBILITY_DEFAULT Database {
      */
     void keep_alive();
 
+    /** Set the size of the term statistics cache.
+     *
+     *  Read-only glass and honey shards cache the term frequency, collection
+     *  frequency and wdf upper bound of recently used terms, which saves
+     *  repeating the lookups needed to get these when preparing to run
+     *  queries.  The cache is shared by all users of this Database object
+     *  (e.g. several Enquire objects), and is emptied when a shard moves to
+     *  a new revision.
+     *
+     *  @param max_entries	The maximum number of terms to cache statistics
+     *				for in each shard, or 0 to disable the cache.
+     *				The default is 1024.
+     *
+     *  @since Added in Xapian 1.5.0.
+     */
+    void set_term_stats_cache_size(Xapian::termcount max_entries);
+
+    /** Set the size of the wildcard expansion cache.
+     *
+     *  Read-only shards which provide revision information (currently glass
+     *  and honey) cache the list of terms which OP_WILDCARD and
+     *  OP_EDIT_DISTANCE subqueries expand to, so running the same query
+     *  again (e.g. to get the next page of results, or after changing the
+     *  other parts of the query) doesn't need to repeat the expansion.  The
+     *  cache is shared by all users of this Database object, and is emptied
+     *  when a shard moves to a new revision.  Remote shards are expanded by
+     *  the server, which always uses the default cache size.
+     *
+     *  @param max_terms	The maximum total number of terms in the
+     *				expansions cached for each shard, or 0 to
+     *				disable the cache.  The default is 16384.
+     *
+     *  @since Added in Xapian 1.5.0.
+     */
+    void set_expansion_cache_size(Xapian::termcount max_terms);
+
+    /** Load statistics for a list of terms into the term statistics cache.
+     *
+     *  This can be used to warm up the cache after opening the database -
+     *  for example, with a list of the terms which occur most often in
+     *  queries, extracted from a query log.
+     *
+     *  See set_term_stats_cache_size() for details of the cache.
+     *
+     *  @param path	File listing the terms, one per line (so terms
+     *			containing a linefeed can't be specified).  Empty
+     *			lines are ignored.
+     *
+     *  @return	The number of terms loaded.
+     *
+     *  @exception Xapian::InvalidArgumentError is thrown if the file can't
+     *		   be opened.
+     *
+     *  @since Added in Xapian 1.5.0.
+     */
+    Xapian::termcount warm_term_stats_cache(const std::string& path) const;
+
     /** Get a document from the database.
      *
      *  The returned object acts as a handle which lazily fetches information
@@ -558,6 +615,28 @@ class XAPIAN_VISIBILITY_DEFAULT Database {
      */
     std::string get_uuid() const;
 
+    /** Get a report of status counters for this database.
+     *
+     *  This is intended for monitoring caching and query expansion.  The
+     *  report consists of lines of the form "<name> <value>", such as
+     *  "results_cache_hits 3", for each shard in turn.
+     *
+     *  Every shard reports "expansion_cache_hits" and
+     *  "expansion_cache_misses" for the cache controlled by
+     *  set_expansion_cache_size() (which is only consulted for read-only
+     *  shards which support revisions), and "wildcard_terms_checked", the
+     *  number of terms OP_WILDCARD expansions have checked against their
+     *  patterns.  Remote shards report the counters of the shards the server
+     *  opened, preceded by the status of the server's caches (see the
+     *  --cache-size option of xapian-tcpsrv).
+     *
+     *  The counters are kept per shard object, so start from zero each time
+     *  a database is opened.
+     *
+     *  @since Added in Xapian 1.5.0.
+     */
+    std::string get_server_status() const;
+
     /** Test if this database is currently locked for writing.
      *
      *  If the underlying object is actually a WritableDatabase, always returns
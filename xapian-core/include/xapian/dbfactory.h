@@ -27,6 +27,7 @@
 #endif
 
 #include <string>
+#include <vector>
 
 #include <xapian/constants.h>
 #include <xapian/database.h>
@@ -119,6 +120,78 @@ Database open(const std::string &program, const std::string &args, unsigned time
 XAPIAN_VISIBILITY_DEFAULT
 WritableDatabase open_writable(const std::string &program, const std::string &args, unsigned timeout = 0, int flags = 0);
 
+/** Set how many idle TCP connections to keep open to each server for reuse.
+ *
+ * By default, each read-only Database opened with the TCP variant of open()
+ * (including via a stub database file) makes a new connection to the server,
+ * and closes it when the Database is closed.  With xapian-tcpsrv this means
+ * a new server process which has to open the database afresh.
+ *
+ * If this is set to a non-zero value, a connection is instead kept open
+ * when the Database is closed (if it's idle, and there aren't already
+ * @a size idle connections to that host and port), and reused by the next
+ * open() for the same host and port.  A reused connection reopens the
+ * database on the server, so sees the latest revision just as a new
+ * connection would.  If the server has closed it (e.g. due to its idle
+ * timeout) another connection is used instead.
+ *
+ * Connections to WritableDatabase objects are never reused.
+ *
+ * The idle connections are shared by all threads.  A process created by
+ * fork() doesn't reuse connections kept by its parent, or connections opened
+ * by its parent which it closes - these are shared with the parent.
+ *
+ * @param size	Maximum number of idle connections to keep for each host
+ *		and port.  0 (the default) disables reuse, and closes any
+ *		connections currently kept.
+ *
+ * @since Added in Xapian 1.5.0.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+void set_connection_pool_size(unsigned size);
+
+/** Combine remote databases which are replicas of the same shard.
+ *
+ * Each query which uses the shard's own statistics (which is the case when
+ * searching a single shard, or if Enquire::set_remote_shard_stats() is
+ * enabled) is sent to the first working replica.  If no reply arrives within
+ * a percentile of recent query times, the query is also sent to the next
+ * working replica (a "hedged" request) and whichever reply arrives first is
+ * used.  This cuts the effect on the overall query time of a server which is
+ * occasionally slow.  Hedging isn't used until at least 10 queries have been
+ * run, and isn't available on platforms without poll().
+ *
+ * Other operations (such as fetching the documents in an MSet, or looking up
+ * term frequencies) use the replica which answered the last query, or if it's
+ * still working on a query whose results weren't needed, another replica
+ * which isn't.
+ *
+ * If communicating with a replica fails, the query or other operation is
+ * retried on another replica instead.  A new connection to the failed replica
+ * is tried after a second, and if that fails too the wait before the next
+ * attempt doubles each time (up to a minute).  A replica which reconnects
+ * opens the latest revision of the database.
+ *
+ * The replicas should be at the same revision (reopen() reopens all of them)
+ * and so have the same document ids - e.g. replicas made using
+ * Xapian::DatabaseReplica, or copies of the same database.
+ *
+ * @param replicas	The replicas, each opened using Remote::open() for
+ *			read-only access.
+ * @param hedge_percentile	Percentile of the times taken by recent
+ *				queries after which to send a hedged request
+ *				(default 95).
+ *
+ * @return A Database for the shard.  It uses the connections of the
+ *	   databases in @a replicas, which shouldn't be used separately while
+ *	   it's in use.
+ *
+ * @since Added in Xapian 1.5.0.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+Database replica_set(const std::vector<Database>& replicas,
+		     double hedge_percentile = 95.0);
+
 }
 #endif
 
@@ -28,6 +28,7 @@
 #endif
 
 #include <string>
+#include <vector>
 
 #include <xapian/attributes.h>
 #include <xapian/eset.h>
@@ -345,18 +346,79 @@ class XAPIAN_VISIBILITY_DEFAULT Enquire {
      *  cases.  You can set a time limit on this, after which check_at_least
      *  will be turned off.
      *
+     *  If @a hard is true, the match also stops once the time limit is
+     *  reached, and the MSet returned contains the best results found so
+     *  far, with MSet::is_partial() returning true.
+     *
+     *  The time limit is checked by the matcher as it goes.  To keep the
+     *  overhead low it only reads the clock every so many candidate
+     *  documents (up to 1024), aiming to read it about every half a
+     *  millisecond.  So the limit is usually only exceeded slightly, but it
+     *  can be exceeded by the time taken to process up to 1024 candidates if
+     *  they suddenly become slow to process (for example, if a slow
+     *  PostingSource or MatchDecider is in use).
+     *
      *  @param time_limit  time in seconds after which to disable
      *			   check_at_least (default: 0.0 which means no
      *			   time limit)
+     *  @param hard	   stop the match once the time limit is reached
+     *			   (default: false).  Added in Xapian 1.5.0.
      *
      *  Limitations:
      *
-     *  This feature is currently supported on platforms which support POSIX
-     *  interval timers.  Interaction with the remote backend when using
-     *  multiple databases may have bugs.  There's not currently a way to
-     *  force the match to end after a certain time.
+     *  Interaction with the remote backend when using multiple databases may
+     *  have bugs.
+     */
+    void set_time_limit(double time_limit, bool hard = false);
+
+    /** Allow approximate ranking in return for a faster match.
+     *
+     *  When sorting by relevance only, the matcher can skip documents which
+     *  it can show can't score highly enough to make it into the results.
+     *  Setting a factor greater than 1.0 makes this more aggressive: once
+     *  enough candidates have been found, documents which can't score at
+     *  least @a factor times the lowest weight in the current candidate set
+     *  may be skipped.  This is particularly effective for OP_OR queries
+     *  with many terms, which often can't otherwise be pruned much.
+     *
+     *  The results are then approximate, but with a bounded error - any
+     *  document which was skipped but would have been returned has a weight
+     *  less than @a factor times that of the lowest weighted document which
+     *  was returned.
+     *
+     *  @param factor	Pruning factor, which must be >= 1.0 (default: 1.0
+     *			which means the results are exact)
+     *
+     *  @exception Xapian::InvalidArgumentError is thrown if @a factor is
+     *		   less than 1.0.
+     *
+     *  @since Added in Xapian 1.5.0.
+     */
+    void set_pruning_factor(double factor);
+
+    /** Let remote shards weight documents using their own statistics.
+     *
+     *  Normally when searching remote shards each one first sends the
+     *  statistics for the query terms, and then the statistics for the whole
+     *  database are sent back to each before the match runs, so every search
+     *  needs two network round trips.  If @a shard_stats is true, each remote
+     *  shard instead weights documents using its own statistics and returns
+     *  its results in a single round trip, which is much faster for shards
+     *  which are far away.
+     *
+     *  The weights are then approximate, and less so the more similar the
+     *  shards are (e.g. if documents are assigned to shards at random).
+     *  Local shards use statistics from all the local shards.
+     *
+     *  If the database is a single remote shard, this is always done since
+     *  the results are then exactly the same.
+     *
+     *  @param shard_stats	Use per-shard statistics for remote shards?
+     *				(default: false)
+     *
+     *  @since Added in Xapian 1.5.0.
      */
-    void set_time_limit(double time_limit);
+    void set_remote_shard_stats(bool shard_stats);
 
     /** Run the query.
      *
@@ -409,6 +471,42 @@ class XAPIAN_VISIBILITY_DEFAULT Enquire {
 	return get_mset(first, maxitems, 0, rset, mdecider);
     }
 
+    /** Run a batch of queries.
+     *
+     *  This gives the same results as calling @a set_query() and then
+     *  @a get_mset() for each query in turn, but is more efficient for
+     *  large batches of queries (e.g. for evaluating a system or extracting
+     *  features for learning to rank).  Queries which occur more than once in
+     *  the batch are only run once, and the term statistics looked up for
+     *  one query are reused by later ones for database shards which support
+     *  caching them (see @a Database::set_term_stats_cache_size()).
+     *
+     *  The query set by @a set_query() isn't changed, and the length of each
+     *  query is taken to be that returned by @a Query::get_length().
+     *
+     *  @param queries		The queries to run.
+     *  @param first		Zero-based index of the first result to return
+     *				for each query.
+     *  @param maxitems		The maximum number of documents to return for
+     *				each query.
+     *  @param checkatleast	Check at least this many documents (see
+     *				@a get_mset() for details).  (default: 0)
+     *  @param rset		Documents marked as relevant (default: no
+     *				documents have been marked as relevant)
+     *  @param mdecider		Xapian::MatchDecider object (default: no
+     *				Xapian::MatchDecider)
+     *
+     *  @return	An MSet for each query, in the same order as @a queries.
+     *
+     *  @since Added in Xapian 1.5.0.
+     */
+    std::vector<MSet> get_msets(const std::vector<Query>& queries,
+				doccount first,
+				doccount maxitems,
+				doccount checkatleast = 0,
+				const RSet* rset = NULL,
+				const MatchDecider* mdecider = NULL) const;
+
     /** Iterate query terms matching a document.
      *
      *  Takes terms from the query set by @a set_query() and from the document
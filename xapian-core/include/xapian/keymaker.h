@@ -58,6 +58,17 @@ class XAPIAN_VISIBILITY_DEFAULT KeyMaker
      */
     virtual std::string operator()(const Xapian::Document & doc) const = 0;
 
+    /** Return the value slot keys from this KeyMaker are stored in.
+     *
+     *  If this returns a slot other than Xapian::BAD_VALUENO then the key
+     *  for each document must already be stored in that value slot (see
+     *  MaterialisedKeyMaker), and the matcher will read keys directly from
+     *  that slot instead of calling operator() for each document considered.
+     *
+     *  The default implementation returns Xapian::BAD_VALUENO.
+     */
+    virtual Xapian::valueno get_materialised_slot() const;
+
     /** Virtual destructor, because we have virtual methods. */
     virtual ~KeyMaker();
 
@@ -146,6 +157,53 @@ class XAPIAN_VISIBILITY_DEFAULT MultiValueKeyMaker : public KeyMaker {
     }
 };
 
+/** KeyMaker subclass for keys computed at index time and stored in a value.
+ *
+ *  Calling a KeyMaker during the match requires building a Document object
+ *  for each document considered.  If a KeyMaker's keys only depend on the
+ *  document (and not on the query) then they can instead be computed when
+ *  indexing by calling materialise() on each document before it is added to
+ *  the database.  Passing the MaterialisedKeyMaker to
+ *  Enquire::set_sort_by_key() (or one of the related methods) then sorts
+ *  by reading keys straight from the value slot, just like
+ *  Enquire::set_sort_by_value().
+ *
+ *  Note that this isn't suitable for keys which depend on the query (for
+ *  example, LatLongDistanceKeyMaker with a per-query centre).
+ */
+class XAPIAN_VISIBILITY_DEFAULT MaterialisedKeyMaker : public KeyMaker {
+    /// The KeyMaker to compute keys with at index time.
+    Xapian::Internal::opt_intrusive_ptr<const KeyMaker> keymaker;
+
+    /// The value slot keys are stored in.
+    Xapian::valueno slot;
+
+  public:
+    /** Construct a MaterialisedKeyMaker.
+     *
+     *  @param keymaker_	KeyMaker to use to compute keys in
+     *			materialise().  This may be NULL if you only
+     *			want to use this object for searching.
+     *  @param slot_	The value slot to store keys in.
+     */
+    MaterialisedKeyMaker(const KeyMaker* keymaker_, Xapian::valueno slot_);
+
+    /** Compute the key for @a doc and store it in the value slot.
+     *
+     *  This should be called on each document before it is added to the
+     *  database.  Any existing value in the slot is replaced, and if the key
+     *  is empty the value is removed.
+     *
+     *  @param doc	The document to compute and store the key for.
+     */
+    void materialise(Xapian::Document& doc) const;
+
+    /// Return the key stored in the value slot of @a doc.
+    std::string operator()(const Xapian::Document& doc) const;
+
+    Xapian::valueno get_materialised_slot() const;
+};
+
 }
 
 #endif // XAPIAN_INCLUDED_KEYMAKER_H
@@ -230,6 +230,17 @@ class XAPIAN_VISIBILITY_DEFAULT MSet {
     /** The maximum possible weight any document could achieve. */
     double get_max_possible() const;
 
+    /** Did the match stop early because of a time limit?
+     *
+     *  If Enquire::set_time_limit() was called with @a hard set to true
+     *  and the time limit was reached, the match stops and the results are
+     *  the best found up to that point.  The bounds and estimate of the
+     *  number of matches are still valid in this case.
+     *
+     *  @since Added in Xapian 1.5.0.
+     */
+    bool is_partial() const;
+
     enum {
 	/** Model the relevancy of non-query terms in MSet::snippet().
 	 *
@@ -41,6 +41,10 @@ namespace Xapian {
 
 class Registry;
 
+namespace Internal {
+class ValueBlockMaxima;
+}
+
 /** Base class which provides an "external" source of postings.
  */
 class XAPIAN_VISIBILITY_DEFAULT PostingSource
@@ -544,6 +548,18 @@ class XAPIAN_VISIBILITY_DEFAULT ValuePostingSource : public PostingSource {
  *  values in the specified slot, or DBL_MAX if value bounds aren't supported
  *  by the current backend.
  *
+ *  For a read-only database shard which provides revision information (glass
+ *  and honey do), the maximum value in each block of docids is calculated
+ *  the first time the slot is used with this posting source and cached until
+ *  the revision changes.  This is used to skip blocks in which the weight is
+ *  too low to matter, and to reduce the upper bound on the weight as the match
+ *  progresses past the blocks with the highest values - the latter is
+ *  particularly effective if the documents have been ordered by the value
+ *  (e.g. using the @c --reorder-by-value option of xapian-compact).  This
+ *  makes the slot suitable for holding a static document quality score to
+ *  combine with the relevance weight.  The block maxima are only bounds on
+ *  this class's get_weight(), so they aren't used by subclasses.
+ *
  *  For efficiency, this posting source doesn't check that the stored values
  *  are valid in any way, so it will never raise an exception due to invalid
  *  stored values.  In particular, it doesn't ensure that the unserialised
@@ -552,6 +568,16 @@ class XAPIAN_VISIBILITY_DEFAULT ValuePostingSource : public PostingSource {
  */
 class XAPIAN_VISIBILITY_DEFAULT ValueWeightPostingSource
 	: public ValuePostingSource {
+    /// Upper bounds on the values for blocks of docids, or NULL.
+    Xapian::Internal::intrusive_ptr<const Xapian::Internal::ValueBlockMaxima>
+	block_maxima;
+
+    /** Skip blocks which can't have a weight of at least @a min_wt.
+     *
+     *  Also reduces the upper bound on the weight if possible.
+     */
+    void skip_low_blocks(double min_wt);
+
   public:
     /** Construct a ValueWeightPostingSource.
      *
@@ -559,6 +585,8 @@ class XAPIAN_VISIBILITY_DEFAULT ValueWeightPostingSource
      */
     explicit ValueWeightPostingSource(Xapian::valueno slot_);
 
+    ~ValueWeightPostingSource();
+
     double get_weight() const;
     ValueWeightPostingSource * clone() const;
     std::string name() const;
@@ -566,6 +594,10 @@ class XAPIAN_VISIBILITY_DEFAULT ValueWeightPostingSource
     ValueWeightPostingSource * unserialise(const std::string &serialised) const;
     void init(const Database & db_);
 
+    void next(double min_wt);
+    void skip_to(Xapian::docid min_docid, double min_wt);
+    bool check(Xapian::docid min_docid, double min_wt);
+
     std::string get_description() const;
 };
 
@@ -200,7 +200,32 @@ class XAPIAN_VISIBILITY_DEFAULT Query {
 	 *
 	 *  @since Added in Xapian 1.5.0.
 	 */
-	WILDCARD_PATTERN_GLOB = WILDCARD_PATTERN_MULTI|WILDCARD_PATTERN_SINGLE
+	WILDCARD_PATTERN_GLOB = WILDCARD_PATTERN_MULTI|WILDCARD_PATTERN_SINGLE,
+
+	/** Use an n-gram index of the terms to find candidates.
+	 *
+	 *  Normally OP_WILDCARD checks every term starting with the fixed
+	 *  prefix of the pattern, so a pattern with a leading wildcard (such
+	 *  as "*phone") has to check every term in the database.  With this
+	 *  flag, an index of every 3 byte substring of every term is built in
+	 *  memory the first time it's needed and used to find candidate terms
+	 *  containing the pattern's literal parts, which are then checked
+	 *  against the pattern.  The index is kept until the database is
+	 *  reopened at a new revision.
+	 *
+	 *  The index needs memory proportional to the total length of all the
+	 *  terms, and building it takes about as long as checking all of them,
+	 *  so this is worthwhile when the same database is used for several
+	 *  such queries.
+	 *
+	 *  This flag is ignored unless the pattern contains at least 3
+	 *  consecutive literal bytes after its first wildcard, and for
+	 *  database shards which aren't read-only or don't support revisions
+	 *  (e.g. inmemory).
+	 *
+	 *  @since Added in Xapian 1.5.0.
+	 */
+	WILDCARD_NGRAM_INDEX = 0x40
     };
 
     /// Default constructor.
@@ -332,6 +357,18 @@ class XAPIAN_VISIBILITY_DEFAULT Query {
      *			  start with the pattern interpreted as a literal
      *			  string.
      *
+     *			* For OP_WILDCARD: Optionally
+     *			  @a WILDCARD_NGRAM_INDEX, to find candidate terms
+     *			  using an in-memory n-gram index of the terms.  This
+     *			  is used for read-only glass and honey shards (and
+     *			  by xapian-tcpsrv and xapian-progsrv for the shards
+     *			  they serve read-only), and only if the pattern
+     *			  has at least 3 consecutive literal bytes after its
+     *			  first wildcard.  Otherwise the flag is ignored and
+     *			  every term starting with the pattern's fixed prefix
+     *			  is checked as usual - the terms matched are the
+     *			  same either way.
+     *
      *	@param combiner The @a Query::op to combine the terms with - one of
      *			@a OP_SYNONYM (the default), @a OP_OR or @a OP_MAX.
      *
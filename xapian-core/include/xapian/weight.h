@@ -25,6 +25,7 @@
 #define XAPIAN_INCLUDED_WEIGHT_H
 
 #include <string>
+#include <vector>
 
 #include <xapian/registry.h>
 #include <xapian/types.h>
@@ -139,6 +140,27 @@ class XAPIAN_VISIBILITY_DEFAULT Weight {
     /// An upper bound on the wdf of this term.
     Xapian::termcount wdf_upper_bound_;
 
+  public:
+    /** @private @internal Built-in schemes the matcher can call directly.
+     *
+     *  A Weight object only has a kernel other than KERNEL_NONE if it was
+     *  created by the clone() method of the corresponding built-in class, so
+     *  objects of user subclasses always use virtual calls.
+     */
+    typedef enum {
+	KERNEL_NONE = 0,
+	KERNEL_BM25 = 1,
+	KERNEL_BM25PLUS = 2
+    } kernel_type;
+
+  private:
+    /// The built-in scheme this object is exactly an instance of, if any.
+    kernel_type kernel_ = KERNEL_NONE;
+
+  protected:
+    /// @private @internal Set by clone() in built-in subclasses.
+    void set_kernel_(kernel_type kernel) { kernel_ = kernel; }
+
   public:
 
     /// Default constructor, needed by subclass constructors.
@@ -298,6 +320,13 @@ class XAPIAN_VISIBILITY_DEFAULT Weight {
     XAPIAN_VISIBILITY_INTERNAL
     void init_(const Internal & stats, Xapian::termcount query_len_);
 
+    /** @private @internal Return the built-in scheme this object is.
+     *
+     *  If this isn't KERNEL_NONE, the matcher may call the corresponding
+     *  class's get_sumpart() directly instead of via a virtual call.
+     */
+    kernel_type get_kernel_() const { return kernel_; }
+
     /** @private @internal Return true if the document length is needed.
      *
      *  If this method returns true, then the document length will be fetched
@@ -591,6 +620,12 @@ class XAPIAN_VISIBILITY_DEFAULT BM25Weight : public Weight {
     /// Factor to multiply the document length by.
     mutable Xapian::doclength len_factor;
 
+    /** Length dependent part of the denominator, calculated on demand.
+     *
+     *  Indexed by document length, for lengths up to about twice the average.
+     */
+    mutable std::vector<double> denom_table;
+
     /// Factor combining all the document independent factors.
     mutable double termweight;
 
@@ -701,6 +736,12 @@ class XAPIAN_VISIBILITY_DEFAULT BM25PlusWeight : public Weight {
     /// Factor to multiply the document length by.
     mutable Xapian::doclength len_factor;
 
+    /** Length dependent part of the denominator, calculated on demand.
+     *
+     *  Indexed by document length, for lengths up to about twice the average.
+     */
+    mutable std::vector<double> denom_table;
+
     /// Factor combining all the document independent factors.
     mutable double termweight;
 
@@ -189,6 +189,16 @@ BoolOrPostList::get_termfreq_est() const
     return static_cast<Xapian::doccount>(P_est * db_size + 0.5);
 }
 
+double
+BoolOrPostList::get_iteration_cost_est() const
+{
+    double cost = 0.0;
+    for (size_t i = 0; i < n_kids; ++i) {
+	cost += plist[i].pl->get_iteration_cost_est();
+    }
+    return cost;
+}
+
 TermFreqs
 BoolOrPostList::get_termfreq_est_using_stats(
 	const Xapian::Weight::Internal& stats) const
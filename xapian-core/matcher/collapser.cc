@@ -124,7 +124,7 @@ CollapseData::add_item(const vector<Result>& results,
 
 collapse_result
 Collapser::check(Result& result,
-		 Xapian::Document::Internal& vsdoc)
+		 ValueStreamDocument& vsdoc)
 {
     ptr = NULL;
     ++docs_considered;
@@ -139,9 +139,8 @@ Collapser::check(Result& result,
     // Use dummy value 0 for item - if process() is called, this will get
     // updated to the appropriate value, and if it isn't then the docid won't
     // match and we'll know the item isn't in the current proto-mset.
-    auto r = table.emplace(result.get_collapse_key(),
-			   CollapseData(0, result.get_docid()));
-    ptr = &r.first->second;
+    auto r = table.emplace(result.get_collapse_key(), 0, result.get_docid());
+    ptr = r.first;
     if (r.second) {
 	// We've not seen this collapse key before.
 	++entry_count;
@@ -186,16 +185,16 @@ Collapser::get_collapse_count(const string & collapse_key,
 			      int percent_threshold,
 			      double min_weight) const
 {
-    auto key = table.find(collapse_key);
+    const CollapseData* key = table.find(collapse_key);
     // If a collapse key is present in the MSet, it must be in our table.
-    Assert(key != table.end());
+    Assert(key);
 
     if (!percent_threshold) {
 	// The recorded collapse_count is correct.
-	return key->second.get_collapse_count();
+	return key->get_collapse_count();
     }
 
-    if (key->second.get_next_best_weight() < min_weight) {
+    if (key->get_next_best_weight() < min_weight) {
 	// We know for certain that all collapsed items would have failed the
 	// percentage cutoff, so collapse_count should be 0.
 	return 0;
@@ -21,13 +21,17 @@
 #ifndef XAPIAN_INCLUDED_COLLAPSER_H
 #define XAPIAN_INCLUDED_COLLAPSER_H
 
-#include "backends/documentinternal.h"
 #include "msetcmp.h"
 #include "omassert.h"
 #include "api/postlist.h"
 #include "api/result.h"
+#include "valuestreamdocument.h"
 
-#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
 #include <vector>
 
 /// Enumeration reporting how a result will be handled by the Collapser.
@@ -129,10 +133,162 @@ class CollapseData {
     Xapian::doccount get_collapse_count() const { return collapse_count; }
 };
 
+/** Open-addressing hash table mapping collapse key values to @a T.
+ *
+ *  The collapse key bytes are appended to a single arena string rather than
+ *  each being allocated separately, and each slot holds the 64-bit hash of
+ *  its key so that probing only needs to compare key bytes when the hashes
+ *  match.  Entries are stored contiguously and never move once added (apart
+ *  from when the entry vector grows), and clear() keeps all the allocated
+ *  storage so the table can be reused without further allocations.
+ */
+template<typename T>
+class CollapseTable {
+    /// An entry in the table.
+    struct Entry {
+	/// Offset of the key in @a keys.
+	size_t key_offset;
+
+	/// Length of the key.
+	size_t key_len;
+
+	/// The value associated with the key.
+	T value;
+
+	template<typename... Args>
+	Entry(size_t key_offset_, size_t key_len_, Args&&... args)
+	    : key_offset(key_offset_), key_len(key_len_),
+	      value(std::forward<Args>(args)...) { }
+    };
+
+    /// A slot in the open-addressing hash table.
+    struct Slot {
+	/// Hash of the key (only valid if @a index is non-zero).
+	std::uint64_t hash;
+
+	/// Index into @a entries plus one, or 0 for an empty slot.
+	size_t index;
+    };
+
+    /// Storage for the keys of all the entries, concatenated.
+    std::string keys;
+
+    /// The entries in the order they were added.
+    std::vector<Entry> entries;
+
+    /// The hash slots - the size is always 0 or a power of 2.
+    std::vector<Slot> slots;
+
+    /// 64-bit FNV-1a hash of the @a len bytes at @a p.
+    static std::uint64_t hash_key(const char* p, size_t len) {
+	std::uint64_t h = 14695981039346656037ULL;
+	while (len--) {
+	    h ^= static_cast<unsigned char>(*p++);
+	    h *= 1099511628211ULL;
+	}
+	// Fold in the high bits since we index slots by the low bits.
+	return h ^ (h >> 32);
+    }
+
+    bool key_matches(const Entry& entry, const std::string& key) const {
+	return entry.key_len == key.size() &&
+	       std::memcmp(keys.data() + entry.key_offset,
+			   key.data(), key.size()) == 0;
+    }
+
+    /** Find the slot for @a key.
+     *
+     *  Returns either the slot containing @a key or the empty slot where it
+     *  should be inserted.  Requires slots to be non-empty.
+     */
+    Slot& find_slot(const std::string& key, std::uint64_t h) {
+	size_t mask = slots.size() - 1;
+	size_t i = size_t(h) & mask;
+	while (true) {
+	    Slot& slot = slots[i];
+	    if (slot.index == 0)
+		return slot;
+	    // Only compare the actual keys if the hashes collide.
+	    if (slot.hash == h && key_matches(entries[slot.index - 1], key))
+		return slot;
+	    i = (i + 1) & mask;
+	}
+    }
+
+    /// Resize the hash slots to @a new_size (which must be a power of 2).
+    void rehash(size_t new_size) {
+	slots.assign(new_size, Slot{0, 0});
+	size_t mask = new_size - 1;
+	for (size_t idx = 0; idx != entries.size(); ++idx) {
+	    const Entry& entry = entries[idx];
+	    std::uint64_t h = hash_key(keys.data() + entry.key_offset,
+				       entry.key_len);
+	    size_t i = size_t(h) & mask;
+	    while (slots[i].index != 0) i = (i + 1) & mask;
+	    slots[i] = Slot{h, idx + 1};
+	}
+    }
+
+  public:
+    /// Return true if the table has no entries.
+    bool empty() const { return entries.empty(); }
+
+    /// Return the number of entries in the table.
+    size_t size() const { return entries.size(); }
+
+    /// Remove all entries, but keep the allocated storage for reuse.
+    void clear() {
+	keys.clear();
+	entries.clear();
+	std::fill(slots.begin(), slots.end(), Slot{0, 0});
+    }
+
+    /** Find the value for @a key.
+     *
+     *  @return Pointer to the value, or NULL if @a key isn't present.
+     */
+    T* find(const std::string& key) {
+	if (slots.empty())
+	    return NULL;
+	Slot& slot = find_slot(key, hash_key(key.data(), key.size()));
+	return slot.index ? &entries[slot.index - 1].value : NULL;
+    }
+
+    const T* find(const std::string& key) const {
+	return const_cast<CollapseTable*>(this)->find(key);
+    }
+
+    /** Insert @a key with value constructed from @a args if not present.
+     *
+     *  The returned pointer remains valid until the next call to emplace()
+     *  or clear().
+     *
+     *  @return Pair of pointer to the value for @a key and true if it was
+     *		newly inserted.
+     */
+    template<typename... Args>
+    std::pair<T*, bool> emplace(const std::string& key, Args&&... args) {
+	// Keep the load factor at most 1/2.
+	if ((entries.size() + 1) * 2 > slots.size()) {
+	    rehash(slots.empty() ? 16 : slots.size() * 2);
+	}
+	std::uint64_t h = hash_key(key.data(), key.size());
+	Slot& slot = find_slot(key, h);
+	if (slot.index) {
+	    return {&entries[slot.index - 1].value, false};
+	}
+	entries.emplace_back(keys.size(), key.size(),
+			     std::forward<Args>(args)...);
+	keys += key;
+	slot = Slot{h, entries.size()};
+	return {&entries.back().value, true};
+    }
+};
+
 /// The Collapser class tracks collapse keys and the documents they match.
 class Collapser {
     /// Map from collapse key values to the items we're keeping for them.
-    std::unordered_map<std::string, CollapseData> table;
+    CollapseTable<CollapseData> table;
 
     /// How many items we're currently keeping in @a table.
     Xapian::doccount entry_count = 0;
@@ -204,7 +360,7 @@ class Collapser {
      *  @return How to handle @a result: EMPTY, NEW, ADD, REJECT or REPLACE.
      */
     collapse_result check(Result& result,
-			  Xapian::Document::Internal & vsdoc);
+			  ValueStreamDocument& vsdoc);
 
     /** Handle a new Result.
      *
@@ -223,15 +379,14 @@ class Collapser {
 	if (collapse_key.empty()) {
 	    return;
 	}
-	auto it = table.find(collapse_key);
-	if (rare(it == table.end())) {
+	CollapseData* collapse_data = table.find(collapse_key);
+	if (rare(collapse_data == NULL)) {
 	    // The entry ought to be present.
 	    Assert(false);
 	    return;
 	}
 
-	CollapseData& collapse_data = it->second;
-	collapse_data.result_has_moved(from, to);
+	collapse_data->result_has_moved(from, to);
     }
 
     Xapian::doccount get_collapse_count(const std::string & collapse_key,
@@ -257,7 +412,7 @@ class Collapser {
  */
 class CollapserLite {
     /// Map from collapse key values to collapse counts.
-    std::unordered_map<std::string, Xapian::doccount> table;
+    CollapseTable<Xapian::doccount> table;
 
     /// How many items we're currently keeping in @a table.
     Xapian::doccount entry_count = 0;
@@ -307,13 +462,13 @@ class CollapserLite {
 	auto r = table.emplace(key, 1);
 	if (r.second) {
 	    // New entry, set to 1.
-	} else if (r.first->second == collapse_max) {
+	} else if (*r.first == collapse_max) {
 	    // Already seen collapse_max with this key so reject.
 	    ++dups_ignored;
 	    return false;
 	} else {
 	    // Increment count.
-	    ++r.first->second;
+	    ++*r.first;
 	}
 	++entry_count;
 	return true;
@@ -346,7 +501,10 @@ class CollapserLite {
 		// FIXME: We can probably do better here.
 		result.set_collapse_count(1);
 	    } else {
-		auto c = result.get_collapse_count() + table[key];
+		const Xapian::doccount* count = table.find(key);
+		// Every key in the merged results must be in our table.
+		Assert(count);
+		auto c = result.get_collapse_count() + *count;
 		result.set_collapse_count(c);
 	    }
 
@@ -128,7 +128,7 @@ ExternalPostList::next(double w_min)
 {
     LOGCALL(MATCH, PostList *, "ExternalPostList::next", w_min);
     Assert(source);
-    source->next(w_min);
+    source->next(source_min_wt(w_min));
     RETURN(update_after_advance());
 }
 
@@ -138,7 +138,7 @@ ExternalPostList::skip_to(Xapian::docid did, double w_min)
     LOGCALL(MATCH, PostList *, "ExternalPostList::skip_to", did | w_min);
     Assert(source);
     if (did <= current) RETURN(NULL);
-    source->skip_to(did, w_min);
+    source->skip_to(did, source_min_wt(w_min));
     RETURN(update_after_advance());
 }
 
@@ -151,7 +151,7 @@ ExternalPostList::check(Xapian::docid did, double w_min, bool &valid)
 	valid = true;
 	RETURN(NULL);
     }
-    valid = source->check(did, w_min);
+    valid = source->check(did, source_min_wt(w_min));
     if (source->at_end()) {
 	LOGLINE(MATCH, "ExternalPostList now at end");
 	if (source_is_owned) delete source;
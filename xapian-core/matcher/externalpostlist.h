@@ -46,6 +46,14 @@ class ExternalPostList : public PostList {
 
     PostList * update_after_advance();
 
+    /** Convert a minimum weight for this postlist to one for the source.
+     *
+     *  The source's weights get multiplied by factor.
+     */
+    double source_min_wt(double w_min) const {
+	return factor == 0.0 ? 0.0 : w_min / factor;
+    }
+
   public:
     /** Constructor.
      *
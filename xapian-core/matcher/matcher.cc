@@ -32,6 +32,7 @@
 #include "omassert.h"
 #include "postlisttree.h"
 #include "protomset.h"
+#include "realtime.h"
 #include "spymaster.h"
 #include "valuestreamdocument.h"
 #include "weight/weightinternal.h"
@@ -46,6 +47,7 @@
 #include <algorithm>
 #include <cerrno>
 #include <cfloat> // For DBL_EPSILON.
+#include <cmath>
 #include <vector>
 
 #ifdef HAVE_POLL_H
@@ -86,33 +88,67 @@ Matcher::for_all_remotes(Action action)
 	return;
     }
 
-    unique_ptr<struct pollfd[]> fds(new struct pollfd[n_remotes]);
-    for (size_t i = 0; i != n_remotes; ++i) {
-	fds[i].fd = remotes[i]->get_read_fd();
-	fds[i].events = POLLIN;
-	fds[i].revents = 0;
-    }
+    // A shard with replicas may be waiting for a reply from more than one of
+    // them, so may have several fds.
+    vector<struct pollfd> fds;
+    vector<size_t> fd_remote;
+    vector<bool> ready;
     do {
-	int r = poll(fds.get(), n_remotes, -1);
-	if (r <= 0) {
-	    // We shouldn't get a timeout, but if we do retry.
-	    if (r == 0 || errno == EINTR || errno == EAGAIN) {
+	fds.clear();
+	fd_remote.clear();
+	double hedge_time = 0.0;
+	for (size_t i = 0; i != n_remotes; ++i) {
+	    vector<int> remote_fds;
+	    remotes[i]->get_read_fds(remote_fds);
+	    for (int fd : remote_fds) {
+		struct pollfd pfd;
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		fds.push_back(pfd);
+		fd_remote.push_back(i);
+	    }
+	    double t = remotes[i]->get_hedge_time();
+	    if (t != 0.0 && (hedge_time == 0.0 || t < hedge_time))
+		hedge_time = t;
+	}
+
+	int timeout_ms = -1;
+	if (hedge_time != 0.0) {
+	    double delay = hedge_time - RealTime::now();
+	    timeout_ms = delay > 0.0 ? int(ceil(delay * 1000.0)) : 0;
+	}
+	int r = poll(fds.data(), fds.size(), timeout_ms);
+	if (r < 0) {
+	    if (errno == EINTR || errno == EAGAIN) {
 		continue;
 	    }
 	    throw Xapian::NetworkError("poll() failed waiting for remotes",
 				       errno);
 	}
-	size_t i = 0;
-	while (i != n_remotes) {
-	    if (fds[i].revents) {
+	if (r == 0) {
+	    // Send hedged queries for shards which are slow to reply.
+	    double now = RealTime::now();
+	    for (size_t i = 0; i != n_remotes; ++i) {
+		double t = remotes[i]->get_hedge_time();
+		if (t != 0.0 && t <= now)
+		    remotes[i]->hedge();
+	    }
+	    continue;
+	}
+
+	ready.assign(n_remotes, false);
+	for (size_t j = 0; j != fds.size(); ++j) {
+	    if (fds[j].revents)
+		ready[fd_remote[j]] = true;
+	}
+	// Work backwards so swapping the last entry into the place of one
+	// we've handled doesn't move an entry we've still to check.
+	for (size_t i = n_remotes; i-- > 0; ) {
+	    if (ready[i]) {
 		action(remotes[i].get());
 		// Swap such that entries we still need to handle are first.
 		swap(remotes[i], remotes[--n_remotes]);
-		fds[i] = fds[n_remotes];
-		// r is number of ready fds.
-		if (--r == 0) break;
-	    } else {
-		++i;
 	    }
 	}
     } while (n_remotes > 1);
@@ -192,13 +228,21 @@ Matcher::Matcher(const Xapian::Database& db_,
 		 Xapian::Enquire::Internal::sort_setting sort_by,
 		 bool sort_val_reverse,
 		 double time_limit,
-		 const vector<opt_intrusive_ptr<Xapian::MatchSpy>>& matchspies)
+		 bool hard_time_limit,
+		 double pruning_factor,
+		 const vector<opt_intrusive_ptr<Xapian::MatchSpy>>& matchspies,
+		 bool shard_stats)
     : db(db_), query(query_)
 {
     // An empty query should get handled higher up.
     Assert(!query.empty());
 
     Xapian::doccount n_shards = db.internal->size();
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+    remote_shard_stats = (shard_stats || n_shards == 1);
+#else
+    (void)shard_stats;
+#endif
     vector<Xapian::RSet> subrsets;
     if (rset && rset->internal.get()) {
 	rset->internal->shard(n_shards, subrsets);
@@ -228,10 +272,13 @@ Matcher::Matcher(const Xapian::Database& db_,
 			      collapse_key, collapse_max,
 			      order, sort_key, sort_by, sort_val_reverse,
 			      time_limit,
+			      hard_time_limit,
+			      pruning_factor,
 			      n_shards == 1 ? percent_threshold : 0,
 			      weight_threshold,
 			      wtscheme,
-			      subrsets[i], matchspies);
+			      subrsets[i], matchspies,
+			      remote_shard_stats);
 	    remotes.emplace_back(new RemoteSubMatch(as_rem, i));
 	    continue;
 	}
@@ -248,6 +295,8 @@ Matcher::Matcher(const Xapian::Database& db_,
 	(void)sort_by;
 	(void)sort_val_reverse;
 	(void)time_limit;
+	(void)hard_time_limit;
+	(void)pruning_factor;
 	(void)matchspies;
 #endif /* XAPIAN_HAS_REMOTE_BACKEND */
 	if (locals.size() != i)
@@ -312,10 +361,12 @@ Matcher::Matcher(const Xapian::Database& db_,
     }
 
 #ifdef XAPIAN_HAS_REMOTE_BACKEND
-    for_all_remotes(
-	[&](RemoteSubMatch* submatch) {
-	    submatch->prepare_match(stats);
-	});
+    if (!remote_shard_stats) {
+	for_all_remotes(
+	    [&](RemoteSubMatch* submatch) {
+		submatch->prepare_match(stats);
+	    });
+    }
 #endif
 
     stats.set_bounds_from_db(db);
@@ -338,6 +389,8 @@ Matcher::get_local_mset(Xapian::doccount first,
 			Xapian::Enquire::Internal::sort_setting sort_by,
 			bool sort_val_reverse,
 			double time_limit,
+			bool hard_time_limit,
+			double pruning_factor,
 			const vector<opt_ptr_spy>& matchspies)
 {
     Assert(!locals.empty());
@@ -448,12 +501,27 @@ Matcher::get_local_mset(Xapian::doccount first,
 			 percent_threshold, percent_threshold_factor,
 			 max_possible,
 			 stop_once_full,
-			 time_limit);
+			 time_limit,
+			 hard_time_limit);
     proto_mset.set_new_min_weight(weight_threshold);
 
+    // Only prune approximately when ranking purely by relevance - otherwise
+    // the weight isn't what decides which documents are returned.
+    if (sort_by != REL)
+	pruning_factor = 1.0;
+
     while (true) {
+	if (proto_mset.out_of_time()) {
+	    break;
+	}
+
 	double min_weight = proto_mset.get_min_weight();
-	if (!pltree.next(min_weight)) {
+	// Only prune approximately once the proto-MSet is full - until then
+	// any document above the cutoff could still be returned.
+	double prune_weight = min_weight;
+	if (proto_mset.full())
+	    prune_weight *= pruning_factor;
+	if (!pltree.next(prune_weight)) {
 	    break;
 	}
 
@@ -530,6 +598,8 @@ Matcher::get_mset(Xapian::doccount first,
 		  Xapian::Enquire::Internal::sort_setting sort_by,
 		  bool sort_val_reverse,
 		  double time_limit,
+		  bool hard_time_limit,
+		  double pruning_factor,
 		  const vector<opt_intrusive_ptr<Xapian::MatchSpy>>& matchspies)
 {
     AssertRel(check_at_least, >=, first + maxitems);
@@ -578,7 +648,9 @@ Matcher::get_mset(Xapian::doccount first,
 				    sorter, collapse_key, collapse_max,
 				    percent_threshold, ptf_to_use,
 				    weight_threshold, order, sort_key, sort_by,
-				    sort_val_reverse, time_limit, matchspies);
+				    sort_val_reverse, time_limit,
+				    hard_time_limit, pruning_factor,
+				    matchspies);
     }
 
 #ifdef XAPIAN_HAS_REMOTE_BACKEND
@@ -592,6 +664,18 @@ Matcher::get_mset(Xapian::doccount first,
     // than we need.
     vector<pair<Xapian::MSet, Xapian::doccount>> msets;
     Xapian::MSet merged_mset;
+
+    // If the remote shards used their own statistics, @a stats only covers
+    // the local shards so the MSet needs statistics which include the
+    // remote shards.
+    unique_ptr<Xapian::Weight::Internal> merged_stats;
+    if (remote_shard_stats) {
+	merged_stats.reset(new Xapian::Weight::Internal);
+	merged_stats->set_query(query);
+	if (!locals.empty())
+	    *merged_stats += stats;
+	merged_stats->set_bounds_from_db(db);
+    }
     if (!locals.empty()) {
 	if (!local_mset.empty())
 	    msets.push_back({local_mset, 0});
@@ -602,6 +686,11 @@ Matcher::get_mset(Xapian::doccount first,
 	[&](RemoteSubMatch* submatch) {
 	    Xapian::MSet remote_mset = submatch->get_mset(matchspies);
 	    merged_mset.internal->merge_stats(remote_mset.internal.get());
+	    if (merged_stats) {
+		auto remote_stats = remote_mset.internal->get_stats();
+		if (remote_stats)
+		    *merged_stats += *remote_stats;
+	    }
 	    if (remote_mset.empty()) {
 		return;
 	    }
@@ -609,6 +698,8 @@ Matcher::get_mset(Xapian::doccount first,
 						 db.internal->size());
 	    msets.push_back({remote_mset, 0});
 	});
+    if (merged_stats)
+	merged_mset.internal->set_stats(merged_stats.release());
 
     if (merged_mset.internal->max_possible == 0.0) {
 	// All the weights are zero.
@@ -78,6 +78,13 @@ class Matcher {
      */
     std::size_t first_oversize;
 # endif
+
+    /** Are remote shards weighting using their own statistics?
+     *
+     *  If so, we don't exchange statistics with them, and each returns its
+     *  MSet in a single round trip.
+     */
+    bool remote_shard_stats = false;
 #endif
 
     Matcher(const Matcher&) = delete;
@@ -100,6 +107,8 @@ class Matcher {
 				Xapian::Enquire::Internal::sort_setting sort_by,
 				bool sort_val_reverse,
 				double time_limit,
+				bool hard_time_limit,
+				double pruning_factor,
 				const std::vector<opt_ptr_spy>& matchspies);
 
     /// Perform action on remotes as they become ready using poll() or select().
@@ -128,7 +137,14 @@ class Matcher {
      *  @param sort_val_reverse	Reverse direction keys sort in?
      *  @param time_limit	time in seconds after which to disable
      *				check_at_least (0.0 means don't).
+     *  @param hard_time_limit	stop the match once time_limit is reached?
+     *  @param pruning_factor	Factor to scale the weight needed to prune by
+     *				(1.0 means exact results).
      *  @param matchspies	MatchSpy objects to use
+     *  @param shard_stats	Should remote shards weight using their own
+     *				statistics?  This is always done if the
+     *				database is a single remote shard, since the
+     *				results are then the same.
      */
     Matcher(const Xapian::Database& db_,
 	    const Xapian::Query& query,
@@ -147,7 +163,10 @@ class Matcher {
 	    Xapian::Enquire::Internal::sort_setting sort_by,
 	    bool sort_val_reverse,
 	    double time_limit,
-	    const std::vector<opt_ptr_spy>& matchspies);
+	    bool hard_time_limit,
+	    double pruning_factor,
+	    const std::vector<opt_ptr_spy>& matchspies,
+	    bool shard_stats = false);
 
     /** Run the match and produce an MSet object.
      *
@@ -183,6 +202,9 @@ class Matcher {
      *  @param sort_val_reverse	Reverse direction keys sort in?
      *  @param time_limit	time in seconds after which to disable
      *				check_at_least (0.0 means don't).
+     *  @param hard_time_limit	stop the match once time_limit is reached?
+     *  @param pruning_factor	Factor to scale the weight needed to prune by
+     *				(1.0 means exact results).
      *  @param matchspies	MatchSpy objects to use
      */
     Xapian::MSet get_mset(Xapian::doccount first,
@@ -201,6 +223,8 @@ class Matcher {
 			  Xapian::Enquire::Internal::sort_setting sort_by,
 			  bool sort_val_reverse,
 			  double time_limit,
+			  bool hard_time_limit,
+			  double pruning_factor,
 			  const std::vector<opt_ptr_spy>& matchspies);
 
     bool full_db_has_positions() const {
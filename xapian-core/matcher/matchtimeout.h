@@ -26,95 +26,83 @@
 # error config.h must be included first in each C++ source file
 #endif
 
-#ifdef HAVE_TIMER_CREATE
-#include "realtime.h"
-
-#include <signal.h>
-#include <time.h>
-#include "safeunistd.h" // For _POSIX_* feature test macros.
-
-extern "C" {
-
-static void
-set_timeout_flag(union sigval sv)
-{
-    *(reinterpret_cast<volatile bool*>(sv.sival_ptr)) = true;
-}
-
-}
-
-// The monotonic clock is the better basis for timeouts, but not always
-// available.
-
-#ifndef _POSIX_MONOTONIC_CLOCK
-const clockid_t TIMEOUT_CLOCK = CLOCK_REALTIME;
-#elif defined __sun
-// Solaris defines CLOCK_MONOTONIC, but "man timer_create" doesn't mention it
-// and when using it timer_create() fails with "EPERM" (perhaps you need to be
-// root to use it?  I can't test that).
-//
-// Solaris defines _POSIX_MONOTONIC_CLOCK so we need to special case.
-const clockid_t TIMEOUT_CLOCK = CLOCK_REALTIME;
-#elif defined __CYGWIN__
-// https://cygwin.com/cygwin-api/std-notes.html currently (2016-05-13) says:
-//
-//     clock_nanosleep currently supports only CLOCK_REALTIME and
-//     CLOCK_MONOTONIC.  clock_setres, clock_settime, and timer_create
-//     currently support only CLOCK_REALTIME.
-//
-// So CLOCK_MONOTONIC is defined, but not supported by timer_create().
-const clockid_t TIMEOUT_CLOCK = CLOCK_REALTIME;
-#else
-const clockid_t TIMEOUT_CLOCK = CLOCK_MONOTONIC;
-#endif
+#include <chrono>
 
+/** Time limit for the matcher.
+ *
+ *  This is checked cooperatively by the matcher rather than using a timer
+ *  which fires asynchronously, so it works the same on all platforms and
+ *  doesn't need a timer or helper thread per match.
+ *
+ *  Reading the clock isn't free, so timed_out() only actually does so every
+ *  so many calls (at most MAX_INTERVAL).  The number of calls between checks
+ *  is adjusted so that we look at the clock roughly every CHECK_PERIOD
+ *  microseconds, so the cost is negligible when the calls are cheap, but we
+ *  still notice promptly if they are slow.  If the calls suddenly become
+ *  slow, the limit can be overrun by up to MAX_INTERVAL slow calls.
+ */
 class TimeOut {
-    struct sigevent sev;
-    timer_t timerid;
-    volatile bool expired;
+    typedef std::chrono::steady_clock clock;
+
+    /// Aim to look at the clock about this often (in microseconds).
+    static constexpr long CHECK_PERIOD = 500;
+
+    /// Maximum number of calls between looking at the clock.
+    static constexpr unsigned MAX_INTERVAL = 1024;
+
+    /// When the time limit expires.
+    clock::time_point deadline;
+
+    /// When we last looked at the clock.
+    clock::time_point last_check;
+
+    /// Number of calls between looking at the clock.
+    unsigned interval = 1;
 
-    TimeOut(const TimeOut&) = delete;
+    /// Number of calls left until we next look at the clock.
+    unsigned countdown = 1;
 
-    TimeOut& operator=(const TimeOut&) = delete;
+    /// Is there a time limit?
+    bool active;
+
+    /// Has the time limit expired?
+    bool expired = false;
 
   public:
-    explicit TimeOut(double limit) : expired(false) {
-	if (limit > 0) {
-	    sev.sigev_notify = SIGEV_THREAD;
-	    sev.sigev_notify_function = set_timeout_flag;
-	    sev.sigev_notify_attributes = NULL;
-	    sev.sigev_value.sival_ptr =
-		static_cast<void*>(const_cast<bool*>(&expired));
-	    if (usual(timer_create(TIMEOUT_CLOCK, &sev, &timerid) == 0)) {
-		struct itimerspec interval;
-		interval.it_interval.tv_sec = 0;
-		interval.it_interval.tv_nsec = 0;
-		RealTime::to_timespec(limit, &interval.it_value);
-		if (usual(timer_settime(timerid, 0, &interval, NULL) == 0)) {
-		    // Timeout successfully set.
-		    return;
-		}
-		timer_delete(timerid);
-	    }
+    explicit TimeOut(double limit) : active(limit > 0) {
+	if (active) {
+	    last_check = clock::now();
+	    deadline = last_check +
+		std::chrono::duration_cast<clock::duration>(
+		    std::chrono::duration<double>(limit));
 	}
-	sev.sigev_notify = SIGEV_NONE;
     }
 
-    ~TimeOut() {
-	if (sev.sigev_notify != SIGEV_NONE) {
-	    timer_delete(timerid);
-	    sev.sigev_notify = SIGEV_NONE;
+    bool timed_out() {
+	if (!active || --countdown != 0)
+	    return expired;
+
+	auto now = clock::now();
+	if (now >= deadline) {
+	    expired = true;
+	    active = false;
+	    return true;
 	}
-    }
 
-    bool timed_out() const { return expired; }
-};
-#else
-class TimeOut {
-  public:
-    explicit TimeOut(double) { }
-    bool timed_out() const { return false; }
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+		now - last_check).count();
+	last_check = now;
+	if (elapsed < CHECK_PERIOD / 2) {
+	    if (interval < MAX_INTERVAL) interval *= 2;
+	} else if (elapsed > CHECK_PERIOD * 2) {
+	    // The calls have got slower, so look at the clock on every call
+	    // until they speed up again, rather than risk overrunning by
+	    // another long interval.
+	    interval = 1;
+	}
+	countdown = interval;
+	return false;
+    }
 };
-#endif
 
 #endif // XAPIAN_INCLUDED_MATCHTIMEOUT_H
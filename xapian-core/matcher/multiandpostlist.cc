@@ -40,6 +40,29 @@ MultiAndPostList::allocate_plist_and_max_wt()
     }
 }
 
+void
+MultiAndPostList::choose_driver()
+{
+    size_t best = 0;
+    double best_cost = 0.0;
+    for (size_t i = 0; i < n_kids; ++i) {
+	double cost = plist[i]->get_iteration_cost_est() +
+		      plist[i]->get_termfreq_est();
+	if (i == 0 || cost < best_cost) {
+	    best = i;
+	    best_cost = cost;
+	}
+    }
+    if (best != 0) {
+	// Keep the rest in the same order.
+	std::rotate(plist, plist + best, plist + best + 1);
+	std::rotate(max_wt, max_wt + best, max_wt + best + 1);
+    }
+    LOGLINE(MATCH, "MultiAndPostList plan: iterate " <<
+	    plist[0]->get_description() << " (estimated cost " << best_cost <<
+	    "), check " << n_kids - 1 << " others");
+}
+
 MultiAndPostList::~MultiAndPostList()
 {
     if (plist) {
@@ -104,6 +127,14 @@ MultiAndPostList::get_termfreq_est() const
     return static_cast<Xapian::doccount>(result + 0.5);
 }
 
+double
+MultiAndPostList::get_iteration_cost_est() const
+{
+    // Only the first sub-postlist is iterated - the others are just checked
+    // for each candidate it finds.
+    return plist[0]->get_iteration_cost_est();
+}
+
 TermFreqs
 MultiAndPostList::get_termfreq_est_using_stats(
 	const Xapian::Weight::Internal & stats) const
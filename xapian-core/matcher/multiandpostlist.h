@@ -108,6 +108,18 @@ class MultiAndPostList : public PostList {
      */
     void allocate_plist_and_max_wt();
 
+    /** Pick which sub-postlist to iterate.
+     *
+     *  The first sub-postlist is iterated and the others are checked against
+     *  each candidate it produces.  The sub-postlists should already be in
+     *  ascending order of estimated termfreq, which is the order we want to
+     *  check them in, but the least frequent isn't always the cheapest to
+     *  iterate (e.g. a value range has to scan every value in the slot), so
+     *  move the sub-postlist which minimises the estimated cost of iterating
+     *  it plus checking each candidate to the front.
+     */
+    void choose_driver();
+
     /// Advance the sublists to the next match.
     PostList * find_next_match(double w_min);
 
@@ -128,6 +140,7 @@ class MultiAndPostList : public PostList {
 	// the longer lists based on those.
 	std::partial_sort_copy(pl_begin, pl_end, plist, plist + n_kids,
 			       ComparePostListTermFreqAscending());
+	choose_driver();
     }
 
     /** Construct as the decay product of an OrPostList or AndMaybePostList. */
@@ -150,6 +163,7 @@ class MultiAndPostList : public PostList {
 	plist[1] = l;
 	max_wt[0] = rmax;
 	max_wt[1] = lmax;
+	choose_driver();
     }
 
     ~MultiAndPostList();
@@ -163,6 +177,8 @@ class MultiAndPostList : public PostList {
     TermFreqs get_termfreq_est_using_stats(
 	const Xapian::Weight::Internal & stats) const;
 
+    double get_iteration_cost_est() const;
+
     Xapian::docid get_docid() const;
 
     double get_weight(Xapian::termcount doclen,
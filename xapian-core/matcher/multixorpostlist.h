@@ -85,6 +85,8 @@ class MultiXorPostList : public PostList {
     TermFreqs get_termfreq_est_using_stats(
 	const Xapian::Weight::Internal & stats) const;
 
+    double get_iteration_cost_est() const;
+
     Xapian::docid get_docid() const;
 
     double get_weight(Xapian::termcount doclen,
@@ -383,6 +383,13 @@ OrPostList::get_termfreq_est() const
     return tf_est;
 }
 
+double
+OrPostList::get_iteration_cost_est() const
+{
+    // We need to iterate both sides.
+    return l->get_iteration_cost_est() + r->get_iteration_cost_est();
+}
+
 TermFreqs
 OrPostList::get_termfreq_est_using_stats(
 	const Xapian::Weight::Internal& stats) const
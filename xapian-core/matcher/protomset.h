@@ -129,6 +129,12 @@ class ProtoMSet {
 
     TimeOut timeout;
 
+    /// Should the match stop once the time limit is reached?
+    bool hard_time_limit;
+
+    /// Did the match stop early because the time limit was reached?
+    bool partial = false;
+
   public:
     ProtoMSet(Xapian::doccount first_,
 	      Xapian::doccount max_items,
@@ -143,7 +149,8 @@ class ProtoMSet {
 	      double percent_threshold_factor_,
 	      double max_possible_,
 	      bool stop_once_full_,
-	      double time_limit)
+	      double time_limit,
+	      bool hard_time_limit_)
 	: max_size(first_ + max_items),
 	  check_at_least(check_at_least_),
 	  sort_by(sort_by_),
@@ -156,7 +163,8 @@ class ProtoMSet {
 	  collapser(collapse_key, collapse_max, results, mcmp),
 	  max_possible(max_possible_),
 	  stop_once_full(stop_once_full_),
-	  timeout(time_limit)
+	  timeout(time_limit),
+	  hard_time_limit(hard_time_limit_)
     {
 	results.reserve(max_size);
     }
@@ -193,6 +201,17 @@ class ProtoMSet {
 	return false;
     }
 
+    /** Check if the match should stop because of the time limit.
+     *
+     *  If it should, the results so far are marked as partial.
+     */
+    bool out_of_time() {
+	if (!hard_time_limit || !timeout.timed_out())
+	    return false;
+	partial = true;
+	return true;
+    }
+
     /** Resolve a pending min_weight change.
      *
      *  Only called when there's a percentage weight cut-off.
@@ -494,7 +513,9 @@ class ProtoMSet {
 	Xapian::doccount uncollapsed_estimated = matches_estimated;
 	Xapian::doccount uncollapsed_upper_bound = matches_upper_bound;
 
-	if (!full()) {
+	// If we stopped early because of the time limit, we can't use the
+	// shortcuts below which rely on having seen every potential match.
+	if (!partial && !full()) {
 	    // We didn't get all the results requested, so we know that we've
 	    // got all there are, and the bounds and estimate are all equal to
 	    // that number.
@@ -509,7 +530,8 @@ class ProtoMSet {
 	    } else {
 		AssertRel(matches_estimated, <=, known_matching_docs);
 	    }
-	} else if (!collapser && known_matching_docs < check_at_least) {
+	} else if (!partial && !collapser &&
+		   known_matching_docs < check_at_least) {
 	    // Similar to the above, but based on known_matching_docs.
 	    matches_lower_bound = known_matching_docs;
 	    matches_estimated = matches_lower_bound;
@@ -669,17 +691,20 @@ class ProtoMSet {
 	AssertRel(matches_estimated, <=, uncollapsed_estimated);
 	AssertRel(matches_upper_bound, <=, uncollapsed_upper_bound);
 
-	return Xapian::MSet(new Xapian::MSet::Internal(first,
-						       matches_upper_bound,
-						       matches_lower_bound,
-						       matches_estimated,
-						       uncollapsed_upper_bound,
-						       uncollapsed_lower_bound,
-						       uncollapsed_estimated,
-						       max_possible,
-						       max_weight,
-						       std::move(results),
-						       percent_scale * 100.0));
+	Xapian::MSet mset(new Xapian::MSet::Internal(first,
+						     matches_upper_bound,
+						     matches_lower_bound,
+						     matches_estimated,
+						     uncollapsed_upper_bound,
+						     uncollapsed_lower_bound,
+						     uncollapsed_estimated,
+						     max_possible,
+						     max_weight,
+						     std::move(results),
+						     percent_scale * 100.0));
+	if (partial)
+	    mset.internal->set_partial();
+	return mset;
     }
 };
 
@@ -52,6 +52,21 @@ class RemoteSubMatch {
 	return db->get_read_fd();
     }
 
+    /// Add the fds to wait on for this shard to @a fds.
+    void get_read_fds(std::vector<int>& fds) const {
+	db->get_read_fds(fds);
+    }
+
+    /// When to call hedge() (0.0 for never).
+    double get_hedge_time() const {
+	return db->get_hedge_time();
+    }
+
+    /// Send the query to another replica of this shard.
+    void hedge() const {
+	db->send_hedge();
+    }
+
     /** Fetch and collate statistics.
      *
      *  Before we can calculate term weights we need to fetch statistics from
@@ -42,7 +42,9 @@ class SpyMaster {
     void operator()(const Xapian::Document& doc,
 		    double weight) {
 	if (spies != NULL) {
-	    for (auto spy : *spies) {
+	    // Iterate by reference to avoid adjusting the reference count of
+	    // each MatchSpy for every document.
+	    for (auto&& spy : *spies) {
 		(*spy)(doc, weight);
 	    }
 	}
@@ -129,6 +129,13 @@ ValueRangePostList::get_termfreq_est() const
     return Xapian::doccount(est + 0.5);
 }
 
+double
+ValueRangePostList::get_iteration_cost_est() const
+{
+    if (!db) return 0.0;
+    return db->get_value_freq(slot);
+}
+
 TermFreqs
 ValueRangePostList::get_termfreq_est_using_stats(
 	const Xapian::Weight::Internal & stats) const
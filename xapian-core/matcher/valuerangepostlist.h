@@ -63,6 +63,12 @@ class ValueRangePostList : public PostList {
     TermFreqs get_termfreq_est_using_stats(
 	const Xapian::Weight::Internal & stats) const;
 
+    /** Iterating has to look at every document with a value in the slot,
+     *  whereas check() is a cheap lookup, so this is usually better checked
+     *  than iterated in an AND.
+     */
+    double get_iteration_cost_est() const;
+
     Xapian::docid get_docid() const;
 
     double get_weight(Xapian::termcount doclen,
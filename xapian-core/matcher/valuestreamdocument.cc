@@ -28,11 +28,10 @@
 using namespace std;
 
 static void
-clear_valuelists(map<Xapian::valueno, ValueList *> & valuelists)
+clear_valuelists(vector<pair<Xapian::valueno, ValueList*>>& valuelists)
 {
-    map<Xapian::valueno, ValueList *>::const_iterator i;
-    for (i = valuelists.begin(); i != valuelists.end(); ++i) {
-	delete i->second;
+    for (auto&& i : valuelists) {
+	delete i.second;
     }
     valuelists.clear();
 }
@@ -60,15 +59,16 @@ ValueStreamDocument::new_shard(size_t n)
 string
 ValueStreamDocument::fetch_value(Xapian::valueno slot) const
 {
-    pair<map<Xapian::valueno, ValueList *>::iterator, bool> ret;
-    ret = valuelists.insert(make_pair(slot, static_cast<ValueList*>(NULL)));
+    auto i = valuelists.begin();
+    while (i != valuelists.end() && i->first != slot) ++i;
     ValueList * vl;
-    if (ret.second) {
+    if (i == valuelists.end()) {
 	// Entry didn't already exist, so open a value list for slot.
 	vl = database->open_value_list(slot);
-	ret.first->second = vl;
+	valuelists.emplace_back(slot, vl);
+	i = valuelists.end() - 1;
     } else {
-	vl = ret.first->second;
+	vl = i->second;
 	if (!vl) {
 	    return string();
 	}
@@ -77,7 +77,7 @@ ValueStreamDocument::fetch_value(Xapian::valueno slot) const
     if (vl->check(did)) {
 	if (vl->at_end()) {
 	    delete vl;
-	    ret.first->second = NULL;
+	    i->second = NULL;
 	} else if (vl->get_docid() == did) {
 	    return vl->get_value();
 	}
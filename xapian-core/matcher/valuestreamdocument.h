@@ -30,6 +30,8 @@
 #include "xapian/types.h"
 
 #include <map>
+#include <utility>
+#include <vector>
 
 /// A document which gets its values from a ValueStreamManager.
 class ValueStreamDocument : public Xapian::Document::Internal {
@@ -39,7 +41,15 @@ class ValueStreamDocument : public Xapian::Document::Internal {
     /// Don't allow copying.
     ValueStreamDocument(const ValueStreamDocument &);
 
-    mutable std::map<Xapian::valueno, ValueList *> valuelists;
+    /** Value streams opened so far, with the slot each is for.
+     *
+     *  Usually only a handful of slots get read during a match (a sort key,
+     *  a collapse key, maybe one or two for a MatchSpy or MatchDecider), so
+     *  a linear scan of a small vector is cheaper than a std::map lookup
+     *  for every value read.  A NULL ValueList pointer means that stream
+     *  has reached its end.
+     */
+    mutable std::vector<std::pair<Xapian::valueno, ValueList*>> valuelists;
 
     Xapian::Database db;
 
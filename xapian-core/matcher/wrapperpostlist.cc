@@ -40,6 +40,12 @@ WrapperPostList::get_termfreq_est() const
     return pl->get_termfreq_est();
 }
 
+double
+WrapperPostList::get_iteration_cost_est() const
+{
+    return pl->get_iteration_cost_est();
+}
+
 TermFreqs
 WrapperPostList::get_termfreq_est_using_stats(
 	const Xapian::Weight::Internal& stats) const
@@ -1,6 +1,7 @@
 noinst_HEADERS +=\
 	net/length.h\
 	net/progclient.h\
+	net/remotecache.h\
 	net/remoteconnection.h\
 	net/remoteprotocol.h\
 	net/remoteserver.h\
@@ -26,6 +27,7 @@ lib_src +=\
 if BUILD_BACKEND_REMOTE
 lib_src +=\
 	net/progclient.cc\
+	net/remotecache.cc\
 	net/remoteconnection.cc\
 	net/remoteserver.cc\
 	net/remotetcpclient.cc\
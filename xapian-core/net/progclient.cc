@@ -64,17 +64,24 @@ split_words(const string &text, vector<string> &words, char ws = ' ')
 }
 #endif
 
-ProgClient::ProgClient(const string &progname, const string &args,
+ProgClient::ProgClient(const string &progname_, const string &args_,
 		       double timeout_, bool writable, int flags)
-	: RemoteDatabase(run_program(progname, args
+	: RemoteDatabase(run_program(progname_, args_
 #ifndef __WIN32__
 						   , pid
 #endif
 	),
-			 timeout_, get_progcontext(progname, args), writable,
-			 flags)
+			 timeout_, get_progcontext(progname_, args_), writable,
+			 flags),
+	  progname(progname_), args(args_)
 {
-    LOGCALL_CTOR(DB, "ProgClient", progname | args | timeout_ | writable | flags);
+    LOGCALL_CTOR(DB, "ProgClient", progname_ | args_ | timeout_ | writable | flags);
+}
+
+RemoteDatabase*
+ProgClient::reconnect() const
+{
+    return new ProgClient(progname, args, timeout, false, 0);
 }
 
 string
@@ -43,6 +43,12 @@ class ProgClient : public RemoteDatabase {
     pid_t pid;
 #endif
 
+    /// The program used to create the connection.
+    std::string progname;
+
+    /// Any arguments to the program.
+    std::string args;
+
     /** Start the child process.
      *
      *  @param progname	The program used to create the connection.
@@ -90,6 +96,8 @@ class ProgClient : public RemoteDatabase {
 	       bool writable,
 	       int flags);
 
+    RemoteDatabase* reconnect() const;
+
     /** Destructor. */
     ~ProgClient();
 };
@@ -0,0 +1,253 @@
+/** @file remotecache.cc
+ * @brief Cache of replies for the remote server, shared between connections
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "remotecache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <thread>
+
+#ifndef __WIN32__
+# include <sys/mman.h>
+# ifndef MAP_ANONYMOUS
+#  define MAP_ANONYMOUS MAP_ANON
+# endif
+#endif
+
+#include "omassert.h"
+
+using namespace std;
+
+/// Maximum number of slots in each set.
+static const size_t MAX_WAYS = 4;
+
+/** How many times to try to acquire the lock before giving up.
+ *
+ *  We yield between attempts, so this is typically a few milliseconds,
+ *  which is much longer than any operation holds the lock for.
+ */
+static const int MAX_LOCK_ATTEMPTS = 1000;
+
+struct RemoteCache::Header {
+    /// Lock protecting everything else in the shared memory.
+    atomic_flag lock = ATOMIC_FLAG_INIT;
+
+    /// Incremented on each use of a slot, to track which is least recent.
+    unsigned long long clock = 0;
+
+    unsigned long long hits = 0;
+
+    unsigned long long misses = 0;
+
+    /// Number of slots in use.
+    size_t entries = 0;
+
+    /// Total size in bytes of the keys and values in use.
+    size_t size = 0;
+};
+
+/// Header of each slot, which is followed by the key and then the value.
+struct RemoteCache::Slot {
+    /// Value of Header::clock when last used, or 0 if this slot is unused.
+    unsigned long long last_used;
+
+    size_t hash;
+
+    unsigned key_len;
+
+    unsigned value_len;
+
+    char* data() { return reinterpret_cast<char*>(this + 1); }
+};
+
+namespace {
+
+/// Hold the cache's lock, if it can be acquired.
+class CacheLock {
+    atomic_flag& flag;
+
+    bool locked = false;
+
+  public:
+    explicit CacheLock(atomic_flag& flag_) : flag(flag_) {
+	for (int i = 0; i != MAX_LOCK_ATTEMPTS; ++i) {
+	    if (!flag.test_and_set(memory_order_acquire)) {
+		locked = true;
+		return;
+	    }
+	    this_thread::yield();
+	}
+    }
+
+    ~CacheLock() {
+	if (locked) flag.clear(memory_order_release);
+    }
+
+    explicit operator bool() const { return locked; }
+};
+
+}
+
+static inline size_t
+round_up(size_t n, size_t multiple)
+{
+    return (n + multiple - 1) / multiple * multiple;
+}
+
+const size_t RemoteCache::SLOTS_OFFSET = round_up(sizeof(RemoteCache::Header),
+					     alignof(RemoteCache::Slot));
+
+RemoteCache::RemoteCache(size_t max_size_, size_t slot_size_)
+    : slot_size(round_up(slot_size_, alignof(Slot))), max_size(max_size_)
+{
+    Assert(slot_size > sizeof(Slot));
+    if (max_size <= SLOTS_OFFSET)
+	return;
+    size_t n_slots = (max_size - SLOTS_OFFSET) / slot_size;
+    if (n_slots == 0)
+	return;
+    ways = min(n_slots, MAX_WAYS);
+    n_sets = n_slots / ways;
+    mem_size = SLOTS_OFFSET + n_sets * ways * slot_size;
+
+#ifndef __WIN32__
+    // Anonymous shared memory stays shared with any child processes we
+    // fork.
+    void* mem = mmap(NULL, mem_size, PROT_READ | PROT_WRITE,
+		     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+	throw bad_alloc();
+#else
+    // Connections are handled by threads, which share our memory anyway.
+    void* mem = ::operator new(mem_size);
+    memset(mem, 0, mem_size);
+#endif
+    header = new (mem) Header;
+}
+
+RemoteCache::~RemoteCache()
+{
+    if (!header)
+	return;
+#ifndef __WIN32__
+    munmap(static_cast<void*>(header), mem_size);
+#else
+    ::operator delete(static_cast<void*>(header));
+#endif
+}
+
+RemoteCache::Slot*
+RemoteCache::slot(size_t i) const
+{
+    char* base = reinterpret_cast<char*>(header) + SLOTS_OFFSET;
+    return reinterpret_cast<Slot*>(base + i * slot_size);
+}
+
+bool
+RemoteCache::find(const string& key, string& value)
+{
+    if (!header)
+	return false;
+    size_t h = hash<string>()(key);
+    size_t first = h % n_sets * ways;
+    CacheLock lock(header->lock);
+    if (!lock)
+	return false;
+    for (size_t i = first; i != first + ways; ++i) {
+	Slot* s = slot(i);
+	if (s->last_used && s->hash == h && s->key_len == key.size() &&
+	    memcmp(s->data(), key.data(), key.size()) == 0) {
+	    s->last_used = ++header->clock;
+	    ++header->hits;
+	    value.assign(s->data() + s->key_len, s->value_len);
+	    return true;
+	}
+    }
+    ++header->misses;
+    return false;
+}
+
+void
+RemoteCache::insert(const string& key, const string& value)
+{
+    if (!header)
+	return;
+    size_t size = key.size() + value.size();
+    if (size > slot_size - sizeof(Slot))
+	return;
+    size_t h = hash<string>()(key);
+    size_t first = h % n_sets * ways;
+    CacheLock lock(header->lock);
+    if (!lock)
+	return;
+    Slot* victim = NULL;
+    for (size_t i = first; i != first + ways; ++i) {
+	Slot* s = slot(i);
+	if (s->last_used && s->hash == h && s->key_len == key.size() &&
+	    memcmp(s->data(), key.data(), key.size()) == 0) {
+	    // Another connection got there first.
+	    return;
+	}
+	if (!victim || s->last_used < victim->last_used)
+	    victim = s;
+    }
+    if (victim->last_used) {
+	--header->entries;
+	header->size -= victim->key_len + victim->value_len;
+    }
+    victim->last_used = ++header->clock;
+    victim->hash = h;
+    victim->key_len = key.size();
+    victim->value_len = value.size();
+    memcpy(victim->data(), key.data(), key.size());
+    memcpy(victim->data() + key.size(), value.data(), value.size());
+    ++header->entries;
+    header->size += size;
+}
+
+// The counters are read without taking the lock as they're only reported
+// for information.
+
+size_t
+RemoteCache::get_entries() const
+{
+    return header ? header->entries : 0;
+}
+
+size_t
+RemoteCache::get_size() const
+{
+    return header ? header->size : 0;
+}
+
+unsigned long long
+RemoteCache::get_hits() const
+{
+    return header ? header->hits : 0;
+}
+
+unsigned long long
+RemoteCache::get_misses() const
+{
+    return header ? header->misses : 0;
+}
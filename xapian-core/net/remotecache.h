@@ -0,0 +1,120 @@
+/** @file remotecache.h
+ * @brief Cache of replies for the remote server, shared between connections
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_REMOTECACHE_H
+#define XAPIAN_INCLUDED_REMOTECACHE_H
+
+#include <string>
+
+/** Cache of serialised replies, keyed by the serialised request.
+ *
+ *  RemoteServer uses this to avoid rerunning identical queries against a
+ *  read-only database.  The cache lives in a single block of memory which is
+ *  mapped shared, so a RemoteCache created before xapian-tcpsrv forks to
+ *  handle each connection is used by all of them (on platforms where
+ *  connections are handled by threads it's simply shared by the threads).
+ *
+ *  Nothing is ever explicitly removed, so keys need to identify the database
+ *  revision - entries for old revisions just get evicted in time.
+ *
+ *  The memory is split into fixed size slots, in sets of a few slots.  A key
+ *  can only be stored in the set its hash selects, and the least recently
+ *  used slot in that set is replaced.  Replies which don't fit in a slot
+ *  (together with their key) aren't cached.
+ *
+ *  Access is serialised by a spinlock in the shared memory.  If that can't
+ *  be acquired after a bounded number of attempts the lookup is treated as
+ *  a miss (and an insert is skipped) so a busy or broken cache can't stop
+ *  the server answering queries.
+ */
+class RemoteCache {
+    struct Header;
+
+    struct Slot;
+
+    /// Offset of the first slot from the start of the shared memory.
+    static const size_t SLOTS_OFFSET;
+
+    /// The shared memory, which starts with a Header.
+    Header* header = NULL;
+
+    /// Size of the shared memory in bytes.
+    size_t mem_size = 0;
+
+    /// Number of sets of slots.
+    size_t n_sets = 0;
+
+    /// Number of slots in each set.
+    size_t ways = 0;
+
+    /// Size of each slot in bytes (including the Slot header).
+    size_t slot_size;
+
+    /// Maximum size requested.
+    size_t max_size;
+
+    /// Return slot @a i.
+    Slot* slot(size_t i) const;
+
+    /// Don't allow assignment.
+    RemoteCache& operator=(const RemoteCache&) = delete;
+
+    /// Don't allow copying.
+    RemoteCache(const RemoteCache&) = delete;
+
+  public:
+    /** Construct a cache.
+     *
+     *  @param max_size_	Maximum size in bytes (0 disables caching).
+     *  @param slot_size_	Size of each slot in bytes, which limits the
+     *				size of a key and reply which can be cached.
+     */
+    RemoteCache(size_t max_size_, size_t slot_size_);
+
+    ~RemoteCache();
+
+    /// Is caching enabled?
+    bool enabled() const { return header != NULL; }
+
+    /** Look up a cached reply.
+     *
+     *  @param key	The key to look up.
+     *  @param value	Set to the cached reply if found.
+     *
+     *  @return true if @a key was found.
+     */
+    bool find(const std::string& key, std::string& value);
+
+    /** Add a reply to the cache.
+     *
+     *  Replies which are too large to cache are ignored.
+     */
+    void insert(const std::string& key, const std::string& value);
+
+    size_t get_entries() const;
+
+    size_t get_size() const;
+
+    size_t get_max_size() const { return max_size; }
+
+    unsigned long long get_hits() const;
+
+    unsigned long long get_misses() const;
+};
+
+#endif // XAPIAN_INCLUDED_REMOTECACHE_H
@@ -37,11 +37,13 @@
 #include <cerrno>
 #include <climits>
 #include <cstdint>
+#include <memory>
 #include <string>
 #ifdef __WIN32__
 # include <type_traits>
 #endif
 
+#include "compression_stream.h"
 #include "debuglog.h"
 #include "fd.h"
 #include "filetests.h"
@@ -56,6 +58,15 @@ using namespace std;
 
 #define CHUNKSIZE 4096
 
+/// Bit set in the type code of a compressed message.
+#define COMPRESSED_MESSAGE 0x80
+
+/// Messages shorter than this aren't worth trying to compress.
+#define COMPRESS_MIN_SIZE 1024
+
+/// Size of the blocks a file is compressed in.
+#define COMPRESS_BLOCK_SIZE 65536
+
 [[noreturn]]
 static void
 throw_database_closed()
@@ -70,12 +81,6 @@ throw_network_error_insane_message_length()
     throw Xapian::NetworkError("Insane message length specified!");
 }
 
-[[noreturn]]
-static void
-throw_timeout(const char* msg, const string& context)
-{
-    throw Xapian::NetworkTimeoutError(msg, context);
-}
 
 #ifdef __WIN32__
 static inline void
@@ -100,13 +105,21 @@ RemoteConnection::RemoteConnection(int fdin_, int fdout_,
 #endif
 }
 
-#ifdef __WIN32__
 RemoteConnection::~RemoteConnection()
 {
+#ifdef __WIN32__
     if (overlapped.hEvent)
 	CloseHandle(overlapped.hEvent);
-}
 #endif
+}
+
+CompressionStream&
+RemoteConnection::get_zlib()
+{
+    if (!zlib)
+	zlib.reset(new CompressionStream);
+    return *zlib;
+}
 
 bool
 RemoteConnection::read_at_least(size_t min_len, double end_time)
@@ -130,7 +143,7 @@ RemoteConnection::read_at_least(size_t min_len, double end_time)
 	    waitrc = WaitForSingleObject(overlapped.hEvent, calc_read_wait_msecs(end_time));
 	    if (waitrc != WAIT_OBJECT_0) {
 		LOGLINE(REMOTE, "read: timeout has expired");
-		throw_timeout("Timeout expired while trying to read", context);
+		throw_timeout("Timeout expired while trying to read");
 	    }
 	    // Get the final result of the read.
 	    if (!GetOverlappedResult(hin, &overlapped, &received, FALSE))
@@ -182,7 +195,7 @@ RemoteConnection::read_at_least(size_t min_len, double end_time)
 	    // Check if the timeout has expired.
 	    if (time_diff < 0) {
 		LOGLINE(REMOTE, "read: timeout has expired");
-		throw_timeout("Timeout expired while trying to read", context);
+		throw_timeout("Timeout expired while trying to read");
 	    }
 
 	    // Wait until there is data, an error, or the timeout is reached.
@@ -194,7 +207,7 @@ RemoteConnection::read_at_least(size_t min_len, double end_time)
 	    if (poll_result > 0) break;
 
 	    if (poll_result == 0)
-		throw_timeout("Timeout expired while trying to read", context);
+		throw_timeout("Timeout expired while trying to read");
 
 	    // EINTR means poll was interrupted by a signal.  EAGAIN means that
 	    // allocation of internal data structures failed.
@@ -217,7 +230,7 @@ RemoteConnection::read_at_least(size_t min_len, double end_time)
 	    if (select_result > 0) break;
 
 	    if (select_result == 0)
-		throw_timeout("Timeout expired while trying to read", context);
+		throw_timeout("Timeout expired while trying to read");
 
 	    // EINTR means select was interrupted by a signal.  The Linux
 	    // select(2) man page says: "Portable programs may wish to check
@@ -242,9 +255,30 @@ RemoteConnection::send_message(char type, const string &message,
 	throw_database_closed();
 
     string header;
+    if (compress && message.size() >= COMPRESS_MIN_SIZE) {
+	size_t size = message.size();
+	const char* p = get_zlib().compress(message.data(), &size);
+	if (p) {
+	    // Send as a single compressed block.
+	    header += char(type | COMPRESSED_MESSAGE);
+	    header += encode_length(size * 2 + 1);
+	    string data(p, size);
+	    data += encode_length(0);
+	    send_data(header, data, end_time);
+	    return;
+	}
+    }
+
     header += type;
     header += encode_length(message.size());
+    send_data(header, message, end_time);
+}
 
+void
+RemoteConnection::send_data(const string& header, const string& message,
+			    double end_time)
+{
+    LOGCALL_VOID(REMOTE, "RemoteConnection::send_data", header | message | end_time);
 #ifdef __WIN32__
     HANDLE hout = fd_to_handle(fdout);
     const string * str = &header;
@@ -262,7 +296,7 @@ RemoteConnection::send_message(char type, const string &message,
 	    waitrc = WaitForSingleObject(overlapped.hEvent, calc_read_wait_msecs(end_time));
 	    if (waitrc != WAIT_OBJECT_0) {
 		LOGLINE(REMOTE, "write: timeout has expired");
-		throw_timeout("Timeout expired while trying to write", context);
+		throw_timeout("Timeout expired while trying to write");
 	    }
 	    // Get the final result.
 	    if (!GetOverlappedResult(hout, &overlapped, &n, FALSE))
@@ -316,7 +350,7 @@ RemoteConnection::send_message(char type, const string &message,
 	double time_diff = end_time - now;
 	if (time_diff < 0) {
 	    LOGLINE(REMOTE, "write: timeout has expired");
-	    throw_timeout("Timeout expired while trying to write", context);
+	    throw_timeout("Timeout expired while trying to write");
 	}
 
 	// Wait until there is space or the timeout is reached.
@@ -356,7 +390,7 @@ RemoteConnection::send_message(char type, const string &message,
 	}
 
 	if (result == 0)
-	    throw_timeout("Timeout expired while trying to write", context);
+	    throw_timeout("Timeout expired while trying to write");
     }
 #endif
 }
@@ -368,6 +402,37 @@ RemoteConnection::send_file(char type, int fd, double end_time)
     if (fdout == -1)
 	throw_database_closed();
 
+    if (compress) {
+	// Send the file as a compressed message, compressing each block
+	// which gets smaller.
+	unique_ptr<char[]> buf(new char[COMPRESS_BLOCK_SIZE]);
+	string header(1, char(type | COMPRESSED_MESSAGE));
+	string data;
+	while (true) {
+	    ssize_t res;
+	    do {
+		res = read(fd, buf.get(), COMPRESS_BLOCK_SIZE);
+	    } while (res < 0 && errno == EINTR);
+	    if (res < 0) throw Xapian::NetworkError("read failed", errno);
+	    if (res == 0) break;
+
+	    size_t size = size_t(res);
+	    const char* p = get_zlib().compress(buf.get(), &size);
+	    if (p) {
+		header += encode_length(size * 2 + 1);
+		data.assign(p, size);
+	    } else {
+		header += encode_length(size * 2);
+		data.assign(buf.get(), size);
+	    }
+	    send_data(header, data, end_time);
+	    header.resize(0);
+	}
+	header += encode_length(0);
+	send_data(header, string(), end_time);
+	return;
+    }
+
     off_t size = file_size(fd);
     if (errno)
 	throw Xapian::NetworkError("Couldn't stat file to send", errno);
@@ -399,7 +464,7 @@ RemoteConnection::send_file(char type, int fd, double end_time)
 	    waitrc = WaitForSingleObject(overlapped.hEvent, calc_read_wait_msecs(end_time));
 	    if (waitrc != WAIT_OBJECT_0) {
 		LOGLINE(REMOTE, "write: timeout has expired");
-		throw_timeout("Timeout expired while trying to write", context);
+		throw_timeout("Timeout expired while trying to write");
 	    }
 	    // Get the final result.
 	    if (!GetOverlappedResult(hout, &overlapped, &n, FALSE))
@@ -467,7 +532,7 @@ RemoteConnection::send_file(char type, int fd, double end_time)
 	double time_diff = end_time - now;
 	if (time_diff < 0) {
 	    LOGLINE(REMOTE, "write: timeout has expired");
-	    throw_timeout("Timeout expired while trying to write", context);
+	    throw_timeout("Timeout expired while trying to write");
 	}
 
 	// Wait until there is space or the timeout is reached.
@@ -507,7 +572,7 @@ RemoteConnection::send_file(char type, int fd, double end_time)
 	}
 
 	if (result == 0)
-	    throw_timeout("Timeout expired while trying to write", context);
+	    throw_timeout("Timeout expired while trying to write");
     }
 #endif
 }
@@ -519,10 +584,108 @@ RemoteConnection::sniff_next_message_type(double end_time)
     if (fdin == -1)
 	throw_database_closed();
 
+    if (!finish_compressed_message(end_time))
+	RETURN(-1);
     if (!read_at_least(1, end_time))
 	RETURN(-1);
     unsigned char type = buffer[0];
-    RETURN(type);
+    RETURN(type & ~COMPRESSED_MESSAGE);
+}
+
+bool
+RemoteConnection::get_length(size_t& len, double end_time)
+{
+    if (!read_at_least(1, end_time))
+	return false;
+    len = static_cast<unsigned char>(buffer[0]);
+    if (len != 0xff) {
+	buffer.erase(0, 1);
+	return true;
+    }
+    len = 0;
+    size_t i = 1;
+    unsigned char ch;
+    int shift = 0;
+    do {
+	if (shift > 28) {
+	    // Something is very wrong...
+	    throw_network_error_insane_message_length();
+	}
+	if (!read_at_least(i + 1, end_time))
+	    return false;
+	ch = buffer[i++];
+	len |= size_t(ch & 0x7f) << shift;
+	shift += 7;
+    } while ((ch & 0x80) == 0);
+    len += 255;
+    buffer.erase(0, i);
+    return true;
+}
+
+int
+RemoteConnection::get_compressed_data(string& result, size_t at_least,
+				      double end_time)
+{
+    LOGCALL(REMOTE, int, "RemoteConnection::get_compressed_data", result | at_least | end_time);
+    while (result.size() < at_least) {
+	if (!inflated.empty()) {
+	    size_t n = at_least - result.size();
+	    if (n >= inflated.size()) {
+		result += inflated;
+		inflated.resize(0);
+	    } else {
+		result.append(inflated, 0, n);
+		inflated.erase(0, n);
+	    }
+	    continue;
+	}
+
+	if (!reading_compressed)
+	    RETURN(0);
+
+	size_t len;
+	if (!get_length(len, end_time))
+	    RETURN(-1);
+	if (len == 0) {
+	    reading_compressed = false;
+	    RETURN(0);
+	}
+	size_t block_len = len >> 1;
+	if (!read_at_least(block_len, end_time))
+	    RETURN(-1);
+	if (len & 1) {
+	    bool done;
+	    try {
+		CompressionStream& z = get_zlib();
+		z.decompress_start();
+		done = z.decompress_chunk(buffer.data(), int(block_len),
+					  inflated);
+	    } catch (const Xapian::DatabaseError & e) {
+		// CompressionStream is shared with the backends, but here bad
+		// data means the connection is at fault, not a database.
+		throw Xapian::NetworkError(e.get_msg(), context);
+	    }
+	    if (!done)
+		throw Xapian::NetworkError("Compressed block truncated",
+					   context);
+	} else {
+	    inflated.assign(buffer, 0, block_len);
+	}
+	buffer.erase(0, block_len);
+    }
+    RETURN(1);
+}
+
+bool
+RemoteConnection::finish_compressed_message(double end_time)
+{
+    inflated.resize(0);
+    while (reading_compressed) {
+	string discard;
+	if (get_compressed_data(discard, CHUNKSIZE, end_time) < 0)
+	    return false;
+    }
+    return true;
 }
 
 int
@@ -532,8 +695,19 @@ RemoteConnection::get_message(string &result, double end_time)
     if (fdin == -1)
 	throw_database_closed();
 
+    if (!finish_compressed_message(end_time))
+	RETURN(-1);
     if (!read_at_least(2, end_time))
 	RETURN(-1);
+    if (buffer[0] & COMPRESSED_MESSAGE) {
+	unsigned char type = buffer[0] & ~COMPRESSED_MESSAGE;
+	buffer.erase(0, 1);
+	reading_compressed = true;
+	result.resize(0);
+	if (get_compressed_data(result, size_t(-1), end_time) < 0)
+	    RETURN(-1);
+	RETURN(type);
+    }
     size_t len = static_cast<unsigned char>(buffer[1]);
     if (!read_at_least(len + 2, end_time))
 	RETURN(-1);
@@ -574,8 +748,19 @@ RemoteConnection::get_message_chunked(double end_time)
     if (fdin == -1)
 	throw_database_closed();
 
+    if (!finish_compressed_message(end_time))
+	RETURN(-1);
     if (!read_at_least(2, end_time))
 	RETURN(-1);
+    if (buffer[0] & COMPRESSED_MESSAGE) {
+	unsigned char type = buffer[0] & ~COMPRESSED_MESSAGE;
+	buffer.erase(0, 1);
+	reading_compressed = true;
+	// Once the compressed data ends, get_message_chunk() will see no data
+	// left.
+	chunked_data_left = 0;
+	RETURN(type);
+    }
     uint_least64_t len = static_cast<unsigned char>(buffer[1]);
     if (len != 0xff) {
 	chunked_data_left = off_t(len);
@@ -630,6 +815,8 @@ RemoteConnection::get_message_chunk(string &result, size_t at_least,
 	throw_database_closed();
 
     if (at_least <= result.size()) RETURN(true);
+    if (reading_compressed || !inflated.empty())
+	RETURN(get_compressed_data(result, at_least, end_time));
     at_least -= result.size();
 
     bool read_enough = (off_t(at_least) <= chunked_data_left);
@@ -674,6 +861,18 @@ RemoteConnection::receive_file(const string &file, double end_time)
 	throw Xapian::NetworkError("Couldn't open file for writing: " + file, errno);
 
     int type = get_message_chunked(end_time);
+    if (reading_compressed) {
+	string data;
+	int res;
+	do {
+	    res = get_compressed_data(data, COMPRESS_BLOCK_SIZE, end_time);
+	    if (res < 0)
+		RETURN(-1);
+	    write_all(fd, data.data(), data.size());
+	    data.resize(0);
+	} while (res);
+	RETURN(type);
+    }
     do {
 	off_t min_read = min(chunked_data_left, off_t(CHUNKSIZE));
 	if (!read_at_least(min_read, end_time))
@@ -731,6 +930,15 @@ RemoteConnection::shutdown()
     }
 }
 
+void
+RemoteConnection::throw_timeout(const char* msg)
+{
+    // The other end may still send the rest of the reply, or a reply to the
+    // message we were sending, so the connection can't be reused.
+    timed_out = true;
+    throw Xapian::NetworkTimeoutError(msg, context);
+}
+
 void
 RemoteConnection::do_close()
 {
@@ -751,6 +959,52 @@ RemoteConnection::do_close()
     }
 }
 
+int
+RemoteConnection::release()
+{
+    LOGCALL(REMOTE, int, "RemoteConnection::release", NO_ARGS);
+
+    bool idle = (fdin >= 0 && fdin == fdout && !timed_out &&
+		 buffer.empty() && chunked_data_left == 0 &&
+		 !reading_compressed);
+#ifndef __WIN32__
+    if (idle) {
+	// If a read wouldn't block, there's unexpected data waiting, or the
+	// other end has closed the connection.
+# ifdef HAVE_POLL
+	struct pollfd fds;
+	fds.fd = fdin;
+	fds.events = POLLIN;
+	int res;
+	do {
+	    res = poll(&fds, 1, 0);
+	} while (res < 0 && (errno == EINTR || errno == EAGAIN));
+	idle = (res == 0);
+# else
+	if (fdin < FD_SETSIZE) {
+	    fd_set fdset;
+	    FD_ZERO(&fdset);
+	    FD_SET(fdin, &fdset);
+	    struct timeval tv = { 0, 0 };
+	    int res;
+	    do {
+		res = select(fdin + 1, &fdset, 0, 0, &tv);
+	    } while (res < 0 && (errno == EINTR || errno == EAGAIN));
+	    idle = (res == 0);
+	}
+# endif
+    }
+#endif
+
+    if (!idle) {
+	do_close();
+	RETURN(-1);
+    }
+    int fd = fdin;
+    fdin = fdout = -1;
+    RETURN(fd);
+}
+
 #ifdef __WIN32__
 DWORD
 RemoteConnection::calc_read_wait_msecs(double end_time)
@@ -763,7 +1017,7 @@ RemoteConnection::calc_read_wait_msecs(double end_time)
 
     // DWORD is unsigned, so we mustn't try and return a negative value.
     if (time_diff < 0.0) {
-	throw_timeout("Timeout expired before starting read", context);
+	throw_timeout("Timeout expired before starting read");
     }
     return static_cast<DWORD>(time_diff * 1000.0);
 }
@@ -22,6 +22,7 @@
 #define XAPIAN_INCLUDED_REMOTECONNECTION_H
 
 #include <cerrno>
+#include <memory>
 #include <string>
 
 #include "remoteprotocol.h"
@@ -158,6 +159,8 @@ inline int eai_to_xapian(int e) {
     return e;
 }
 
+class CompressionStream;
+
 /** A RemoteConnection object provides a bidirectional connection to another
  *  RemoteConnection object on a remote machine.
  *
@@ -191,7 +194,71 @@ class RemoteConnection {
     std::string buffer;
 
     /// Remaining bytes of message data still to come over fdin for a chunked read.
-    off_t chunked_data_left;
+    off_t chunked_data_left = 0;
+
+    /// Compress large messages and files which we send?
+    bool compress = false;
+
+    /// Are we part way through reading a compressed message?
+    bool reading_compressed = false;
+
+    /** Has a read or write timed out?
+     *
+     *  If so, a reply may still be on its way, so the connection mustn't be
+     *  reused.
+     */
+    bool timed_out = false;
+
+    /// Data from the current compressed block which hasn't been returned yet.
+    std::string inflated;
+
+    /// zlib wrapper, created when first needed.
+    std::unique_ptr<CompressionStream> zlib;
+
+    /// Return zlib, creating it if necessary.
+    CompressionStream& get_zlib();
+
+    /// Throw NetworkTimeoutError, and note that we've timed out.
+    [[noreturn]]
+    void throw_timeout(const char* msg);
+
+    /** Read an encoded length from the start of buffer and remove it.
+     *
+     *  @return false on EOF, otherwise true.
+     */
+    bool get_length(size_t& len, double end_time);
+
+    /** Read data from a compressed message.
+     *
+     *  A compressed message has the top bit set in its type code, and its
+     *  data is a sequence of blocks, each preceded by an encoded length which
+     *  is twice the block's size, plus one if the block is compressed.  The
+     *  sequence is ended by an encoded length of 0.
+     *
+     *  @param result	String to append data to.
+     *  @param at_least	Read until result has at least this many bytes.
+     *  @param end_time	Time to give up.
+     *
+     *  @return 1 if at_least bytes are now in result; 0 if the message ended
+     *		first; -1 on EOF.
+     */
+    int get_compressed_data(std::string& result, size_t at_least,
+			    double end_time);
+
+    /** Skip any unread data from a compressed message.
+     *
+     *  @return false on EOF, otherwise true.
+     */
+    bool finish_compressed_message(double end_time);
+
+    /** Write header and then data to fdout.
+     *
+     *  @param header	First data to write.
+     *  @param data	Data to write after header.
+     *  @param end_time	Time to give up.
+     */
+    void send_data(const std::string& header, const std::string& data,
+		   double end_time);
 
     /** Read until there are at least min_len bytes in buffer.
      *
@@ -234,10 +301,19 @@ class RemoteConnection {
     RemoteConnection(int fdin_, int fdout_,
 		     const std::string & context_ = std::string());
 
-#ifdef __WIN32__
-    /// Destructor
+    /// Destructor.
     ~RemoteConnection();
-#endif
+
+    /** Set whether to compress messages and files we send.
+     *
+     *  Compressed data can always be received, so this only needs to be
+     *  agreed with the other end to the extent that it must understand the
+     *  compressed message format.
+     */
+    void set_compression(bool compress_) { compress = compress_; }
+
+    /// Are we compressing messages and files we send?
+    bool get_compression() const { return compress; }
 
     /** Return the underlying fd this remote connection reads from. */
     int get_read_fd() const { return fdin; }
@@ -358,6 +434,17 @@ class RemoteConnection {
 
     /** Close the connection. */
     void do_close();
+
+    /** Give up the connection without closing it, so it can be reused.
+     *
+     *  This is only possible if the same fd is used in both directions, and
+     *  the connection is idle - i.e. nothing has been received which hasn't
+     *  been read yet, and no read or write has timed out (so no reply can
+     *  still be on its way).  Otherwise the connection is closed.
+     *
+     *  @return The fd, or -1 if the connection couldn't be released.
+     */
+    int release();
 };
 
 /** RemoteConnection which owns its own fd(s).
@@ -54,7 +54,14 @@
 // 41: pre-1.5.0 Changed REPLY_ALLTERMS, REPLY_METADATAKEYLIST, REPLY_TERMLIST.
 // 42: pre-1.5.0 Use little-endian IEEE for doubles
 // 43: 1.5.0 REPLY_DONE sent for 5 more messages
-#define XAPIAN_REMOTE_PROTOCOL_MAJOR_VERSION 43
+// 44: 1.5.0 MSG_QUERY passes the pruning factor
+// 45: 1.5.0 MSG_QUERY passes hard time limit flag; MSet has partial flag
+// 46: 1.5.0 MSG_POSTLIST fetches postings in chunks
+// 47: 1.5.0 Optional compression of messages
+// 48: 1.5.0 MSG_QUERY can ask for the MSet using the shard's own stats
+// 49: 1.5.0 MSG_STATUS reports the server's cache statistics
+// 50: 1.5.0 MSG_DOCUMENTS fetches several documents in one round trip
+#define XAPIAN_REMOTE_PROTOCOL_MAJOR_VERSION 50
 #define XAPIAN_REMOTE_PROTOCOL_MINOR_VERSION 0
 
 /** Message types (client -> server).
@@ -95,6 +102,8 @@ enum message_type {
     MSG_FREQS,			// Get termfreq and collfreq
     MSG_UNIQUETERMS,		// Get number of unique terms in doc
     MSG_POSITIONLISTCOUNT,	// Get PositionList length
+    MSG_STATUS,			// Get server status
+    MSG_DOCUMENTS,		// Get several documents
     MSG_MAX
 };
 
@@ -115,7 +124,7 @@ enum reply_type {
     REPLY_TERMLIST,		// Get Termlist
     REPLY_POSITIONLIST,		// Get PositionList
     REPLY_POSTLISTSTART,	// Start of a postlist
-    REPLY_POSTLISTITEM,		// Item in body of a postlist
+    REPLY_POSTLISTCHUNK,	// Chunk of postings in a postlist
     REPLY_VALUE,		// Document Value
     REPLY_ADDDOCUMENT,		// Add Document
     REPLY_RESULTS,		// Results (MSet)
@@ -126,6 +135,8 @@ enum reply_type {
     REPLY_POSITIONLISTCOUNT,	// Get PositionList length
     REPLY_REMOVESPELLING,	// Remove a spelling
     REPLY_TERMLIST0,		// Header for get Termlist
+    REPLY_STATUS,		// Server status
+    REPLY_DOCUMENTS,		// Get several documents
     REPLY_MAX
 };
 
@@ -38,6 +38,8 @@
 
 #include "api/msetinternal.h"
 #include "api/termlist.h"
+#include "backends/databaseinternal.h"
+#include "backends/multi/multi_database.h"
 #include "length.h"
 #include "matcher/matcher.h"
 #include "omassert.h"
@@ -64,7 +66,7 @@ struct ConnectionClosed { };
 RemoteServer::RemoteServer(const vector<string>& dbpaths,
 			   int fdin_, int fdout_,
 			   double active_timeout_, double idle_timeout_,
-			   bool writable_)
+			   bool writable_, bool compress_)
     : RemoteConnection(fdin_, fdout_, string()),
       db(NULL), wdb(NULL), writable(writable_),
       active_timeout(active_timeout_), idle_timeout(idle_timeout_)
@@ -105,6 +107,12 @@ RemoteServer::RemoteServer(const vector<string>& dbpaths,
 	throw Xapian::NetworkError("Couldn't set SIGPIPE to SIG_IGN", errno);
 #endif
 
+    // The greeting tells the client whether we compress, and it can then
+    // compress what it sends too.
+    set_compression(compress_);
+
+    update_cache_revision();
+
     // Send greeting message.
     msg_update(string());
 }
@@ -115,6 +123,40 @@ RemoteServer::~RemoteServer()
     // wdb is either NULL or equal to db, so we shouldn't delete it too!
 }
 
+void
+RemoteServer::update_cache_revision()
+{
+    cache_revision.resize(0);
+    if (wdb)
+	return;
+    const Xapian::Database::Internal* internal = db->internal.get();
+    size_t n_shards = internal->size();
+    for (size_t i = 0; i != n_shards; ++i) {
+	const Xapian::Database::Internal* shard = internal;
+	if (n_shards > 1)
+	    shard = static_cast<const MultiDatabase*>(internal)->shards[i];
+	Xapian::rev revision;
+	if (!shard->get_cache_revision(revision)) {
+	    cache_revision.resize(0);
+	    return;
+	}
+	// Include the UUID so that a database replaced by a different one
+	// (e.g. by replication) doesn't match.
+	string uuid = shard->get_uuid();
+	cache_revision += encode_length(uuid.size());
+	cache_revision += uuid;
+	cache_revision += encode_length(revision);
+    }
+}
+
+void
+RemoteServer::set_cache_size(size_t size)
+{
+    own_stats_cache.reset(new RemoteCache(size, STATS_CACHE_SLOT_SIZE));
+    own_results_cache.reset(new RemoteCache(size, RESULTS_CACHE_SLOT_SIZE));
+    set_caches(own_stats_cache.get(), own_results_cache.get());
+}
+
 message_type
 RemoteServer::get_message(double timeout, string & result,
 			  message_type required_type)
@@ -171,6 +213,9 @@ RemoteServer::run()
 		case MSG_DOCUMENT:
 		    msg_document(message);
 		    continue;
+		case MSG_DOCUMENTS:
+		    msg_documents(message);
+		    continue;
 		case MSG_TERMEXISTS:
 		    msg_termexists(message);
 		    continue;
@@ -252,6 +297,9 @@ RemoteServer::run()
 		case MSG_POSITIONLISTCOUNT:
 		    msg_positionlistcount(message);
 		    continue;
+		case MSG_STATUS:
+		    msg_status(message);
+		    continue;
 		default: {
 		    // MSG_GETMSET - used during a conversation.
 		    // MSG_SHUTDOWN - handled by get_message().
@@ -392,26 +440,42 @@ RemoteServer::msg_positionlistcount(const string &message)
 void
 RemoteServer::msg_postlist(const string &message)
 {
-    const string & term = message;
-
-    Xapian::doccount termfreq = db->get_termfreq(term);
-    Xapian::termcount collfreq = db->get_collection_freq(term);
-    send_message(REPLY_POSTLISTSTART, encode_length(termfreq) + encode_length(collfreq));
+    const char *p = message.data();
+    const char *p_end = p + message.size();
+    Xapian::docid did;
+    decode_length(&p, p_end, did);
+    Xapian::doccount max_postings;
+    decode_length(&p, p_end, max_postings);
+    if (max_postings == 0)
+	throw Xapian::NetworkError("Bad MSG_POSTLIST");
+    string term(p, p_end);
+
+    if (did == 0) {
+	Xapian::doccount termfreq = db->get_termfreq(term);
+	Xapian::termcount collfreq = db->get_collection_freq(term);
+	send_message(REPLY_POSTLISTSTART,
+		     encode_length(termfreq) + encode_length(collfreq));
+	did = 1;
+    }
 
-    Xapian::docid lastdocid = 0;
+    // The first byte is set to '1' below if there are more postings.
+    string reply(1, '0');
+    Xapian::docid lastdocid = did - 1;
     const Xapian::PostingIterator end = db->postlist_end(term);
-    for (Xapian::PostingIterator i = db->postlist_begin(term);
-	 i != end; ++i) {
-
+    Xapian::PostingIterator i = db->postlist_begin(term);
+    i.skip_to(did);
+    for (Xapian::doccount n = 0; i != end; ++i, ++n) {
+	if (n == max_postings) {
+	    reply[0] = '1';
+	    break;
+	}
 	Xapian::docid newdocid = *i;
-	string reply = encode_length(newdocid - lastdocid - 1);
+	reply += encode_length(newdocid - lastdocid - 1);
 	reply += encode_length(i.get_wdf());
-
-	send_message(REPLY_POSTLISTITEM, reply);
 	lastdocid = newdocid;
     }
 
-    send_message(REPLY_DONE, string());
+    send_message(REPLY_POSTLISTCHUNK, reply);
 }
 
 void
@@ -445,6 +509,7 @@ RemoteServer::msg_reopen(const string & msg)
 	send_message(REPLY_DONE, string());
 	return;
     }
+    update_cache_revision();
     msg_update(msg);
 }
 
@@ -463,6 +528,7 @@ RemoteServer::msg_update(const string &)
     message += encode_length(doclen_lb);
     message += encode_length(db->get_doclength_upper_bound() - doclen_lb);
     message += (db->has_positions() ? '1' : '0');
+    message += (get_compression() ? '1' : '0');
     message += encode_length(db->get_total_length());
     string uuid = db->get_uuid();
     message += uuid;
@@ -475,6 +541,19 @@ RemoteServer::msg_query(const string &message_in)
     const char *p = message_in.c_str();
     const char *p_end = p + message_in.size();
 
+    // If the client wants us to use our own statistics it sends the MSet
+    // range now, and we send back the MSet without exchanging statistics.
+    if (p == p_end || *p < '0' || *p > '1') {
+	throw Xapian::NetworkError("bad message (shard_stats)");
+    }
+    bool shard_stats = (*p++ == '1');
+    Xapian::doccount first = 0, maxitems = 0, check_at_least = 0;
+    if (shard_stats) {
+	decode_length(&p, p_end, first);
+	decode_length(&p, p_end, maxitems);
+	decode_length(&p, p_end, check_at_least);
+    }
+
     // Unserialise the Query.
     size_t len;
     decode_length_and_check(&p, p_end, len);
@@ -514,6 +593,16 @@ RemoteServer::msg_query(const string &message_in)
 
     double time_limit = unserialise_double(&p, p_end);
 
+    if (p == p_end || *p < '0' || *p > '1') {
+	throw Xapian::NetworkError("bad message (hard_time_limit)");
+    }
+    bool hard_time_limit(*p++ != '0');
+
+    double pruning_factor = unserialise_double(&p, p_end);
+    if (!(pruning_factor >= 1.0)) {
+	throw Xapian::NetworkError("bad message (pruning_factor)");
+    }
+
     int percent_threshold = *p++;
     if (percent_threshold < 0 || percent_threshold > 100) {
 	throw Xapian::NetworkError("bad message (percent_threshold)");
@@ -564,41 +653,98 @@ RemoteServer::msg_query(const string &message_in)
 	p += len;
     }
 
-    Xapian::Weight::Internal local_stats;
-    Matcher matcher(*db, query, qlen, &rset, local_stats, *wt,
-		    false, false,
-		    collapse_key, collapse_max,
-		    percent_threshold, weight_threshold,
-		    order, sort_key, sort_by, sort_value_forward, time_limit,
-		    matchspies);
-
-    send_message(REPLY_STATS, serialise_stats(local_stats));
+    // The replies only depend on the message and the database revision,
+    // unless a time limit might cut the match short.
+    bool cacheable = (wdb == NULL && time_limit <= 0.0 &&
+		      !cache_revision.empty());
+
+    // Only set up the match if we need to.
+    unique_ptr<Xapian::Weight::Internal> local_stats;
+    unique_ptr<Matcher> matcher;
+    auto get_matcher = [&]() -> Matcher& {
+	if (!matcher) {
+	    local_stats.reset(new Xapian::Weight::Internal);
+	    matcher.reset(new Matcher(*db, query, qlen, &rset, *local_stats,
+				      *wt, false, false,
+				      collapse_key, collapse_max,
+				      percent_threshold, weight_threshold,
+				      order, sort_key, sort_by,
+				      sort_value_forward, time_limit,
+				      hard_time_limit, pruning_factor,
+				      matchspies));
+	}
+	return *matcher;
+    };
 
     string message;
-    get_message(active_timeout, message, MSG_GETMSET);
-    p = message.c_str();
-    p_end = p + message.size();
+    string results_key;
+    if (shard_stats) {
+	if (cacheable && results_cache) {
+	    results_key = cache_revision;
+	    results_key += message_in;
+	}
+    } else {
+	string stats_key;
+	if (cacheable && stats_cache) {
+	    stats_key = cache_revision;
+	    stats_key += message_in;
+	}
+	if (!stats_key.empty() && stats_cache->find(stats_key, message)) {
+	    send_message(REPLY_STATS, message);
+	} else {
+	    (void)get_matcher();
+	    message = serialise_stats(*local_stats);
+	    if (!stats_key.empty())
+		stats_cache->insert(stats_key, message);
+	    send_message(REPLY_STATS, message);
+	}
 
-    Xapian::termcount first;
-    decode_length(&p, p_end, first);
-    Xapian::termcount maxitems;
-    decode_length(&p, p_end, maxitems);
+	get_message(active_timeout, message, MSG_GETMSET);
+	if (cacheable && results_cache) {
+	    // Keys for queries which asked for the shard's own statistics are
+	    // just cache_revision + message_in, and message_in starts with '1'.
+	    results_key = cache_revision;
+	    results_key += '0';
+	    results_key += encode_length(message_in.size());
+	    results_key += message_in;
+	    results_key += message;
+	}
+    }
 
-    Xapian::termcount check_at_least;
-    decode_length(&p, p_end, check_at_least);
+    if (!results_key.empty()) {
+	string cached;
+	if (results_cache->find(results_key, cached)) {
+	    send_message(REPLY_RESULTS, cached);
+	    return;
+	}
+    }
 
-    message.erase(0, message.size() - (p_end - p));
-    unique_ptr<Xapian::Weight::Internal> total_stats(new Xapian::Weight::Internal);
-    unserialise_stats(message, *total_stats);
-    total_stats->set_bounds_from_db(*db);
+    Matcher& matcher_ref = get_matcher();
+    unique_ptr<Xapian::Weight::Internal> total_stats;
+    if (shard_stats) {
+	total_stats = std::move(local_stats);
+    } else {
+	p = message.c_str();
+	p_end = p + message.size();
+
+	decode_length(&p, p_end, first);
+	decode_length(&p, p_end, maxitems);
+	decode_length(&p, p_end, check_at_least);
+
+	message.erase(0, message.size() - (p_end - p));
+	total_stats.reset(new Xapian::Weight::Internal);
+	unserialise_stats(message, *total_stats);
+	total_stats->set_bounds_from_db(*db);
+    }
 
-    Xapian::MSet mset = matcher.get_mset(first, maxitems, check_at_least,
+    Xapian::MSet mset = matcher_ref.get_mset(first, maxitems, check_at_least,
 					 *total_stats, *wt, 0, 0,
 					 collapse_key, collapse_max,
 					 percent_threshold, weight_threshold,
 					 order,
 					 sort_key, sort_by, sort_value_forward,
-					 time_limit, matchspies);
+					 time_limit, hard_time_limit,
+					 pruning_factor, matchspies);
     // FIXME: The local side already has these stats, except for the maxpart
     // information.
     mset.internal->set_stats(total_stats.release());
@@ -610,6 +756,8 @@ RemoteServer::msg_query(const string &message_in)
 	message += spy_results;
     }
     message += mset.internal->serialise();
+    if (!results_key.empty())
+	results_cache->insert(results_key, message);
     send_message(REPLY_RESULTS, message);
 }
 
@@ -634,6 +782,44 @@ RemoteServer::msg_document(const string &message)
     send_message(REPLY_DONE, string());
 }
 
+void
+RemoteServer::msg_documents(const string &message)
+{
+    const char *p = message.data();
+    const char *p_end = p + message.size();
+    string reply;
+    Xapian::docid did = 0;
+    while (p != p_end) {
+	Xapian::docid inc;
+	decode_length(&p, p_end, inc);
+	did += inc;
+
+	Xapian::Document doc;
+	try {
+	    doc = db->get_document(did);
+	} catch (const Xapian::DocNotFoundError &) {
+	    // Let the client report this if it actually wants the document.
+	    reply += '0';
+	    continue;
+	}
+	reply += '1';
+	string data = doc.get_data();
+	reply += encode_length(data.size());
+	reply += data;
+	reply += encode_length(doc.values_count());
+	Xapian::valueno prev_slot = 0;
+	for (auto i = doc.values_begin(); i != doc.values_end(); ++i) {
+	    Xapian::valueno slot = i.get_valueno();
+	    reply += encode_length(slot - prev_slot);
+	    prev_slot = slot;
+	    const string& value = *i;
+	    reply += encode_length(value.size());
+	    reply += value;
+	}
+    }
+    send_message(REPLY_DOCUMENTS, reply);
+}
+
 void
 RemoteServer::msg_keepalive(const string &)
 {
@@ -709,6 +895,31 @@ RemoteServer::msg_uniqueterms(const string &message)
     send_message(REPLY_UNIQUETERMS, encode_length(db->get_unique_terms(did)));
 }
 
+void
+RemoteServer::msg_status(const string &)
+{
+    string message;
+    auto add = [&message](const char* name, unsigned long long value) {
+	message += name;
+	message += ' ';
+	message += str(value);
+	message += '\n';
+    };
+    auto add_cache = [&add](const string& prefix, const RemoteCache* cache) {
+	add((prefix + "_hits").c_str(), cache ? cache->get_hits() : 0);
+	add((prefix + "_misses").c_str(), cache ? cache->get_misses() : 0);
+	add((prefix + "_entries").c_str(), cache ? cache->get_entries() : 0);
+	add((prefix + "_size").c_str(), cache ? cache->get_size() : 0);
+	add((prefix + "_max_size").c_str(),
+	    cache ? cache->get_max_size() : 0);
+    };
+    add_cache("stats_cache", stats_cache);
+    add_cache("results_cache", results_cache);
+    // Add the counters for the database we're serving.
+    message += db->get_server_status();
+    send_message(REPLY_STATUS, message);
+}
+
 void
 RemoteServer::msg_commit(const string &)
 {
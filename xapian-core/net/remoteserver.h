@@ -28,8 +28,10 @@
 #include "xapian/visibility.h"
 #include "xapian/weight.h"
 
+#include "remotecache.h"
 #include "remoteconnection.h"
 
+#include <memory>
 #include <string>
 
 /** Remote backend server base class. */
@@ -69,6 +71,26 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     /// The registry, which allows unserialisation of user subclasses.
     Xapian::Registry reg;
 
+    /// Cache of the statistics sent in reply to MSG_QUERY, or NULL.
+    RemoteCache* stats_cache = NULL;
+
+    /// Cache of the MSets sent in reply to MSG_QUERY, or NULL.
+    RemoteCache* results_cache = NULL;
+
+    /// Caches created by set_cache_size().
+    std::unique_ptr<RemoteCache> own_stats_cache, own_results_cache;
+
+    /** Identifies the revision of each shard of db, to prefix cache keys.
+     *
+     *  Empty if the revision can't be identified, in which case nothing is
+     *  cached.
+     */
+    std::string cache_revision;
+
+    /// Update cache_revision after opening or reopening db.
+    XAPIAN_VISIBILITY_INTERNAL
+    void update_cache_revision();
+
     /// Accept a message from the client.
     XAPIAN_VISIBILITY_INTERNAL
     message_type get_message(double timeout, std::string & result,
@@ -94,6 +116,10 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     XAPIAN_VISIBILITY_INTERNAL
     void msg_document(const std::string & message);
 
+    // get several documents
+    XAPIAN_VISIBILITY_INTERNAL
+    void msg_documents(const std::string & message);
+
     // term exists?
     XAPIAN_VISIBILITY_INTERNAL
     void msg_termexists(const std::string & message);
@@ -206,6 +232,10 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     XAPIAN_VISIBILITY_INTERNAL
     void msg_uniqueterms(const std::string & message);
 
+    // get server status
+    XAPIAN_VISIBILITY_INTERNAL
+    void msg_status(const std::string & message);
+
   public:
     /** Construct a RemoteServer.
      *
@@ -218,12 +248,14 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
      *  @param idle_timeout_	Timeout while waiting for a new action from
      *			the client (specified in seconds).
      *  @param writable Should the database be opened for writing?
+     *  @param compress Should large messages be compressed?
      */
     RemoteServer(const std::vector<std::string> &dbpaths,
 		 int fdin, int fdout,
 		 double active_timeout_,
 		 double idle_timeout_,
-		 bool writable = false);
+		 bool writable = false,
+		 bool compress = false);
 
     /// Destructor.
     ~RemoteServer();
@@ -240,6 +272,41 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
 
     /// Set the registry used for (un)serialisation.
     void set_registry(const Xapian::Registry & reg_) { reg = reg_; }
+
+    /// Slot size for a cache of statistics (see RemoteCache).
+    static const size_t STATS_CACHE_SLOT_SIZE = 1024;
+
+    /// Slot size for a cache of MSets (see RemoteCache).
+    static const size_t RESULTS_CACHE_SLOT_SIZE = 8192;
+
+    /** Set the size of the query caches.
+     *
+     *  When the database is read-only, the statistics and MSet sent for each
+     *  query are cached, keyed by the serialised query and settings and the
+     *  revision of the database, so that repeating a query (e.g. to fetch
+     *  the same page of results again) doesn't need to rerun the match.
+     *
+     *  The caches created by this method belong to this RemoteServer - use
+     *  set_caches() to share caches between connections.
+     *
+     *  @param size	Maximum size in bytes of each cache (default: 0, which
+     *			disables caching).
+     */
+    void set_cache_size(size_t size);
+
+    /** Use caches shared with other RemoteServer objects.
+     *
+     *  See set_cache_size().  The caches must outlive this object, and all
+     *  the RemoteServer objects using them must serve the same databases
+     *  with the same registry.
+     *
+     *  @param stats_cache_	Cache of statistics (NULL to disable).
+     *  @param results_cache_	Cache of MSets (NULL to disable).
+     */
+    void set_caches(RemoteCache* stats_cache_, RemoteCache* results_cache_) {
+	stats_cache = stats_cache_;
+	results_cache = results_cache_;
+    }
 };
 
 #endif // XAPIAN_INCLUDED_REMOTESERVER_H
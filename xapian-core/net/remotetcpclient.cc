@@ -24,11 +24,113 @@
 
 #include <xapian/error.h>
 
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "socket_utils.h"
 #include "str.h"
 #include "tcpclient.h"
 
 using namespace std;
 
+namespace {
+
+/** Idle connections to servers, for reuse by RemoteTcpClient.
+ *
+ *  Keyed by the context string, which identifies the host and port.
+ */
+class ConnectionPool {
+    mutex pool_mutex;
+
+    map<string, vector<int>> idle;
+
+    unsigned max_per_server = 0;
+
+    /// The process the connections in idle belong to.
+    decltype(getpid()) owner = getpid();
+
+    /** Forget connections inherited from our parent process.
+     *
+     *  After fork() the parent still owns the connections, so using them
+     *  here too would mix up the two processes' requests and replies.
+     *  Closing our copies of the fds doesn't affect the parent's use of
+     *  them.  Must be called with pool_mutex held.
+     */
+    void check_owner() {
+	if (rare(owner != getpid())) {
+	    for (auto&& i : idle) {
+		for (int fd : i.second)
+		    close_fd_or_socket(fd);
+	    }
+	    idle.clear();
+	    owner = getpid();
+	}
+    }
+
+  public:
+    ~ConnectionPool() {
+	set_size(0);
+    }
+
+    void set_size(unsigned size) {
+	lock_guard<mutex> lock(pool_mutex);
+	check_owner();
+	max_per_server = size;
+	for (auto i = idle.begin(); i != idle.end(); ) {
+	    vector<int>& fds = i->second;
+	    while (fds.size() > max_per_server) {
+		close_fd_or_socket(fds.back());
+		fds.pop_back();
+	    }
+	    if (fds.empty()) {
+		i = idle.erase(i);
+	    } else {
+		++i;
+	    }
+	}
+    }
+
+    bool enabled() {
+	lock_guard<mutex> lock(pool_mutex);
+	return max_per_server != 0;
+    }
+
+    /// Take an idle connection to the server @a key, or return -1.
+    int get(const string& key) {
+	lock_guard<mutex> lock(pool_mutex);
+	check_owner();
+	auto i = idle.find(key);
+	if (i == idle.end())
+	    return -1;
+	// Use the most recently used, which is the least likely to have been
+	// closed by the server's idle timeout.
+	int fd = i->second.back();
+	i->second.pop_back();
+	if (i->second.empty())
+	    idle.erase(i);
+	return fd;
+    }
+
+    /// Add idle connection @a fd to the server @a key, or close it.
+    void put(const string& key, int fd) {
+	lock_guard<mutex> lock(pool_mutex);
+	check_owner();
+	vector<int>& fds = idle[key];
+	if (fds.size() >= max_per_server) {
+	    if (fds.empty())
+		idle.erase(key);
+	    close_fd_or_socket(fd);
+	    return;
+	}
+	fds.push_back(fd);
+    }
+};
+
+ConnectionPool pool;
+
+}
+
 int
 RemoteTcpClient::open_socket(const string & hostname, int port,
 			     double timeout_connect)
@@ -56,7 +158,51 @@ RemoteTcpClient::get_tcpcontext(const string & hostname, int port)
     return result;
 }
 
+RemoteTcpClient*
+RemoteTcpClient::open(const string& hostname, int port,
+		      double timeout_, double timeout_connect,
+		      bool writable, int flags)
+{
+    string context = get_tcpcontext(hostname, port);
+    if (!writable) {
+	int fd;
+	while ((fd = pool.get(context)) >= 0) {
+	    try {
+		return new RemoteTcpClient(fd, hostname, port,
+					   timeout_connect, context,
+					   timeout_, false, flags, true);
+	    } catch (const Xapian::NetworkError&) {
+		// Most likely the server has closed the connection due to its
+		// idle timeout, so try the next one.
+	    }
+	}
+    }
+    return new RemoteTcpClient(open_socket(hostname, port, timeout_connect),
+			       hostname, port, timeout_connect,
+			       context, timeout_, writable, flags, false);
+}
+
+RemoteDatabase*
+RemoteTcpClient::reconnect() const
+{
+    return open(hostname, port, timeout, timeout_connect, false, 0);
+}
+
+void
+RemoteTcpClient::set_pool_size(unsigned size)
+{
+    pool.set_size(size);
+}
+
 RemoteTcpClient::~RemoteTcpClient()
 {
+    // A connection opened before a fork() is shared with the other process,
+    // so only the process which opened it may reuse it.
+    if (!pool_key.empty() && opener == getpid() && pool.enabled()) {
+	int fd = release_connection();
+	if (fd >= 0)
+	    pool.put(pool_key, fd);
+	return;
+    }
     do_close();
 }
@@ -22,6 +22,7 @@
 #define XAPIAN_INCLUDED_REMOTETCPCLIENT_H
 
 #include "backends/remote/remote-database.h"
+#include "safeunistd.h"
 
 #ifdef __WIN32__
 # define SOCKET_INITIALIZER_MIXIN private WinsockInitializer,
@@ -61,6 +62,44 @@ class RemoteTcpClient : SOCKET_INITIALIZER_MIXIN public RemoteDatabase {
      */
     static std::string get_tcpcontext(const std::string & hostname, int port);
 
+    /** Constructor.
+     *
+     *  @param fd		The connected socket.
+     *  @param hostname_	The host connected to.
+     *  @param port_		The port connected to.
+     *  @param timeout_connect_	Timeout used for connecting (in seconds).
+     *  @param context_		Context string from get_tcpcontext().
+     *  @param timeout		Timeout during communication (in seconds).
+     *	@param writable		Is this a WritableDatabase?
+     *	@param flags		Xapian::DB_RETRY_LOCK or 0.
+     *	@param reused		Is @a fd an idle connection from the pool?
+     */
+    RemoteTcpClient(int fd, const std::string& hostname_, int port_,
+		    double timeout_connect_, const std::string& context_,
+		    double timeout_, bool writable, int flags, bool reused)
+	: RemoteDatabase(fd, timeout_, context_, writable, flags, reused),
+	  hostname(hostname_), port(port_), timeout_connect(timeout_connect_),
+	  pool_key(writable ? std::string() : context_), opener(getpid()) { }
+
+    /// The host connected to.
+    std::string hostname;
+
+    /// The port connected to.
+    int port;
+
+    /// Timeout used for connecting (in seconds).
+    double timeout_connect;
+
+    /** Key for returning the connection to the pool of idle connections.
+     *
+     *  Empty for a WritableDatabase, since the server holds the write lock
+     *  until the connection is closed.
+     */
+    std::string pool_key;
+
+    /// The process which opened the connection.
+    decltype(getpid()) opener;
+
   public:
     /** Constructor.
      *
@@ -76,11 +115,34 @@ class RemoteTcpClient : SOCKET_INITIALIZER_MIXIN public RemoteDatabase {
     RemoteTcpClient(const std::string & hostname, int port,
 		    double timeout_, double timeout_connect, bool writable,
 		    int flags)
-	: RemoteDatabase(open_socket(hostname, port, timeout_connect),
-			 timeout_, get_tcpcontext(hostname, port),
-			 writable, flags) { }
+	: RemoteTcpClient(open_socket(hostname, port, timeout_connect),
+			  hostname, port, timeout_connect,
+			  get_tcpcontext(hostname, port),
+			  timeout_, writable, flags, false) { }
+
+    /** Open a connection, reusing an idle one from the pool if possible.
+     *
+     *  Parameters are as for the public constructor.  Idle connections are
+     *  only reused for read-only databases.
+     */
+    static RemoteTcpClient* open(const std::string& hostname, int port,
+				 double timeout_, double timeout_connect,
+				 bool writable, int flags);
 
-    /** Destructor. */
+    /** Set the maximum number of idle connections to keep for each server.
+     *
+     *  0 (the default) disables the pool, and idle connections already in
+     *  it are closed.
+     */
+    static void set_pool_size(unsigned size);
+
+    RemoteDatabase* reconnect() const;
+
+    /** Destructor.
+     *
+     *  If the pool is enabled and the connection is idle, it is added to
+     *  the pool instead of being closed.
+     */
     ~RemoteTcpClient();
 };
 
@@ -37,20 +37,37 @@ using namespace std;
 RemoteTcpServer::RemoteTcpServer(const vector<std::string> &dbpaths_,
 				 const std::string & host, int port,
 				 double active_timeout_, double idle_timeout_,
-				 bool writable_, bool verbose_)
+				 bool writable_, bool verbose_,
+				 bool compress_)
     : TcpServer(host, port, true, verbose_),
-      dbpaths(dbpaths_), writable(writable_),
+      dbpaths(dbpaths_), writable(writable_), compress(compress_),
       active_timeout(active_timeout_), idle_timeout(idle_timeout_)
 {
 }
 
+RemoteTcpServer::~RemoteTcpServer()
+{
+}
+
+void
+RemoteTcpServer::set_cache_size(size_t size)
+{
+    // Create the caches now so that the processes forked to handle each
+    // connection share them.
+    stats_cache.reset(new RemoteCache(size,
+				      RemoteServer::STATS_CACHE_SLOT_SIZE));
+    results_cache.reset(new RemoteCache(size,
+					RemoteServer::RESULTS_CACHE_SLOT_SIZE));
+}
+
 void
 RemoteTcpServer::handle_one_connection(int socket)
 {
     try {
 	RemoteServer sserv(dbpaths, socket, socket,
-			   active_timeout, idle_timeout, writable);
+			   active_timeout, idle_timeout, writable, compress);
 	sserv.set_registry(reg);
+	sserv.set_caches(stats_cache.get(), results_cache.get());
 	sserv.run();
     } catch (const Xapian::NetworkTimeoutError &e) {
 	if (verbose)
@@ -21,12 +21,14 @@
 #ifndef XAPIAN_INCLUDED_REMOTETCPSERVER_H
 #define XAPIAN_INCLUDED_REMOTETCPSERVER_H
 
+#include "remotecache.h"
 #include "tcpserver.h"
 
 #include <xapian/database.h>
 #include <xapian/registry.h>
 #include <xapian/visibility.h>
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -50,6 +52,9 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteTcpServer : public TcpServer {
     /** Is this a WritableDatabase? */
     bool writable;
 
+    /** Should large messages be compressed? */
+    bool compress;
+
     /** Timeout between messages during a single operation (in seconds). */
     double active_timeout;
 
@@ -59,6 +64,9 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteTcpServer : public TcpServer {
     /** Registry used for (un)serialisation. */
     Xapian::Registry reg;
 
+    /** Query caches shared by all connections (NULL if not caching). */
+    std::unique_ptr<RemoteCache> stats_cache, results_cache;
+
     /** Accept a connection and return the filedescriptor for it. */
     int accept_connection();
 
@@ -76,15 +84,25 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteTcpServer : public TcpServer {
      *	@param writable		Should we open the DB for writing?
      *	@param verbose		Should we produce output when connections are
      *				made or lost?
+     *	@param compress		Should large messages be compressed?
      */
     RemoteTcpServer(const std::vector<std::string> &dbpaths_,
 		    const std::string &host, int port,
 		    double active_timeout, double idle_timeout,
-		    bool writable, bool verbose);
+		    bool writable, bool verbose, bool compress = false);
+
+    ~RemoteTcpServer();
 
     /// Set the registry used for (un)serialisation.
     void set_registry(const Xapian::Registry & reg_) { reg = reg_; }
 
+    /** Set the size of the query caches.
+     *
+     *  See RemoteServer::set_cache_size().  The caches are shared by all
+     *  connections, so this must be called before run().
+     */
+    void set_cache_size(size_t size);
+
     /** Handle a single connection on an already connected socket.
      *
      *  This method may be called by multiple threads.
@@ -24,16 +24,35 @@
 
 #include "api/replication.h"
 
+#include "pack.h"
+#include "replicationprotocol.h"
 #include "socket_utils.h"
 #include "tcpclient.h"
 
+#include <memory>
+#include <vector>
+
 using namespace std;
 
-ReplicateTcpClient::ReplicateTcpClient(const string & hostname, int port,
-				       double timeout_connect,
-				       double socket_timeout)
-    : socket(open_socket(hostname, port, timeout_connect)),
-      remconn(-1, socket)
+/// Send the greeting which starts each connection to the master.
+static void
+send_greeting(RemoteConnection & conn)
+{
+    string message;
+    pack_uint(message, unsigned(XAPIAN_REPLICATION_PROTOCOL_MAJOR_VERSION));
+    pack_uint(message, unsigned(XAPIAN_REPLICATION_PROTOCOL_MINOR_VERSION));
+    // DatabaseReplica always accepts compressed messages.
+    pack_bool(message, true);
+    conn.send_message('V', message, 0.0);
+}
+
+ReplicateTcpClient::ReplicateTcpClient(const string & hostname_, int port_,
+				       double timeout_connect_,
+				       double socket_timeout_)
+    : socket(open_socket(hostname_, port_, timeout_connect_)),
+      hostname(hostname_), port(port_),
+      timeout_connect(timeout_connect_), socket_timeout(socket_timeout_),
+      remconn(new OwnedRemoteConnection(-1, socket))
 {
     set_socket_timeouts(socket, socket_timeout);
 }
@@ -50,14 +69,106 @@ ReplicateTcpClient::update_from_master(const std::string & path,
 				       const std::string & masterdb,
 				       Xapian::ReplicationInfo & info,
 				       double reader_close_time,
-				       bool force_copy)
+				       bool force_copy,
+				       unsigned n_streams)
 {
     Xapian::DatabaseReplica replica(path);
-    remconn.send_message('R',
-			 force_copy ? string() : replica.get_revision_info(),
-			 0.0);
-    remconn.send_message('D', masterdb, 0.0);
+    replica.set_relay_changesets(max_changesets);
+    request_changes(replica, masterdb, 'D', force_copy, n_streams);
     replica.set_read_fd(socket);
+    apply_changes(replica, info, reader_close_time);
+}
+
+void
+ReplicateTcpClient::request_changes(Xapian::DatabaseReplica & replica,
+				    const std::string & masterdb,
+				    char type,
+				    bool force_copy,
+				    unsigned n_streams)
+{
+    string revision = force_copy ? string() : replica.get_revision_info();
+    if (n_streams > 1 && !force_copy) {
+	// If the replica has no usable database we know a copy is needed,
+	// otherwise ask the master and see if its reply starts with one.
+	if (!revision.empty()) {
+	    send_greeting(*remconn);
+	    remconn->send_message('R', revision, 0.0);
+	    remconn->send_message(type, masterdb, 0.0);
+	    if (peek_socket_byte(socket) != REPL_REPLY_DB_HEADER)
+		return;
+	    // Abandon this conversation and start again once the bulk of the
+	    // copy has been received in parallel.
+	    reconnect();
+	}
+	copy_in_parallel(replica, masterdb, n_streams);
+	revision = replica.get_revision_info();
+    }
+    send_greeting(*remconn);
+    remconn->send_message('R', revision, 0.0);
+    remconn->send_message(type, masterdb, 0.0);
+}
+
+void
+ReplicateTcpClient::reconnect()
+{
+    // Only replace the old connection once the new one is open, so remconn
+    // is still valid if open_socket() throws.
+    int fd = open_socket(hostname, port, timeout_connect);
+    remconn.reset(new OwnedRemoteConnection(-1, fd));
+    socket = fd;
+    set_socket_timeouts(socket, socket_timeout);
+}
+
+void
+ReplicateTcpClient::copy_in_parallel(Xapian::DatabaseReplica & replica,
+				     const std::string & masterdb,
+				     unsigned n_streams)
+{
+    string revision = replica.get_revision_info();
+    vector<unique_ptr<OwnedRemoteConnection>> conns;
+    vector<int> fds;
+    for (unsigned i = 0; i != n_streams; ++i) {
+	int fd = open_socket(hostname, port, timeout_connect);
+	conns.emplace_back(new OwnedRemoteConnection(-1, fd));
+	set_socket_timeouts(fd, socket_timeout);
+	string message;
+	pack_uint(message, i);
+	pack_uint(message, n_streams);
+	message += masterdb;
+	send_greeting(*conns.back());
+	conns.back()->send_message('R', revision, 0.0);
+	conns.back()->send_message('C', message, 0.0);
+	fds.push_back(fd);
+    }
+    replica.apply_copy_ranges(fds);
+    for (auto& conn : conns)
+	conn->shutdown();
+}
+
+void
+ReplicateTcpClient::start_streaming(const std::string & path,
+				    const std::string & masterdb,
+				    bool force_copy,
+				    unsigned n_streams)
+{
+    stream_replica.reset(new Xapian::DatabaseReplica(path));
+    stream_replica->set_relay_changesets(max_changesets);
+    request_changes(*stream_replica, masterdb, 'S', force_copy, n_streams);
+    stream_replica->set_read_fd(socket);
+}
+
+void
+ReplicateTcpClient::apply_streamed_changes(Xapian::ReplicationInfo & info,
+					   double reader_close_time)
+{
+    apply_changes(*stream_replica, info, reader_close_time);
+}
+
+void
+ReplicateTcpClient::apply_changes(Xapian::DatabaseReplica & replica,
+				  Xapian::ReplicationInfo & info,
+				  double reader_close_time)
+{
     info.clear();
     bool more;
     do {
@@ -72,5 +183,6 @@ ReplicateTcpClient::update_from_master(const std::string & path,
 
 ReplicateTcpClient::~ReplicateTcpClient()
 {
-    remconn.shutdown();
+    if (remconn)
+	remconn->shutdown();
 }
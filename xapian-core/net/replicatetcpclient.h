@@ -26,6 +26,8 @@
 #include "xapian/visibility.h"
 #include "api/replication.h"
 
+#include <memory>
+
 #ifdef __WIN32__
 # define SOCKET_INITIALIZER_MIXIN : private WinsockInitializer
 #else
@@ -43,8 +45,56 @@ class XAPIAN_VISIBILITY_DEFAULT ReplicateTcpClient SOCKET_INITIALIZER_MIXIN {
     /// The socket fd.
     int socket;
 
+    /// The server's hostname and port, for opening further connections.
+    std::string hostname;
+
+    int port;
+
+    /// Timeouts to use for further connections (in seconds).
+    double timeout_connect, socket_timeout;
+
+    /// The number of changesets for replicas to keep (0 for none).
+    unsigned max_changesets = 0;
+
     /// Write-only connection to the server.
-    OwnedRemoteConnection remconn;
+    std::unique_ptr<OwnedRemoteConnection> remconn;
+
+    /// The replica being streamed to, if start_streaming() has been called.
+    std::unique_ptr<Xapian::DatabaseReplica> stream_replica;
+
+    /** Send the request for changes of @a type ('D' or 'S') to the master.
+     *
+     *  If @a n_streams is more than 1 and the master's reply would start
+     *  with a copy of the whole database, the bulk of that copy is first
+     *  received using copy_in_parallel().
+     */
+    XAPIAN_VISIBILITY_INTERNAL
+    void request_changes(Xapian::DatabaseReplica & replica,
+			 const std::string & remotedb,
+			 char type,
+			 bool force_copy,
+			 unsigned n_streams);
+
+    /// Close the connection to the server and open a new one.
+    XAPIAN_VISIBILITY_INTERNAL
+    void reconnect();
+
+    /** Receive a copy of the database over @a n_streams extra connections at
+     *  once.
+     *
+     *  The copy is left as a partial copy, which the master completes when
+     *  the replica next asks for changes in the usual way.
+     */
+    XAPIAN_VISIBILITY_INTERNAL
+    void copy_in_parallel(Xapian::DatabaseReplica & replica,
+			  const std::string & remotedb,
+			  unsigned n_streams);
+
+    /// Apply changes from the master until it says there are no more.
+    XAPIAN_VISIBILITY_INTERNAL
+    static void apply_changes(Xapian::DatabaseReplica & replica,
+			      Xapian::ReplicationInfo & info,
+			      double reader_close_time);
 
     /** Attempt to open a TCP/IP socket connection to a replication server.
      *
@@ -72,11 +122,44 @@ class XAPIAN_VISIBILITY_DEFAULT ReplicateTcpClient SOCKET_INITIALIZER_MIXIN {
     ReplicateTcpClient(const std::string & hostname, int port,
 		       double timeout_connect, double socket_timeout);
 
+    /** Keep changesets applied to replicas updated by this client.
+     *
+     *  See Xapian::DatabaseReplica::set_relay_changesets().
+     */
+    void set_relay_changesets(unsigned max_changesets_) {
+	max_changesets = max_changesets_;
+    }
+
+    /** Update the replica at @a path from the master.
+     *
+     *  If @a n_streams is more than 1 and the replica needs a copy of the
+     *  whole database, the copy is received over that many connections at
+     *  once.  This isn't done if @a force_copy is true.
+     */
     void update_from_master(const std::string & path,
 			    const std::string & remotedb,
 			    Xapian::ReplicationInfo & info,
 			    double reader_close_time,
-			    bool force_copy);
+			    bool force_copy,
+			    unsigned n_streams = 1);
+
+    /** Ask the master to stream changes as they happen.
+     *
+     *  After calling this, call apply_streamed_changes() repeatedly to apply
+     *  them.  @a n_streams is as for update_from_master().
+     */
+    void start_streaming(const std::string & path,
+			 const std::string & remotedb,
+			 bool force_copy,
+			 unsigned n_streams = 1);
+
+    /** Wait for the next set of changes streamed by the master and apply it.
+     *
+     *  The master sends an empty set of changes periodically if nothing
+     *  changes, in which case this returns with @a info cleared.
+     */
+    void apply_streamed_changes(Xapian::ReplicationInfo & info,
+				double reader_close_time);
 
     /** Destructor. */
     ~ReplicateTcpClient();
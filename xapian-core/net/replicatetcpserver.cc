@@ -24,12 +24,15 @@
 
 #include <xapian/error.h>
 #include "api/replication.h"
+#include "pack.h"
+#include "replicationprotocol.h"
+#include "str.h"
 
 using namespace std;
 
 ReplicateTcpServer::ReplicateTcpServer(const string & host, int port,
-				       const string & path_)
-    : TcpServer(host, port, false, false), path(path_)
+				       const string & path_, bool compress_)
+    : TcpServer(host, port, false, false), path(path_), compress(compress_)
 {
 }
 
@@ -41,17 +44,62 @@ ReplicateTcpServer::handle_one_connection(int socket)
 {
     RemoteConnection client(socket, -1);
     try {
+	// The client starts by saying which version of the protocol it speaks
+	// and whether it accepts compressed messages.  Clients which predate
+	// version 2 don't send this, so start with their 'R' message instead.
+	string greeting;
+	int type = client.get_message(greeting, 0.0);
+	unsigned major = 1, minor = 0;
+	bool accept_compressed = false;
+	if (type == 'V') {
+	    const char * p = greeting.data();
+	    const char * p_end = p + greeting.size();
+	    if (!unpack_uint(&p, p_end, &major) ||
+		!unpack_uint(&p, p_end, &minor) ||
+		!unpack_bool(&p, p_end, &accept_compressed)) {
+		throw Xapian::NetworkError("Bad replication client greeting");
+	    }
+	}
+	if (major != XAPIAN_REPLICATION_PROTOCOL_MAJOR_VERSION) {
+	    // Read the rest of the request, so closing the connection doesn't
+	    // discard the reply before the client sees it.
+	    string dummy;
+	    while (type != 'D' && type != 'S' && type != 'C' && type >= 0)
+		type = client.get_message(dummy, 0.0);
+	    string msg = "Replication protocol version mismatch: master is ";
+	    msg += str(XAPIAN_REPLICATION_PROTOCOL_MAJOR_VERSION);
+	    msg += ", replica is ";
+	    msg += str(major);
+	    RemoteConnection(-1, socket).send_message(REPL_REPLY_FAIL, msg,
+						      0.0);
+	    return;
+	}
+
 	// Read start_revision from the client.
 	string start_revision;
 	if (client.get_message(start_revision, 0.0) != 'R') {
 	    throw Xapian::NetworkError("Bad replication client message");
 	}
 
-	// Read dbname from the client.
+	// Read dbname from the client.  'S' instead of 'D' asks for changes to
+	// be streamed as they happen, and 'C' asks for one share of the ranges
+	// of a database copy, in which case dbname is preceded by the share
+	// number and the number of shares.
 	string dbname;
-	if (client.get_message(dbname, 0.0) != 'D') {
+	type = client.get_message(dbname, 0.0);
+	if (type != 'D' && type != 'S' && type != 'C') {
 	    throw Xapian::NetworkError("Bad replication client message (2)");
 	}
+	unsigned stream = 0, n_streams = 1;
+	if (type == 'C') {
+	    const char * p = dbname.data();
+	    const char * p_end = p + dbname.size();
+	    if (!unpack_uint(&p, p_end, &stream) ||
+		!unpack_uint(&p, p_end, &n_streams)) {
+		throw Xapian::NetworkError("Bad replication client message (3)");
+	    }
+	    dbname.erase(0, p - dbname.data());
+	}
 	if (dbname.find("..") != string::npos) {
 	    throw Xapian::NetworkError("dbname contained '..'");
 	}
@@ -60,7 +108,16 @@ ReplicateTcpServer::handle_one_connection(int socket)
 	dbpath += '/';
 	dbpath += dbname;
 	Xapian::DatabaseMaster master(dbpath);
-	master.write_changesets_to_fd(socket, start_revision, NULL);
+	master.set_compression(compress && accept_compressed);
+	if (type == 'S') {
+	    master.stream_changesets_to_fd(socket, start_revision,
+					   check_interval);
+	} else if (type == 'C') {
+	    master.write_copy_ranges_to_fd(socket, start_revision,
+					   stream, n_streams);
+	} else {
+	    master.write_changesets_to_fd(socket, start_revision, NULL);
+	}
     } catch (...) {
 	// Ignore exceptions.
     }
@@ -31,6 +31,12 @@ class XAPIAN_VISIBILITY_DEFAULT ReplicateTcpServer : public TcpServer {
     /// The path to pass to DatabaseMaster.
     std::string path;
 
+    /// Should the data sent be compressed (to clients which accept that)?
+    bool compress;
+
+    /// How often to check for changes to send to streaming clients (seconds).
+    double check_interval = 0.1;
+
   public:
     /** Construct a ReplicateTcpServer and start listening for connections.
      *
@@ -38,13 +44,24 @@ class XAPIAN_VISIBILITY_DEFAULT ReplicateTcpServer : public TcpServer {
      *			(or "" to listen on all interfaces).
      *  @param port	The TCP port number to listen on.
      *  @param path_	The path to the parent directory of the databases.
+     *  @param compress_	Should the data sent be compressed?  This is only
+     *			done for clients which say they accept compressed
+     *			data.
      */
     ReplicateTcpServer(const std::string & host, int port,
-		       const std::string & path_);
+		       const std::string & path_, bool compress_ = false);
 
     /// Destructor.
     ~ReplicateTcpServer();
 
+    /** Set how often to check for changes to send to streaming clients.
+     *
+     *  @param check_interval_	The interval in seconds (default: 0.1).
+     */
+    void set_check_interval(double check_interval_) {
+	check_interval = check_interval_;
+    }
+
     /** Handle a single connection on an already connected socket.
      *
      *  This method may be called by multiple threads.
@@ -29,10 +29,12 @@
 
 #include <algorithm>
 #include <string>
+#include <vector>
 
 #define XAPIAN_DEPRECATED(X) X
 #include <xapian.h>
 #include "backendmanager_local.h"
+#include "str.h"
 #include "testsuite.h"
 #include "testutils.h"
 
@@ -928,6 +930,119 @@ DEFINE_TESTCASE(cutoff1, backend) {
     return true;
 }
 
+/// Test Enquire::set_pruning_factor().
+DEFINE_TESTCASE(pruningfactor1, backend) {
+    Xapian::Enquire enquire(get_database("etext"));
+    enquire.set_query(query(Xapian::Query::OP_OR,
+			    "the", "and", "of", "to", "in", "it", "that", "is"));
+    // Count the documents which the matcher considers.
+    Xapian::ValueCountMatchSpy spy_exact(0);
+    enquire.add_matchspy(&spy_exact);
+    Xapian::MSet exact = enquire.get_mset(0, 10);
+    TEST_EQUAL(exact.size(), 10);
+    enquire.clear_matchspies();
+
+    enquire.set_pruning_factor(1.0);
+    Xapian::MSet mset = enquire.get_mset(0, 10);
+    TEST(mset_range_is_same(mset, 0, exact, 0, 10));
+
+    const double factor = 1.5;
+    enquire.set_pruning_factor(factor);
+    Xapian::ValueCountMatchSpy spy(0);
+    enquire.add_matchspy(&spy);
+    mset = enquire.get_mset(0, 10);
+    TEST_EQUAL(mset.size(), 10);
+    // Pruning more aggressively should mean fewer documents are considered.
+    tout << "Documents considered: " << spy_exact.get_total() << " exact, "
+	 << spy.get_total() << " with pruning factor " << factor << endl;
+    TEST_REL(spy.get_total(), <, spy_exact.get_total());
+    TEST_REL(mset.get_matches_lower_bound(), <=, mset.get_matches_estimated());
+    TEST_REL(mset.get_matches_estimated(), <=, mset.get_matches_upper_bound());
+    double lowest = mset.back().get_weight();
+    for (auto i = exact.begin(); i != exact.end(); ++i) {
+	Xapian::MSetIterator j = mset.begin();
+	while (j != mset.end() && *j != *i) ++j;
+	if (j == mset.end()) {
+	    // A document may only be missed if it couldn't have scored much
+	    // higher than those returned.
+	    TEST_REL(i.get_weight(), <, factor * lowest);
+	} else {
+	    TEST_EQUAL_DOUBLE(i.get_weight(), j.get_weight());
+	}
+    }
+
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   enquire.set_pruning_factor(0.5));
+    return true;
+}
+
+/// Check a weight cutoff doesn't get scaled by the pruning factor.
+DEFINE_TESTCASE(pruningfactor2, backend) {
+    Xapian::Enquire enquire(get_database("etext"));
+    enquire.set_query(Xapian::Query("king"));
+    Xapian::MSet top = enquire.get_mset(0, 10);
+    TEST_EQUAL(top.size(), 10);
+    double cutoff = top[4].get_weight();
+
+    // Ask for more documents than pass the cutoff, so the MSet is never full.
+    enquire.set_cutoff(0, cutoff);
+    Xapian::ValueCountMatchSpy spy_exact(0);
+    enquire.add_matchspy(&spy_exact);
+    Xapian::MSet exact = enquire.get_mset(0, 100);
+    TEST_REL(exact.size(), >=, 5);
+    TEST_REL(exact.size(), <, 100);
+
+    enquire.set_pruning_factor(2.0);
+    enquire.clear_matchspies();
+    Xapian::ValueCountMatchSpy spy(0);
+    enquire.add_matchspy(&spy);
+    Xapian::MSet mset = enquire.get_mset(0, 100);
+    TEST_EQUAL(mset.size(), exact.size());
+    TEST(mset_range_is_same(mset, 0, exact, 0, exact.size()));
+    // The pruning factor shouldn't have been applied at all, so the same
+    // documents should have been considered.
+    TEST_EQUAL(spy.get_total(), spy_exact.get_total());
+    return true;
+}
+
+/// Test Enquire::get_msets() gives the same results as get_mset().
+DEFINE_TESTCASE(getmsets1, backend) {
+    Xapian::Enquire enquire(get_database("etext"));
+    Xapian::Query orig("king");
+    enquire.set_query(orig);
+
+    vector<Xapian::Query> queries;
+    queries.push_back(query(Xapian::Query::OP_OR, "the", "and", "of"));
+    queries.push_back(query("that"));
+    queries.push_back(Xapian::Query());
+    queries.push_back(query(Xapian::Query::OP_AND, "to", "in"));
+    queries.push_back(query("nosuchterm"));
+    // Repeat a query, which should only get run once.
+    queries.push_back(query(Xapian::Query::OP_OR, "the", "and", "of"));
+
+    vector<Xapian::MSet> msets = enquire.get_msets(queries, 0, 10);
+    TEST_EQUAL(msets.size(), queries.size());
+    TEST_EQUAL(enquire.get_query().get_description(), orig.get_description());
+
+    for (size_t i = 0; i != queries.size(); ++i) {
+	enquire.set_query(queries[i]);
+	Xapian::MSet mset = enquire.get_mset(0, 10);
+	TEST_EQUAL(msets[i].size(), mset.size());
+	TEST(mset_range_is_same(msets[i], 0, mset, 0, mset.size()));
+	TEST_EQUAL(msets[i].get_matches_estimated(),
+		   mset.get_matches_estimated());
+	TEST_EQUAL(msets[i].get_termfreq("and"), mset.get_termfreq("and"));
+    }
+    TEST_EQUAL(msets[0].size(), 10);
+    TEST_EQUAL(msets[2].size(), 0);
+    TEST_EQUAL(msets[4].size(), 0);
+
+    msets = enquire.get_msets(vector<Xapian::Query>(), 0, 10);
+    TEST(msets.empty());
+
+    return true;
+}
+
 // tests the allow query terms expand option
 DEFINE_TESTCASE(allowqterms1, backend) {
     Xapian::Enquire enquire(get_database("apitest_simpledata"));
@@ -1175,6 +1290,68 @@ DEFINE_TESTCASE(fetchdocs1, backend) {
     return true;
 }
 
+// Test that prefetched documents have the right data and values, including
+// after the database is modified.
+DEFINE_TESTCASE(fetchdocs2, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+    for (int i = 1; i <= 10; ++i) {
+	Xapian::Document doc;
+	doc.set_data("doc " + str(i));
+	doc.add_term("all");
+	if (i % 3) {
+	    doc.add_value(1, "one " + str(i));
+	    doc.add_value(i + 1, "slot " + str(i));
+	}
+	db.add_document(doc);
+    }
+    db.commit();
+
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("all"));
+    enquire.set_docid_order(enquire.ASCENDING);
+    Xapian::MSet mset = enquire.get_mset(0, 10);
+    TEST_EQUAL(mset.size(), 10);
+
+    // Only fetch some of the documents, so the others are fetched on demand.
+    mset.fetch(mset[2], mset[6]);
+    for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i) {
+	Xapian::Document doc = i.get_document();
+	Xapian::docid did = *i;
+	TEST_EQUAL(doc.get_data(), "doc " + str(did));
+	if (did % 3) {
+	    TEST_EQUAL(doc.values_count(), 2);
+	    TEST_EQUAL(doc.get_value(1), "one " + str(did));
+	    TEST_EQUAL(doc.get_value(did + 1), "slot " + str(did));
+	} else {
+	    TEST_EQUAL(doc.values_count(), 0);
+	}
+	// Opening the same document again should give the same answer.
+	TEST_EQUAL(i.get_document().get_data(), doc.get_data());
+    }
+
+    // Documents fetched before a change shouldn't be returned after it.
+    mset.fetch();
+    TEST_EQUAL(mset[4].get_document().get_data(), "doc 5");
+    Xapian::Document doc;
+    doc.set_data("new 5");
+    doc.add_value(7, "seven");
+    db.replace_document(5, doc);
+    db.delete_document(6);
+    doc = mset[4].get_document();
+    TEST_EQUAL(doc.get_data(), "new 5");
+    TEST_EQUAL(doc.values_count(), 1);
+    TEST_EQUAL(doc.get_value(7), "seven");
+    TEST_EXCEPTION(Xapian::DocNotFoundError, db.get_document(6));
+
+    // Fetching a document which no longer exists should only fail when it's
+    // actually wanted.
+    mset.fetch();
+    TEST_EQUAL(mset[6].get_document().get_data(), "doc 7");
+    TEST_EXCEPTION(Xapian::DocNotFoundError, db.get_document(6));
+
+    return true;
+}
+
 // test that searching for a term not in the database fails nicely
 DEFINE_TESTCASE(absentterm1, backend) {
     Xapian::Enquire enquire(get_database("apitest_simpledata"));
@@ -546,6 +546,55 @@ DEFINE_TESTCASE(databasemodified1, writable && !inmemory && !remote && !multi) {
     return true;
 }
 
+/// Check cached term statistics are updated when the revision changes.
+DEFINE_TESTCASE(termstatscache1, writable && !inmemory) {
+    Xapian::WritableDatabase db = get_writable_database();
+    Xapian::Document doc;
+    doc.add_term("foo", 3);
+    db.add_document(doc);
+    db.commit();
+
+    Xapian::Database rodb = get_writable_database_as_database();
+    TEST_EQUAL(rodb.get_termfreq("foo"), 1);
+    TEST_EQUAL(rodb.get_collection_freq("foo"), 3);
+    TEST_EQUAL(rodb.get_wdf_upper_bound("foo"), 3);
+
+    doc.add_term("foo", 2);
+    db.add_document(doc);
+    db.commit();
+
+    // Until reopened, we should still see the old revision.
+    TEST_EQUAL(rodb.get_termfreq("foo"), 1);
+    TEST_EQUAL(rodb.get_collection_freq("foo"), 3);
+
+    TEST(rodb.reopen());
+    TEST_EQUAL(rodb.get_termfreq("foo"), 2);
+    TEST_EQUAL(rodb.get_collection_freq("foo"), 8);
+    TEST_REL(rodb.get_wdf_upper_bound("foo"), >=, 5);
+
+    // Check disabling the cache still gives the right answers.
+    rodb.set_term_stats_cache_size(0);
+    TEST_EQUAL(rodb.get_termfreq("foo"), 2);
+    TEST_EQUAL(rodb.get_collection_freq("foo"), 8);
+
+    rodb.set_term_stats_cache_size(1);
+    const char* terms_path = "termstatscache1.terms";
+    {
+	ofstream out(terms_path);
+	out << "foo\n\nbar\n";
+    }
+    TEST_EQUAL(rodb.warm_term_stats_cache(terms_path), 2);
+    unlink(terms_path);
+    TEST_EQUAL(rodb.get_termfreq("bar"), 0);
+    TEST_EQUAL(rodb.get_termfreq("foo"), 2);
+    TEST_EQUAL(rodb.get_collection_freq("foo"), 8);
+
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   rodb.warm_term_stats_cache(terms_path));
+
+    return true;
+}
+
 /// Regression test for bug#462 fixed in 1.0.19 and 1.1.5.
 DEFINE_TESTCASE(qpmemoryleak1, writable && !inmemory) {
     // Inmemory never throws DatabaseModifiedError.
@@ -1755,3 +1804,52 @@ DEFINE_TESTCASE(splitpostings1, writable) {
 
     return true;
 }
+
+/// Check iterating and skipping through long postlists.
+DEFINE_TESTCASE(longpostlist1, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+    for (Xapian::docid did = 1; did <= 10000; ++did) {
+	Xapian::Document doc;
+	doc.add_term("all", did % 7 + 1);
+	if (did % 3 == 0) doc.add_term("third");
+	db.add_document(doc);
+    }
+    db.commit();
+
+    Xapian::docid expect = 1;
+    for (auto p = db.postlist_begin("all"); p != db.postlist_end("all"); ++p) {
+	TEST_EQUAL(*p, expect);
+	TEST_EQUAL(p.get_wdf(), expect % 7 + 1);
+	++expect;
+    }
+    TEST_EQUAL(expect, 10001);
+
+    // Skip forwards by varying amounts, including within and beyond the
+    // postings which have already been read.
+    Xapian::PostingIterator p = db.postlist_begin("third");
+    TEST_EQUAL(*p, 3);
+    for (Xapian::docid did : { 4, 5, 1000, 1001, 1500, 3000, 3001, 9000,
+			       9998, 9999 }) {
+	p.skip_to(did);
+	TEST(p != db.postlist_end("third"));
+	TEST_EQUAL(*p, (did + 2) / 3 * 3);
+	TEST_EQUAL(p.get_wdf(), 1);
+    }
+    ++p;
+    TEST(p == db.postlist_end("third"));
+
+    p = db.postlist_begin("third");
+    p.skip_to(10000);
+    TEST(p == db.postlist_end("third"));
+
+    p = db.postlist_begin("all");
+    p.skip_to(5000);
+    Xapian::doccount count = 0;
+    while (p != db.postlist_end("all")) {
+	++count;
+	++p;
+    }
+    TEST_EQUAL(count, 5001);
+
+    return true;
+}
@@ -24,7 +24,10 @@
 
 #include <xapian.h>
 
+#include <map>
+
 #include "apitest.h"
+#include "str.h"
 #include "testutils.h"
 
 using namespace std;
@@ -108,3 +111,127 @@ DEFINE_TESTCASE(collapsekey6, backend) {
 
     return true;
 }
+
+static void
+make_collapsekey7_db(Xapian::WritableDatabase& db, const string&)
+{
+    for (int i = 0; i != 1000; ++i) {
+	Xapian::Document doc;
+	doc.add_term("all");
+	doc.add_term("wdf", i % 7 + 1);
+	// 250 distinct collapse key values, including some which only differ
+	// in their final byte, and an embedded zero byte.
+	string key = "key";
+	key += str(i % 250 / 10);
+	key += char(i % 10);
+	doc.add_value(0, key);
+	db.add_document(doc);
+    }
+}
+
+/// Test collapsing with enough distinct keys to need the table to grow.
+DEFINE_TESTCASE(collapsekey7, generated) {
+    Xapian::Database db = get_database("collapsekey7", make_collapsekey7_db);
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query(Xapian::Query::OP_OR,
+				    Xapian::Query("all"),
+				    Xapian::Query("wdf")));
+
+    for (Xapian::doccount cmax = 1; cmax <= 4; ++cmax) {
+	tout << "cmax = " << cmax << endl;
+	enquire.set_collapse_key(0, cmax);
+	Xapian::MSet mset = enquire.get_mset(0, 1000);
+	TEST_EQUAL(mset.size(), 250 * cmax);
+	TEST_EQUAL(mset.get_matches_lower_bound(), 250 * cmax);
+	map<string, Xapian::doccount> seen;
+	for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i) {
+	    const string& key = i.get_collapse_key();
+	    TEST_EQUAL(i.get_document().get_value(0), key);
+	    TEST_EQUAL(i.get_collapse_count(), 4 - cmax);
+	    TEST(++seen[key] <= cmax);
+	}
+	TEST_EQUAL(seen.size(), 250);
+    }
+
+    return true;
+}
+
+static void
+make_collapsekey8_db(Xapian::WritableDatabase& db, const string&)
+{
+    for (Xapian::docid did = 1; did <= 200; ++did) {
+	Xapian::Document doc;
+	doc.add_term("all");
+	doc.add_value(0, "c" + str(did % 7));
+	// Unique sort keys in a different order to the docids.
+	string sort_key = str(did * 37 % 200);
+	sort_key.insert(0, 3 - sort_key.size(), '0');
+	doc.add_value(1, sort_key);
+	doc.add_value(2, "unused");
+	doc.add_value(3, did % 3 ? "yes" : "no");
+	doc.add_value(4, str(did % 4));
+	db.add_document(doc);
+    }
+}
+
+/// MatchDecider which reads value slot 3.
+class Slot3Decider : public Xapian::MatchDecider {
+  public:
+    bool operator()(const Xapian::Document& doc) const {
+	return doc.get_value(3) == "yes";
+    }
+};
+
+/** Test collapsing and sorting read the right slots when other slots are
+ *  read for each candidate too.
+ */
+DEFINE_TESTCASE(collapsekey8, generated && !remote) {
+    Xapian::Database db = get_database("collapsekey8", make_collapsekey8_db);
+
+    // Work out the expected result: the document with the lowest sort key
+    // for each collapse key, ignoring those the decider rejects.
+    map<string, pair<string, Xapian::docid>> best;
+    for (Xapian::docid did = 1; did <= db.get_doccount(); ++did) {
+	Xapian::Document doc = db.get_document(did);
+	if (doc.get_value(3) != "yes") continue;
+	auto sort_key_and_did = make_pair(doc.get_value(1), did);
+	auto i = best.find(doc.get_value(0));
+	if (i == best.end()) {
+	    best.emplace(doc.get_value(0), sort_key_and_did);
+	} else if (sort_key_and_did < i->second) {
+	    i->second = sort_key_and_did;
+	}
+    }
+    map<string, Xapian::docid> expected;
+    for (auto&& i : best)
+	expected.insert(i.second);
+
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("all"));
+    enquire.set_collapse_key(0);
+    enquire.set_sort_by_value(1, false);
+    Xapian::ValueCountMatchSpy spy(4);
+    enquire.add_matchspy(&spy);
+    Slot3Decider decider;
+    Xapian::MSet mset = enquire.get_mset(0, 100, 0, NULL, &decider);
+
+    TEST_EQUAL(mset.size(), expected.size());
+    auto e = expected.begin();
+    for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i, ++e) {
+	Xapian::Document doc = i.get_document();
+	TEST_EQUAL(*i, e->second);
+	TEST_EQUAL(i.get_collapse_key(), doc.get_value(0));
+	TEST_EQUAL(i.get_sort_key(), doc.get_value(1));
+    }
+
+    // The spy should only have seen values from slot 4.
+    Xapian::doccount total = 0;
+    for (auto v = spy.values_begin(); v != spy.values_end(); ++v) {
+	TEST((*v).size() == 1 && (*v)[0] >= '0' && (*v)[0] <= '3');
+	total += v.get_termfreq();
+    }
+    TEST_EQUAL(total, spy.get_total());
+    TEST_REL(total, >=, mset.size());
+
+    return true;
+}
@@ -27,6 +27,8 @@
 #include "api_db.h"
 
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <map>
 #include <string>
@@ -34,11 +36,22 @@
 #include "safenetdb.h" // For gai_strerror().
 #include "safesysstat.h" // For mkdir().
 #include "safeunistd.h" // For sleep().
+#if defined HAVE_FORK && defined HAVE_POLL
+# include <csignal>
+# include <cerrno>
+# include <poll.h>
+# include <netinet/in.h>
+# include <arpa/inet.h>
+# include "safesyssocket.h"
+# include "safesyswait.h"
+#endif
 
 #include <xapian.h>
 
 #include "backendmanager.h"
 #include "backendmanager_local.h"
+#include "str.h"
+#include "stringutils.h"
 #include "testsuite.h"
 #include "testutils.h"
 #include "unixcmds.h"
@@ -231,6 +244,137 @@ DEFINE_TESTCASE(stubdb2, path) {
     return true;
 }
 
+static void
+make_remotecompress1_db(Xapian::WritableDatabase& db, const string&)
+{
+    for (int i = 1; i <= 1000; ++i) {
+	Xapian::Document doc;
+	doc.set_data(string(2000, char('a' + i % 26)) + str(i));
+	doc.add_term("all");
+	doc.add_term("Q" + str(i));
+	db.add_document(doc);
+    }
+    db.commit();
+}
+
+// Check a remote server which compresses messages.
+DEFINE_TESTCASE(remotecompress1, generated && path) {
+    string path = get_database_path("remotecompress1",
+				    make_remotecompress1_db);
+    mkdir(".stub", 0755);
+    const char * dbpath = ".stub/remotecompress1";
+    ofstream out(dbpath);
+    TEST(out.is_open());
+    out << "remote :" << BackendManager::get_xapian_progsrv_command()
+	<< " --compress " << path << endl;
+    out.close();
+
+    Xapian::Database db(path);
+    Xapian::Database remote;
+    try {
+	remote = Xapian::Database(dbpath, Xapian::DB_BACKEND_STUB);
+    } catch (Xapian::FeatureUnavailableError&) {
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+	throw;
+#endif
+	SKIP_TEST("Remote backend not enabled");
+    }
+
+    // A big MSet and a query big enough to be compressed when sent.
+    vector<Xapian::Query> subqs;
+    for (int i = 1; i <= 500; ++i)
+	subqs.push_back(Xapian::Query("Q" + str(i)));
+    Xapian::Query queries[] = {
+	Xapian::Query("all"),
+	Xapian::Query(Xapian::Query::OP_OR, subqs.begin(), subqs.end())
+    };
+    for (auto&& query : queries) {
+	Xapian::Enquire enq(db);
+	enq.set_query(query);
+	Xapian::MSet mset = enq.get_mset(0, 1000);
+	Xapian::Enquire remote_enq(remote);
+	remote_enq.set_query(query);
+	Xapian::MSet remote_mset = remote_enq.get_mset(0, 1000);
+	TEST(mset_range_is_same(mset, 0, remote_mset, 0, mset.size()));
+	TEST_EQUAL(mset.size(), remote_mset.size());
+    }
+
+    for (Xapian::docid did = 1; did <= 1000; did += 99) {
+	TEST_EQUAL(remote.get_document(did).get_data(),
+		   db.get_document(did).get_data());
+    }
+
+    return true;
+}
+
+/// Test the remote server's query caches.
+DEFINE_TESTCASE(remotecache1, path) {
+    string path = get_database_path("apitest_simpledata");
+    mkdir(".stub", 0755);
+    const char * dbpath = ".stub/remotecache1";
+    ofstream out(dbpath);
+    TEST(out.is_open());
+    out << "remote :" << BackendManager::get_xapian_progsrv_command()
+	<< " --cache-size 100000 " << path << endl;
+    out.close();
+
+    Xapian::Database db(path);
+    Xapian::Database remote;
+    try {
+	remote = Xapian::Database(dbpath, Xapian::DB_BACKEND_STUB);
+    } catch (Xapian::FeatureUnavailableError&) {
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+	throw;
+#endif
+	SKIP_TEST("Remote backend not enabled");
+    }
+    // A local database has no server caches to report on.
+    TEST_EQUAL(db.get_server_status().find("results_cache_"), string::npos);
+    TEST_EQUAL(server_stat(remote, "results_cache_hits"), 0);
+    TEST_EQUAL(server_stat(remote, "results_cache_max_size"), 100000);
+
+    Xapian::Query query(Xapian::Query::OP_OR,
+			Xapian::Query("word"), Xapian::Query("paragraph"));
+    Xapian::Enquire enq(db);
+    enq.set_query(query);
+    Xapian::MSet mset = enq.get_mset(0, 10);
+
+    // With a single shard, the stats aren't exchanged so only the results
+    // cache is used.
+    Xapian::Enquire remote_enq(remote);
+    remote_enq.set_query(query);
+    for (unsigned hits = 0; hits != 2; ++hits) {
+	Xapian::MSet remote_mset = remote_enq.get_mset(0, 10);
+	TEST(mset_range_is_same(mset, 0, remote_mset, 0, mset.size()));
+	TEST_EQUAL(server_stat(remote, "results_cache_hits"), hits);
+	TEST_EQUAL(server_stat(remote, "results_cache_misses"), 1);
+    }
+    TEST_EQUAL(server_stat(remote, "stats_cache_misses"), 0);
+
+    // A different range is a different entry.
+    remote_enq.get_mset(0, 5);
+    TEST_EQUAL(server_stat(remote, "results_cache_misses"), 2);
+    TEST_EQUAL(server_stat(remote, "results_cache_entries"), 2);
+
+    // Combined with a local shard, the stats are exchanged.
+    Xapian::Database combined(db);
+    combined.add_database(remote);
+    Xapian::Enquire combined_enq(combined);
+    combined_enq.set_query(query);
+    Xapian::MSet first_mset = combined_enq.get_mset(0, 10);
+    Xapian::MSet second_mset = combined_enq.get_mset(0, 10);
+    TEST(mset_range_is_same(first_mset, 0, second_mset, 0, first_mset.size()));
+    TEST_EQUAL(server_stat(remote, "stats_cache_misses"), 1);
+    TEST_EQUAL(server_stat(remote, "stats_cache_hits"), 1);
+    TEST_EQUAL(server_stat(remote, "results_cache_hits"), 2);
+
+    // Reopening at the same revision keeps the cached entries.
+    TEST(!remote.reopen());
+    TEST_EQUAL(server_stat(remote, "results_cache_entries"), 3);
+
+    return true;
+}
+
 // Regression test - bad entries were ignored after a good entry prior to 1.0.8.
 DEFINE_TESTCASE(stubdb3, path) {
     mkdir(".stub", 0755);
@@ -909,6 +1053,516 @@ DEFINE_TESTCASE(keepalive1, remote) {
     return true;
 }
 
+/** Find the host and port of a remote TCP database.
+ *
+ *  @return false if @a db isn't a remote TCP database.
+ */
+static bool
+get_tcp_host_and_port(const Xapian::Database& db, string& host, int& port)
+{
+    string desc = db.get_description();
+    size_t i = desc.find("remote:tcp(");
+    if (i == string::npos)
+	return false;
+    i += CONST_STRLEN("remote:tcp(");
+    size_t colon = desc.find(':', i);
+    size_t end = desc.find(')', colon);
+    host.assign(desc, i, colon - i);
+    port = atoi(desc.c_str() + colon + 1);
+    TEST(end != string::npos);
+    TEST(port != 0);
+    return true;
+}
+
+#if defined HAVE_FORK && defined HAVE_POLL
+/** Relays a TCP connection to a server, and can hold back the replies.
+ *
+ *  This lets us test what happens when a server is slow to reply.  The
+ *  relaying is done by a child process, which handles a single connection.
+ */
+class ReplyHolder {
+    pid_t child = -1;
+
+    /// Socket to send commands to the child over.
+    int control = -1;
+
+    int port = 0;
+
+    void command(char ch) {
+	if (write(control, &ch, 1) != 1)
+	    FAIL_TEST("Failed to send command to relay");
+    }
+
+    [[noreturn]]
+    static void relay(int listener, int ctl, const string& host,
+		      int server_port);
+
+  public:
+    ReplyHolder(const string& host, int server_port);
+
+    ~ReplyHolder();
+
+    /// The port to connect to for the relayed connection.
+    int get_port() const { return port; }
+
+    /// Stop passing on data from the server.
+    void hold() { command('h'); }
+
+    /// Pass on data from the server again, including anything held back.
+    void resume() { command('r'); }
+
+    /** Wait for the relayed connection to be closed.
+     *
+     *  @return true if it was closed within @a secs seconds.
+     */
+    bool wait_for_close(int secs);
+};
+
+void
+ReplyHolder::relay(int listener, int ctl, const string& host, int server_port)
+{
+    // A write to a closed connection should just fail.
+    signal(SIGPIPE, SIG_IGN);
+    int client = accept(listener, NULL, NULL);
+    close(listener);
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(server_port);
+    if (client < 0 || server < 0 ||
+	inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1 ||
+	connect(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+	_exit(1);
+    }
+
+    bool holding = false;
+    while (true) {
+	struct pollfd fds[3];
+	fds[0].fd = ctl;
+	fds[0].events = POLLIN;
+	fds[1].fd = client;
+	fds[1].events = POLLIN;
+	fds[2].fd = server;
+	fds[2].events = holding ? 0 : POLLIN;
+	if (poll(fds, 3, -1) < 0) {
+	    if (errno == EINTR) continue;
+	    _exit(1);
+	}
+	// Act on commands first, so that a command sent before a request
+	// takes effect before the reply to that request can be passed on.
+	if (fds[0].revents) {
+	    char ch;
+	    if (read(ctl, &ch, 1) != 1) _exit(0);
+	    holding = (ch == 'h');
+	}
+	char buf[4096];
+	if (fds[1].revents) {
+	    ssize_t n = read(client, buf, sizeof(buf));
+	    if (n <= 0 || write(server, buf, n) != n) _exit(0);
+	}
+	if (!holding && fds[2].revents) {
+	    ssize_t n = read(server, buf, sizeof(buf));
+	    if (n <= 0 || write(client, buf, n) != n) _exit(0);
+	}
+    }
+}
+
+ReplyHolder::ReplyHolder(const string& host, int server_port)
+{
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0)
+	FAIL_TEST("socket() failed");
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = 0;
+    SOCKLEN_T len = sizeof(addr);
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1 ||
+	bind(listener, reinterpret_cast<sockaddr*>(&addr), len) < 0 ||
+	listen(listener, 1) < 0 ||
+	getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len) < 0) {
+	close(listener);
+	FAIL_TEST("Failed to set up listening socket for relay");
+    }
+    port = ntohs(addr.sin_port);
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, PF_UNSPEC, fds) < 0) {
+	close(listener);
+	FAIL_TEST("socketpair() failed");
+    }
+    child = fork();
+    if (child == 0) {
+	close(fds[0]);
+	relay(listener, fds[1], host, server_port);
+    }
+    close(listener);
+    close(fds[1]);
+    if (child == -1) {
+	close(fds[0]);
+	FAIL_TEST("fork() failed");
+    }
+    control = fds[0];
+}
+
+ReplyHolder::~ReplyHolder()
+{
+    // The child may be waiting for a connection, so just kill it.
+    kill(child, SIGKILL);
+    close(control);
+    // If the remotetcp backend's SIGCHLD handler has already reaped the
+    // child, this will fail with ECHILD, which is fine.
+    int status;
+    while (waitpid(child, &status, 0) < 0 && errno == EINTR) { }
+}
+
+bool
+ReplyHolder::wait_for_close(int secs)
+{
+    // The child exits once the connection is closed, which closes its end
+    // of the control socket.
+    struct pollfd fds;
+    fds.fd = control;
+    fds.events = POLLIN;
+    fds.revents = 0;
+    int res;
+    do {
+	res = poll(&fds, 1, secs * 1000);
+    } while (res < 0 && errno == EINTR);
+    char ch;
+    return res > 0 && read(control, &ch, 1) == 0;
+}
+#endif
+
+/// Test reusing idle TCP connections.
+DEFINE_TESTCASE(remotepool1, remote) {
+    Xapian::Database db(get_remote_database("apitest_simpledata", 300000));
+    string host;
+    int port;
+    if (!get_tcp_host_and_port(db, host, port))
+	SKIP_TEST("Only supported for TCP connections");
+
+    // Make sure the idle connection is closed however the test ends, or
+    // the server won't exit.
+    struct PoolSizeResetter {
+	~PoolSizeResetter() { Xapian::Remote::set_connection_pool_size(0); }
+    } resetter;
+    Xapian::Remote::set_connection_pool_size(1);
+
+    Xapian::doccount doccount = db.get_doccount();
+    vector<Xapian::docid> docids;
+    {
+	Xapian::Enquire enq(db);
+	enq.set_query(Xapian::Query("word"));
+	Xapian::MSet mset = enq.get_mset(0, 10);
+	docids.assign(mset.begin(), mset.end());
+	TEST(!docids.empty());
+    }
+    // Releasing the last reference puts the connection in the pool.
+    db = Xapian::Database();
+
+    // The server was started with --one-shot, so this only works if the
+    // connection is reused.
+    Xapian::Database db2 = Xapian::Remote::open(host, port);
+    TEST_EQUAL(db2.get_doccount(), doccount);
+    Xapian::Enquire enq2(db2);
+    enq2.set_query(Xapian::Query("word"));
+    Xapian::MSet mset = enq2.get_mset(0, 10);
+    TEST(vector<Xapian::docid>(mset.begin(), mset.end()) == docids);
+
+    return true;
+}
+
+/// Check a connection which timed out waiting for a reply isn't reused.
+DEFINE_TESTCASE(remotepool2, remote) {
+#if defined HAVE_FORK && defined HAVE_POLL
+    if (!startswith(get_dbtype(), "remotetcp"))
+	SKIP_TEST("Only supported for TCP connections");
+    int port = get_remote_database_port("apitest_simpledata", 300000);
+    ReplyHolder holder("127.0.0.1", port);
+
+    struct PoolSizeResetter {
+	~PoolSizeResetter() { Xapian::Remote::set_connection_pool_size(0); }
+    } resetter;
+    Xapian::Remote::set_connection_pool_size(1);
+
+    {
+	Xapian::Database db = Xapian::Remote::open("127.0.0.1",
+						   holder.get_port(), 1000);
+	Xapian::Enquire enq(db);
+	enq.set_query(Xapian::Query("word"));
+	holder.hold();
+	TEST_EXCEPTION(Xapian::NetworkTimeoutError, enq.get_mset(0, 10));
+    }
+
+    // The reply is still on its way, so the connection should have been
+    // closed rather than put in the pool for reuse.
+    TEST(holder.wait_for_close(10));
+#else
+    SKIP_TEST("Test requires fork() and poll()");
+#endif
+    return true;
+}
+
+/// Check a child process doesn't reuse its parent's idle connections.
+DEFINE_TESTCASE(remotepool3, remote) {
+#if defined HAVE_FORK && defined HAVE_POLL
+    Xapian::Database db(get_remote_database("apitest_simpledata", 300000));
+    string host;
+    int port;
+    if (!get_tcp_host_and_port(db, host, port))
+	SKIP_TEST("Only supported for TCP connections");
+
+    struct PoolSizeResetter {
+	~PoolSizeResetter() { Xapian::Remote::set_connection_pool_size(0); }
+    } resetter;
+    Xapian::Remote::set_connection_pool_size(1);
+
+    Xapian::doccount doccount = db.get_doccount();
+    db = Xapian::Database();
+
+    int fds[2];
+    if (pipe(fds) < 0)
+	FAIL_TEST("pipe() failed");
+    pid_t child = fork();
+    if (child == -1)
+	FAIL_TEST("fork() failed");
+    if (child == 0) {
+	// The server was started with --one-shot, so the child can only open
+	// the database by reusing the parent's connection, which it mustn't.
+	char result = 'r';
+	try {
+	    Xapian::Database db2 = Xapian::Remote::open(host, port, 500, 500);
+	    (void)db2.get_doccount();
+	} catch (const Xapian::NetworkError&) {
+	    result = 'n';
+	} catch (...) {
+	    result = 'e';
+	}
+	if (write(fds[1], &result, 1) != 1)
+	    _exit(1);
+	_exit(0);
+    }
+    close(fds[1]);
+    char result = 0;
+    ssize_t n;
+    do {
+	n = read(fds[0], &result, 1);
+    } while (n < 0 && errno == EINTR);
+    close(fds[0]);
+    // The remotetcp backend's SIGCHLD handler may have reaped the child.
+    while (waitpid(child, NULL, 0) < 0 && errno == EINTR) { }
+    TEST_EQUAL(result, 'n');
+
+    // The parent can still use the connection.
+    Xapian::Database db2 = Xapian::Remote::open(host, port);
+    TEST_EQUAL(db2.get_doccount(), doccount);
+#else
+    SKIP_TEST("Test requires fork() and poll()");
+#endif
+    return true;
+}
+
+/// Check a connection with a reply still to come isn't kept for reuse.
+DEFINE_TESTCASE(remotepool4, remote) {
+#if defined HAVE_FORK && defined HAVE_POLL
+    if (!startswith(get_dbtype(), "remotetcp"))
+	SKIP_TEST("Only supported for TCP connections");
+    int port = get_remote_database_port("apitest_simpledata", 300000);
+    ReplyHolder holder("127.0.0.1", port);
+
+    struct PoolSizeResetter {
+	~PoolSizeResetter() { Xapian::Remote::set_connection_pool_size(0); }
+    } resetter;
+    Xapian::Remote::set_connection_pool_size(1);
+
+    // The remote shard unserialises this as a plain ValueCountMatchSpy.
+    struct ThrowingSpy : public Xapian::ValueCountMatchSpy {
+	ThrowingSpy() : Xapian::ValueCountMatchSpy(0) { }
+
+	void operator()(const Xapian::Document&, double) {
+	    throw Xapian::InvalidOperationError("Spy says no");
+	}
+    };
+
+    {
+	Xapian::Database db = Xapian::Remote::open("127.0.0.1",
+						   holder.get_port());
+	Xapian::WritableDatabase local(string(), Xapian::DB_BACKEND_INMEMORY);
+	Xapian::Document doc;
+	doc.add_term("word");
+	local.add_document(doc);
+	db.add_database(local);
+
+	// The query is sent to the remote shard before the local shard is
+	// searched, so the exception leaves the reply unread.
+	Xapian::Enquire enq(db);
+	enq.set_query(Xapian::Query("word"));
+	enq.set_remote_shard_stats(true);
+	ThrowingSpy spy;
+	enq.add_matchspy(&spy);
+	holder.hold();
+	TEST_EXCEPTION(Xapian::InvalidOperationError, enq.get_mset(0, 10));
+    }
+
+    // The reply is still on its way, so the connection should have been
+    // closed rather than put in the pool for reuse.
+    TEST(holder.wait_for_close(10));
+#else
+    SKIP_TEST("Test requires fork() and poll()");
+#endif
+    return true;
+}
+
+/// Test hedged queries over replicas of a shard.
+DEFINE_TESTCASE(remotereplicas1, remote) {
+    Xapian::Database db1 = get_remote_database("apitest_simpledata", 300000);
+    Xapian::Database db2 = get_remote_database("apitest_simpledata", 300000);
+
+    const char* terms[] = { "word", "paragraph", "this", "test" };
+    vector<vector<Xapian::docid>> expected;
+    for (auto term : terms) {
+	Xapian::Enquire enq(db2);
+	enq.set_query(Xapian::Query(term));
+	Xapian::MSet mset = enq.get_mset(0, 10);
+	expected.emplace_back(mset.begin(), mset.end());
+    }
+
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   Xapian::Remote::replica_set({}));
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   Xapian::Remote::replica_set({db1, db2}, 0.0));
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   Xapian::Remote::replica_set({db1, db1}));
+
+    // Use a low percentile so that many of the queries get hedged.
+    Xapian::Database db = Xapian::Remote::replica_set({db1, db2}, 1.0);
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   Xapian::Remote::replica_set({db2, db}));
+    for (int i = 0; i != 50; ++i) {
+	size_t j = i % (sizeof(terms) / sizeof(terms[0]));
+	Xapian::Enquire enq(db);
+	enq.set_query(Xapian::Query(terms[j]));
+	Xapian::MSet mset = enq.get_mset(0, 10);
+	TEST(vector<Xapian::docid>(mset.begin(), mset.end()) == expected[j]);
+	TEST_EQUAL(db.get_document(1).get_data(), db2.get_document(1).get_data());
+    }
+
+    // The databases passed in are left alone, so can be used in another
+    // replica set.
+    Xapian::Database other = Xapian::Remote::replica_set({db2, db1});
+    TEST_EQUAL(other.get_doccount(), db2.get_doccount());
+
+    // A replica which fails is skipped.
+    Xapian::Database db3 = get_remote_database("apitest_simpledata", 300000);
+    Xapian::Database db4 = get_remote_database("apitest_simpledata", 300000);
+    db3.close();
+    db = Xapian::Remote::replica_set({db3, db4});
+    // Operations other than queries use a working replica too.
+    TEST_EQUAL(db.get_doccount(), db4.get_doccount());
+    TEST_EQUAL(db.get_termfreq("word"), db4.get_termfreq("word"));
+    TEST_EQUAL(db.get_document(1).get_data(), db4.get_document(1).get_data());
+    TEST_EQUAL(db.get_metadata("foo"), db4.get_metadata("foo"));
+    TEST(db.reopen() == false);
+    for (size_t j = 0; j != sizeof(terms) / sizeof(terms[0]); ++j) {
+	Xapian::Enquire enq(db);
+	enq.set_query(Xapian::Query(terms[j]));
+	Xapian::MSet mset = enq.get_mset(0, 10);
+	TEST(vector<Xapian::docid>(mset.begin(), mset.end()) == expected[j]);
+    }
+    // Including queries which use the combined statistics.
+    {
+	Xapian::Database combined(db);
+	combined.add_database(db2);
+	Xapian::Enquire enq(combined);
+	enq.set_query(Xapian::Query("word"));
+	TEST(enq.get_mset(0, 10).size() > 0);
+    }
+
+    return true;
+}
+
+/// Check a slow replica doesn't hold up fetching documents.
+DEFINE_TESTCASE(remotereplicas2, remote) {
+#if defined HAVE_FORK && defined HAVE_POLL
+    if (!startswith(get_dbtype(), "remotetcp"))
+	SKIP_TEST("Only supported for TCP connections");
+    int port = get_remote_database_port("apitest_simpledata", 300000);
+    ReplyHolder holder("127.0.0.1", port);
+    // If we end up waiting for the held replica, this short timeout means
+    // that we get an exception rather than succeeding slowly.
+    Xapian::Database db1 = Xapian::Remote::open("127.0.0.1",
+						holder.get_port(), 5000);
+    Xapian::Database db2 = get_remote_database("apitest_simpledata", 300000);
+    Xapian::Database db = Xapian::Remote::replica_set({db1, db2}, 50.0);
+
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query("word"));
+    Xapian::MSet expected = enq.get_mset(0, 10);
+    TEST(!expected.empty());
+    // Record enough query times for hedging to start.
+    for (int i = 0; i != 10; ++i) {
+	(void)enq.get_mset(0, 10);
+    }
+
+    // The first replica won't reply, so the query should be answered by the
+    // second, and the documents fetched from it too.
+    holder.hold();
+    Xapian::MSet mset = enq.get_mset(0, 10);
+    TEST(mset_range_is_same(mset, 0, expected, 0, expected.size()));
+    mset.fetch();
+    for (auto i = mset.begin(); i != mset.end(); ++i) {
+	Xapian::docid did = *i;
+	TEST_EQUAL(i.get_document().get_data(),
+		   db2.get_document(did).get_data());
+	TEST_EQUAL(db.get_doclength(did), db2.get_doclength(did));
+	TEST_EQUAL(db.get_document(did).termlist_count(),
+		   db2.get_document(did).termlist_count());
+    }
+
+    // Once the first replica has replied, everything should still work.
+    holder.resume();
+    for (int i = 0; i != 10; ++i) {
+	mset = enq.get_mset(0, 10);
+	TEST(mset_range_is_same(mset, 0, expected, 0, expected.size()));
+	TEST_EQUAL(mset.begin().get_document().get_data(),
+		   db2.get_document(*mset.begin()).get_data());
+    }
+#else
+    SKIP_TEST("Test requires fork() and poll()");
+#endif
+    return true;
+}
+
+/// Check a replica which failed is retried after a while.
+DEFINE_TESTCASE(remotereplicas3, remote) {
+    // Each remotetcp server only accepts one connection, so we can't
+    // reconnect to it.
+    if (startswith(get_dbtype(), "remotetcp"))
+	SKIP_TEST("Only supported for remoteprog");
+    Xapian::Database db1 = get_remote_database("apitest_simpledata", 300000);
+    Xapian::Database db2 = get_remote_database("apitest_simpledata", 300000);
+    Xapian::doccount termfreq = db2.get_termfreq("word");
+    Xapian::Database db = Xapian::Remote::replica_set({db1, db2});
+
+    // The first replica fails, so the second gets used.
+    db1.close();
+    TEST_EQUAL(db.get_termfreq("word"), termfreq);
+
+    // Until the first replica is due a retry, there's no working replica.
+    db2.close();
+    TEST_EXCEPTION(Xapian::DatabaseClosedError, db.get_termfreq("word"));
+
+    // Then a new connection to it gets used.
+    sleep(2);
+    TEST_EQUAL(db.get_termfreq("word"), termfreq);
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query("word"));
+    TEST_EQUAL(enq.get_mset(0, 10).size(), termfreq);
+    return true;
+}
+
 // test that iterating through all terms in a database works.
 DEFINE_TESTCASE(allterms1, backend) {
     Xapian::Database db(get_database("apitest_allterms"));
@@ -1760,6 +2414,50 @@ DEFINE_TESTCASE(netstats1, remote) {
     return true;
 }
 
+// Test remote shards weighting with their own statistics.
+DEFINE_TESTCASE(remoteshardstats1, remote) {
+    BackendManagerLocal local_manager(test_driver::get_srcdir() + "/testdata/");
+
+    static const char * const words[] = { "paragraph", "word", "this" };
+    Xapian::Query query(Xapian::Query::OP_OR, words, words + 3);
+    const char * dbnames[] = { "apitest_simpledata", "apitest_simpledata2" };
+
+    Xapian::Database db;
+    for (auto dbname : dbnames)
+	db.add_database(get_database(dbname));
+    Xapian::Enquire enq(db);
+    enq.set_query(query);
+    enq.set_remote_shard_stats(true);
+    Xapian::MSet mset = enq.get_mset(0, 100);
+
+    // Each document should have the weight it gets when its shard is
+    // searched alone.
+    Xapian::doccount total_size = 0;
+    Xapian::doccount termfreq = 0;
+    for (size_t shard = 0; shard != 2; ++shard) {
+	Xapian::Database shard_db =
+	    local_manager.get_database(dbnames[shard]);
+	Xapian::Enquire shard_enq(shard_db);
+	shard_enq.set_query(query);
+	Xapian::MSet shard_mset = shard_enq.get_mset(0, 100);
+	total_size += shard_mset.size();
+	termfreq += shard_mset.get_termfreq("paragraph");
+	for (auto i = shard_mset.begin(); i != shard_mset.end(); ++i) {
+	    Xapian::docid did = (*i - 1) * 2 + shard + 1;
+	    Xapian::MSetIterator j = mset.begin();
+	    while (j != mset.end() && *j != did) ++j;
+	    TEST(j != mset.end());
+	    TEST_EQUAL_DOUBLE(j.get_weight(), i.get_weight());
+	}
+    }
+    TEST_EQUAL(mset.size(), total_size);
+
+    // The MSet's statistics should cover both shards.
+    TEST_EQUAL(mset.get_termfreq("paragraph"), termfreq);
+
+    return true;
+}
+
 // Coordinate matching - scores 1 for each matching term
 class MyWeight : public Xapian::Weight {
     double scale_factor;
@@ -28,6 +28,7 @@
 #include <xapian.h>
 
 #include "apitest.h"
+#include "str.h"
 #include "testsuite.h"
 #include "testutils.h"
 
@@ -431,3 +432,136 @@ DEFINE_TESTCASE(valuerangematchesub1, backend) {
     TEST_REL(mset.get_matches_estimated(), <=, db.get_doccount() / 3);
     return true;
 }
+
+static void
+make_valuerangeplan_db(Xapian::WritableDatabase &db, const string &)
+{
+    for (int i = 1; i <= 100; ++i) {
+	Xapian::Document doc;
+	doc.add_value(0, str(1000 + i));
+	if (i % 10 == 0) doc.add_term("rare");
+	if (i % 3 == 0) {
+	    doc.add_posting("red", 1);
+	    doc.add_posting("apple", 2);
+	    doc.add_posting("pie", 3);
+	} else {
+	    doc.add_posting("apple", 1);
+	    doc.add_posting("red", 2);
+	    doc.add_posting("pie", 5);
+	}
+	db.add_document(doc);
+    }
+}
+
+/// PostingSource matching every document, which counts how it's advanced.
+class CountingAllPostingSource : public Xapian::PostingSource {
+  public:
+    /// Counts shared by all clones.
+    struct Counts {
+	unsigned nexts = 0;
+
+	unsigned skips = 0;
+    };
+
+  private:
+    Counts& counts;
+
+    Xapian::docid did = 0;
+
+    Xapian::docid last_docid = 0;
+
+    Xapian::doccount termfreq_est = 0;
+
+  public:
+    explicit CountingAllPostingSource(Counts& counts_) : counts(counts_) { }
+
+    PostingSource* clone() const {
+	return new CountingAllPostingSource(counts);
+    }
+
+    void init(const Xapian::Database& db) {
+	did = 0;
+	last_docid = db.get_lastdocid();
+	// Claim fewer matches than there are, but more than the estimate for
+	// the value range in valuerangeplan1, so this would be checked rather
+	// than iterated if only the termfreq estimates were considered.
+	termfreq_est = db.get_doccount() * 3 / 10;
+    }
+
+    Xapian::doccount get_termfreq_min() const { return 0; }
+
+    Xapian::doccount get_termfreq_est() const { return termfreq_est; }
+
+    Xapian::doccount get_termfreq_max() const { return last_docid; }
+
+    void next(double) {
+	++counts.nexts;
+	++did;
+    }
+
+    void skip_to(Xapian::docid to_did, double) {
+	++counts.skips;
+	if (to_did > did) did = to_did;
+    }
+
+    bool at_end() const { return did > last_docid; }
+
+    Xapian::docid get_docid() const { return did; }
+
+    string get_description() const { return "CountingAllPostingSource"; }
+};
+
+/** Check a mix of a value range, positional filters and a term.
+ *
+ *  The value range has the lowest estimated termfreq, but is the most
+ *  expensive to iterate, and the positional filters get reordered, so check
+ *  the results are still right, and that the range isn't the subquery which
+ *  gets iterated.
+ */
+DEFINE_TESTCASE(valuerangeplan1, generated) {
+    Xapian::Database db = get_database("valuerangeplan", make_valuerangeplan_db);
+    Xapian::Enquire enq(db);
+
+    Xapian::Query range(Xapian::Query::OP_VALUE_RANGE, 0, "1020", "1080");
+    const char* phrase[] = { "red", "apple" };
+    const char* near[] = { "apple", "pie" };
+    Xapian::Query query(Xapian::Query::OP_AND,
+			Xapian::Query(Xapian::Query::OP_NEAR,
+				      near, near + 2, 2),
+			Xapian::Query(Xapian::Query::OP_PHRASE,
+				      phrase, phrase + 2));
+    query = Xapian::Query(Xapian::Query::OP_AND, query, range);
+    query = Xapian::Query(Xapian::Query::OP_FILTER, query,
+			  Xapian::Query("rare"));
+    enq.set_query(query);
+    enq.set_docid_order(Xapian::Enquire::ASCENDING);
+    enq.set_weighting_scheme(Xapian::BoolWeight());
+    Xapian::MSet mset = enq.get_mset(0, 10);
+    mset_expect_order(mset, 30, 60);
+
+    // Here the range is the cheapest subquery to iterate.
+    query = Xapian::Query(Xapian::Query::OP_AND,
+			  Xapian::Query(Xapian::Query::OP_PHRASE,
+					phrase, phrase + 2),
+			  range);
+    enq.set_query(query);
+    mset = enq.get_mset(0, 100);
+    TEST_EQUAL(mset.size(), 20);
+    TEST_EQUAL(*mset[0], 21);
+    TEST_EQUAL(*mset[19], 78);
+
+    // Check which subquery gets iterated: the value range has the lower
+    // termfreq estimate, but has to scan every value in the slot, so the
+    // posting source should be iterated and the range just checked.
+    CountingAllPostingSource::Counts counts;
+    CountingAllPostingSource source(counts);
+    query = Xapian::Query(Xapian::Query::OP_AND, range, Xapian::Query(&source));
+    enq.set_query(query);
+    mset = enq.get_mset(0, 100);
+    TEST_EQUAL(mset.size(), 61);
+    tout << "next() calls " << counts.nexts << ", skip_to() calls "
+	 << counts.skips << endl;
+    TEST_EQUAL(counts.skips, 0);
+    TEST_REL(counts.nexts, >=, db.get_doccount());
+    return true;
+}
@@ -28,6 +28,7 @@
 #include <xapian.h>
 
 #include <string>
+#include <vector>
 #include "safeunistd.h"
 
 #include "str.h"
@@ -394,6 +395,154 @@ DEFINE_TESTCASE(valueweightsource3, valuestats && !multi) {
     return true;
 }
 
+/// ValueWeightPostingSource without the block maxima optimisation.
+class PlainValueWeightPostingSource : public Xapian::ValuePostingSource {
+  public:
+    explicit PlainValueWeightPostingSource(Xapian::valueno slot_)
+	: Xapian::ValuePostingSource(slot_) { }
+
+    PlainValueWeightPostingSource * clone() const {
+	return new PlainValueWeightPostingSource(get_slot());
+    }
+
+    void init(const Xapian::Database& database) {
+	Xapian::ValuePostingSource::init(database);
+	string upper_bound = database.get_value_upper_bound(get_slot());
+	set_maxweight(Xapian::sortable_unserialise(upper_bound));
+    }
+
+    double get_weight() const {
+	return Xapian::sortable_unserialise(get_value());
+    }
+};
+
+static void
+make_valueweightsourceblocks_db(Xapian::WritableDatabase& db, const string&)
+{
+    for (Xapian::docid did = 1; did <= 4000; ++did) {
+	Xapian::Document doc;
+	doc.add_term("all", 1 + did % 3);
+	if (did % 2 == 0) doc.add_term("even");
+	// Most documents have a low prior, but there's a range with high ones.
+	double prior = (did / 500 == 5) ? 5 + did % 7 : (did % 5) * 0.1;
+	doc.add_value(0, Xapian::sortable_serialise(prior));
+	db.add_document(doc);
+    }
+}
+
+/// Check ValueWeightPostingSource gives the same results using block maxima.
+DEFINE_TESTCASE(valueweightsourceblocks1, generated && !remote) {
+    Xapian::Database db = get_database("valueweightsourceblocks",
+				       make_valueweightsourceblocks_db);
+    Xapian::Enquire enq(db);
+    Xapian::ValueWeightPostingSource src(0);
+    PlainValueWeightPostingSource ref_src(0);
+
+    auto make_queries = [](Xapian::PostingSource* ps) {
+	vector<Xapian::Query> queries;
+	queries.emplace_back(ps);
+	queries.emplace_back(Xapian::Query::OP_OR,
+			     Xapian::Query("even"), Xapian::Query(ps));
+	queries.emplace_back(Xapian::Query::OP_AND_MAYBE,
+			     Xapian::Query("all"), Xapian::Query(ps));
+	queries.emplace_back(Xapian::Query::OP_OR,
+			     Xapian::Query("all"),
+			     Xapian::Query(Xapian::Query::OP_SCALE_WEIGHT,
+					   Xapian::Query(ps), 0.25));
+	return queries;
+    };
+    vector<Xapian::Query> queries = make_queries(&src);
+    vector<Xapian::Query> ref_queries = make_queries(&ref_src);
+
+    for (size_t i = 0; i != queries.size(); ++i) {
+	tout << queries[i] << endl;
+	for (Xapian::doccount size : { 1, 10, 100 }) {
+	    enq.set_query(ref_queries[i]);
+	    Xapian::MSet ref = enq.get_mset(0, size);
+	    enq.set_query(queries[i]);
+	    Xapian::MSet mset = enq.get_mset(0, size);
+	    TEST_EQUAL(mset.size(), ref.size());
+	    for (Xapian::doccount j = 0; j != mset.size(); ++j) {
+		TEST_EQUAL(*mset[j], *ref[j]);
+		TEST_EQUAL_DOUBLE(mset[j].get_weight(), ref[j].get_weight());
+	    }
+	}
+    }
+
+    return true;
+}
+
+/// Check ValueWeightPostingSource skips blocks with low values.
+DEFINE_TESTCASE(valueweightsourceblocks2, glass) {
+    Xapian::Database db = get_database("valueweightsourceblocks",
+				       make_valueweightsourceblocks_db);
+    Xapian::ValueWeightPostingSource src(0);
+    src.init(db);
+    TEST_EQUAL(src.get_maxweight(), 11);
+    src.next(4.0);
+    TEST(!src.at_end());
+    // Blocks are at least 128 documents, so the first one which needs to be
+    // checked is the one containing docid 2500.
+    TEST_REL(src.get_docid(), >, 2432);
+    TEST_REL(src.get_docid(), <=, 2500);
+    src.skip_to(3100, 4.0);
+    // Nothing after docid 3000 has a high enough value.
+    TEST(src.at_end());
+
+    // Once past the high values, the maxweight should be reduced.
+    src.init(db);
+    src.skip_to(3100, 0.0);
+    TEST(!src.at_end());
+    TEST_REL(src.get_maxweight(), <, 1.0);
+
+    return true;
+}
+
+/// Subclass which weights documents with low values highest.
+class InvertedValueWeightPostingSource
+    : public Xapian::ValueWeightPostingSource {
+  public:
+    explicit InvertedValueWeightPostingSource(Xapian::valueno slot_)
+	: Xapian::ValueWeightPostingSource(slot_) { }
+
+    InvertedValueWeightPostingSource * clone() const {
+	return new InvertedValueWeightPostingSource(get_slot());
+    }
+
+    double get_weight() const {
+	return 11.0 - Xapian::sortable_unserialise(get_value());
+    }
+};
+
+/// Check block maxima aren't used for subclasses which override get_weight().
+DEFINE_TESTCASE(valueweightsourceblocks3, glass) {
+    Xapian::Database db = get_database("valueweightsourceblocks",
+				       make_valueweightsourceblocks_db);
+    InvertedValueWeightPostingSource src(0);
+    src.init(db);
+    TEST_EQUAL(src.get_maxweight(), 11);
+    // The lowest values are the highest weights, so nothing can be skipped.
+    src.next(4.0);
+    TEST(!src.at_end());
+    TEST_EQUAL(src.get_docid(), 1);
+    src.skip_to(3100, 4.0);
+    TEST(!src.at_end());
+    TEST_EQUAL(src.get_docid(), 3100);
+    TEST_EQUAL(src.get_maxweight(), 11);
+
+    // The top documents are those with value 0.
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query(&src));
+    Xapian::MSet mset = enq.get_mset(0, 10);
+    TEST_EQUAL(mset.size(), 10);
+    for (auto i = mset.begin(); i != mset.end(); ++i) {
+	TEST_EQUAL(*i % 5, 0);
+	TEST_EQUAL_DOUBLE(i.get_weight(), 11.0);
+    }
+
+    return true;
+}
+
 // Check that fixedweightsource works correctly.
 DEFINE_TESTCASE(fixedweightsource1, backend) {
     Xapian::Database db(get_database("apitest_phrase"));
@@ -640,9 +789,6 @@ make_matchtimelimit1_db(Xapian::WritableDatabase &db, const string &)
 // SlowDecreasingValueWeightPostingSource on the remote).
 DEFINE_TESTCASE(matchtimelimit1, generated && !remote)
 {
-#ifndef HAVE_TIMER_CREATE
-    SKIP_TEST("Enquire::set_time_limit() not implemented for this platform");
-#endif
     Xapian::Database db = get_database("matchtimelimit1",
 				       make_matchtimelimit1_db);
 
@@ -661,6 +807,41 @@ DEFINE_TESTCASE(matchtimelimit1, generated && !remote)
     return true;
 }
 
+/// Test Enquire::set_time_limit() with hard set to true.
+DEFINE_TESTCASE(matchtimelimit2, generated && !remote)
+{
+    Xapian::Database db = get_database("matchtimelimit1",
+				       make_matchtimelimit1_db);
+
+    int count = 0;
+    SlowDecreasingValueWeightPostingSource src(count);
+    src.init(db);
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query(&src));
+
+    enquire.set_time_limit(1.5, true);
+
+    // Each candidate takes at least a second, so looking at all 20 can't
+    // finish within the time limit however loaded the machine is.  These
+    // checks don't depend on how long things actually take - a slow machine
+    // just means the time limit is reached after fewer candidates.
+    Xapian::MSet mset = enquire.get_mset(0, 10);
+    TEST(mset.is_partial());
+    // The clock is checked after every candidate when they're this slow, so
+    // the match should stop after the second at the latest.
+    TEST_REL(count, <=, 2);
+    TEST_REL(mset.size(), <=, Xapian::doccount(count));
+    // Any results should be the best of those seen.
+    if (!mset.empty())
+	TEST_EQUAL(*mset[0], 1);
+    TEST_REL(mset.get_matches_lower_bound(), >=, mset.size());
+    TEST_REL(mset.get_matches_lower_bound(), <=, mset.get_matches_estimated());
+    TEST_REL(mset.get_matches_estimated(), <=, mset.get_matches_upper_bound());
+    TEST_EQUAL(mset.get_matches_upper_bound(), db.get_doccount());
+
+    return true;
+}
+
 class CheckBoundsPostingSource
     : public Xapian::DecreasingValueWeightPostingSource {
   public:
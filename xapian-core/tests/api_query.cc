@@ -25,6 +25,10 @@
 
 #include <xapian.h>
 
+#include <set>
+
+#include "stringutils.h"
+
 #include "testsuite.h"
 #include "testutils.h"
 
@@ -541,6 +545,159 @@ DEFINE_TESTCASE(wildcard3, generated) {
     return true;
 }
 
+/// Check cached wildcard expansions are used correctly.
+DEFINE_TESTCASE(wildcardcache1, writable && !inmemory) {
+    Xapian::WritableDatabase wdb = get_writable_database();
+    for (auto term : { "abc", "xyz", "abd" }) {
+	Xapian::Document doc;
+	doc.add_term(term);
+	wdb.add_document(doc);
+    }
+    wdb.commit();
+
+    Xapian::Database db = get_writable_database_as_database();
+    Xapian::Enquire enq(db);
+    const Xapian::Query::op o = Xapian::Query::OP_WILDCARD;
+    const int first = Xapian::Query::WILDCARD_LIMIT_FIRST;
+    unsigned long long hits = 0, misses = 0;
+    for (int i = 0; i != 2; ++i) {
+	enq.set_query(Xapian::Query(o, "ab"));
+	TEST_EQUAL(enq.get_mset(0, 10).size(), 2);
+	// The expansion limit is part of the cache key.
+	enq.set_query(Xapian::Query(o, "ab", 1, first));
+	TEST_EQUAL(enq.get_mset(0, 10).size(), 1);
+	// An expansion which fails shouldn't be cached.
+	enq.set_query(Xapian::Query(o, "ab", 1));
+	TEST_EXCEPTION(Xapian::WildcardError, enq.get_mset(0, 10));
+	enq.set_query(Xapian::Query(Xapian::Query::OP_EDIT_DISTANCE, "abx",
+				    0, 0, Xapian::Query::OP_SYNONYM, 1));
+	TEST_EQUAL(enq.get_mset(0, 10).size(), 2);
+
+	auto new_hits = server_stat(db, "expansion_cache_hits");
+	auto new_misses = server_stat(db, "expansion_cache_misses");
+	tout << "Pass " << i << ": " << new_hits - hits << " hits, "
+	     << new_misses - misses << " misses" << endl;
+	if (i == 0) {
+	    TEST_EQUAL(new_hits, 0);
+	    TEST_REL(new_misses, >, 1);
+	} else {
+	    // Only the expansion which failed should miss again (and it stops
+	    // the match at the first shard it fails in).
+	    TEST_EQUAL(new_misses - misses, 1);
+	    TEST_EQUAL(new_hits - hits, misses - 1);
+	}
+	hits = new_hits;
+	misses = new_misses;
+    }
+
+    Xapian::Document doc;
+    doc.add_term("abe");
+    wdb.add_document(doc);
+    wdb.commit();
+
+    // The cached expansions are for the old revision.
+    TEST(db.reopen());
+    enq.set_query(Xapian::Query(o, "ab"));
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 3);
+    enq.set_query(Xapian::Query(Xapian::Query::OP_EDIT_DISTANCE, "abx",
+				0, 0, Xapian::Query::OP_SYNONYM, 1));
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 3);
+    // Both should have missed in the shard which was modified (another
+    // shard may not have changed revision, so could still get hits).
+    TEST_REL(server_stat(db, "expansion_cache_misses"), >=, misses + 2);
+
+    // Check disabling the cache still gives the right answers.
+    db.set_expansion_cache_size(0);
+    enq.set_query(Xapian::Query(o, "ab"));
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 3);
+    hits = server_stat(db, "expansion_cache_hits");
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 3);
+    // The remote server's cache isn't affected by set_expansion_cache_size().
+    if (!startswith(get_dbtype(), "remote"))
+	TEST_EQUAL(server_stat(db, "expansion_cache_hits"), hits);
+
+    return true;
+}
+
+/// Check WILDCARD_NGRAM_INDEX doesn't change which terms a wildcard matches.
+DEFINE_TESTCASE(ngramwildcard1, generated) {
+    Xapian::Database db = get_database("ngramwildcard1",
+				       [](Xapian::WritableDatabase& wdb,
+					  const string&)
+				       {
+					   static const char* const terms[] = {
+					       "XPphone", "XPtelephone",
+					       "Zphone", "ZZtelephone",
+					       "abc", "aphone", "headphones",
+					       "iphone", "one", "oneone",
+					       "ph\xc3\xb6ne", "phone",
+					       "smartphone", "telegraph",
+					       "telephone", "television",
+					       "xylophone"
+					   };
+					   for (auto t : terms) {
+					       Xapian::Document doc;
+					       doc.add_term(t);
+					       wdb.add_document(doc);
+					   }
+				       });
+
+    static const char* const patterns[] = {
+	"*phone", "*tele*", "*ph?ne", "tele*one", "a*phone", "XP*one",
+	"*zzz", "*one*one", "*phon", "*pho*e", "?elephone", "Z*phone"
+    };
+    Xapian::Enquire enq(db);
+    enq.set_weighting_scheme(Xapian::BoolWeight());
+    // Count the terms the expansions check against the pattern with and
+    // without the index.
+    unsigned long long checked_scan = 0, checked_index = 0;
+    for (auto pattern : patterns) {
+	for (int limit : { Xapian::Query::WILDCARD_LIMIT_ERROR,
+			   Xapian::Query::WILDCARD_LIMIT_FIRST }) {
+	    Xapian::termcount max_expansion =
+		(limit == Xapian::Query::WILDCARD_LIMIT_FIRST ? 2 : 0);
+	    int flags = limit | Xapian::Query::WILDCARD_PATTERN_GLOB;
+	    auto checked = server_stat(db, "wildcard_terms_checked");
+	    enq.set_query(Xapian::Query(Xapian::Query::OP_WILDCARD, pattern,
+					max_expansion, flags));
+	    Xapian::MSet mset1 = enq.get_mset(0, db.get_doccount());
+	    auto checked1 = server_stat(db, "wildcard_terms_checked");
+	    checked_scan += checked1 - checked;
+	    flags |= Xapian::Query::WILDCARD_NGRAM_INDEX;
+	    enq.set_query(Xapian::Query(Xapian::Query::OP_WILDCARD, pattern,
+					max_expansion, flags));
+	    Xapian::MSet mset2 = enq.get_mset(0, db.get_doccount());
+	    checked_index += server_stat(db, "wildcard_terms_checked") - checked1;
+	    tout << pattern << " limit " << limit << endl;
+	    TEST_EQUAL(mset1.size(), mset2.size());
+	    TEST(mset_range_is_same(mset1, 0, mset2, 0, mset1.size()));
+	}
+    }
+    tout << "Terms checked: " << checked_scan << " by scanning, "
+	 << checked_index << " using the index" << endl;
+    if (get_dbtype().find("inmemory") != string::npos) {
+	// Inmemory doesn't support revisions, so the flag is ignored.
+	TEST_EQUAL(checked_index, checked_scan);
+    } else {
+	TEST_REL(checked_index, <, checked_scan);
+	TEST_REL(checked_index, >, 0);
+    }
+
+    // Check the expected matches for a leading wildcard.
+    enq.set_query(Xapian::Query(Xapian::Query::OP_WILDCARD, "*phone", 0,
+				Xapian::Query::WILDCARD_PATTERN_GLOB |
+				Xapian::Query::WILDCARD_NGRAM_INDEX));
+    mset_expect_order(enq.get_mset(0, 20), 6, 8, 12, 13, 15, 17);
+
+    // Check the implicit trailing '*' is still applied with only the n-gram
+    // flag set.
+    enq.set_query(Xapian::Query(Xapian::Query::OP_WILDCARD, "tele", 0,
+				Xapian::Query::WILDCARD_NGRAM_INDEX));
+    mset_expect_order(enq.get_mset(0, 20), 14, 15, 16);
+
+    return true;
+}
+
 DEFINE_TESTCASE(dualprefixwildcard1, backend) {
     Xapian::Database db = get_database("apitest_simpledata");
     Xapian::Query q(Xapian::Query::OP_SYNONYM,
@@ -810,6 +967,57 @@ DEFINE_TESTCASE(dualprefixeditdist1, generated) {
     return true;
 }
 
+/// Check skipping terms by prefix doesn't change which terms match.
+DEFINE_TESTCASE(editdist2, generated) {
+    static const struct { const char* term; bool match; } terms[] = {
+	{ "aardvark", false },
+	{ "abc", false },
+	{ "ample", true },
+	{ "eaxmple", true },
+	{ "exa", false },
+	{ "exam", false },
+	{ "examination", false },
+	{ "example", true },
+	{ "exampleee", true },
+	{ "exampleeee", false },
+	{ "examples", true },
+	{ "exampel", true },
+	{ "examplz", true },
+	{ "exaple", true },
+	{ "exmaple", true },
+	{ "exxample", true },
+	{ "exzzzzz", false },
+	{ "sample", true },
+	{ "xample", true },
+	{ "xxample", true },
+	{ "zzample", true },
+	{ "zzzmple", false },
+	{ "zzzzzzz", false },
+    };
+    Xapian::Database db = get_database("editdist2",
+				       [](Xapian::WritableDatabase& wdb,
+					  const string&)
+				       {
+					   for (auto&& t : terms) {
+					       Xapian::Document doc;
+					       doc.add_term(t.term);
+					       wdb.add_document(doc);
+					   }
+				       });
+
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query(Xapian::Query::OP_EDIT_DISTANCE, "example",
+				0, 0, Xapian::Query::OP_SYNONYM, 2));
+    Xapian::MSet mset = enq.get_mset(0, db.get_doccount());
+    set<Xapian::docid> matched(mset.begin(), mset.end());
+    for (Xapian::docid did = 1; did <= db.get_doccount(); ++did) {
+	tout << terms[did - 1].term << endl;
+	TEST_EQUAL(matched.count(did) != 0, terms[did - 1].match);
+    }
+
+    return true;
+}
+
 struct positional_testcase {
     int window;
     const char * terms[4];
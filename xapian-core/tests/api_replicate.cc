@@ -28,17 +28,32 @@
 
 #include <xapian.h>
 #include "api/replication.h"
+#include "net/replicatetcpclient.h"
+#include "net/replicatetcpserver.h"
 
 #include "apitest.h"
 #include "dbcheck.h"
 #include "errno_to_string.h"
 #include "fd.h"
 #include "filetests.h"
+#include "pack.h"
+#include "replicationprotocol.h"
 #include "safedirent.h"
 #include "safefcntl.h"
 #include "safesysstat.h"
 #include "safeunistd.h"
+#ifdef HAVE_SOCKETPAIR
+# include "safesyssocket.h"
+# include "safesyswait.h"
+#endif
+#ifdef HAVE_FORK
+# include <csignal>
+# include <iostream>
+# include <netinet/in.h>
+#endif
 #include "setenv.h"
+#include "str.h"
+#include "stringutils.h"
 #include "testsuite.h"
 #include "testutils.h"
 #include "unixcmds.h"
@@ -46,8 +61,10 @@
 #include <sys/types.h>
 
 #include <cerrno>
+#include <cstring>
 #include <cstdlib>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -908,3 +925,661 @@ DEFINE_TESTCASE(replicate7, replicas) {
 #endif
     return true;
 }
+
+// Test replication with compression.
+DEFINE_TESTCASE(replicate8, replicas) {
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+    UNSET_MAX_CHANGESETS_AFTERWARDS;
+    string tempdir = ".replicatmp";
+    mktmpdir(tempdir);
+    string masterpath = get_named_writable_database_path("master");
+
+    set_max_changesets(10);
+
+    Xapian::WritableDatabase orig(get_named_writable_database("master"));
+    Xapian::DatabaseMaster master(masterpath);
+    master.set_compression(true);
+    string replicapath = tempdir + "/replica";
+    {
+	Xapian::DatabaseReplica replica(replicapath);
+
+	// Add enough documents that the database files span several of the
+	// blocks they're compressed in.
+	for (int i = 0; i < 2000; ++i) {
+	    Xapian::Document doc;
+	    doc.set_data(string(1000, char('a' + i % 26)));
+	    doc.add_term("all");
+	    doc.add_term("Q" + str(i));
+	    orig.add_document(doc);
+	}
+	orig.commit();
+
+	int count = replicate(master, replica, tempdir, 0, 1, true);
+	TEST_EQUAL(count, 1);
+	check_equal_dbs(masterpath, replicapath);
+
+	Xapian::Document doc;
+	doc.add_term("all");
+	doc.add_term("Qnew");
+	orig.add_document(doc);
+	orig.commit();
+
+	count = replicate(master, replica, tempdir, 1, 0, true);
+	TEST_EQUAL(count, 2);
+	check_equal_dbs(masterpath, replicapath);
+
+	Xapian::Database dbcopy(replicapath);
+	for (Xapian::docid did = 1; did <= 2000; ++did) {
+	    TEST_EQUAL(dbcopy.get_document(did).get_data(),
+		       string(1000, char('a' + (did - 1) % 26)));
+	}
+
+	// Compressed data which won't inflate should be reported as a network
+	// problem, not a problem with a database.
+	string badpath = tempdir + "/changeset_bad";
+	{
+	    FD fd(open(badpath.c_str(),
+		       O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666));
+	    if (fd == -1)
+		FAIL_TEST("Open failed (when creating '" << badpath << "')");
+	    // A compressed FAIL message (0x80 flags it as compressed) with one
+	    // deflated block of 4 bytes, then the zero length which ends it.
+	    string bad;
+	    bad += char(REPL_REPLY_FAIL | 0x80);
+	    bad += char((4 << 1) | 1);
+	    bad += "\xff\xff\xff\xff";
+	    bad += '\0';
+	    do_write(fd, bad.data(), bad.size());
+	}
+	FD fd(open(badpath.c_str(), O_RDONLY | O_BINARY));
+	if (fd == -1)
+	    FAIL_TEST("Open failed (when reading '" << badpath << "')");
+	replica.set_read_fd(fd);
+	TEST_EXCEPTION(Xapian::NetworkError,
+		       replica.apply_next_changeset(NULL, 0));
+
+	// We need this inner scope to we close the replica before we remove
+	// the temporary directory on Windows.
+    }
+
+    rmtmpdir(tempdir);
+#endif
+    return true;
+}
+
+// Test streaming changes to a replica.
+DEFINE_TESTCASE(replicate9, replicas) {
+#if defined XAPIAN_HAS_REMOTE_BACKEND && defined HAVE_FORK && defined HAVE_SOCKETPAIR
+    UNSET_MAX_CHANGESETS_AFTERWARDS;
+    string tempdir = ".replicatmp";
+    mktmpdir(tempdir);
+    string masterpath = get_named_writable_database_path("master");
+
+    set_max_changesets(10);
+
+    Xapian::WritableDatabase orig(get_named_writable_database("master"));
+    Xapian::Document doc;
+    doc.add_term("all");
+    orig.add_document(doc);
+    orig.commit();
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, PF_UNSPEC, fds) < 0) {
+	FAIL_TEST("socketpair() failed");
+    }
+    pid_t child = fork();
+    if (child == -1)
+	FAIL_TEST("fork() failed");
+    if (child == 0) {
+	close(fds[0]);
+	try {
+	    Xapian::DatabaseMaster master(masterpath);
+	    master.stream_changesets_to_fd(fds[1], string(), 0.01);
+	} catch (...) {
+	    _exit(1);
+	}
+	_exit(0);
+    }
+    close(fds[1]);
+
+    string replicapath = tempdir + "/replica";
+    {
+	Xapian::DatabaseReplica replica(replicapath);
+	replica.set_read_fd(fds[0]);
+
+	// We should get a copy of the database, without asking for it.
+	Xapian::ReplicationInfo info;
+	TEST(!replica.apply_next_changeset(&info, 0));
+	TEST_EQUAL(info.fullcopy_count, 1);
+	check_equal_dbs(masterpath, replicapath);
+
+	// Then each commit should be sent as it happens.
+	for (int i = 0; i < 3; ++i) {
+	    orig.add_document(doc);
+	    orig.commit();
+	    int changesets = 0;
+	    while (replica.apply_next_changeset(&info, 0)) {
+		changesets += info.changeset_count;
+	    }
+	    TEST_EQUAL(changesets, 1);
+	    check_equal_dbs(masterpath, replicapath);
+	}
+    }
+
+    // Closing our end should make the master return.
+    close(fds[0]);
+    int status;
+    while (waitpid(child, &status, 0) < 0) {
+	if (errno != EINTR)
+	    FAIL_TEST("waitpid() failed");
+    }
+    TEST(WIFEXITED(status));
+    TEST_EQUAL(WEXITSTATUS(status), 0);
+
+    rmtmpdir(tempdir);
+#endif
+    return true;
+}
+
+// Test resuming an interrupted database copy, and receiving a copy over
+// several connections.
+DEFINE_TESTCASE(replicate10, replicas) {
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+    UNSET_MAX_CHANGESETS_AFTERWARDS;
+    string tempdir = ".replicatmp";
+    mktmpdir(tempdir);
+    string masterpath = get_named_writable_database_path("master");
+
+    set_max_changesets(10);
+
+    Xapian::WritableDatabase orig(get_named_writable_database("master"));
+    Xapian::DatabaseMaster master(masterpath);
+    string replicapath = tempdir + "/replica";
+    string replica2path = tempdir + "/replica2";
+    {
+	Xapian::DatabaseReplica replica(replicapath);
+
+	for (int i = 0; i < 2000; ++i) {
+	    Xapian::Document doc;
+	    doc.set_data(string(1000, char('a' + i % 26)));
+	    doc.add_term("all");
+	    doc.add_term("Q" + str(i));
+	    orig.add_document(doc);
+	}
+	orig.commit();
+
+	string changesetpath = tempdir + "/changeset";
+	get_changeset(changesetpath, master, replica, 0, 1, true);
+	off_t full_size = get_file_size(changesetpath);
+
+	// Cut the copy short.
+	string brokenpath = tempdir + "/changeset_broken";
+	truncated_copy(changesetpath, brokenpath, full_size * 3 / 4);
+	TEST_EXCEPTION(Xapian::NetworkError,
+		       apply_changeset(brokenpath, replica, 0, 1, true));
+
+	// The master should only need to send the rest of the copy.
+	get_changeset(changesetpath, master, replica, 0, 1, true);
+	TEST_REL(get_file_size(changesetpath), <, full_size);
+	TEST_EQUAL(apply_changeset(changesetpath, replica, 0, 1, true), 1);
+	check_equal_dbs(masterpath, replicapath);
+
+	// Now receive a copy in three parts, and check that the copy then
+	// sent by write_changesets_to_fd() contains no ranges.
+	Xapian::DatabaseReplica replica2(replica2path);
+	string revision = replica2.get_revision_info();
+	vector<int> fds;
+	for (unsigned i = 0; i != 3; ++i) {
+	    string partpath = tempdir + "/part" + str(i);
+	    {
+		FD fd(open(partpath.c_str(),
+			   O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666));
+		if (fd == -1)
+		    FAIL_TEST("Open failed (when creating '" << partpath << "')");
+		master.write_copy_ranges_to_fd(fd, revision, i, 3);
+	    }
+	    int fd = open(partpath.c_str(), O_RDONLY | O_BINARY);
+	    if (fd == -1)
+		FAIL_TEST("Open failed (when reading '" << partpath << "')");
+	    fds.push_back(fd);
+	}
+	replica2.apply_copy_ranges(fds);
+	for (int fd : fds) close(fd);
+
+	get_changeset(changesetpath, master, replica2, 0, 1, true);
+	TEST_REL(get_file_size(changesetpath), <, 1000);
+	TEST_EQUAL(apply_changeset(changesetpath, replica2, 0, 1, true), 1);
+	check_equal_dbs(masterpath, replica2path);
+
+	// A replica which is up to date doesn't need any ranges.
+	revision = replica2.get_revision_info();
+	string partpath = tempdir + "/part";
+	{
+	    FD fd(open(partpath.c_str(),
+		       O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666));
+	    master.write_copy_ranges_to_fd(fd, revision, 0, 1);
+	}
+	TEST_EQUAL(get_file_size(partpath), 2);
+
+	TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		       master.write_copy_ranges_to_fd(-1, revision, 1, 1));
+
+	// We need this inner scope to we close the replicas before we remove
+	// the temporary directory on Windows.
+    }
+
+    rmtmpdir(tempdir);
+#endif
+    return true;
+}
+
+// Count the changesets kept in either of the databases in a replica.
+static int
+count_relay_changesets(const string & replicapath)
+{
+    int count = 0;
+    for (const char * subdir : { "/replica_0", "/replica_1" }) {
+	DIR * dir = opendir((replicapath + subdir).c_str());
+	if (!dir) continue;
+	while (struct dirent * entry = readdir(dir)) {
+	    string name = entry->d_name;
+	    if (startswith(name, "changes") && name != "changestmp")
+		++count;
+	}
+	closedir(dir);
+    }
+    return count;
+}
+
+// Test a replica relaying changesets to a further replica.
+DEFINE_TESTCASE(replicate11, replicas) {
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+    UNSET_MAX_CHANGESETS_AFTERWARDS;
+    string tempdir = ".replicatmp";
+    mktmpdir(tempdir);
+    string masterpath = get_named_writable_database_path("master");
+
+    set_max_changesets(10);
+
+    Xapian::Document doc;
+    doc.set_data("doc");
+    doc.add_posting("doc", 1);
+
+    Xapian::WritableDatabase orig(get_named_writable_database("master"));
+    Xapian::DatabaseMaster master(masterpath);
+    string relaypath = tempdir + "/relay";
+    string replicapath = tempdir + "/replica";
+    {
+	Xapian::DatabaseReplica relay(relaypath);
+	relay.set_relay_changesets(2);
+	Xapian::DatabaseMaster relay_master(relaypath);
+	Xapian::DatabaseReplica replica(replicapath);
+
+	orig.add_document(doc);
+	orig.commit();
+
+	// The first update needs a copy at each level.
+	replicate(master, relay, tempdir, 0, 1, true);
+	replicate(relay_master, replica, tempdir, 0, 1, true);
+	check_equal_dbs(masterpath, replicapath);
+	TEST_EQUAL(count_relay_changesets(relaypath), 0);
+
+	// After that, the relay can send on the changesets it applies.
+	orig.add_document(doc);
+	orig.commit();
+	orig.add_document(doc);
+	orig.commit();
+	replicate(master, relay, tempdir, 2, 0, true);
+	TEST_EQUAL(count_relay_changesets(relaypath), 2);
+	replicate(relay_master, replica, tempdir, 2, 0, true);
+	check_equal_dbs(masterpath, replicapath);
+
+	// The relay only keeps 2 changesets, so a replica which is further
+	// behind than that needs a copy.
+	for (int i = 0; i < 3; ++i) {
+	    orig.add_document(doc);
+	    orig.commit();
+	}
+	replicate(master, relay, tempdir, 3, 0, true);
+	TEST_EQUAL(count_relay_changesets(relaypath), 2);
+	replicate(relay_master, replica, tempdir, 0, 1, true);
+	check_equal_dbs(masterpath, replicapath);
+
+	orig.add_document(doc);
+	orig.commit();
+	replicate(master, relay, tempdir, 1, 0, true);
+	replicate(relay_master, replica, tempdir, 1, 0, true);
+	check_equal_dbs(masterpath, replicapath);
+
+	// We need this inner scope to we close the replicas before we remove
+	// the temporary directory on Windows.
+    }
+
+    rmtmpdir(tempdir);
+#endif
+    return true;
+}
+
+#if defined XAPIAN_HAS_REMOTE_BACKEND && defined HAVE_FORK && defined HAVE_SOCKETPAIR
+/// A replication server running in a child process.
+class ReplicateServerProcess {
+    pid_t child = -1;
+
+    int port = 0;
+
+  public:
+    /// Start a server for the databases in directory @a path.
+    explicit ReplicateServerProcess(const string & path,
+				    bool compress = false);
+
+    ~ReplicateServerProcess();
+
+    int get_port() const { return port; }
+};
+
+ReplicateServerProcess::ReplicateServerProcess(const string & path,
+					       bool compress)
+{
+    // Find a free port by letting the kernel pick one.
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (fd < 0 ||
+	bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+	getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len) < 0) {
+	FAIL_TEST("Couldn't find a free port");
+    }
+    port = ntohs(addr.sin_port);
+    close(fd);
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, PF_UNSPEC, fds) < 0) {
+	FAIL_TEST("socketpair() failed");
+    }
+    // Don't let the child flush our buffered output a second time.
+    cout.flush();
+    cerr.flush();
+    child = fork();
+    if (child == -1)
+	FAIL_TEST("fork() failed");
+    if (child == 0) {
+	close(fds[0]);
+	// Put the server's processes in their own process group so they can
+	// all be killed together.
+	setpgid(0, 0);
+	// A client closing a connection early shouldn't kill the process
+	// serving it.
+	signal(SIGPIPE, SIG_IGN);
+	try {
+	    ReplicateTcpServer server("127.0.0.1", port, path, compress);
+	    // A client can have several connections open at once, so serve
+	    // them from several processes.  We can't use run() as it calls
+	    // exit() in the processes it forks, which would run our atexit
+	    // handlers.
+	    bool worker = false;
+	    for (int i = 0; i != 4 && !worker; ++i) {
+		pid_t pid = fork();
+		if (pid < 0)
+		    _exit(1);
+		worker = (pid == 0);
+	    }
+	    if (!worker && write(fds[1], "", 1) != 1)
+		_exit(1);
+	    close(fds[1]);
+	    while (true)
+		server.run_once();
+	} catch (...) {
+	}
+	_exit(1);
+    }
+    close(fds[1]);
+    char ch;
+    ssize_t n;
+    do {
+	n = read(fds[0], &ch, 1);
+    } while (n < 0 && errno == EINTR);
+    close(fds[0]);
+    if (n != 1)
+	FAIL_TEST("Replication server failed to start");
+}
+
+ReplicateServerProcess::~ReplicateServerProcess()
+{
+    kill(-child, SIGKILL);
+    // The child may already have been reaped by a SIGCHLD handler.
+    while (waitpid(child, NULL, 0) < 0 && errno == EINTR) { }
+}
+
+/** Send a request for a copy of @a dbname to a replication server.
+ *
+ *  @param greeting	The contents of the 'V' message to start with, or
+ *			an empty string to send none (as version 1 did).
+ *
+ *  @return Everything the server sends in reply.
+ */
+static string
+raw_replicate_request(int port, const string & greeting,
+		      const string & dbname)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (fd < 0 ||
+	connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+	FAIL_TEST("Couldn't connect to replication server");
+    }
+    // Each message is its type, then its length (all these are short enough
+    // for that to be a single byte), then its contents.
+    string request;
+    if (!greeting.empty())
+	request += 'V' + string(1, char(greeting.size())) + greeting;
+    request += 'R' + string(1, '\0');
+    request += 'D' + string(1, char(dbname.size())) + dbname;
+    do_write(fd, request.data(), request.size());
+    string reply;
+    char buf[4096];
+    size_t n;
+    while ((n = do_read(fd, buf, sizeof(buf))) != 0) {
+	reply.append(buf, n);
+	if (n < sizeof(buf)) break;
+    }
+    close(fd);
+    return reply;
+}
+
+/** Return the types of the uncompressed messages in @a data.
+ *
+ *  Fails the test if any message is compressed.
+ */
+static string
+uncompressed_message_types(const string & data)
+{
+    string types;
+    size_t i = 0;
+    while (i != data.size()) {
+	unsigned char type = data[i++];
+	// RemoteConnection sets the top bit of the type of a compressed
+	// message.
+	TEST(!(type & 0x80));
+	TEST(i != data.size());
+	size_t len = static_cast<unsigned char>(data[i++]);
+	if (len == 0xff) {
+	    len = 0;
+	    int shift = 0;
+	    unsigned char ch;
+	    do {
+		TEST(i != data.size());
+		ch = data[i++];
+		len |= size_t(ch & 0x7f) << shift;
+		shift += 7;
+	    } while ((ch & 0x80) == 0);
+	    len += 255;
+	}
+	TEST_REL(len, <=, data.size() - i);
+	i += len;
+	types += char(type);
+    }
+    return types;
+}
+#endif
+
+// Test replicating over TCP, receiving copies over several connections.
+DEFINE_TESTCASE(replicate12, replicas) {
+#if defined XAPIAN_HAS_REMOTE_BACKEND && defined HAVE_FORK && defined HAVE_SOCKETPAIR
+    UNSET_MAX_CHANGESETS_AFTERWARDS;
+    string tempdir = ".replicatmp";
+    mktmpdir(tempdir);
+    string masterpath = get_named_writable_database_path("master");
+    string::size_type slash = masterpath.rfind('/');
+    string masterdir(masterpath, 0, slash);
+    string mastername(masterpath, slash + 1);
+
+    set_max_changesets(10);
+
+    Xapian::WritableDatabase orig(get_named_writable_database("master"));
+    for (int i = 0; i < 2000; ++i) {
+	Xapian::Document doc;
+	doc.set_data(string(1000, char('a' + i % 26)));
+	doc.add_term("all");
+	doc.add_term("Q" + str(i));
+	orig.add_document(doc);
+    }
+    orig.commit();
+
+    Xapian::Document doc;
+    doc.add_term("all");
+
+    ReplicateServerProcess server(masterdir);
+    string replicapath = tempdir + "/replica";
+    string replica2path = tempdir + "/replica2";
+    {
+	// The first update needs a copy, which is received in three parts.
+	Xapian::ReplicationInfo info;
+	ReplicateTcpClient("127.0.0.1", server.get_port(), 10.0, 10.0).
+	    update_from_master(replicapath, mastername, info, 0, false, 3);
+	TEST_EQUAL(info.fullcopy_count, 1);
+	TEST_EQUAL(info.changeset_count, 0);
+	check_equal_dbs(masterpath, replicapath);
+
+	// Later updates only need changesets, so shouldn't try to copy.
+	orig.add_document(doc);
+	orig.commit();
+	ReplicateTcpClient("127.0.0.1", server.get_port(), 10.0, 10.0).
+	    update_from_master(replicapath, mastername, info, 0, false, 3);
+	TEST_EQUAL(info.fullcopy_count, 0);
+	TEST_EQUAL(info.changeset_count, 1);
+	check_equal_dbs(masterpath, replicapath);
+
+	// An up to date replica gets nothing.
+	ReplicateTcpClient("127.0.0.1", server.get_port(), 10.0, 10.0).
+	    update_from_master(replicapath, mastername, info, 0, false, 3);
+	TEST_EQUAL(info.fullcopy_count, 0);
+	TEST_EQUAL(info.changeset_count, 0);
+	TEST(!info.changed);
+
+	// Streaming to a new replica also starts with a copy in parts.
+	ReplicateTcpClient client("127.0.0.1", server.get_port(), 10.0, 10.0);
+	client.start_streaming(replica2path, mastername, false, 3);
+	client.apply_streamed_changes(info, 0);
+	TEST_EQUAL(info.fullcopy_count, 1);
+	check_equal_dbs(masterpath, replica2path);
+
+	orig.add_document(doc);
+	orig.commit();
+	int changesets = 0;
+	while (changesets == 0) {
+	    client.apply_streamed_changes(info, 0);
+	    changesets += info.changeset_count;
+	}
+	TEST_EQUAL(changesets, 1);
+	check_equal_dbs(masterpath, replica2path);
+
+	// We need this inner scope to we close the replicas before we remove
+	// the temporary directory on Windows.
+    }
+
+    rmtmpdir(tempdir);
+#endif
+    return true;
+}
+
+// Test the greeting which starts each replication connection.
+DEFINE_TESTCASE(replicate13, replicas) {
+#if defined XAPIAN_HAS_REMOTE_BACKEND && defined HAVE_FORK && defined HAVE_SOCKETPAIR
+    string tempdir = ".replicatmp";
+    mktmpdir(tempdir);
+    string masterpath = get_named_writable_database_path("master");
+    string::size_type slash = masterpath.rfind('/');
+    string masterdir(masterpath, 0, slash);
+    string mastername(masterpath, slash + 1);
+
+    Xapian::WritableDatabase orig(get_named_writable_database("master"));
+    for (int i = 0; i < 200; ++i) {
+	Xapian::Document doc;
+	doc.set_data(string(1000, char('a' + i % 26)));
+	doc.add_term("all");
+	orig.add_document(doc);
+    }
+    orig.commit();
+
+    ReplicateServerProcess server(masterdir, true);
+    string replicapath = tempdir + "/replica";
+    {
+	// A client which doesn't accept compressed data isn't sent any, even
+	// though the server compresses.
+	string greeting;
+	pack_uint(greeting, unsigned(XAPIAN_REPLICATION_PROTOCOL_MAJOR_VERSION));
+	pack_uint(greeting, unsigned(XAPIAN_REPLICATION_PROTOCOL_MINOR_VERSION));
+	pack_bool(greeting, false);
+	string plain = raw_replicate_request(server.get_port(), greeting,
+					     mastername);
+	string types = uncompressed_message_types(plain);
+	TEST(!types.empty());
+	TEST_EQUAL(types[0], char(REPL_REPLY_DB_HEADER));
+	TEST_EQUAL(types.back(), char(REPL_REPLY_END_OF_CHANGES));
+
+	// One which does is sent much less.
+	greeting.back() = '1';
+	string compressed = raw_replicate_request(server.get_port(), greeting,
+						  mastername);
+	TEST_REL(compressed.size(), <, plain.size() / 2);
+
+	// A client which speaks version 1 of the protocol sends no greeting,
+	// and should be told it can't be served.
+	string old = raw_replicate_request(server.get_port(), string(),
+					   mastername);
+	types = uncompressed_message_types(old);
+	TEST_EQUAL(types, string(1, char(REPL_REPLY_FAIL)));
+
+	// And so should a client which speaks a later version.
+	greeting.resize(0);
+	unsigned later_major = XAPIAN_REPLICATION_PROTOCOL_MAJOR_VERSION + 1;
+	pack_uint(greeting, later_major);
+	pack_uint(greeting, 0u);
+	pack_bool(greeting, true);
+	string later = raw_replicate_request(server.get_port(), greeting,
+					     mastername);
+	types = uncompressed_message_types(later);
+	TEST_EQUAL(types, string(1, char(REPL_REPLY_FAIL)));
+
+	// The usual client gets a compressed copy, which it can apply.
+	Xapian::ReplicationInfo info;
+	ReplicateTcpClient("127.0.0.1", server.get_port(), 10.0, 10.0).
+	    update_from_master(replicapath, mastername, info, 0, false);
+	TEST_EQUAL(info.fullcopy_count, 1);
+	check_equal_dbs(masterpath, replicapath);
+
+	// We need this inner scope to we close the replica before we remove
+	// the temporary directory on Windows.
+    }
+
+    rmtmpdir(tempdir);
+#endif
+    return true;
+}
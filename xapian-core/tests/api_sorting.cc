@@ -360,6 +360,52 @@ DEFINE_TESTCASE(sortfunctorremote1, remote) {
     return true;
 }
 
+/// Test MaterialisedKeyMaker, which should also work with remote databases.
+DEFINE_TESTCASE(materialisedkeymaker1, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+    Xapian::MultiValueKeyMaker keymaker;
+    keymaker.add_value(0);
+    keymaker.add_value(1, true);
+    Xapian::MaterialisedKeyMaker sorter(&keymaker, 5);
+    static const char* const values[][2] = {
+	{ "b", "x" }, { "a", "y" }, { "b", "z" }, { "a", "x" }, { "", "y" }
+    };
+    for (auto&& v : values) {
+	Xapian::Document doc;
+	doc.add_term("foo");
+	doc.add_value(0, v[0]);
+	doc.add_value(1, v[1]);
+	sorter.materialise(doc);
+	TEST_EQUAL(doc.get_value(5), keymaker(doc));
+	db.add_document(doc);
+    }
+    db.commit();
+
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("foo"));
+    enquire.set_sort_by_key(&sorter, false);
+    Xapian::MSet mset = enquire.get_mset(0, 10);
+    mset_expect_order(mset, 5, 2, 4, 3, 1);
+
+    enquire.set_sort_by_key_then_relevance(&sorter, true);
+    mset = enquire.get_mset(0, 10);
+    mset_expect_order(mset, 1, 3, 4, 2, 5);
+
+    // A MaterialisedKeyMaker for searching only doesn't need a KeyMaker.
+    Xapian::MaterialisedKeyMaker search_sorter(NULL, 5);
+    enquire.set_sort_by_relevance_then_key(&search_sorter, false);
+    mset = enquire.get_mset(0, 10);
+    mset_expect_order(mset, 5, 2, 4, 3, 1);
+
+    Xapian::Document doc;
+    TEST_EXCEPTION(Xapian::InvalidOperationError,
+		   search_sorter.materialise(doc));
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   Xapian::MaterialisedKeyMaker(&keymaker, Xapian::BAD_VALUENO));
+
+    return true;
+}
+
 DEFINE_TESTCASE(replace_weights1, backend) {
     Xapian::Database mydb(get_database("apitest_onedoc"));
     Xapian::Enquire enquire(mydb);
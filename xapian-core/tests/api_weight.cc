@@ -136,6 +136,38 @@ DEFINE_TESTCASE(bm25weight5, backend) {
     return true;
 }
 
+/// BM25Weight subclass which scales the per-term weights by a half.
+class HalfBM25Weight : public Xapian::BM25Weight {
+    HalfBM25Weight * clone() const {
+	return new HalfBM25Weight();
+    }
+
+  public:
+    double get_sumpart(Xapian::termcount wdf, Xapian::termcount doclen,
+		       Xapian::termcount uniqterms) const {
+	return BM25Weight::get_sumpart(wdf, doclen, uniqterms) * 0.5;
+    }
+};
+
+/// Check the matcher's direct call for BM25Weight isn't used for subclasses.
+DEFINE_TESTCASE(bm25weight6, backend && !remote) {
+    Xapian::Database db = get_database("apitest_simpledata");
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("paragraph"));
+
+    Xapian::MSet mset1 = enquire.get_mset(0, 10);
+    enquire.set_weighting_scheme(HalfBM25Weight());
+    Xapian::MSet mset2 = enquire.get_mset(0, 10);
+    TEST_EQUAL(mset1.size(), 5);
+    TEST_EQUAL(mset2.size(), 5);
+    for (Xapian::doccount i = 0; i != mset1.size(); ++i) {
+	TEST_EQUAL(*mset1[i], *mset2[i]);
+	TEST_EQUAL_DOUBLE(mset1[i].get_weight() * 0.5, mset2[i].get_weight());
+    }
+
+    return true;
+}
+
 // Test exception for junk after serialised weight.
 DEFINE_TESTCASE(bm25plusweight1, !backend) {
     Xapian::BM25PlusWeight wt(2.0, 0.1, 1.3, 0.6, 0.01, 0.5);
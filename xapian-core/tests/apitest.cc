@@ -115,6 +115,14 @@ get_remote_database(const string &dbname, unsigned int timeout)
     return backendmanager->get_remote_database(dbnames, timeout);
 }
 
+int
+get_remote_database_port(const string &dbname, unsigned int timeout)
+{
+    vector<string> dbnames;
+    dbnames.push_back(dbname);
+    return backendmanager->get_remote_database_port(dbnames, timeout);
+}
+
 Xapian::Database
 get_writable_database_as_database()
 {
@@ -236,6 +236,16 @@ BackendManager::get_remote_database(const vector<string> &, unsigned int)
     throw Xapian::InvalidOperationError(msg);
 }
 
+int
+BackendManager::get_remote_database_port(const vector<string> &, unsigned int)
+{
+    string msg = "BackendManager::get_remote_database_port() called for "
+		 "non-remotetcp database (type is ";
+    msg += get_dbtype();
+    msg += ')';
+    throw Xapian::InvalidOperationError(msg);
+}
+
 Xapian::Database
 BackendManager::get_writable_database_as_database()
 {
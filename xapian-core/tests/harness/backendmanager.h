@@ -129,6 +129,12 @@ class BackendManager {
     /// Get a remote database instance with the specified timeout.
     virtual Xapian::Database get_remote_database(const std::vector<std::string> & files, unsigned int timeout);
 
+    /** Start a TCP server for a remote database, and return its port.
+     *
+     *  Unlike get_remote_database(), this doesn't connect to the server.
+     */
+    virtual int get_remote_database_port(const std::vector<std::string> & files, unsigned int timeout);
+
     /// Create a Database object for the last opened WritableDatabase.
     virtual Xapian::Database get_writable_database_as_database();
 
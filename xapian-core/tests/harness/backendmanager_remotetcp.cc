@@ -367,6 +367,13 @@ BackendManagerRemoteTcp::get_remote_database(const vector<string> & files,
     return Xapian::Remote::open(LOCALHOST, port);
 }
 
+int
+BackendManagerRemoteTcp::get_remote_database_port(const vector<string> & files,
+						  unsigned int timeout)
+{
+    return launch_xapian_tcpsrv(get_remote_database_args(files, timeout));
+}
+
 Xapian::Database
 BackendManagerRemoteTcp::get_writable_database_as_database()
 {
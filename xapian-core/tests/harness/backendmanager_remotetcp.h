@@ -58,6 +58,10 @@ class BackendManagerRemoteTcp : public BackendManagerRemote {
     Xapian::Database get_remote_database(const std::vector<std::string> & files,
 					 unsigned int timeout);
 
+    /// Start a server for a remote database, and return its port.
+    int get_remote_database_port(const std::vector<std::string> & files,
+				 unsigned int timeout);
+
     /// Create a Database object for the last opened WritableDatabase.
     Xapian::Database get_writable_database_as_database();
 
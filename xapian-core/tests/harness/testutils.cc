@@ -26,6 +26,7 @@
 
 #include "testsuite.h"
 
+#include <cstdlib>
 #include <fstream>
 #include <vector>
 
@@ -215,3 +216,25 @@ test_mset_order_equal(const Xapian::MSet &mset1, const Xapian::MSet &mset2)
 			 mset1 << "\n !=\n" << mset2);
     }
 }
+
+unsigned long long
+server_stat(const Xapian::Database& db, const string& name)
+{
+    string status = db.get_server_status();
+    unsigned long long total = 0;
+    bool found = false;
+    size_t i = 0;
+    while (i < status.size()) {
+	size_t eol = status.find('\n', i);
+	if (eol == string::npos) eol = status.size();
+	if (status.compare(i, name.size(), name) == 0 &&
+	    status[i + name.size()] == ' ') {
+	    total += strtoull(status.c_str() + i + name.size() + 1, NULL, 10);
+	    found = true;
+	}
+	i = eol + 1;
+    }
+    if (!found)
+	FAIL_TEST("No " << name << " in status: " << status);
+    return total;
+}
@@ -65,6 +65,14 @@ void mset_expect_order(const Xapian::MSet &A,
 void test_mset_order_equal(const Xapian::MSet &mset1,
 			   const Xapian::MSet &mset2);
 
+/** Return the total of counter @ name over the shards of @a db.
+ *
+ *  The counters are read from Database::get_server_status().  Fails the
+ *  test if no shard reports @a name.
+ */
+unsigned long long server_stat(const Xapian::Database& db,
+			       const std::string& name);
+
 // ######################################################################
 // Useful test macros
 
@@ -0,0 +1,91 @@
+/** @file perftest_weight.cc
+ * @brief performance tests for weighting schemes
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "perftest/perftest_weight.h"
+
+#include <xapian.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "backendmanager.h"
+#include "perftest.h"
+#include "str.h"
+#include "testrunner.h"
+#include "testsuite.h"
+#include "testutils.h"
+
+using namespace std;
+
+static void
+builddb_longdocs1(Xapian::WritableDatabase &db, const string & dbname)
+{
+    logger.testcase_begin(dbname);
+    unsigned int runsize = 20000;
+
+    std::map<std::string, std::string> params;
+    params["runsize"] = str(runsize);
+    logger.indexing_begin(dbname, params);
+    for (unsigned int i = 0; i < runsize; ++i) {
+	Xapian::Document doc;
+	// Documents average about 500 words, so the BM25 tables are the
+	// maximum size, but each "R" term only indexes a few documents.
+	doc.add_term("common", 400 + i % 200);
+	doc.add_term("R" + str(i % 5000));
+	doc.add_term("R" + str((i * 7 + 3) % 5000));
+	db.replace_document(i + 1, doc);
+	logger.indexing_add();
+    }
+    db.commit();
+    logger.indexing_end();
+    logger.testcase_end();
+}
+
+// Test the performance of BM25 for queries with many rare terms.
+DEFINE_TESTCASE(bm25manyterms1, writable && !remote && !inmemory) {
+    Xapian::Database db;
+    db = backendmanager->get_database("longdocs1", builddb_longdocs1,
+				      "longdocs1");
+
+    logger.testcase_begin("bm25manyterms1");
+    Xapian::Enquire enquire(db);
+
+    for (unsigned int n_terms : { 10, 100, 1000 }) {
+	vector<Xapian::Query> subqs;
+	for (unsigned int i = 0; i != n_terms; ++i)
+	    subqs.emplace_back("R" + str(i * 3));
+	Xapian::Query query(Xapian::Query::OP_OR, subqs.begin(), subqs.end());
+	enquire.set_query(query);
+
+	logger.searching_start("BM25 OR of " + str(n_terms) + " rare terms");
+	for (int rep = 0; rep != 100; ++rep) {
+	    logger.search_start();
+	    Xapian::MSet mset = enquire.get_mset(0, 10);
+	    logger.search_end(query, mset);
+	    TEST_EQUAL(mset.size(), 10);
+	}
+	logger.searching_end();
+    }
+
+    logger.testcase_end();
+    return true;
+}
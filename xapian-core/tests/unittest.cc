@@ -33,6 +33,7 @@
 #include <utility>
 
 #include "safeunistd.h"
+#include "safesyswait.h"
 
 #define XAPIAN_UNITTEST
 static const char * unittest_assertion_failed = NULL;
@@ -84,6 +85,9 @@ using namespace std;
 #include "../common/str.cc"
 #include "../backends/uuids.cc"
 #include "../net/length.cc"
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+# include "../net/remotecache.cc"
+#endif
 #include "../net/serialise-error.cc"
 #include "../api/error.cc"
 #include "../api/sortable-serialise.cc"
@@ -419,6 +423,62 @@ static bool test_serialiseerror1()
 
     return true;
 }
+
+// Test RemoteCache.
+static bool test_remotecache1()
+{
+    // Room for 8 slots in two sets.
+    RemoteCache cache(8 * 256 + 256, 256);
+    TEST(cache.enabled());
+    string value;
+    TEST(!cache.find("a", value));
+    cache.insert("a", "A");
+    TEST(cache.find("a", value));
+    TEST_EQUAL(value, "A");
+    TEST_EQUAL(cache.get_hits(), 1);
+    TEST_EQUAL(cache.get_misses(), 1);
+    TEST_EQUAL(cache.get_entries(), 1);
+    TEST_EQUAL(cache.get_size(), 2);
+
+    // Too big for a slot.
+    cache.insert("b", string(256, 'B'));
+    TEST(!cache.find("b", value));
+    TEST_EQUAL(cache.get_entries(), 1);
+
+    // Filling the cache evicts the least recently used entries, but never
+    // more than the number of entries stored.
+    for (int i = 0; i != 100; ++i) {
+	cache.insert(str(i), str(i * 2));
+	TEST(cache.get_entries() <= 8);
+    }
+    TEST(!cache.find("a", value));
+    TEST(cache.find("99", value));
+    TEST_EQUAL(value, "198");
+
+    // Too small to hold any slots.
+    RemoteCache tiny(100, 256);
+    TEST(!tiny.enabled());
+    tiny.insert("a", "A");
+    TEST(!tiny.find("a", value));
+
+#ifdef HAVE_FORK
+    // Entries added by a child process (e.g. xapian-tcpsrv handling another
+    // connection) are visible to the parent.
+    pid_t child = fork();
+    TEST(child != -1);
+    if (child == 0) {
+	cache.insert("child", "from child");
+	_exit(0);
+    }
+    int status;
+    TEST_EQUAL(waitpid(child, &status, 0), child);
+    TEST(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    TEST(cache.find("child", value));
+    TEST_EQUAL(value, "from child");
+#endif
+
+    return true;
+}
 #endif
 
 // Test log2() (which might be our replacement version).
@@ -931,6 +991,7 @@ static const test_desc tests[] = {
     TESTCASE(serialiselength1),
     TESTCASE(serialiselength2),
     TESTCASE(serialiseerror1),
+    TESTCASE(remotecache1),
 #endif
     TESTCASE(log2),
     TESTCASE(sortableserialise1),
@@ -40,8 +40,11 @@ namespace Xapian {
 BM25PlusWeight *
 BM25PlusWeight::clone() const
 {
-    return new BM25PlusWeight(param_k1, param_k2, param_k3, param_b,
-			      param_min_normlen, param_delta);
+    BM25PlusWeight* wt = new BM25PlusWeight(param_k1, param_k2, param_k3,
+					    param_b, param_min_normlen,
+					    param_delta);
+    wt->set_kernel_(KERNEL_BM25PLUS);
+    return wt;
 }
 
 void
@@ -75,6 +78,9 @@ BM25PlusWeight::init(double factor)
     }
 
     LOGVALUE(WTCALC, len_factor);
+
+    Xapian::Weight::Internal::bm25_denominator_table(denom_table, len_factor,
+						     get_average_length());
 }
 
 string
@@ -122,10 +128,12 @@ BM25PlusWeight::get_sumpart(Xapian::termcount wdf, Xapian::termcount len,
 			    Xapian::termcount) const
 {
     LOGCALL(WTCALC, double, "BM25PlusWeight::get_sumpart", wdf | len);
-    Xapian::doclength normlen = max(len * len_factor, param_min_normlen);
-
     double wdf_double = wdf;
-    double denom = param_k1 * (normlen * param_b + (1 - param_b)) + wdf_double;
+    double denom =
+	Xapian::Weight::Internal::bm25_denominator(denom_table, len,
+						   len_factor, param_k1,
+						   param_b, param_min_normlen);
+    denom += wdf_double;
     AssertRel(denom,>,0);
     // Parameter delta (δ) is a pseudo tf value to control the scale of the
     // tf lower bound. δ can be tuned for e.g from 0.0 to 1.5 but BM25+ can
@@ -39,8 +39,10 @@ namespace Xapian {
 BM25Weight *
 BM25Weight::clone() const
 {
-    return new BM25Weight(param_k1, param_k2, param_k3, param_b,
-			  param_min_normlen);
+    BM25Weight* wt = new BM25Weight(param_k1, param_k2, param_k3, param_b,
+				    param_min_normlen);
+    wt->set_kernel_(KERNEL_BM25);
+    return wt;
 }
 
 void
@@ -127,6 +129,9 @@ BM25Weight::init(double factor)
     }
 
     LOGVALUE(WTCALC, len_factor);
+
+    Xapian::Weight::Internal::bm25_denominator_table(denom_table, len_factor,
+						     get_average_length());
 }
 
 string
@@ -172,10 +177,12 @@ BM25Weight::get_sumpart(Xapian::termcount wdf, Xapian::termcount len,
 			Xapian::termcount) const
 {
     LOGCALL(WTCALC, double, "BM25Weight::get_sumpart", wdf | len);
-    Xapian::doclength normlen = max(len * len_factor, param_min_normlen);
-
     double wdf_double = wdf;
-    double denom = param_k1 * (normlen * param_b + (1 - param_b)) + wdf_double;
+    double denom =
+	Xapian::Weight::Internal::bm25_denominator(denom_table, len,
+						   len_factor, param_k1,
+						   param_b, param_min_normlen);
+    denom += wdf_double;
     AssertRel(denom,>,0);
     RETURN(termweight * (wdf_double / denom));
 }
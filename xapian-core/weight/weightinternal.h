@@ -32,10 +32,12 @@
 #include "internaltypes.h"
 #include "omassert.h"
 
+#include <algorithm>
 #include <cerrno>
 #include <cstdlib>
 #include <map>
 #include <string>
+#include <vector>
 
 /// The frequencies for a term.
 struct TermFreqs {
@@ -267,6 +269,55 @@ class Weight::Internal {
 	m += "'";
 	throw InvalidArgumentError(m);
     }
+
+    /** Set up a table of the length normalisation part of the BM25
+     *  denominator.
+     *
+     *  Entry @a len of @a table is filled in by bm25_denominator() the first
+     *  time it's needed, so a term only pays for the document lengths it
+     *  actually sees (which matters for the many terms with few postings).
+     *  The table covers document lengths up to about twice the average,
+     *  which should include most documents, and is left empty if
+     *  @a len_factor is zero.
+     */
+    static void bm25_denominator_table(std::vector<double>& table,
+				       Xapian::doclength len_factor,
+				       double average_length) {
+	table.clear();
+	if (len_factor == 0)
+	    return;
+	const Xapian::termcount MAX_TABLE_SIZE = 1024;
+	Xapian::termcount size = MAX_TABLE_SIZE;
+	if (average_length * 2 < MAX_TABLE_SIZE)
+	    size = Xapian::termcount(average_length * 2) + 1;
+	// 0 marks entries not calculated yet.  A calculated entry can only be
+	// 0 if k1 or b is, in which case we just calculate it each time.
+	table.assign(size, 0.0);
+    }
+
+    /** Return the length normalisation part of the BM25 denominator:
+     *
+     *  k1 * (max(len * len_factor, min_normlen) * b + (1 - b))
+     *
+     *  using and filling in @a table (see bm25_denominator_table()).
+     */
+    static double bm25_denominator(std::vector<double>& table,
+				   Xapian::termcount len,
+				   Xapian::doclength len_factor,
+				   double k1, double b,
+				   Xapian::doclength min_normlen) {
+	double* entry = NULL;
+	if (usual(len < table.size())) {
+	    entry = &table[len];
+	    if (usual(*entry != 0))
+		return *entry;
+	}
+	Xapian::doclength normlen = std::max(len * len_factor, min_normlen);
+	double denom = k1 * (normlen * b + (1 - b));
+	if (entry)
+	    *entry = denom;
+	return denom;
+    }
 };
 
 }